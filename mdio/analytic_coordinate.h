@@ -0,0 +1,219 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_ANALYTIC_COORDINATE_H_
+#define MDIO_ANALYTIC_COORDINATE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "mdio/variable.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace internal {
+// The key under ["metadata"]["attributes"] declaring an analytic coordinate.
+constexpr char kAnalyticCoordinateKey[] = "analyticCoordinate";
+}  // namespace internal
+
+/**
+ * @brief A regularly sampled 1-D dimension coordinate, value = start + step * i
+ * Declared in the schema under the coordinate Variable's attributes:
+ * @code
+ * "metadata": {
+ *   "attributes": {"analyticCoordinate": {"start": 1000, "step": 2}}
+ * }
+ * @endcode
+ * The size is taken from the Variable's dimension; if "size" is given it must
+ * match. Label-based selection against an analytic coordinate is resolved with
+ * arithmetic and performs no reads.
+ */
+struct AnalyticCoordinate {
+  double start = 0;
+  double step = 1;
+  Index size = 0;
+
+  /**
+   * @brief Parses the analytic coordinate declaration.
+   * @param j The JSON declaration with keys "start", "step" and optional
+   * "size".
+   * @return The analytic coordinate or an error if the JSON is malformed.
+   */
+  static Result<AnalyticCoordinate> FromJson(const nlohmann::json& j) {
+    if (!j.is_object() || !j.contains("start") || !j.contains("step") ||
+        !j["start"].is_number() || !j["step"].is_number()) {
+      return absl::InvalidArgumentError(
+          "Error parsing analyticCoordinate:\n\tExpected numeric keys 'start' "
+          "and 'step'");
+    }
+    AnalyticCoordinate coord;
+    coord.start = j["start"].get<double>();
+    coord.step = j["step"].get<double>();
+    if (coord.step == 0) {
+      return absl::InvalidArgumentError(
+          "Error parsing analyticCoordinate:\n\t'step' must not be zero");
+    }
+    if (j.contains("size")) {
+      if (!j["size"].is_number_integer() || j["size"].get<Index>() < 0) {
+        return absl::InvalidArgumentError(
+            "Error parsing analyticCoordinate:\n\t'size' must be a "
+            "non-negative integer");
+      }
+      coord.size = j["size"].get<Index>();
+    }
+    return coord;
+  }
+
+  nlohmann::json ToJson() const {
+    return {{"start", start}, {"step", step}, {"size", size}};
+  }
+
+  /// The coordinate value at the (absolute) index.
+  double value(Index index) const { return start + step * index; }
+
+  /**
+   * @brief Finds the index holding a coordinate value.
+   * For integral types the value must land exactly on the grid. For floating
+   * point types a small relative tolerance is allowed.
+   * @return The index, or a NotFoundError if the value is off grid or out of
+   * bounds.
+   */
+  template <typename T>
+  Result<Index> index_of(const T& val) const {
+    double pos = (static_cast<double>(val) - start) / step;
+    double rounded = std::round(pos);
+    double tolerance = std::is_floating_point_v<T> ? 1e-6 : 0.0;
+    if (std::abs(pos - rounded) > tolerance) {
+      return absl::NotFoundError("Value is not on the coordinate grid.");
+    }
+    Index index = static_cast<Index>(rounded);
+    if (index < 0 || index >= size) {
+      return absl::NotFoundError("Value is outside of the coordinate range.");
+    }
+    return index;
+  }
+};
+
+/**
+ * @brief Retrieves the analytic coordinate declared on a Variable.
+ * @return The analytic coordinate, or a NotFoundError if the Variable is not
+ * declared analytic.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<AnalyticCoordinate> GetAnalyticCoordinate(
+    const Variable<T, R, M>& variable) {
+  auto attrs = variable.GetAttributes();
+  if (!attrs.contains("attributes") ||
+      !attrs["attributes"].contains(internal::kAnalyticCoordinateKey)) {
+    return absl::NotFoundError("Variable " + variable.get_variable_name() +
+                               " is not an analytic coordinate.");
+  }
+  if (variable.rank() != 1) {
+    return absl::InvalidArgumentError(
+        "Analytic coordinates must be 1D but Variable " +
+        variable.get_variable_name() + " has rank " +
+        std::to_string(variable.rank()));
+  }
+  MDIO_ASSIGN_OR_RETURN(
+      auto coord, AnalyticCoordinate::FromJson(
+                      attrs["attributes"][internal::kAnalyticCoordinateKey]))
+  MDIO_ASSIGN_OR_RETURN(auto shape, variable.get_store_shape())
+  if (coord.size != 0 && coord.size != shape[0]) {
+    return absl::InvalidArgumentError(
+        "analyticCoordinate size " + std::to_string(coord.size) +
+        " does not match the size of Variable " +
+        variable.get_variable_name());
+  }
+  coord.size = shape[0];
+  return coord;
+}
+
+/**
+ * @brief Finds the index of a coordinate value within a (possibly sliced)
+ * analytic coordinate Variable.
+ * @return The absolute index, or a NotFoundError if the value is not present
+ * in the Variable's current domain.
+ */
+template <typename V, typename T, DimensionIndex R, ReadWriteMode M>
+Result<Index> AnalyticIndexOf(const Variable<T, R, M>& variable,
+                              const AnalyticCoordinate& coord, const V& val) {
+  MDIO_ASSIGN_OR_RETURN(auto index, coord.index_of(val))
+  auto interval = variable.dimensions()[0].interval();
+  if (!tensorstore::Contains(interval, index)) {
+    return absl::NotFoundError("Value is outside of the current domain.");
+  }
+  return index;
+}
+
+/**
+ * @brief Reads a coordinate Variable, materializing analytic coordinates.
+ * Analytic coordinates are computed in memory without touching the store.
+ * Any other Variable falls back to `Variable::Read`.
+ * @param variable The coordinate Variable to read.
+ * @return A future of VariableData.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Future<VariableData<T, R, offset_origin>> ReadCoordinate(
+    Variable<T, R, M>& variable) {  // NOLINT
+  auto coordRes = GetAnalyticCoordinate(variable);
+  if (!coordRes.ok()) {
+    if (absl::IsNotFound(coordRes.status())) {
+      return variable.Read();
+    }
+    return coordRes.status();
+  }
+  auto coord = coordRes.value();
+  MDIO_ASSIGN_OR_RETURN(auto data, from_variable<T, R>(variable))
+  // Compute in double and convert so any numeric dtype (or void) works.
+  auto values = tensorstore::AllocateArray<double>(variable.dimensions().box());
+  auto interval = variable.dimensions()[0].interval();
+  for (Index i = interval.inclusive_min(); i < interval.exclusive_max(); ++i) {
+    values({i}) = coord.value(i);
+  }
+  auto status =
+      tensorstore::CopyConvertedArray(values, data.get_data_accessor());
+  if (!status.ok()) {
+    return status;
+  }
+  return tensorstore::MakeReadyFuture<VariableData<T, R, offset_origin>>(
+      std::move(data));
+}
+
+/**
+ * @brief Writes an analytic coordinate out as a real Zarr array.
+ * Readers that do not understand the analyticCoordinate attribute can then
+ * read the values as usual.
+ * @param variable The analytic coordinate Variable.
+ * @return The write futures, or an error if the Variable is not analytic.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<WriteFutures> MaterializeAnalyticCoordinate(
+    Variable<T, R, M>& variable) {  // NOLINT
+  auto coordRes = GetAnalyticCoordinate(variable);
+  if (!coordRes.ok()) {
+    return coordRes.status();
+  }
+  MDIO_ASSIGN_OR_RETURN(auto data, ReadCoordinate(variable).result())
+  return variable.Write(data);
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_ANALYTIC_COORDINATE_H_
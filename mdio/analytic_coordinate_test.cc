@@ -0,0 +1,236 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/analytic_coordinate.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+::nlohmann::json GetAnalyticToy() {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 30},
+      {"name": "time", "size": 50}
+    ],
+    "coordinates": ["inline", "crossline", "time"]
+  },
+  {
+    "name": "inline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "inline", "size": 20}],
+    "metadata": {
+      "attributes": {"analyticCoordinate": {"start": 100, "step": 2}}
+    }
+  },
+  {
+    "name": "crossline",
+    "dataType": "int32",
+    "dimensions": [{"name": "crossline", "size": 30}],
+    "metadata": {
+      "attributes": {
+        "analyticCoordinate": {"start": 500, "step": -1, "size": 30}
+      }
+    }
+  },
+  {
+    "name": "time",
+    "dataType": "float32",
+    "dimensions": [{"name": "time", "size": 50}],
+    "metadata": {
+      "attributes": {"analyticCoordinate": {"start": 0.0, "step": 0.004}}
+    }
+  }
+]
+  )";
+  return mdio::test_util::Manifest("regular_grid", variables);
+}
+
+mdio::Result<mdio::Dataset> MakeAnalyticDataset(const std::string& path) {
+  return mdio::test_util::SETUP(path, GetAnalyticToy()).result();
+}
+
+TEST(AnalyticCoordinate, fromJson) {
+  auto coordRes =
+      mdio::AnalyticCoordinate::FromJson({{"start", 10}, {"step", 5}});
+  ASSERT_TRUE(coordRes.status().ok()) << coordRes.status();
+  EXPECT_EQ(coordRes.value().value(3), 25);
+
+  EXPECT_FALSE(mdio::AnalyticCoordinate::FromJson({{"start", 10}}).ok());
+  EXPECT_FALSE(
+      mdio::AnalyticCoordinate::FromJson({{"start", 10}, {"step", 0}}).ok());
+  EXPECT_FALSE(mdio::AnalyticCoordinate::FromJson(
+                   {{"start", 10}, {"step", 1}, {"size", -1}})
+                   .ok());
+}
+
+TEST(AnalyticCoordinate, indexOf) {
+  mdio::AnalyticCoordinate coord{100, 2, 20};
+  EXPECT_EQ(coord.index_of(100).value(), 0);
+  EXPECT_EQ(coord.index_of(138).value(), 19);
+  EXPECT_FALSE(coord.index_of(101).ok()) << "Off-grid values are not found";
+  EXPECT_FALSE(coord.index_of(140).ok()) << "Out of range values are not found";
+
+  mdio::AnalyticCoordinate time{0.0, 0.004, 50};
+  EXPECT_EQ(time.index_of(0.012f).value(), 3);
+  EXPECT_FALSE(time.index_of(0.013).ok());
+}
+
+TEST(AnalyticCoordinate, readWithoutStorage) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto inlineVar = dsRes.value().variables.get<uint32_t>("inline").value();
+
+  auto dataRes = mdio::ReadCoordinate(inlineVar).result();
+  ASSERT_TRUE(dataRes.status().ok()) << dataRes.status();
+  auto accessor = dataRes.value().get_data_accessor();
+  EXPECT_EQ(accessor({0}), 100);
+  EXPECT_EQ(accessor({19}), 138);
+
+  // The store has never been written.
+  auto stored = inlineVar.Read().result();
+  ASSERT_TRUE(stored.status().ok()) << stored.status();
+  EXPECT_EQ(stored.value().get_data_accessor()({19}), 0);
+  std::filesystem::remove_all(path);
+}
+
+TEST(AnalyticCoordinate, selValue) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  mdio::ValueDescriptor<uint32_t> il = {"inline", 110};
+  auto slicedRes = ds.sel(il);
+  ASSERT_TRUE(slicedRes.status().ok()) << slicedRes.status();
+  auto domain = slicedRes.value().domain;
+  EXPECT_EQ(domain[1].interval().inclusive_min(), 5);
+  EXPECT_EQ(domain[1].interval().size(), 1);
+
+  mdio::ValueDescriptor<uint32_t> offGrid = {"inline", 111};
+  EXPECT_FALSE(ds.sel(offGrid).status().ok());
+  std::filesystem::remove_all(path);
+}
+
+TEST(AnalyticCoordinate, selRange) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  mdio::RangeDescriptor<uint32_t> il = {"inline", 104, 120, 1};
+  auto slicedRes = ds.sel(il);
+  ASSERT_TRUE(slicedRes.status().ok()) << slicedRes.status();
+  auto domain = slicedRes.value().domain;
+  EXPECT_EQ(domain[1].interval().inclusive_min(), 2);
+  EXPECT_EQ(domain[1].interval().exclusive_max(), 11);
+
+  // A decreasing coordinate gives a reversed range.
+  mdio::RangeDescriptor<int32_t> xl = {"crossline", 490, 495, 1};
+  EXPECT_FALSE(ds.sel(xl).status().ok());
+  mdio::RangeDescriptor<int32_t> xlOk = {"crossline", 495, 490, 1};
+  auto xlRes = ds.sel(xlOk);
+  ASSERT_TRUE(xlRes.status().ok()) << xlRes.status();
+  EXPECT_EQ(xlRes.value().domain[0].interval().inclusive_min(), 5);
+  EXPECT_EQ(xlRes.value().domain[0].interval().exclusive_max(), 11);
+
+  mdio::RangeDescriptor<float> time = {"time", 0.008f, 0.02f, 1};
+  auto timeRes = ds.sel(time);
+  ASSERT_TRUE(timeRes.status().ok()) << timeRes.status();
+  EXPECT_EQ(timeRes.value().domain[2].interval().inclusive_min(), 2);
+  EXPECT_EQ(timeRes.value().domain[2].interval().exclusive_max(), 6);
+  std::filesystem::remove_all(path);
+}
+
+TEST(AnalyticCoordinate, selList) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  mdio::ListDescriptor<uint32_t> il = {"inline", {100, 104}};
+  auto indices = ds.descriptor_to_index(il);
+  ASSERT_TRUE(indices.status().ok()) << indices.status();
+  EXPECT_THAT(indices.value()["inline"], ::testing::ElementsAre(0, 2));
+
+  mdio::ListDescriptor<uint32_t> missing = {"inline", {100, 101}};
+  EXPECT_FALSE(ds.descriptor_to_index(missing).status().ok());
+  std::filesystem::remove_all(path);
+}
+
+TEST(AnalyticCoordinate, selSliced) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  mdio::RangeDescriptor<mdio::Index> il = {"inline", 5, 10, 1};
+  auto slicedRes = dsRes.value().isel(il);
+  ASSERT_TRUE(slicedRes.status().ok()) << slicedRes.status();
+  auto sliced = slicedRes.value();
+
+  mdio::ValueDescriptor<uint32_t> inside = {"inline", 112};
+  auto insideRes = sliced.sel(inside);
+  ASSERT_TRUE(insideRes.status().ok()) << insideRes.status();
+  EXPECT_EQ(insideRes.value().domain[1].interval().inclusive_min(), 6);
+
+  mdio::ValueDescriptor<uint32_t> outside = {"inline", 100};
+  EXPECT_FALSE(sliced.sel(outside).status().ok())
+      << "Values outside of the sliced domain should not be found";
+  std::filesystem::remove_all(path);
+}
+
+TEST(AnalyticCoordinate, materialize) {
+  const std::string path = "zarrs/analytic";
+  auto dsRes = MakeAnalyticDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  auto matRes = ds.MaterializeAnalyticCoordinates().result();
+  ASSERT_TRUE(matRes.ok()) << matRes.status();
+
+  auto crossline = ds.variables.get<int32_t>("crossline").value();
+  auto stored = crossline.Read().result();
+  ASSERT_TRUE(stored.status().ok()) << stored.status();
+  auto accessor = stored.value().get_data_accessor();
+  EXPECT_EQ(accessor({0}), 500);
+  EXPECT_EQ(accessor({29}), 471);
+
+  auto time = ds.variables.get<float>("time").value();
+  auto storedTime = time.Read().result();
+  ASSERT_TRUE(storedTime.status().ok()) << storedTime.status();
+  EXPECT_FLOAT_EQ(storedTime.value().get_data_accessor()({10}), 0.04f);
+
+  auto image = ds.variables.at("image").value();
+  EXPECT_FALSE(mdio::MaterializeAnalyticCoordinate(image).status().ok())
+      << "Only analytic coordinates can be materialized";
+  std::filesystem::remove_all(path);
+}
+
+}  // namespace
@@ -0,0 +1,235 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_ASYNC_WRITER_H_
+#define MDIO_ASYNC_WRITER_H_
+
+#include <algorithm>
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "mdio/variable.h"
+#include "tensorstore/util/future.h"
+
+namespace mdio {
+
+/**
+ * @brief Options of an AsyncWriter.
+ */
+struct AsyncWriterOptions {
+  /// The bytes of data in flight beyond which Write blocks.
+  Index maxInflightBytes = Index{256} << 20;
+  /**
+   * Called with a message for every write that covers only part of a chunk,
+   * which forces the store to read, modify and write the chunk back.
+   */
+  std::function<void(const std::string&)> onPartialChunk;
+};
+
+/**
+ * @brief Counters of an AsyncWriter.
+ */
+struct AsyncWriterStats {
+  Index writes = 0;
+  Index bytes = 0;
+  Index partialChunkWrites = 0;
+  Index failures = 0;
+  Index peakInflightBytes = 0;
+};
+
+/**
+ * @brief Writes to a Variable with a bounded amount of data in flight.
+ * Write returns as soon as the write is issued, unless the in-flight budget is
+ * used up, in which case it blocks until earlier writes complete. Producers
+ * are throttled to the speed of the storage and memory stays bounded while
+ * the storage is kept busy.
+ * Failures do not stop the writer; they are collected and returned by Flush.
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto seismic, dataset.variables.get<float>("seismic"))
+ * MDIO_ASSIGN_OR_RETURN(auto writer, mdio::AsyncWriter<float>::Create(seismic))
+ * for (auto& block : blocks) {
+ *   MDIO_RETURN_IF_ERROR(writer.Write(block));
+ * }
+ * MDIO_RETURN_IF_ERROR(writer.Flush());
+ * @endcode
+ * The data must not be modified until its write has completed.
+ */
+template <typename T = void, DimensionIndex R = dynamic_rank,
+          ReadWriteMode M = ReadWriteMode::dynamic>
+class AsyncWriter {
+ public:
+  /// Called with the outcome of a write once it is durable or has failed.
+  using Callback = std::function<void(const absl::Status&)>;
+
+  /**
+   * @brief Creates a writer for a Variable.
+   * @param variable The Variable to write to.
+   * @param options The in-flight budget and partial chunk handler.
+   */
+  static Result<AsyncWriter> Create(const Variable<T, R, M>& variable,
+                                    const AsyncWriterOptions& options = {}) {
+    MDIO_ASSIGN_OR_RETURN(auto shape, variable.get_store_shape())
+    MDIO_ASSIGN_OR_RETURN(auto chunks, variable.get_chunk_shape())
+    AsyncWriter writer;
+    writer.variable_ = variable;
+    writer.options_ = options;
+    writer.shape_.assign(shape.begin(), shape.end());
+    writer.chunkShape_.assign(chunks.begin(), chunks.end());
+    writer.state_ = std::make_shared<State>();
+    return writer;
+  }
+
+  /**
+   * @brief Issues a write of the region the data covers.
+   * Blocks while the data in flight would exceed the budget. A single write
+   * larger than the budget is issued once nothing else is in flight.
+   * @param data The data to write.
+   * @param done Called with the outcome of the write, once its bytes are out
+   * of the budget. It may issue further writes.
+   * @return An error if the write could not be issued.
+   */
+  template <ArrayOriginKind OriginKind>
+  absl::Status Write(const VariableData<T, R, OriginKind>& data,
+                     Callback done = {}) {
+    const Index bytes = data.num_samples() * data.dtype().size();
+    MDIO_ASSIGN_OR_RETURN(auto target, internal::SliceToData(variable_, data))
+    const bool partial = CoversPartialChunk(data.dimensions());
+    {
+      std::unique_lock<std::mutex> lock(state_->mutex);
+      state_->idle.wait(lock, [&] {
+        return state_->inflightBytes == 0 ||
+               state_->inflightBytes + bytes <= options_.maxInflightBytes;
+      });
+      state_->inflightBytes += bytes;
+      ++state_->pending;
+      auto& stats = state_->stats;
+      ++stats.writes;
+      stats.bytes += bytes;
+      stats.partialChunkWrites += partial;
+      stats.peakInflightBytes =
+          std::max(stats.peakInflightBytes, state_->inflightBytes);
+    }
+    if (partial && options_.onPartialChunk) {
+      options_.onPartialChunk("A write to " + variable_.get_variable_name() +
+                              " covers only part of a chunk and will read, "
+                              "modify and write it back.");
+    }
+
+    auto futures = target.Write(data);
+    futures.commit_future.ExecuteWhenReady(
+        [state = state_, bytes,
+         done = std::move(done)](tensorstore::ReadyFuture<void> readyFut) {
+          absl::Status status = readyFut.result().status();
+          // The bytes are released before the callback, which may issue the
+          // next write.
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            state->inflightBytes -= bytes;
+            if (!status.ok()) {
+              ++state->stats.failures;
+              state->errors.push_back(status);
+            }
+          }
+          state->idle.notify_all();
+          if (done) {
+            done(status);
+          }
+          // After the callback, so that Flush also waits on it.
+          {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            --state->pending;
+          }
+          state->idle.notify_all();
+        });
+    return absl::OkStatus();
+  }
+
+  /**
+   * @brief Waits for every issued write and its callback to complete.
+   * @return OkStatus, or the first failure since the last Flush annotated with
+   * the number of failed writes.
+   */
+  absl::Status Flush() {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->idle.wait(lock, [&] { return state_->pending == 0; });
+    if (state_->errors.empty()) {
+      return absl::OkStatus();
+    }
+    absl::Status first = state_->errors.front();
+    size_t failed = state_->errors.size();
+    state_->errors.clear();
+    if (failed == 1) {
+      return first;
+    }
+    return absl::Status(first.code(), std::to_string(failed) +
+                                          " writes failed, the first with: " +
+                                          std::string(first.message()));
+  }
+
+  /// The bytes of data currently in flight.
+  Index inflight_bytes() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->inflightBytes;
+  }
+
+  AsyncWriterStats stats() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->stats;
+  }
+
+ private:
+  AsyncWriter() = default;
+
+  // Shared with the completion callbacks, which may outlive the writer.
+  struct State {
+    std::mutex mutex;
+    std::condition_variable idle;
+    Index inflightBytes = 0;
+    Index pending = 0;
+    std::vector<absl::Status> errors;
+    AsyncWriterStats stats;
+  };
+
+  template <DimensionIndex DR>
+  bool CoversPartialChunk(const IndexDomainView<DR>& domain) const {
+    const DimensionIndex rank =
+        std::min<DimensionIndex>(domain.rank(), chunkShape_.size());
+    for (DimensionIndex i = 0; i < rank; ++i) {
+      Index start = domain[i].inclusive_min();
+      Index stop = domain[i].exclusive_max();
+      if (start % chunkShape_[i] != 0 ||
+          (stop % chunkShape_[i] != 0 && stop != shape_[i])) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  Variable<T, R, M> variable_;
+  AsyncWriterOptions options_;
+  std::vector<Index> shape_;
+  std::vector<Index> chunkShape_;
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace mdio
+
+#endif  // MDIO_ASYNC_WRITER_H_
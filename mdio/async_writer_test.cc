@@ -0,0 +1,201 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/async_writer.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/async_writer.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 30},
+      {"name": "time", "size": 64}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 64] }
+      }
+    }
+  }
+]
+  )";
+  return mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("async_writer", variables));
+}
+
+// The block of inlines [start, stop) filled with inline * 100 + time.
+mdio::VariableData<float> MakeBlock(mdio::Variable<float> image,
+                                    mdio::Index start, mdio::Index stop) {
+  mdio::RangeDescriptor<mdio::Index> desc = {"inline", start, stop, 1};
+  auto block = mdio::from_variable<float>(image.slice(desc).value()).value();
+  auto values = block.get_data_accessor();
+  for (mdio::Index i = start; i < stop; ++i) {
+    for (mdio::Index k = 0; k < 64; ++k) {
+      values({i, k}) = i * 100.0f + k;
+    }
+  }
+  return block;
+}
+
+TEST(AsyncWriter, boundedInflight) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+
+  mdio::AsyncWriterOptions options;
+  // Two blocks of 8 inlines.
+  options.maxInflightBytes = 2 * 8 * 64 * 4;
+  std::vector<std::string> warnings;
+  options.onPartialChunk = [&](const std::string& message) {
+    warnings.push_back(message);
+  };
+  auto writer = mdio::AsyncWriter<float>::Create(image, options);
+  ASSERT_TRUE(writer.status().ok()) << writer.status();
+
+  std::atomic<int> done{0};
+  for (mdio::Index start = 0; start < 30; start += 8) {
+    auto block = MakeBlock(image, start, std::min<mdio::Index>(start + 8, 30));
+    auto status = writer.value().Write(block, [&](const absl::Status& status) {
+      EXPECT_TRUE(status.ok()) << status;
+      ++done;
+    });
+    ASSERT_TRUE(status.ok()) << status;
+    EXPECT_LE(writer.value().inflight_bytes(), options.maxInflightBytes);
+  }
+  auto flushed = writer.value().Flush();
+  ASSERT_TRUE(flushed.ok()) << flushed;
+  EXPECT_EQ(done, 4);
+  EXPECT_EQ(writer.value().inflight_bytes(), 0);
+  EXPECT_TRUE(warnings.empty()) << "The last block ends at the array edge";
+
+  auto stats = writer.value().stats();
+  EXPECT_EQ(stats.writes, 4);
+  EXPECT_EQ(stats.bytes, 30 * 64 * 4);
+  EXPECT_EQ(stats.failures, 0);
+  EXPECT_LE(stats.peakInflightBytes, options.maxInflightBytes);
+
+  auto data = image.Read().result();
+  ASSERT_TRUE(data.status().ok()) << data.status();
+  auto values = data.value().get_data_accessor();
+  for (mdio::Index i = 0; i < 30; ++i) {
+    for (mdio::Index k = 0; k < 64; ++k) {
+      ASSERT_EQ(values({i, k}), i * 100.0f + k);
+    }
+  }
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(AsyncWriter, chainedWrites) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+
+  mdio::AsyncWriterOptions options;
+  // One block of 8 inlines, so each write waits for the one before.
+  options.maxInflightBytes = 8 * 64 * 4;
+  auto writer = mdio::AsyncWriter<float>::Create(image, options).value();
+
+  // Each completion issues the next block, as a completion driven producer
+  // would.
+  std::atomic<int> done{0};
+  std::function<void(const absl::Status&)> next =
+      [&](const absl::Status& status) {
+        EXPECT_TRUE(status.ok()) << status;
+        mdio::Index start = 8 * ++done;
+        if (start < 30) {
+          auto block =
+              MakeBlock(image, start, std::min<mdio::Index>(start + 8, 30));
+          EXPECT_TRUE(writer.Write(block, next).ok());
+        }
+      };
+  ASSERT_TRUE(writer.Write(MakeBlock(image, 0, 8), next).ok());
+  auto flushed = writer.Flush();
+  ASSERT_TRUE(flushed.ok()) << flushed;
+  EXPECT_EQ(done, 4) << "Flush waits for the chained writes";
+  EXPECT_EQ(writer.stats().writes, 4);
+
+  auto data = image.Read().result();
+  ASSERT_TRUE(data.status().ok()) << data.status();
+  EXPECT_EQ(data.value().get_data_accessor()({29, 63}), 2900.0f + 63);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(AsyncWriter, partialChunk) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+
+  mdio::AsyncWriterOptions options;
+  int warnings = 0;
+  options.onPartialChunk = [&](const std::string&) { ++warnings; };
+  auto writer = mdio::AsyncWriter<float>::Create(image, options).value();
+  ASSERT_TRUE(writer.Write(MakeBlock(image, 3, 5)).ok());
+  ASSERT_TRUE(writer.Write(MakeBlock(image, 8, 16)).ok());
+  ASSERT_TRUE(writer.Flush().ok());
+  EXPECT_EQ(warnings, 1);
+  EXPECT_EQ(writer.stats().partialChunkWrites, 1);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(AsyncWriter, aggregatesErrors) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+  auto writer = mdio::AsyncWriter<float>::Create(image).value();
+
+  // Delete the store from under the writer so the writes fail.
+  auto block = MakeBlock(image, 0, 8);
+  std::filesystem::remove_all(kTestPath);
+  std::filesystem::create_directories(kTestPath + "/image");
+  std::filesystem::create_directories(kTestPath + "/image/0.0");
+
+  std::atomic<int> failed{0};
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_TRUE(writer
+                    .Write(block,
+                           [&](const absl::Status& status) {
+                             failed += !status.ok();
+                           })
+                    .ok());
+  }
+  auto flushed = writer.Flush();
+  EXPECT_FALSE(flushed.ok());
+  EXPECT_EQ(failed, 2);
+  EXPECT_EQ(writer.stats().failures, 2);
+  EXPECT_THAT(std::string(flushed.message()),
+              ::testing::HasSubstr("2 writes failed"));
+  EXPECT_TRUE(writer.Flush().ok()) << "Errors are reported once";
+  std::filesystem::remove_all(kTestPath);
+}
+
+}  // namespace
@@ -0,0 +1,281 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_CHUNK_ADVISOR_H_
+#define MDIO_CHUNK_ADVISOR_H_
+
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace internal {
+// The key under ["metadata"]["attributes"] declaring the access patterns.
+constexpr char kAccessPatternsKey[] = "accessPatterns";
+}  // namespace internal
+
+/**
+ * @brief A kind of read issued against a Variable, as the box it reads.
+ * A box extent of -1 spans the whole dimension. Requests land at uniformly
+ * random offsets.
+ */
+struct AccessPattern {
+  std::vector<Index> extent;
+  double weight = 1;
+
+  /// One index of `dim` and everything else, e.g. an inline section or a time
+  /// slice.
+  static AccessPattern Slice(DimensionIndex rank, DimensionIndex dim,
+                             double weight = 1) {
+    AccessPattern pattern{std::vector<Index>(rank, -1), weight};
+    pattern.extent[dim] = 1;
+    return pattern;
+  }
+
+  /// One index of every dimension but the last, which is read whole.
+  static AccessPattern Trace(DimensionIndex rank, double weight = 1) {
+    AccessPattern pattern{std::vector<Index>(rank, 1), weight};
+    pattern.extent.back() = -1;
+    return pattern;
+  }
+
+  /// A box of the given extent anywhere in the Variable.
+  static AccessPattern Window(std::vector<Index> extent, double weight = 1) {
+    return AccessPattern{std::move(extent), weight};
+  }
+};
+
+/**
+ * @brief Parses the access patterns declared on a Variable.
+ * Declared in the schema under the Variable's attributes:
+ * @code
+ * "metadata": {
+ *   "attributes": {
+ *     "accessPatterns": [
+ *       {"type": "slice", "dimension": "inline", "weight": 2},
+ *       {"type": "slice", "dimension": "time"},
+ *       {"type": "trace"},
+ *       {"type": "window", "shape": {"inline": 64, "crossline": 64}}
+ *     ]
+ *   }
+ * }
+ * @endcode
+ * Window dimensions that are not named are read whole. The weight defaults to
+ * 1.
+ * @param j The JSON array of access patterns.
+ * @param dimensions The dimension names of the Variable.
+ * @return The access patterns or an error if the JSON is malformed.
+ */
+inline Result<std::vector<AccessPattern>> ParseAccessPatterns(
+    const nlohmann::json& j, const std::vector<std::string>& dimensions) {
+  const DimensionIndex rank = dimensions.size();
+  auto dimensionIndex = [&](const std::string& name) -> DimensionIndex {
+    auto it = std::find(dimensions.begin(), dimensions.end(), name);
+    return it == dimensions.end() ? -1 : it - dimensions.begin();
+  };
+  auto error = [](const std::string& message) {
+    return absl::InvalidArgumentError("Error parsing accessPatterns:\n\t" +
+                                      message);
+  };
+  if (!j.is_array() || j.empty()) {
+    return error("Expected a non-empty array");
+  }
+  std::vector<AccessPattern> patterns;
+  for (const auto& item : j) {
+    if (!item.is_object() || !item.contains("type") ||
+        !item["type"].is_string()) {
+      return error("Expected string key 'type'");
+    }
+    double weight = 1;
+    if (item.contains("weight")) {
+      if (!item["weight"].is_number() || item["weight"].get<double>() < 0) {
+        return error("'weight' must be a non-negative number");
+      }
+      weight = item["weight"].get<double>();
+    }
+    std::string type = item["type"];
+    if (type == "slice") {
+      if (!item.contains("dimension") || !item["dimension"].is_string() ||
+          dimensionIndex(item["dimension"]) < 0) {
+        return error("A slice needs the 'dimension' it indexes");
+      }
+      DimensionIndex dim = dimensionIndex(item["dimension"]);
+      patterns.push_back(AccessPattern::Slice(rank, dim, weight));
+    } else if (type == "trace") {
+      if (rank < 2) {
+        return error("A trace needs at least two dimensions");
+      }
+      patterns.push_back(AccessPattern::Trace(rank, weight));
+    } else if (type == "window") {
+      if (!item.contains("shape") || !item["shape"].is_object()) {
+        return error("A window needs a 'shape' object");
+      }
+      std::vector<Index> extent(rank, -1);
+      for (const auto& [name, size] : item["shape"].items()) {
+        if (dimensionIndex(name) < 0 || !size.is_number_integer() ||
+            size.get<Index>() < 1) {
+          return error("Invalid window extent for '" + name + "'");
+        }
+        extent[dimensionIndex(name)] = size.get<Index>();
+      }
+      patterns.push_back(AccessPattern::Window(std::move(extent), weight));
+    } else {
+      return error("Unknown type '" + type +
+                   "', expected 'slice', 'trace' or 'window'");
+    }
+  }
+  return patterns;
+}
+
+/**
+ * @brief The knobs of the chunk shape cost model.
+ * A request costs its stored bytes plus `requestOverheadBytes`, the bytes that
+ * could have been transferred in the time one request takes to start.
+ */
+struct ChunkAdvisorOptions {
+  /// The largest stored (compressed) chunk.
+  Index maxObjectBytes = Index{16} << 20;
+  /// The smallest stored chunk, unless the whole Variable is smaller.
+  Index minObjectBytes = Index{1} << 20;
+  double requestOverheadBytes = 1 << 20;
+  /// The expected compression ratio of a chunk.
+  double compressionRatio = 1;
+};
+
+/**
+ * @brief A proposed chunk shape with its expected cost per weighted request.
+ */
+struct ChunkAdvice {
+  std::vector<Index> chunkShape;
+  double expectedBytes = 0;
+  double expectedRequests = 0;
+};
+
+/**
+ * @brief Proposes the chunk shape minimizing the expected bytes read and
+ * request count over a weighted set of access patterns.
+ * Every dimension tries the powers of two up to its size and the size itself,
+ * so the search is exhaustive over that grid.
+ * @param shape The shape of the Variable.
+ * @param itemSize The bytes per element.
+ * @param patterns The expected accesses; their weights need not sum to 1.
+ * @param options The object size constraint and cost model.
+ * @return The advice, or an InvalidArgumentError if the inputs are
+ * inconsistent.
+ */
+inline Result<ChunkAdvice> AdviseChunkShape(
+    const std::vector<Index>& shape, Index itemSize,
+    const std::vector<AccessPattern>& patterns,
+    const ChunkAdvisorOptions& options = {}) {
+  const DimensionIndex rank = shape.size();
+  if (rank == 0 || itemSize <= 0) {
+    return absl::InvalidArgumentError(
+        "Chunk advice needs a non-empty shape and a positive item size.");
+  }
+  double totalWeight = 0;
+  for (const auto& pattern : patterns) {
+    if (static_cast<DimensionIndex>(pattern.extent.size()) != rank) {
+      return absl::InvalidArgumentError(
+          "Access pattern rank does not match the Variable's rank.");
+    }
+    totalWeight += pattern.weight;
+  }
+  if (totalWeight <= 0) {
+    return absl::InvalidArgumentError(
+        "Access patterns need a positive weight.");
+  }
+
+  std::vector<std::vector<Index>> sizes(rank);
+  double totalBytes = itemSize;
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    if (shape[i] < 1) {
+      return absl::InvalidArgumentError("Chunk advice needs a positive shape.");
+    }
+    for (Index size = 1; size < shape[i]; size *= 2) {
+      sizes[i].push_back(size);
+    }
+    sizes[i].push_back(shape[i]);
+    totalBytes *= shape[i];
+  }
+  const double ratio = std::max(options.compressionRatio, 1.0);
+  const double minBytes =
+      std::min<double>(options.minObjectBytes, totalBytes / ratio);
+
+  ChunkAdvice best;
+  double bestCost = std::numeric_limits<double>::infinity();
+  // Chunks that break the size constraint only win if nothing else fits.
+  bool bestFits = false;
+  std::vector<size_t> choice(rank, 0);
+  std::vector<Index> chunk(rank);
+  while (true) {
+    double chunkBytes = itemSize / ratio;
+    for (DimensionIndex i = 0; i < rank; ++i) {
+      chunk[i] = sizes[i][choice[i]];
+      chunkBytes *= chunk[i];
+    }
+    bool fits = chunkBytes <= options.maxObjectBytes && chunkBytes >= minBytes;
+    double requests = 0;
+    for (const auto& pattern : patterns) {
+      double touched = 1;
+      for (DimensionIndex i = 0; i < rank; ++i) {
+        Index grid = (shape[i] + chunk[i] - 1) / chunk[i];
+        Index extent = pattern.extent[i];
+        if (extent < 0 || extent >= shape[i]) {
+          touched *= grid;
+        } else {
+          // Chunks overlapped by a randomly placed interval.
+          touched *= std::min<double>(
+              grid, static_cast<double>(extent - 1) / chunk[i] + 1);
+        }
+      }
+      requests += pattern.weight / totalWeight * touched;
+    }
+    double bytes = requests * chunkBytes;
+    double cost = bytes + requests * options.requestOverheadBytes;
+    // Prefer fitting chunks, then cheaper ones, then fewer objects.
+    if ((fits && !bestFits) ||
+        (fits == bestFits &&
+         (cost < bestCost * (1 - 1e-12) ||
+          (cost <= bestCost * (1 + 1e-12) &&
+           chunkBytes > best.expectedBytes / best.expectedRequests)))) {
+      best.chunkShape = chunk;
+      best.expectedBytes = bytes;
+      best.expectedRequests = requests;
+      bestCost = cost;
+      bestFits = fits;
+    }
+
+    DimensionIndex i = rank - 1;
+    while (i >= 0 && ++choice[i] == sizes[i].size()) {
+      choice[i] = 0;
+      --i;
+    }
+    if (i < 0) {
+      break;
+    }
+  }
+  return best;
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_CHUNK_ADVISOR_H_
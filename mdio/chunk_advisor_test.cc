@@ -0,0 +1,170 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/chunk_advisor.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "mdio/dataset_factory.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+using ::testing::ElementsAre;
+
+const std::vector<mdio::Index> kShape = {256, 256, 1024};  // NOLINT
+
+TEST(ChunkAdvisor, timeSlices) {
+  auto advice = mdio::AdviseChunkShape(
+      kShape, 4, {mdio::AccessPattern::Slice(3, 2)});
+  ASSERT_TRUE(advice.status().ok()) << advice.status();
+  // The thinnest slab that still makes a 1 MiB object.
+  EXPECT_THAT(advice.value().chunkShape, ElementsAre(256, 256, 4));
+  EXPECT_DOUBLE_EQ(advice.value().expectedRequests, 1);
+  EXPECT_DOUBLE_EQ(advice.value().expectedBytes, 1 << 20);
+}
+
+TEST(ChunkAdvisor, traces) {
+  auto advice =
+      mdio::AdviseChunkShape(kShape, 4, {mdio::AccessPattern::Trace(3)});
+  ASSERT_TRUE(advice.status().ok()) << advice.status();
+  auto chunk = advice.value().chunkShape;
+  EXPECT_EQ(chunk[2], 1024) << "A trace is one request";
+  EXPECT_EQ(chunk[0] * chunk[1] * chunk[2] * 4, 1 << 20);
+  EXPECT_DOUBLE_EQ(advice.value().expectedRequests, 1);
+}
+
+TEST(ChunkAdvisor, mixedPatterns) {
+  std::vector<mdio::AccessPattern> patterns = {
+      mdio::AccessPattern::Slice(3, 0), mdio::AccessPattern::Slice(3, 1),
+      mdio::AccessPattern::Slice(3, 2), mdio::AccessPattern::Trace(3)};
+  mdio::ChunkAdvisorOptions options;
+  options.maxObjectBytes = 4 << 20;
+  auto advice = mdio::AdviseChunkShape(kShape, 4, patterns, options);
+  ASSERT_TRUE(advice.status().ok()) << advice.status();
+  auto chunk = advice.value().chunkShape;
+  mdio::Index bytes = chunk[0] * chunk[1] * chunk[2] * 4;
+  EXPECT_GE(bytes, 1 << 20);
+  EXPECT_LE(bytes, 4 << 20);
+  // Sections in both directions keep either from spanning the survey.
+  EXPECT_LT(chunk[0], 256);
+  EXPECT_LT(chunk[1], 256);
+  EXPECT_LT(chunk[2], 1024);
+
+  // Whole-Variable chunks always read everything.
+  auto whole = mdio::AdviseChunkShape({64, 64, 64}, 4, patterns);
+  ASSERT_TRUE(whole.status().ok()) << whole.status();
+  EXPECT_THAT(whole.value().chunkShape, ElementsAre(64, 64, 64))
+      << "The Variable is smaller than the minimum object";
+}
+
+TEST(ChunkAdvisor, windows) {
+  auto advice = mdio::AdviseChunkShape(
+      kShape, 4, {mdio::AccessPattern::Window({64, 64, 64})});
+  ASSERT_TRUE(advice.status().ok()) << advice.status();
+  auto chunk = advice.value().chunkShape;
+  EXPECT_EQ(chunk[0] * chunk[1] * chunk[2] * 4, 1 << 20);
+  EXPECT_LE(advice.value().expectedRequests, 8);
+}
+
+TEST(ChunkAdvisor, compressionShrinksObjects) {
+  mdio::ChunkAdvisorOptions options;
+  options.compressionRatio = 4;
+  auto advice = mdio::AdviseChunkShape(
+      kShape, 4, {mdio::AccessPattern::Slice(3, 2)}, options);
+  ASSERT_TRUE(advice.status().ok()) << advice.status();
+  EXPECT_THAT(advice.value().chunkShape, ElementsAre(256, 256, 16));
+}
+
+TEST(ChunkAdvisor, invalid) {
+  EXPECT_FALSE(mdio::AdviseChunkShape({}, 4, {}).ok());
+  EXPECT_FALSE(
+      mdio::AdviseChunkShape(kShape, 4, {mdio::AccessPattern::Trace(2)}).ok())
+      << "Rank mismatch";
+  EXPECT_FALSE(
+      mdio::AdviseChunkShape(kShape, 4, {mdio::AccessPattern::Trace(3, 0)})
+          .ok())
+      << "No weight";
+}
+
+TEST(ChunkAdvisor, parse) {
+  std::vector<std::string> dims = {"inline", "crossline", "time"};
+  auto patterns = mdio::ParseAccessPatterns(
+      nlohmann::json::parse(R"([
+        {"type": "slice", "dimension": "crossline", "weight": 2},
+        {"type": "trace"},
+        {"type": "window", "shape": {"inline": 8, "time": 100}}
+      ])"),
+      dims);
+  ASSERT_TRUE(patterns.status().ok()) << patterns.status();
+  ASSERT_EQ(patterns.value().size(), 3);
+  EXPECT_THAT(patterns.value()[0].extent, ElementsAre(-1, 1, -1));
+  EXPECT_EQ(patterns.value()[0].weight, 2);
+  EXPECT_THAT(patterns.value()[1].extent, ElementsAre(1, 1, -1));
+  EXPECT_THAT(patterns.value()[2].extent, ElementsAre(8, -1, 100));
+
+  for (const auto& bad : {R"([])", R"([{"type": "slice"}])",
+                          R"([{"type": "slice", "dimension": "depth"}])",
+                          R"([{"type": "trace", "weight": -1}])",
+                          R"([{"type": "window", "shape": {"time": 0}}])",
+                          R"([{"type": "sweep"}])"}) {
+    EXPECT_FALSE(
+        mdio::ParseAccessPatterns(nlohmann::json::parse(bad), dims).ok())
+        << bad;
+  }
+}
+
+TEST(ChunkAdvisor, construct) {
+  std::string variables = R"(
+[
+  {
+    "name": "seismic",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 256},
+      {"name": "crossline", "size": 256},
+      {"name": "time", "size": 1024}
+    ],
+    "metadata": {
+      "attributes": {
+        "accessPatterns": [{"type": "slice", "dimension": "time"}]
+      }
+    }
+  }
+]
+  )";
+  auto j = mdio::test_util::Manifest("advised", variables);
+  auto res = Construct(j, "zarrs/advised");
+  ASSERT_TRUE(res.status().ok()) << res.status();
+  auto spec = std::get<1>(res.value())[0];
+  EXPECT_EQ(spec["metadata"]["chunks"], nlohmann::json({256, 256, 4}));
+  EXPECT_EQ(spec["attributes"]["metadata"]["chunkGrid"]["configuration"]
+                ["chunkShape"],
+            nlohmann::json({256, 256, 4}))
+      << "The advice is recorded in the Variable's metadata";
+
+  j["variables"][0]["metadata"]["attributes"]["accessPatterns"] = {
+      {{"type", "slice"}, {"dimension", "depth"}}};
+  EXPECT_FALSE(Construct(j, "zarrs/advised").status().ok());
+}
+
+}  // namespace
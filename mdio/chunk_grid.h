@@ -0,0 +1,514 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_CHUNK_GRID_H_
+#define MDIO_CHUNK_GRID_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "mdio/quantization.h"
+#include "mdio/variable.h"
+#include "tensorstore/cast.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace internal {
+// The key under ["metadata"]["attributes"] holding a rectilinear chunk grid.
+constexpr char kRectilinearChunkGridKey[] = "rectilinearChunkGrid";
+// The number of chunks read concurrently when computing chunk statistics.
+constexpr size_t kChunkStatsBatch = 16;
+}  // namespace internal
+
+/**
+ * @brief The logical chunk grid of a Variable, regular or rectilinear.
+ * A rectilinear grid lets chunk sizes follow the data density, e.g. large
+ * chunks over the dense core of a survey and small ones over its sparse edges:
+ * @code
+ * "chunkGrid": {
+ *   "name": "rectilinear",
+ *   "configuration": {"chunkShape": [[64, 256, 256, 64], [128, 128], [1000]]}
+ * }
+ * @endcode
+ * Every dimension lists its chunk sizes, which must sum to its size.
+ *
+ * Zarr v2 only stores regular grids, so a rectilinear Variable is stored with
+ * its smallest chunk size along each dimension. Every other size must be a
+ * multiple of it, except for the last which may be partial, so every logical
+ * chunk is an exact union of stored chunks and reading one touches nothing
+ * outside of it. It does take one request per stored chunk though: the 16
+ * of [4, 16, 4] are stored as four keys of 4. Grids such as [64, 63, 64],
+ * whose stored chunk would shrink to a common divisor, are rejected.
+ */
+class ChunkGrid {
+ public:
+  ChunkGrid() = default;
+
+  /**
+   * @brief Creates a regular grid, the last chunk of a dimension may be
+   * partial.
+   */
+  static Result<ChunkGrid> Regular(const std::vector<Index>& shape,
+                                   const std::vector<Index>& chunkShape) {
+    if (shape.size() != chunkShape.size()) {
+      return absl::InvalidArgumentError(
+          "Shape and chunk shape must have the same rank.");
+    }
+    std::vector<std::vector<Index>> sizes(shape.size());
+    for (size_t i = 0; i < shape.size(); ++i) {
+      if (chunkShape[i] <= 0 || shape[i] < 0) {
+        return absl::InvalidArgumentError(
+            "Chunk shape must be positive and shape must be non-negative.");
+      }
+      for (Index start = 0; start < shape[i]; start += chunkShape[i]) {
+        sizes[i].push_back(std::min(chunkShape[i], shape[i] - start));
+      }
+    }
+    ChunkGrid grid;
+    grid.regular_ = true;
+    grid.Init(shape, sizes);
+    return grid;
+  }
+
+  /**
+   * @brief Creates a rectilinear grid.
+   * @param shape The shape of the Variable.
+   * @param chunkSizes The chunk sizes along each dimension.
+   * @return The grid or an error if the sizes do not tile the shape or are not
+   * multiples of the smallest, see `storage_chunk_shape`.
+   */
+  static Result<ChunkGrid> Rectilinear(
+      const std::vector<Index>& shape,
+      const std::vector<std::vector<Index>>& chunkSizes) {
+    if (shape.size() != chunkSizes.size()) {
+      return absl::InvalidArgumentError(
+          "Rectilinear chunk sizes must be given for every dimension.");
+    }
+    for (size_t i = 0; i < shape.size(); ++i) {
+      Index total = 0;
+      for (Index size : chunkSizes[i]) {
+        if (size <= 0) {
+          return absl::InvalidArgumentError(
+              "Rectilinear chunk sizes must be positive.");
+        }
+        total += size;
+      }
+      if (total != shape[i]) {
+        return absl::InvalidArgumentError(
+            "Rectilinear chunk sizes of dimension " + std::to_string(i) +
+            " sum to " + std::to_string(total) + " but its size is " +
+            std::to_string(shape[i]) + ".");
+      }
+      Index stored = StoredChunkSize(chunkSizes[i]);
+      for (size_t c = 0; c + 1 < chunkSizes[i].size(); ++c) {
+        if (chunkSizes[i][c] % stored != 0) {
+          return absl::InvalidArgumentError(
+              "Rectilinear chunk sizes of dimension " + std::to_string(i) +
+              " must be multiples of the smallest, " + std::to_string(stored) +
+              ", but " + std::to_string(chunkSizes[i][c]) +
+              " is not. Zarr would store them with their common divisor.");
+        }
+      }
+    }
+    ChunkGrid grid;
+    grid.regular_ = false;
+    grid.Init(shape, chunkSizes);
+    return grid;
+  }
+
+  /**
+   * @brief Parses an MDIO schema chunkGrid.
+   * @param j The chunkGrid JSON, regular or rectilinear.
+   * @param shape The shape of the Variable.
+   * @return The grid or an error if the JSON is malformed.
+   */
+  static Result<ChunkGrid> FromJson(const nlohmann::json& j,
+                                    const std::vector<Index>& shape) {
+    if (!j.is_object() || !j.contains("configuration") ||
+        !j["configuration"].contains("chunkShape") ||
+        !j["configuration"]["chunkShape"].is_array()) {
+      return absl::InvalidArgumentError(
+          "Error parsing chunkGrid:\n\tExpected key "
+          "'configuration.chunkShape'");
+    }
+    const auto& chunkShape = j["configuration"]["chunkShape"];
+    try {
+      if (IsRectilinear(j)) {
+        return Rectilinear(
+            shape, chunkShape.get<std::vector<std::vector<Index>>>());
+      }
+      return Regular(shape, chunkShape.get<std::vector<Index>>());
+    } catch (const nlohmann::json::exception& e) {
+      return absl::InvalidArgumentError(
+          "There appeared to be some malformed JSON" + std::string(e.what()));
+    }
+  }
+
+  /// Whether an MDIO schema chunkGrid is rectilinear.
+  static bool IsRectilinear(const nlohmann::json& j) {
+    if (j.contains("name") && j["name"] == "rectilinear") {
+      return true;
+    }
+    return j.contains("configuration") &&
+           j["configuration"].contains("chunkShape") &&
+           !j["configuration"]["chunkShape"].empty() &&
+           j["configuration"]["chunkShape"][0].is_array();
+  }
+
+  /// Serializes the grid as an MDIO schema chunkGrid.
+  nlohmann::json ToJson() const {
+    if (regular_) {
+      std::vector<Index> chunkShape(rank());
+      for (size_t i = 0; i < rank(); ++i) {
+        chunkShape[i] = sizes_[i].empty() ? 1 : sizes_[i][0];
+      }
+      return {{"name", "regular"},
+              {"configuration", {{"chunkShape", chunkShape}}}};
+    }
+    return {{"name", "rectilinear"},
+            {"configuration", {{"chunkShape", sizes_}}}};
+  }
+
+  bool is_regular() const { return regular_; }
+
+  size_t rank() const { return shape_.size(); }
+
+  const std::vector<Index>& shape() const { return shape_; }
+
+  /// The chunk sizes along a dimension.
+  const std::vector<Index>& chunk_sizes(size_t dim) const {
+    return sizes_[dim];
+  }
+
+  /// The number of chunks along each dimension.
+  std::vector<Index> grid_shape() const {
+    std::vector<Index> gridShape(rank());
+    for (size_t i = 0; i < rank(); ++i) {
+      gridShape[i] = sizes_[i].size();
+    }
+    return gridShape;
+  }
+
+  Index num_chunks() const {
+    Index count = 1;
+    for (const auto& sizes : sizes_) {
+      count *= sizes.size();
+    }
+    return count;
+  }
+
+  /**
+   * @brief The regular chunk shape the Zarr array is stored with.
+   * Every chunk of the grid is an exact union of these: the first chunk size
+   * of a regular grid and the smallest size of a rectilinear one.
+   */
+  std::vector<Index> storage_chunk_shape() const {
+    std::vector<Index> chunkShape(rank(), 1);
+    for (size_t i = 0; i < rank(); ++i) {
+      if (regular_) {
+        chunkShape[i] = sizes_[i].empty() ? 1 : sizes_[i][0];
+        continue;
+      }
+      chunkShape[i] = StoredChunkSize(sizes_[i]);
+    }
+    return chunkShape;
+  }
+
+  /// The index of the chunk holding a position along a dimension.
+  Index chunk_index(size_t dim, Index position) const {
+    const auto& bounds = bounds_[dim];
+    return std::upper_bound(bounds.begin(), bounds.end(), position) -
+           bounds.begin() - 1;
+  }
+
+  /// The origin and shape of a chunk.
+  void chunk_box(const std::vector<Index>& chunkIndex,
+                 std::vector<Index>* origin, std::vector<Index>* shape) const {
+    origin->resize(rank());
+    shape->resize(rank());
+    for (size_t i = 0; i < rank(); ++i) {
+      (*origin)[i] = bounds_[i][chunkIndex[i]];
+      (*shape)[i] = sizes_[i][chunkIndex[i]];
+    }
+  }
+
+  /**
+   * @brief Calls fn(chunkIndex, origin, shape) for each chunk touched by a box,
+   * in C order. The chunk bounds are clipped to the box.
+   */
+  template <typename Fn>
+  void ForEachChunk(const std::vector<Index>& origin,
+                    const std::vector<Index>& boxShape, Fn&& fn) const {
+    const size_t r = rank();
+    if (r == 0 || origin.size() < r || boxShape.size() < r) {
+      return;
+    }
+    std::vector<Index> start(r), stop(r), lo(r), hi(r);
+    for (size_t i = 0; i < r; ++i) {
+      start[i] = std::max<Index>(origin[i], 0);
+      stop[i] = std::min<Index>(origin[i] + boxShape[i], shape_[i]);
+      if (start[i] >= stop[i]) {
+        return;
+      }
+      lo[i] = chunk_index(i, start[i]);
+      hi[i] = chunk_index(i, stop[i] - 1) + 1;
+    }
+    std::vector<Index> cursor = lo, chunkOrigin(r), chunkShape(r);
+    while (true) {
+      for (size_t i = 0; i < r; ++i) {
+        Index begin = std::max(bounds_[i][cursor[i]], start[i]);
+        Index end = std::min(bounds_[i][cursor[i] + 1], stop[i]);
+        chunkOrigin[i] = begin;
+        chunkShape[i] = end - begin;
+      }
+      fn(cursor, chunkOrigin, chunkShape);
+      size_t d = r;
+      while (d-- > 0) {
+        if (++cursor[d] < hi[d]) {
+          break;
+        }
+        cursor[d] = lo[d];
+        if (d == 0) {
+          return;
+        }
+      }
+    }
+  }
+
+  /// Calls fn(chunkIndex, origin, shape) for every chunk in C order.
+  template <typename Fn>
+  void ForEachChunk(Fn&& fn) const {
+    ForEachChunk(std::vector<Index>(rank(), 0), shape_, std::forward<Fn>(fn));
+  }
+
+ private:
+  // The smallest chunk size of a dimension, ignoring a partial last chunk.
+  static Index StoredChunkSize(const std::vector<Index>& sizes) {
+    if (sizes.empty()) {
+      return 1;
+    }
+    if (sizes.size() == 1) {
+      return sizes[0];
+    }
+    return *std::min_element(sizes.begin(), sizes.end() - 1);
+  }
+
+  void Init(const std::vector<Index>& shape,
+            const std::vector<std::vector<Index>>& sizes) {
+    shape_ = shape;
+    sizes_ = sizes;
+    bounds_.assign(rank(), {0});
+    for (size_t i = 0; i < rank(); ++i) {
+      for (Index size : sizes_[i]) {
+        bounds_[i].push_back(bounds_[i].back() + size);
+      }
+    }
+  }
+
+  bool regular_ = true;
+  std::vector<Index> shape_;
+  std::vector<std::vector<Index>> sizes_;
+  // The chunk boundaries along each dimension, starting at 0.
+  std::vector<std::vector<Index>> bounds_;
+};
+
+/**
+ * @brief Retrieves the logical chunk grid of a Variable.
+ * The rectilinear grid recorded at creation is returned if there is one,
+ * otherwise the regular grid the Variable is stored with. The storage keys
+ * follow the smallest chunk sizes, so a larger logical chunk spans several.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<ChunkGrid> GetChunkGrid(const Variable<T, R, M>& variable) {
+  MDIO_ASSIGN_OR_RETURN(auto storeShape, variable.get_store_shape())
+  std::vector<Index> shape(storeShape.begin(), storeShape.end());
+  auto attrs = variable.GetAttributes();
+  if (attrs.contains("attributes") &&
+      attrs["attributes"].contains(internal::kRectilinearChunkGridKey)) {
+    MDIO_ASSIGN_OR_RETURN(
+        auto grid,
+        ChunkGrid::FromJson(
+            attrs["attributes"][internal::kRectilinearChunkGridKey], shape))
+    return grid;
+  }
+  MDIO_ASSIGN_OR_RETURN(auto chunkShape, variable.get_chunk_shape())
+  // A structarray opened as void carries a trailing byte dimension.
+  chunkShape.resize(shape.size(), shape.empty() ? 1 : shape.back());
+  return ChunkGrid::Regular(
+      shape, std::vector<Index>(chunkShape.begin(), chunkShape.end()));
+}
+
+/**
+ * @brief Slices a Variable down to one chunk of its grid.
+ * @param variable The Variable.
+ * @param grid The chunk grid of the Variable, see `GetChunkGrid`.
+ * @param chunkIndex The position of the chunk in the grid.
+ * @return The sliced Variable or an error if the chunk is outside of the grid.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<Variable<T, R, M>> SliceChunk(const Variable<T, R, M>& variable,
+                                     const ChunkGrid& grid,
+                                     const std::vector<Index>& chunkIndex) {
+  auto gridShape = grid.grid_shape();
+  if (chunkIndex.size() != grid.rank()) {
+    return absl::InvalidArgumentError("Chunk index has the wrong rank.");
+  }
+  for (size_t i = 0; i < grid.rank(); ++i) {
+    if (chunkIndex[i] < 0 || chunkIndex[i] >= gridShape[i]) {
+      return absl::OutOfRangeError("Chunk index is outside of the grid.");
+    }
+  }
+  std::vector<Index> origin, shape;
+  grid.chunk_box(chunkIndex, &origin, &shape);
+  auto domain = variable.get_store().domain();
+  auto labels = domain.labels();
+  std::vector<RangeDescriptor<Index>> slices;
+  for (size_t i = 0; i < grid.rank(); ++i) {
+    slices.push_back({labels[i], origin[i], origin[i] + shape[i], 1});
+  }
+  Variable<T, R, M> copy = variable;
+  return copy.slice(slices);
+}
+
+/**
+ * @brief Computes count, min, max, sum and sumSquares of every chunk.
+ * The chunks are read one request each, a batch at a time, and NaN samples are
+ * skipped. A quantized Variable is dequantized first, so the statistics are
+ * of its values and its fill code counts as NaN. Chunks that the stored
+ * occupancy bitmap marks as empty are not read. Since the counts follow the
+ * data density they show whether a rectilinear grid fits the survey.
+ * @param variable The numeric Variable.
+ * @param grid The chunk grid of the Variable, see `GetChunkGrid`.
+ * @return A JSON array with one entry per chunk in C order, each holding its
+ * "origin", "shape" and statistics.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<nlohmann::json> ComputeChunkStats(const Variable<T, R, M>& variable,
+                                         const ChunkGrid& grid) {
+  auto quantization = GetQuantization(variable);
+  if (!quantization.ok() && !absl::IsNotFound(quantization.status())) {
+    return quantization.status();
+  }
+  // Codes are read as float to be dequantized in place, anything else as
+  // double.
+  tensorstore::TensorStore<> store;
+  if (quantization.ok()) {
+    MDIO_ASSIGN_OR_RETURN(store, tensorstore::Cast<float>(variable.get_store()))
+  } else {
+    MDIO_ASSIGN_OR_RETURN(store,
+                          tensorstore::Cast<double>(variable.get_store()))
+  }
+  auto domain = store.domain();
+  if (static_cast<size_t>(domain.rank()) != grid.rank()) {
+    return absl::InvalidArgumentError(
+        "The chunk grid does not match the rank of Variable " +
+        variable.get_variable_name());
+  }
+  std::vector<Index> origin(grid.rank()), shape(grid.rank());
+  for (size_t i = 0; i < grid.rank(); ++i) {
+    origin[i] = domain[i].inclusive_min();
+    shape[i] = domain[i].size();
+  }
+
+  // Stats of empty chunks need no read.
+  auto occupancy = GetChunkOccupancy(variable);
+  const bool skipEmpty =
+      occupancy.ok() &&
+      internal::OccupancyCovers(occupancy.value(), variable.get_store());
+
+  std::vector<std::pair<std::vector<Index>, std::vector<Index>>> boxes;
+  grid.ForEachChunk(origin, shape,
+                    [&](const std::vector<Index>&,
+                        const std::vector<Index>& chunkOrigin,
+                        const std::vector<Index>& chunkShape) {
+                      boxes.emplace_back(chunkOrigin, chunkShape);
+                    });
+
+  nlohmann::json stats = nlohmann::json::array();
+  for (size_t begin = 0; begin < boxes.size();
+       begin += internal::kChunkStatsBatch) {
+    size_t end = std::min(boxes.size(), begin + internal::kChunkStatsBatch);
+    std::vector<Future<tensorstore::SharedArray<void>>> reads;
+    for (size_t c = begin; c < end; ++c) {
+      if (skipEmpty &&
+          !occupancy.value().AnyInBox(boxes[c].first, boxes[c].second)) {
+        reads.push_back(
+            tensorstore::MakeReadyFuture<tensorstore::SharedArray<void>>(
+                tensorstore::AllocateArray({0}, ContiguousLayoutOrder::c,
+                                           tensorstore::value_init,
+                                           store.dtype())));
+        continue;
+      }
+      tensorstore::Box<> box(grid.rank());
+      for (size_t i = 0; i < grid.rank(); ++i) {
+        box[i] = tensorstore::IndexInterval::UncheckedSized(
+            boxes[c].first[i], boxes[c].second[i]);
+      }
+      MDIO_ASSIGN_OR_RETURN(auto source,
+                            store | tensorstore::AllDims().BoxSlice(box))
+      reads.push_back(tensorstore::Read<tensorstore::zero_origin>(source));
+    }
+    for (size_t c = begin; c < end; ++c) {
+      MDIO_ASSIGN_OR_RETURN(auto array, reads[c - begin].result())
+      Index count = 0;
+      double min = std::numeric_limits<double>::infinity();
+      double max = -std::numeric_limits<double>::infinity();
+      double sum = 0;
+      double sumSquares = 0;
+      auto accumulate = [&](const auto* values) {
+        for (Index k = 0; k < array.num_elements(); ++k) {
+          const double value = values[k];
+          if (std::isnan(value)) {
+            continue;
+          }
+          ++count;
+          min = std::min(min, value);
+          max = std::max(max, value);
+          sum += value;
+          sumSquares += value * value;
+        }
+      };
+      if (quantization.ok()) {
+        float* codes = static_cast<float*>(array.data());
+        quantization.value().Dequantize(codes, array.num_elements());
+        accumulate(codes);
+      } else {
+        accumulate(static_cast<const double*>(array.data()));
+      }
+      if (count == 0) {
+        min = max = 0;
+      }
+      stats.push_back({{"origin", boxes[c].first},
+                       {"shape", boxes[c].second},
+                       {"count", count},
+                       {"min", min},
+                       {"max", max},
+                       {"sum", sum},
+                       {"sumSquares", sumSquares}});
+    }
+  }
+  return stats;
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_CHUNK_GRID_H_
@@ -0,0 +1,263 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/chunk_grid.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+using ::testing::ElementsAre;
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/rectilinear.mdio";
+
+::nlohmann::json GetRectilinearToy() {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 24},
+      {"name": "time", "size": 40}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "rectilinear",
+        "configuration": {"chunkShape": [[4, 16, 4], [20, 20]]}
+      }
+    }
+  }
+]
+  )";
+  return mdio::test_util::Manifest("rectilinear", variables);
+}
+
+TEST(ChunkGrid, regular) {
+  auto grid = mdio::ChunkGrid::Regular({10, 7}, {4, 7});
+  ASSERT_TRUE(grid.status().ok()) << grid.status();
+  EXPECT_TRUE(grid.value().is_regular());
+  EXPECT_THAT(grid.value().grid_shape(), ElementsAre(3, 1));
+  EXPECT_THAT(grid.value().chunk_sizes(0), ElementsAre(4, 4, 2));
+  EXPECT_THAT(grid.value().storage_chunk_shape(), ElementsAre(4, 7));
+  EXPECT_EQ(grid.value().ToJson()["configuration"]["chunkShape"],
+            ::nlohmann::json({4, 7}));
+  EXPECT_FALSE(mdio::ChunkGrid::Regular({10}, {0}).ok());
+}
+
+TEST(ChunkGrid, rectilinear) {
+  auto grid = mdio::ChunkGrid::FromJson(
+      GetRectilinearToy()["variables"][0]["metadata"]["chunkGrid"], {24, 40});
+  ASSERT_TRUE(grid.status().ok()) << grid.status();
+  EXPECT_FALSE(grid.value().is_regular());
+  EXPECT_EQ(grid.value().num_chunks(), 6);
+  EXPECT_THAT(grid.value().storage_chunk_shape(), ElementsAre(4, 20));
+  EXPECT_EQ(grid.value().chunk_index(0, 3), 0);
+  EXPECT_EQ(grid.value().chunk_index(0, 4), 1);
+  EXPECT_EQ(grid.value().chunk_index(0, 19), 1);
+  EXPECT_EQ(grid.value().chunk_index(0, 20), 2);
+
+  std::vector<mdio::Index> origin, shape;
+  grid.value().chunk_box({1, 1}, &origin, &shape);
+  EXPECT_THAT(origin, ElementsAre(4, 20));
+  EXPECT_THAT(shape, ElementsAre(16, 20));
+
+  auto roundTrip =
+      mdio::ChunkGrid::FromJson(grid.value().ToJson(), {24, 40}).value();
+  EXPECT_THAT(roundTrip.chunk_sizes(0), ElementsAre(4, 16, 4));
+
+  EXPECT_FALSE(mdio::ChunkGrid::Rectilinear({24, 40}, {{4, 16}, {40}}).ok())
+      << "The sizes must sum to the shape";
+  EXPECT_FALSE(mdio::ChunkGrid::Rectilinear({24}, {{24}, {1}}).ok());
+}
+
+TEST(ChunkGrid, coprimeSizes) {
+  // A common divisor of 1 would store every sample as its own chunk.
+  EXPECT_FALSE(mdio::ChunkGrid::Rectilinear({191}, {{64, 63, 64}}).ok());
+  EXPECT_FALSE(mdio::ChunkGrid::Rectilinear({192}, {{96, 64, 32}}).ok());
+  // A partial last chunk is fine, as it is for regular grids.
+  auto grid = mdio::ChunkGrid::Rectilinear({127, 8}, {{64, 63}, {8}});
+  ASSERT_TRUE(grid.status().ok()) << grid.status();
+  EXPECT_THAT(grid.value().storage_chunk_shape(), ElementsAre(64, 8));
+  auto multiples = mdio::ChunkGrid::Rectilinear({224}, {{32, 128, 64}});
+  ASSERT_TRUE(multiples.status().ok()) << multiples.status();
+  EXPECT_THAT(multiples.value().storage_chunk_shape(), ElementsAre(32));
+}
+
+TEST(ChunkGrid, coprimeReads) {
+  auto json = GetRectilinearToy();
+  auto& image = json["variables"][0];
+  image["dimensions"][0]["size"] = 127;
+  image["dimensions"][1]["size"] = 8;
+  image["metadata"]["chunkGrid"]["configuration"]["chunkShape"] = {{64, 63},
+                                                                   {8}};
+  auto dsRes = mdio::test_util::SETUP(kTestPath, json).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto variable = dsRes.value().variables.get<float>("image").value();
+  auto data = mdio::from_variable<float>(variable).value();
+  ASSERT_TRUE(variable.Write(data).result().ok());
+
+  mdio::SimKvStoreOptions sim;
+  sim.name = "coprimeReads";
+  sim.latencyMedianMs = 0;
+  sim.latencyP99Ms = 0;
+  sim.bandwidthMiBps = 0;
+  sim.concurrency = 0;
+  auto ds = mdio::Dataset::Open(kTestPath, sim, mdio::constants::kOpen)
+                .result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto stored = ds.value().variables.get<float>("image").value();
+  auto grid = mdio::GetChunkGrid(stored).value();
+  auto chunk = mdio::SliceChunk(stored, grid, {1, 0}).value();
+
+  mdio::ResetSimKvStoreStats(sim.name);
+  ASSERT_TRUE(chunk.Read().result().ok());
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 1)
+      << "One storage key per logical chunk";
+  mdio::ResetSimKvStoreStats(sim.name);
+  ASSERT_TRUE(stored.Read().result().ok());
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 2);
+
+  // Storage follows the smallest size, so the 16 inline chunk of the toy
+  // spans four keys of 4.
+  dsRes = mdio::test_util::SETUP(kTestPath, GetRectilinearToy()).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  variable = dsRes.value().variables.get<float>("image").value();
+  auto toyData = mdio::from_variable<float>(variable).value();
+  ASSERT_TRUE(variable.Write(toyData).result().ok());
+  sim.name = "coprimeReadsToy";
+  ds = mdio::Dataset::Open(kTestPath, sim, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  stored = ds.value().variables.get<float>("image").value();
+  grid = mdio::GetChunkGrid(stored).value();
+  chunk = mdio::SliceChunk(stored, grid, {1, 0}).value();
+  mdio::ResetSimKvStoreStats(sim.name);
+  ASSERT_TRUE(chunk.Read().result().ok());
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 4)
+      << "One storage key per stored chunk of the logical chunk";
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(ChunkGrid, forEachChunk) {
+  auto grid =
+      mdio::ChunkGrid::Rectilinear({24, 40}, {{4, 16, 4}, {20, 20}}).value();
+  std::vector<std::vector<mdio::Index>> seen;
+  grid.ForEachChunk({2, 25}, {10, 10},
+                    [&](const std::vector<mdio::Index>& chunkIndex,
+                        const std::vector<mdio::Index>& origin,
+                        const std::vector<mdio::Index>& shape) {
+                      seen.push_back({chunkIndex[0], chunkIndex[1], origin[0],
+                                      origin[1], shape[0], shape[1]});
+                    });
+  ASSERT_EQ(seen.size(), 2);
+  EXPECT_THAT(seen[0], ElementsAre(0, 1, 2, 25, 2, 10));
+  EXPECT_THAT(seen[1], ElementsAre(1, 1, 4, 25, 8, 10));
+
+  int count = 0;
+  grid.ForEachChunk([&](const std::vector<mdio::Index>&,
+                        const std::vector<mdio::Index>&,
+                        const std::vector<mdio::Index>&) { ++count; });
+  EXPECT_EQ(count, 6);
+}
+
+TEST(ChunkGrid, endToEnd) {
+  auto json = GetRectilinearToy();
+  auto dsRes = mdio::test_util::SETUP(kTestPath, json).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+  auto chunkShape = image.get_chunk_shape();
+  ASSERT_TRUE(chunkShape.status().ok()) << chunkShape.status();
+  EXPECT_THAT(chunkShape.value(), ElementsAre(4, 20))
+      << "Stored with the smallest chunk size";
+
+  auto data = mdio::from_variable<float>(image).value();
+  auto accessor = data.get_data_accessor();
+  for (int i = 0; i < 24; ++i) {
+    for (int k = 0; k < 40; ++k) {
+      // Only the dense core holds live samples.
+      accessor({i, k}) = (i >= 4 && i < 20) ? 1.0f : std::nanf("");
+    }
+  }
+  ASSERT_TRUE(image.Write(data).result().ok());
+
+  auto reopened = mdio::Dataset::Open(kTestPath, mdio::constants::kOpen);
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  auto stored = reopened.value().variables.get<float>("image").value();
+  auto grid = mdio::GetChunkGrid(stored);
+  ASSERT_TRUE(grid.status().ok()) << grid.status();
+  EXPECT_FALSE(grid.value().is_regular());
+  EXPECT_THAT(grid.value().chunk_sizes(0), ElementsAre(4, 16, 4));
+
+  auto core = mdio::SliceChunk(stored, grid.value(), {1, 0});
+  ASSERT_TRUE(core.status().ok()) << core.status();
+  auto domain = core.value().dimensions();
+  EXPECT_EQ(domain[0].inclusive_min(), 4);
+  EXPECT_EQ(domain[0].size(), 16);
+  EXPECT_EQ(domain[1].size(), 20);
+  EXPECT_FALSE(mdio::SliceChunk(stored, grid.value(), {3, 0}).ok());
+
+  auto stats = mdio::ComputeChunkStats(stored, grid.value());
+  ASSERT_TRUE(stats.status().ok()) << stats.status();
+  ASSERT_EQ(stats.value().size(), 6);
+  EXPECT_EQ(stats.value()[0]["count"], 0);
+  EXPECT_EQ(stats.value()[2]["count"], 16 * 20);
+  EXPECT_EQ(stats.value()[2]["sum"], 16.0 * 20);
+  EXPECT_EQ(stats.value()[2]["origin"], ::nlohmann::json({4, 0}));
+  EXPECT_EQ(stats.value()[5]["count"], 0);
+
+  // The statistics of a quantized Variable are of its values, and the fill
+  // code that stores NaN is no sample.
+  json["variables"][0]["metadata"]["attributes"]["quantization"] = {
+      {"dtype", "int16"}, {"scale", 0.5}};
+  dsRes = mdio::test_util::SETUP(kTestPath, json).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto quantized = dsRes.value().variables.get<float>("image").value();
+  for (int i = 4; i < 20; ++i) {
+    for (int k = 0; k < 40; ++k) {
+      accessor({i, k}) = 1.5f;
+    }
+  }
+  ASSERT_TRUE(quantized.Write(data).result().ok());
+  auto raw = dsRes.value().variables.at("image").value();
+  stats = mdio::ComputeChunkStats(raw, grid.value());
+  ASSERT_TRUE(stats.status().ok()) << stats.status();
+  EXPECT_EQ(stats.value()[0]["count"], 0);
+  EXPECT_EQ(stats.value()[2]["count"], 16 * 20);
+  EXPECT_EQ(stats.value()[2]["sum"], 1.5 * 16 * 20);
+  EXPECT_EQ(stats.value()[2]["max"], 1.5);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(ChunkGrid, invalidSchema) {
+  auto json = GetRectilinearToy();
+  json["variables"][0]["metadata"]["chunkGrid"]["configuration"]
+      ["chunkShape"] = {{4, 16}, {20, 20}};
+  auto dsRes = mdio::test_util::SETUP(kTestPath, json).result();
+  EXPECT_FALSE(dsRes.status().ok());
+}
+
+}  // namespace
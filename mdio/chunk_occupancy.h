@@ -0,0 +1,795 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_CHUNK_OCCUPANCY_H_
+#define MDIO_CHUNK_OCCUPANCY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "mdio/impl.h"
+#include "tensorstore/array.h"
+#include "tensorstore/index_space/dim_expression.h"
+#include "tensorstore/index_space/index_transform.h"
+#include "tensorstore/kvstore/key_range.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/tensorstore.h"
+#include "tensorstore/util/future.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+
+// Variable reads through the occupancy bitmap, so it includes this header.
+template <typename T, DimensionIndex R, ReadWriteMode M>
+struct Variable;
+
+template <typename T, DimensionIndex R, ArrayOriginKind OriginKind>
+struct VariableData;
+
+namespace internal {
+// The key under ["metadata"]["attributes"] holding the occupancy bitmap.
+constexpr char kChunkOccupancyKey[] = "chunkOccupancy";
+// Beyond this many chunk rows the listing pass falls back to digit prefixes.
+constexpr Index kMaxOccupancyListPrefixes = 512;
+}  // namespace internal
+
+/**
+ * @brief A compact bitmap recording which chunks of a Variable hold data.
+ * Sparse surveys (land, OBN) leave large parts of the grid empty. Knowing which
+ * chunks exist lets reads, statistics and export skip the missing ones entirely
+ * instead of probing every chunk key in the store.
+ *
+ * Once stored with `SetChunkOccupancy`, `Variable::Read` requests only the
+ * occupied chunks, and so do the statistics, reductions and exports built on
+ * it. `Variable::Write` marks the chunks it writes, so the bitmap stays
+ * current. Data written into the store by other means needs a new
+ * `BuildChunkOccupancy`.
+ *
+ * The bitmap only covers the chunked dimensions of the Variable. For a
+ * structarray opened as void the trailing byte dimension is not represented.
+ *
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto image, dataset.variables.at("image"));
+ * MDIO_ASSIGN_OR_RETURN(auto occupancy,
+ *                       mdio::BuildChunkOccupancy(image).result());
+ * auto stored = mdio::SetChunkOccupancy(image, occupancy);
+ * if (!stored.ok()) return stored.status();
+ * // Only the occupied chunks are requested.
+ * MDIO_ASSIGN_OR_RETURN(auto data, image.Read().result());
+ * @endcode
+ */
+class ChunkOccupancy {
+ public:
+  ChunkOccupancy() = default;
+
+  /**
+   * @brief Creates an empty occupancy bitmap.
+   * @param shape The shape of the Variable in elements.
+   * @param chunkShape The chunk shape of the Variable.
+   * @return An empty bitmap or an error if the shapes are inconsistent.
+   */
+  static Result<ChunkOccupancy> Create(const std::vector<Index>& shape,
+                                       const std::vector<Index>& chunkShape) {
+    if (shape.size() != chunkShape.size()) {
+      return absl::InvalidArgumentError(
+          "Shape and chunk shape must have the same rank.");
+    }
+    ChunkOccupancy occupancy;
+    occupancy.shape_ = shape;
+    occupancy.chunkShape_ = chunkShape;
+    occupancy.gridShape_.resize(shape.size());
+    Index numChunks = 1;
+    for (size_t i = 0; i < shape.size(); ++i) {
+      if (chunkShape[i] <= 0 || shape[i] < 0) {
+        return absl::InvalidArgumentError(
+            "Chunk shape must be positive and shape must be non-negative.");
+      }
+      occupancy.gridShape_[i] = (shape[i] + chunkShape[i] - 1) / chunkShape[i];
+      numChunks *= occupancy.gridShape_[i];
+    }
+    occupancy.numChunks_ = numChunks;
+    occupancy.words_.assign((numChunks + 63) / 64, 0);
+    return occupancy;
+  }
+
+  /**
+   * @brief Reconstructs an occupancy bitmap from its attribute representation.
+   * @param j The JSON produced by `ToJson()`.
+   * @return The bitmap or an error if the JSON is malformed.
+   */
+  static Result<ChunkOccupancy> FromJson(const nlohmann::json& j) {
+    if (!j.is_object() || !j.contains("shape") || !j.contains("chunkShape") ||
+        !j.contains("encoding") || !j.contains("bits")) {
+      return absl::InvalidArgumentError(
+          "Error parsing chunkOccupancy:\n\tExpected keys 'shape', "
+          "'chunkShape', 'encoding' and 'bits'");
+    }
+    ChunkOccupancy occupancy;
+    try {
+      MDIO_ASSIGN_OR_RETURN(
+          occupancy, Create(j["shape"].get<std::vector<Index>>(),
+                            j["chunkShape"].get<std::vector<Index>>()))
+      const std::string encoding = j["encoding"].get<std::string>();
+      if (encoding == "bitmap") {
+        std::string raw;
+        if (!absl::Base64Unescape(j["bits"].get<std::string>(), &raw)) {
+          return absl::InvalidArgumentError(
+              "Error parsing chunkOccupancy:\n\tInvalid base64 bitmap");
+        }
+        for (Index i = 0; i < occupancy.numChunks_; ++i) {
+          if (static_cast<size_t>(i / 8) < raw.size() &&
+              (static_cast<uint8_t>(raw[i / 8]) >> (i % 8)) & 1) {
+            occupancy.set_linear(i);
+          }
+        }
+      } else if (encoding == "rle") {
+        // Alternating run lengths, starting with a run of empty chunks.
+        Index pos = 0;
+        bool bit = false;
+        for (const auto& run : j["bits"]) {
+          Index len = run.get<Index>();
+          if (len < 0 || pos + len > occupancy.numChunks_) {
+            return absl::InvalidArgumentError(
+                "Error parsing chunkOccupancy:\n\tRun lengths exceed the "
+                "chunk grid");
+          }
+          if (bit) {
+            for (Index i = pos; i < pos + len; ++i) {
+              occupancy.set_linear(i);
+            }
+          }
+          pos += len;
+          bit = !bit;
+        }
+      } else {
+        return absl::InvalidArgumentError(
+            "Error parsing chunkOccupancy:\n\tUnknown encoding '" + encoding +
+            "'");
+      }
+    } catch (const nlohmann::json::exception& e) {
+      return absl::InvalidArgumentError(
+          "There appeared to be some malformed JSON" + std::string(e.what()));
+    }
+    return occupancy;
+  }
+
+  /**
+   * @brief Serializes the bitmap for storage in the Variable attributes.
+   * The smaller of a run-length or a base64 bitmap encoding is chosen.
+   */
+  nlohmann::json ToJson() const {
+    nlohmann::json j;
+    j["shape"] = shape_;
+    j["chunkShape"] = chunkShape_;
+    j["count"] = count();
+
+    std::vector<Index> runs;
+    bool bit = false;
+    Index len = 0;
+    for (Index i = 0; i < numChunks_; ++i) {
+      if (test_linear(i) != bit) {
+        runs.push_back(len);
+        bit = !bit;
+        len = 0;
+      }
+      ++len;
+    }
+    runs.push_back(len);
+
+    // A run is roughly as expensive as a few base64 characters in JSON.
+    if (static_cast<Index>(runs.size()) * 4 < (numChunks_ + 7) / 8) {
+      j["encoding"] = "rle";
+      j["bits"] = runs;
+    } else {
+      std::string raw((numChunks_ + 7) / 8, '\0');
+      for (Index i = 0; i < numChunks_; ++i) {
+        if (test_linear(i)) {
+          raw[i / 8] = static_cast<char>(raw[i / 8] | (1 << (i % 8)));
+        }
+      }
+      j["encoding"] = "bitmap";
+      j["bits"] = absl::Base64Escape(raw);
+    }
+    return j;
+  }
+
+  /// The number of chunked dimensions.
+  size_t rank() const { return shape_.size(); }
+
+  /// The shape of the Variable in elements.
+  const std::vector<Index>& shape() const { return shape_; }
+
+  /// The chunk shape of the Variable.
+  const std::vector<Index>& chunk_shape() const { return chunkShape_; }
+
+  /// The number of chunks along each dimension.
+  const std::vector<Index>& grid_shape() const { return gridShape_; }
+
+  /// The total number of chunks in the grid.
+  Index num_chunks() const { return numChunks_; }
+
+  /// The number of chunks that hold data.
+  Index count() const {
+    Index total = 0;
+    for (auto word : words_) {
+      total += absl::popcount(word);
+    }
+    return total;
+  }
+
+  /**
+   * @brief Checks whether the chunk at the given grid position holds data.
+   * Out-of-range positions are reported as empty.
+   */
+  bool test(const std::vector<Index>& chunkIndex) const {
+    Index linear = linear_index(chunkIndex);
+    return linear >= 0 && test_linear(linear);
+  }
+
+  /// Marks (or clears) the chunk at the given grid position.
+  void set(const std::vector<Index>& chunkIndex, bool occupied = true) {
+    Index linear = linear_index(chunkIndex);
+    if (linear < 0) {
+      return;
+    }
+    if (occupied) {
+      set_linear(linear);
+    } else {
+      words_[linear / 64] &= ~(uint64_t{1} << (linear % 64));
+    }
+  }
+
+  /**
+   * @brief Marks every chunk touched by a box of elements.
+   * Intended to be called alongside `Variable::Write` so the bitmap can be
+   * maintained without a listing pass.
+   * @param origin The inclusive origin of the box in elements.
+   * @param boxShape The shape of the box in elements.
+   */
+  void MarkBox(const std::vector<Index>& origin,
+               const std::vector<Index>& boxShape) {
+    ForEachChunkInBox(origin, boxShape, [this](Index linear) {
+      set_linear(linear);
+      return true;
+    });
+  }
+
+  /**
+   * @brief Checks whether every chunk touched by a box of elements holds data.
+   */
+  bool AllInBox(const std::vector<Index>& origin,
+                const std::vector<Index>& boxShape) const {
+    bool all = true;
+    ForEachChunkInBox(origin, boxShape, [this, &all](Index linear) {
+      all = test_linear(linear);
+      return all;
+    });
+    return all;
+  }
+
+  /**
+   * @brief Checks whether any chunk touched by a box of elements holds data.
+   */
+  bool AnyInBox(const std::vector<Index>& origin,
+                const std::vector<Index>& boxShape) const {
+    bool found = false;
+    ForEachChunkInBox(origin, boxShape, [this, &found](Index linear) {
+      found = test_linear(linear);
+      return !found;
+    });
+    return found;
+  }
+
+  /**
+   * @brief Visits the occupied parts of a box of elements.
+   * Adjacent occupied chunks along the innermost dimension are coalesced into a
+   * single region so callers issue fewer, larger requests.
+   * @param origin The inclusive origin of the box in elements.
+   * @param boxShape The shape of the box in elements.
+   * @param fn Called with the origin and shape of each occupied region,
+   * clipped to the box.
+   */
+  void ForEachOccupiedRegion(
+      const std::vector<Index>& origin, const std::vector<Index>& boxShape,
+      const std::function<void(const std::vector<Index>&,
+                               const std::vector<Index>&)>& fn) const {
+    const size_t r = rank();
+    if (r == 0 || origin.size() < r || boxShape.size() < r) {
+      return;
+    }
+    std::vector<Index> lo(r), hi(r);
+    for (size_t i = 0; i < r; ++i) {
+      Index start = std::max<Index>(origin[i], 0);
+      Index stop = std::min<Index>(origin[i] + boxShape[i], shape_[i]);
+      if (start >= stop) {
+        return;
+      }
+      lo[i] = start / chunkShape_[i];
+      hi[i] = (stop - 1) / chunkShape_[i] + 1;
+    }
+
+    std::vector<Index> cursor = lo;
+    std::vector<Index> regionOrigin(r), regionShape(r);
+    const size_t inner = r - 1;
+    while (true) {
+      // Scan the innermost dimension for runs of occupied chunks.
+      Index runStart = -1;
+      for (Index c = lo[inner]; c <= hi[inner]; ++c) {
+        bool occupied = false;
+        if (c < hi[inner]) {
+          cursor[inner] = c;
+          occupied = test_linear(linear_index(cursor));
+        }
+        if (occupied && runStart < 0) {
+          runStart = c;
+        } else if (!occupied && runStart >= 0) {
+          for (size_t i = 0; i < r; ++i) {
+            Index first = i == inner ? runStart : cursor[i];
+            Index last = i == inner ? c : cursor[i] + 1;
+            Index start = std::max(first * chunkShape_[i], origin[i]);
+            Index stop = std::min({last * chunkShape_[i], shape_[i],
+                                   origin[i] + boxShape[i]});
+            regionOrigin[i] = start;
+            regionShape[i] = stop - start;
+          }
+          fn(regionOrigin, regionShape);
+          runStart = -1;
+        }
+      }
+      // Advance the outer dimensions.
+      if (inner == 0) {
+        return;
+      }
+      size_t d = inner - 1;
+      while (true) {
+        if (++cursor[d] < hi[d]) {
+          break;
+        }
+        cursor[d] = lo[d];
+        if (d == 0) {
+          return;
+        }
+        --d;
+      }
+    }
+  }
+
+  /**
+   * @brief Projects the bitmap onto a subset of its dimensions.
+   * A projected chunk is occupied if any chunk along the dropped dimensions is
+   * occupied. Dropping the sample dimension gives the live-trace footprint.
+   * @param keepDims The dimensions to keep, in order.
+   * @return The projected bitmap or an error if a dimension is out of range.
+   */
+  Result<ChunkOccupancy> Project(
+      const std::vector<DimensionIndex>& keepDims) const {
+    std::vector<Index> projShape, projChunks;
+    for (auto dim : keepDims) {
+      if (dim < 0 || dim >= static_cast<DimensionIndex>(rank())) {
+        return absl::InvalidArgumentError(
+            "Dimension " + std::to_string(dim) +
+            " is out of range for the occupancy bitmap.");
+      }
+      projShape.push_back(shape_[dim]);
+      projChunks.push_back(chunkShape_[dim]);
+    }
+    MDIO_ASSIGN_OR_RETURN(auto projected, Create(projShape, projChunks))
+    std::vector<Index> chunkIndex(rank()), projIndex(keepDims.size());
+    for (Index linear = 0; linear < numChunks_; ++linear) {
+      if (!test_linear(linear)) {
+        continue;
+      }
+      Index rem = linear;
+      for (size_t i = rank(); i-- > 0;) {
+        chunkIndex[i] = rem % gridShape_[i];
+        rem /= gridShape_[i];
+      }
+      for (size_t i = 0; i < keepDims.size(); ++i) {
+        projIndex[i] = chunkIndex[keepDims[i]];
+      }
+      projected.set(projIndex);
+    }
+    return projected;
+  }
+
+  /**
+   * @brief Merges the occupied chunks of another bitmap into this one.
+   * @return An error if the chunk grids differ.
+   */
+  absl::Status Merge(const ChunkOccupancy& other) {
+    if (other.shape_ != shape_ || other.chunkShape_ != chunkShape_) {
+      return absl::InvalidArgumentError(
+          "Cannot merge occupancy bitmaps with different chunk grids.");
+    }
+    for (size_t i = 0; i < words_.size(); ++i) {
+      words_[i] |= other.words_[i];
+    }
+    return absl::OkStatus();
+  }
+
+ private:
+  Index linear_index(const std::vector<Index>& chunkIndex) const {
+    if (chunkIndex.size() != rank()) {
+      return -1;
+    }
+    Index linear = 0;
+    for (size_t i = 0; i < rank(); ++i) {
+      if (chunkIndex[i] < 0 || chunkIndex[i] >= gridShape_[i]) {
+        return -1;
+      }
+      linear = linear * gridShape_[i] + chunkIndex[i];
+    }
+    return linear;
+  }
+
+  bool test_linear(Index linear) const {
+    return (words_[linear / 64] >> (linear % 64)) & 1;
+  }
+
+  void set_linear(Index linear) {
+    words_[linear / 64] |= uint64_t{1} << (linear % 64);
+  }
+
+  // Calls fn(linear) for each chunk touched by the box until fn returns false.
+  template <typename Fn>
+  void ForEachChunkInBox(const std::vector<Index>& origin,
+                         const std::vector<Index>& boxShape, Fn&& fn) const {
+    const size_t r = rank();
+    if (r == 0 || origin.size() < r || boxShape.size() < r) {
+      return;
+    }
+    std::vector<Index> lo(r), hi(r);
+    for (size_t i = 0; i < r; ++i) {
+      Index start = std::max<Index>(origin[i], 0);
+      Index stop = std::min<Index>(origin[i] + boxShape[i], shape_[i]);
+      if (start >= stop) {
+        return;
+      }
+      lo[i] = start / chunkShape_[i];
+      hi[i] = (stop - 1) / chunkShape_[i] + 1;
+    }
+    std::vector<Index> cursor = lo;
+    while (true) {
+      if (!fn(linear_index(cursor))) {
+        return;
+      }
+      size_t d = r;
+      while (d-- > 0) {
+        if (++cursor[d] < hi[d]) {
+          break;
+        }
+        cursor[d] = lo[d];
+        if (d == 0) {
+          return;
+        }
+      }
+    }
+  }
+
+  std::vector<Index> shape_;
+  std::vector<Index> chunkShape_;
+  std::vector<Index> gridShape_;
+  Index numChunks_ = 0;
+  std::vector<uint64_t> words_;
+};
+
+namespace internal {
+
+/**
+ * @brief Parses a zarr chunk key such as "3/0/12" into a grid position.
+ * @return The grid position, or an empty vector if the key is not a chunk key
+ * of the expected rank (e.g. ".zarray").
+ */
+inline std::vector<Index> ParseChunkKey(std::string_view key, char separator,
+                                        size_t rank) {
+  std::vector<std::string_view> parts = absl::StrSplit(key, separator);
+  if (parts.size() != rank) {
+    return {};
+  }
+  std::vector<Index> chunkIndex(rank);
+  for (size_t i = 0; i < rank; ++i) {
+    if (!absl::SimpleAtoi(parts[i], &chunkIndex[i])) {
+      return {};
+    }
+  }
+  return chunkIndex;
+}
+
+/**
+ * @brief Retrieves the occupancy bitmap stored in a Variable's attributes.
+ * @param attrs The attributes as returned by `Variable::GetAttributes`.
+ * @return The bitmap, or a NotFoundError if none is stored.
+ */
+inline Result<ChunkOccupancy> GetChunkOccupancy(const nlohmann::json& attrs) {
+  if (!attrs.contains("attributes") ||
+      !attrs["attributes"].contains(kChunkOccupancyKey)) {
+    return absl::NotFoundError("No chunk occupancy bitmap is stored.");
+  }
+  return ChunkOccupancy::FromJson(attrs["attributes"][kChunkOccupancyKey]);
+}
+
+/**
+ * @brief Checks whether an occupancy bitmap describes a view of an array.
+ * That holds for the array and its boxes within the bitmap's shape, which
+ * keep the indices of the array. Strided, translated and stacked views do
+ * not, and are read without the bitmap.
+ */
+template <typename Store>
+bool OccupancyCovers(const ChunkOccupancy& occupancy, const Store& store) {
+  auto domain = store.domain();
+  if (occupancy.rank() == 0 ||
+      occupancy.rank() > static_cast<size_t>(domain.rank()) ||
+      !store.kvstore().valid()) {
+    return false;
+  }
+  for (size_t i = 0; i < occupancy.rank(); ++i) {
+    if (domain[i].inclusive_min() < 0 ||
+        domain[i].exclusive_max() > occupancy.shape()[i]) {
+      return false;
+    }
+  }
+  auto spec = store.spec();
+  if (!spec.ok()) {
+    return false;
+  }
+  auto transform = spec.value().transform();
+  if (!transform.valid() || transform.output_rank() != domain.rank()) {
+    return false;
+  }
+  for (DimensionIndex i = 0; i < transform.output_rank(); ++i) {
+    auto map = transform.output_index_maps()[i];
+    if (map.method() !=
+            tensorstore::OutputIndexMethod::single_input_dimension ||
+        map.input_dimension() != i || map.stride() != 1 ||
+        map.offset() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Reads the occupied chunks of a store into an array filled with its
+ * fill value. Adjacent occupied chunks are read in one request.
+ * @pre `OccupancyCovers(occupancy, store)`
+ */
+template <typename Store>
+Future<SharedArray<void, dynamic_rank, offset_origin>> ReadOccupiedArray(
+    const Store& store, const ChunkOccupancy& occupancy) {
+  auto domain = store.domain();
+  auto target = tensorstore::AllocateArray(
+      domain.box(), mdio::ContiguousLayoutOrder::c, tensorstore::value_init,
+      store.dtype());
+  MDIO_ASSIGN_OR_RETURN(auto fill, store.fill_value())
+  if (fill.valid()) {
+    MDIO_ASSIGN_OR_RETURN(auto broadcast,
+                          tensorstore::BroadcastArray(fill, domain.shape()))
+    tensorstore::CopyArray(broadcast, target);
+  }
+
+  std::vector<Index> origin(occupancy.rank()), shape(occupancy.rank());
+  for (size_t i = 0; i < occupancy.rank(); ++i) {
+    origin[i] = domain[i].inclusive_min();
+    shape[i] = domain[i].size();
+  }
+
+  absl::Status status = absl::OkStatus();
+  std::vector<tensorstore::AnyFuture> futures;
+  occupancy.ForEachOccupiedRegion(
+      origin, shape,
+      [&](const std::vector<Index>& regionOrigin,
+          const std::vector<Index>& regionShape) {
+        if (!status.ok()) {
+          return;
+        }
+        tensorstore::Box<> box(domain.box());
+        for (size_t i = 0; i < regionOrigin.size(); ++i) {
+          box[i] = tensorstore::IndexInterval::UncheckedSized(regionOrigin[i],
+                                                              regionShape[i]);
+        }
+        auto source = store | tensorstore::AllDims().BoxSlice(box);
+        auto dest = target | tensorstore::AllDims().BoxSlice(box);
+        if (!source.ok()) {
+          status = source.status();
+          return;
+        }
+        if (!dest.ok()) {
+          status = dest.status();
+          return;
+        }
+        futures.push_back(tensorstore::Read(source.value(), dest.value()));
+      });
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto all_done_future = tensorstore::WaitAllFuture(futures);
+  auto pair = tensorstore::PromiseFuturePair<
+      SharedArray<void, dynamic_rank, offset_origin>>::Make();
+  all_done_future.ExecuteWhenReady(
+      [target, promise = pair.promise](
+          tensorstore::ReadyFuture<void> readyFut) {
+        auto ready_result = readyFut.result();
+        if (!ready_result.ok()) {
+          promise.SetResult(ready_result.status());
+          return;
+        }
+        promise.SetResult(target);
+      });
+  return pair.future;
+}
+
+/**
+ * @brief Creates an empty occupancy bitmap matching a Variable's chunk grid.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<ChunkOccupancy> EmptyChunkOccupancy(const Variable<T, R, M>& variable) {
+  MDIO_ASSIGN_OR_RETURN(auto shape, variable.get_store_shape())
+  MDIO_ASSIGN_OR_RETURN(auto chunkShape, variable.get_chunk_shape())
+  return ChunkOccupancy::Create(std::vector<Index>(shape.begin(), shape.end()),
+                                std::vector<Index>(chunkShape.begin(),
+                                                   chunkShape.end()));
+}
+
+}  // namespace internal
+
+/**
+ * @brief Builds the occupancy bitmap of a Variable with a listing pass.
+ * The chunk keys are listed concurrently per chunk row, so no bulk data is
+ * read. The result is not stored; see `SetChunkOccupancy`.
+ * @param variable The Variable to scan.
+ * @return A future resolving to the occupancy bitmap.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Future<ChunkOccupancy> BuildChunkOccupancy(const Variable<T, R, M>& variable) {
+  MDIO_ASSIGN_OR_RETURN(auto occupancy,
+                        internal::EmptyChunkOccupancy(variable))
+  MDIO_ASSIGN_OR_RETURN(auto spec, variable.get_spec())
+  char separator = '.';
+  if (spec["metadata"].contains("dimension_separator") &&
+      spec["metadata"]["dimension_separator"] == "/") {
+    separator = '/';
+  }
+
+  auto kvstore = variable.get_store().kvstore();
+  const size_t rank = occupancy.rank();
+
+  // One listing per chunk row; fall back to leading digits for huge grids.
+  std::vector<std::string> prefixes;
+  if (rank > 1 &&
+      occupancy.grid_shape()[0] <= internal::kMaxOccupancyListPrefixes) {
+    for (Index i = 0; i < occupancy.grid_shape()[0]; ++i) {
+      prefixes.push_back(std::to_string(i) + separator);
+    }
+  } else {
+    for (char digit = '0'; digit <= '9'; ++digit) {
+      prefixes.push_back(std::string(1, digit));
+    }
+  }
+
+  std::vector<Future<std::vector<tensorstore::kvstore::ListEntry>>> listings;
+  std::vector<tensorstore::AnyFuture> futures;
+  listings.reserve(prefixes.size());
+  for (const auto& prefix : prefixes) {
+    tensorstore::kvstore::ListOptions options;
+    options.range = tensorstore::KeyRange::Prefix(prefix);
+    auto listing = tensorstore::kvstore::ListFuture(kvstore, options);
+    futures.push_back(listing);
+    listings.push_back(std::move(listing));
+  }
+
+  auto all_done_future = tensorstore::WaitAllFuture(futures);
+  auto pair = tensorstore::PromiseFuturePair<ChunkOccupancy>::Make();
+  all_done_future.ExecuteWhenReady(
+      [promise = pair.promise, listings = std::move(listings),
+       occupancy = std::move(occupancy), separator,
+       rank](tensorstore::ReadyFuture<void> readyFut) mutable {
+        for (const auto& listing : listings) {
+          auto entries = listing.result();
+          if (!entries.ok()) {
+            promise.SetResult(entries.status());
+            return;
+          }
+          for (const auto& entry : entries.value()) {
+            auto chunkIndex =
+                internal::ParseChunkKey(entry.key, separator, rank);
+            if (!chunkIndex.empty()) {
+              occupancy.set(chunkIndex);
+            }
+          }
+        }
+        promise.SetResult(std::move(occupancy));
+      });
+  return pair.future;
+}
+
+/**
+ * @brief Retrieves the occupancy bitmap stored in a Variable's attributes.
+ * @return The bitmap, or a NotFoundError if none was stored.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<ChunkOccupancy> GetChunkOccupancy(const Variable<T, R, M>& variable) {
+  auto occupancy = internal::GetChunkOccupancy(variable.GetAttributes());
+  if (absl::IsNotFound(occupancy.status())) {
+    return absl::NotFoundError("Variable " + variable.get_variable_name() +
+                               " has no chunk occupancy bitmap.");
+  }
+  return occupancy;
+}
+
+/**
+ * @brief Stores an occupancy bitmap in a Variable's attributes.
+ * NOTE: This does not commit changes to durable media. Please see the
+ * CommitMetadata method in the Dataset to commit changes.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<void> SetChunkOccupancy(Variable<T, R, M>& variable,  // NOLINT
+                               const ChunkOccupancy& occupancy) {
+  auto attrs = variable.GetAttributes();
+  attrs["attributes"][internal::kChunkOccupancyKey] = occupancy.ToJson();
+  return variable.UpdateAttributes(attrs);
+}
+
+/**
+ * @brief Marks the chunks covered by a written block in an occupancy bitmap.
+ * @param occupancy The bitmap to update.
+ * @param domain The domain of the block that was written.
+ */
+template <DimensionIndex R>
+void MarkWritten(ChunkOccupancy& occupancy,  // NOLINT
+                 const IndexDomainView<R>& domain) {
+  const size_t rank = std::min<size_t>(occupancy.rank(), domain.rank());
+  std::vector<Index> origin(rank), shape(rank);
+  for (size_t i = 0; i < rank; ++i) {
+    origin[i] = domain[i].inclusive_min();
+    shape[i] = domain[i].size();
+  }
+  occupancy.MarkBox(origin, shape);
+}
+
+/**
+ * @brief Reads a Variable, skipping the chunks that hold no data.
+ * Missing chunks are filled with the Variable's fill value without ever being
+ * requested from the store, and quantized Variables are dequantized as by
+ * `Variable::Read`. A view the bitmap does not describe, e.g. a strided
+ * slice, is read in full.
+ * @param variable The (possibly sliced) Variable to read.
+ * @param occupancy The occupancy bitmap of the whole Variable.
+ * @return A future of VariableData that will be ready when the read is
+ * complete.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Future<VariableData<T, R, offset_origin>> ReadOccupied(
+    const Variable<T, R, M>& variable, const ChunkOccupancy& occupancy) {
+  Variable<T, R, M> copy = variable;
+  return copy.Read(occupancy);
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_CHUNK_OCCUPANCY_H_
@@ -0,0 +1,426 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/chunk_occupancy.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+::nlohmann::json GetSparseToy() {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 64},
+      {"name": "crossline", "size": 64},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [16, 16, 32] }
+      }
+    },
+    "coordinates": ["inline", "crossline", "time"]
+  },
+  {
+    "name": "inline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "inline", "size": 64}]
+  },
+  {
+    "name": "crossline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "crossline", "size": 64}]
+  },
+  {
+    "name": "time",
+    "dataType": "uint32",
+    "dimensions": [{"name": "time", "size": 32}]
+  }
+]
+  )";
+  return mdio::test_util::Manifest("sparse_land", variables);
+}
+
+mdio::Result<mdio::Dataset> MakeSparseDataset(
+    const std::string& path, const ::nlohmann::json& json = GetSparseToy()) {
+  MDIO_ASSIGN_OR_RETURN(auto ds, mdio::test_util::SETUP(path, json).result())
+  MDIO_ASSIGN_OR_RETURN(auto image, ds.variables.get<float>("image"))
+
+  // Two live patches: chunk (0, 1) and chunks (3, 2) + (3, 3).
+  mdio::RangeDescriptor<mdio::Index> il1 = {"inline", 0, 16, 1};
+  mdio::RangeDescriptor<mdio::Index> xl1 = {"crossline", 16, 32, 1};
+  mdio::RangeDescriptor<mdio::Index> il2 = {"inline", 50, 60, 1};
+  mdio::RangeDescriptor<mdio::Index> xl2 = {"crossline", 40, 64, 1};
+  for (auto [il, xl] : {std::make_pair(il1, xl1), std::make_pair(il2, xl2)}) {
+    MDIO_ASSIGN_OR_RETURN(auto patch, image.slice(il, xl))
+    MDIO_ASSIGN_OR_RETURN(auto data, mdio::from_variable<float>(patch))
+    auto accessor = data.get_data_accessor();
+    auto* raw = accessor.data();
+    auto offset = data.get_flattened_offset();
+    for (mdio::Index i = 0; i < data.num_samples(); ++i) {
+      raw[i + offset] = 1.0f;
+    }
+    auto writeFut = patch.Write(data);
+    auto written = writeFut.commit_future.result();
+    if (!written.ok()) {
+      return written.status();
+    }
+  }
+  return ds;
+}
+
+TEST(ChunkOccupancy, create) {
+  auto occRes = mdio::ChunkOccupancy::Create({100, 50, 10}, {32, 16, 10});
+  ASSERT_TRUE(occRes.status().ok()) << occRes.status();
+  auto occ = occRes.value();
+  EXPECT_THAT(occ.grid_shape(), ::testing::ElementsAre(4, 4, 1));
+  EXPECT_EQ(occ.num_chunks(), 16);
+  EXPECT_EQ(occ.count(), 0);
+
+  EXPECT_FALSE(mdio::ChunkOccupancy::Create({10, 10}, {5}).status().ok());
+  EXPECT_FALSE(mdio::ChunkOccupancy::Create({10}, {0}).status().ok());
+}
+
+TEST(ChunkOccupancy, setAndTest) {
+  auto occ = mdio::ChunkOccupancy::Create({64, 64}, {16, 16}).value();
+  occ.set({1, 2});
+  occ.set({3, 3});
+  EXPECT_TRUE(occ.test({1, 2}));
+  EXPECT_TRUE(occ.test({3, 3}));
+  EXPECT_FALSE(occ.test({0, 0}));
+  EXPECT_FALSE(occ.test({4, 0})) << "Out of range chunks are empty";
+  EXPECT_EQ(occ.count(), 2);
+  occ.set({1, 2}, false);
+  EXPECT_FALSE(occ.test({1, 2}));
+  EXPECT_EQ(occ.count(), 1);
+}
+
+TEST(ChunkOccupancy, markBox) {
+  auto occ = mdio::ChunkOccupancy::Create({64, 64}, {16, 16}).value();
+  occ.MarkBox({10, 30}, {10, 3});
+  EXPECT_EQ(occ.count(), 4);
+  EXPECT_TRUE(occ.test({0, 1}));
+  EXPECT_TRUE(occ.test({1, 2}));
+  EXPECT_FALSE(occ.test({0, 0}));
+  EXPECT_TRUE(occ.AnyInBox({0, 0}, {64, 64}));
+  EXPECT_FALSE(occ.AnyInBox({32, 0}, {32, 64}));
+}
+
+TEST(ChunkOccupancy, coalescedRegions) {
+  auto occ = mdio::ChunkOccupancy::Create({40, 64}, {16, 16}).value();
+  occ.set({0, 0});
+  occ.set({0, 1});
+  occ.set({0, 3});
+  occ.set({2, 2});
+
+  std::vector<std::vector<mdio::Index>> origins, shapes;
+  occ.ForEachOccupiedRegion(
+      {0, 0}, {40, 64},
+      [&](const std::vector<mdio::Index>& o,
+          const std::vector<mdio::Index>& s) {
+        origins.push_back(o);
+        shapes.push_back(s);
+      });
+  ASSERT_EQ(origins.size(), 3);
+  EXPECT_THAT(origins[0], ::testing::ElementsAre(0, 0));
+  EXPECT_THAT(shapes[0], ::testing::ElementsAre(16, 32));
+  EXPECT_THAT(origins[1], ::testing::ElementsAre(0, 48));
+  EXPECT_THAT(shapes[1], ::testing::ElementsAre(16, 16));
+  // The last chunk row is clipped to the shape.
+  EXPECT_THAT(origins[2], ::testing::ElementsAre(32, 32));
+  EXPECT_THAT(shapes[2], ::testing::ElementsAre(8, 16));
+
+  // Regions are clipped to the requested box.
+  origins.clear();
+  shapes.clear();
+  occ.ForEachOccupiedRegion(
+      {4, 8}, {4, 20},
+      [&](const std::vector<mdio::Index>& o,
+          const std::vector<mdio::Index>& s) {
+        origins.push_back(o);
+        shapes.push_back(s);
+      });
+  ASSERT_EQ(origins.size(), 1);
+  EXPECT_THAT(origins[0], ::testing::ElementsAre(4, 8));
+  EXPECT_THAT(shapes[0], ::testing::ElementsAre(4, 20));
+}
+
+TEST(ChunkOccupancy, project) {
+  auto occ = mdio::ChunkOccupancy::Create({64, 64, 64}, {16, 16, 16}).value();
+  occ.set({1, 2, 0});
+  occ.set({1, 2, 3});
+  occ.set({2, 0, 1});
+  auto footprintRes = occ.Project({0, 1});
+  ASSERT_TRUE(footprintRes.status().ok()) << footprintRes.status();
+  auto footprint = footprintRes.value();
+  EXPECT_EQ(footprint.rank(), 2);
+  EXPECT_EQ(footprint.count(), 2);
+  EXPECT_TRUE(footprint.test({1, 2}));
+  EXPECT_TRUE(footprint.test({2, 0}));
+  EXPECT_FALSE(occ.Project({3}).status().ok());
+}
+
+TEST(ChunkOccupancy, merge) {
+  auto a = mdio::ChunkOccupancy::Create({64}, {16}).value();
+  auto b = mdio::ChunkOccupancy::Create({64}, {16}).value();
+  a.set({0});
+  b.set({3});
+  ASSERT_TRUE(a.Merge(b).ok());
+  EXPECT_EQ(a.count(), 2);
+  auto c = mdio::ChunkOccupancy::Create({64}, {8}).value();
+  EXPECT_FALSE(a.Merge(c).ok());
+}
+
+TEST(ChunkOccupancy, jsonRoundTrip) {
+  // Sparse bitmaps are run-length encoded.
+  auto sparse = mdio::ChunkOccupancy::Create({1024, 1024}, {8, 8}).value();
+  sparse.MarkBox({0, 0}, {64, 1024});
+  auto sparseJson = sparse.ToJson();
+  EXPECT_EQ(sparseJson["encoding"], "rle") << sparseJson;
+  EXPECT_EQ(sparseJson["count"], sparse.count());
+  auto sparseRes = mdio::ChunkOccupancy::FromJson(sparseJson);
+  ASSERT_TRUE(sparseRes.status().ok()) << sparseRes.status();
+  EXPECT_EQ(sparseRes.value().count(), sparse.count());
+  EXPECT_EQ(sparseRes.value().ToJson(), sparseJson);
+
+  // Checkerboards fall back to a packed bitmap.
+  auto dense = mdio::ChunkOccupancy::Create({64, 64}, {1, 1}).value();
+  for (mdio::Index i = 0; i < 64; ++i) {
+    for (mdio::Index j = (i % 2); j < 64; j += 2) {
+      dense.set({i, j});
+    }
+  }
+  auto denseJson = dense.ToJson();
+  EXPECT_EQ(denseJson["encoding"], "bitmap") << denseJson;
+  auto denseRes = mdio::ChunkOccupancy::FromJson(denseJson);
+  ASSERT_TRUE(denseRes.status().ok()) << denseRes.status();
+  EXPECT_EQ(denseRes.value().ToJson(), denseJson);
+}
+
+TEST(ChunkOccupancy, malformedJson) {
+  EXPECT_FALSE(mdio::ChunkOccupancy::FromJson({{"shape", {4}}}).status().ok());
+  nlohmann::json j = {{"shape", {4}},
+                      {"chunkShape", {1}},
+                      {"encoding", "rle"},
+                      {"bits", {2, 5}}};
+  EXPECT_FALSE(mdio::ChunkOccupancy::FromJson(j).status().ok())
+      << "Runs exceeding the grid should be rejected";
+  j["encoding"] = "unknown";
+  EXPECT_FALSE(mdio::ChunkOccupancy::FromJson(j).status().ok());
+}
+
+TEST(ChunkOccupancy, parseChunkKey) {
+  EXPECT_THAT(mdio::internal::ParseChunkKey("3/0/12", '/', 3),
+              ::testing::ElementsAre(3, 0, 12));
+  EXPECT_THAT(mdio::internal::ParseChunkKey("3.0", '.', 2),
+              ::testing::ElementsAre(3, 0));
+  EXPECT_TRUE(mdio::internal::ParseChunkKey(".zarray", '/', 1).empty());
+  EXPECT_TRUE(mdio::internal::ParseChunkKey("1/2", '/', 3).empty());
+}
+
+TEST(ChunkOccupancy, buildFromListing) {
+  const std::string path = "zarrs/occupancy";
+  auto dsRes = MakeSparseDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  auto image = ds.variables.at("image").value();
+
+  auto occRes = mdio::BuildChunkOccupancy(image).result();
+  ASSERT_TRUE(occRes.status().ok()) << occRes.status();
+  auto occ = occRes.value();
+  EXPECT_THAT(occ.grid_shape(), ::testing::ElementsAre(4, 4, 1));
+  EXPECT_EQ(occ.count(), 3);
+  EXPECT_TRUE(occ.test({0, 1, 0}));
+  EXPECT_TRUE(occ.test({3, 2, 0}));
+  EXPECT_TRUE(occ.test({3, 3, 0}));
+  std::filesystem::remove_all(path);
+}
+
+TEST(ChunkOccupancy, readOccupied) {
+  const std::string path = "zarrs/occupancy";
+  auto dsRes = MakeSparseDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  auto image = ds.variables.get<float>("image").value();
+
+  auto occ = mdio::BuildChunkOccupancy(image).result().value();
+  auto sparseRes = mdio::ReadOccupied(image, occ).result();
+  ASSERT_TRUE(sparseRes.status().ok()) << sparseRes.status();
+  auto fullRes = image.Read().result();
+  ASSERT_TRUE(fullRes.status().ok()) << fullRes.status();
+
+  auto sparse = sparseRes.value().get_data_accessor();
+  auto full = fullRes.value().get_data_accessor();
+  for (mdio::Index i = 0; i < 64; ++i) {
+    for (mdio::Index j = 0; j < 64; ++j) {
+      for (mdio::Index k = 0; k < 32; k += 7) {
+        float expected = full({i, j, k});
+        float actual = sparse({i, j, k});
+        if (std::isnan(expected)) {
+          ASSERT_TRUE(std::isnan(actual)) << i << " " << j << " " << k;
+        } else {
+          ASSERT_EQ(actual, expected) << i << " " << j << " " << k;
+        }
+      }
+    }
+  }
+  std::filesystem::remove_all(path);
+}
+
+TEST(ChunkOccupancy, readOccupiedSliced) {
+  const std::string path = "zarrs/occupancy";
+  auto dsRes = MakeSparseDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  auto image = ds.variables.get<float>("image").value();
+  auto occ = mdio::BuildChunkOccupancy(image).result().value();
+
+  mdio::RangeDescriptor<mdio::Index> il = {"inline", 8, 56, 1};
+  mdio::RangeDescriptor<mdio::Index> xl = {"crossline", 20, 50, 1};
+  auto sliced = image.slice(il, xl).value();
+  auto readRes = mdio::ReadOccupied(sliced, occ).result();
+  ASSERT_TRUE(readRes.status().ok()) << readRes.status();
+  auto data = readRes.value().get_data_accessor();
+  EXPECT_EQ(data({8, 20, 0}), 1.0f);
+  EXPECT_EQ(data({55, 49, 31}), 1.0f);
+  EXPECT_TRUE(std::isnan(data({40, 20, 0})));
+  std::filesystem::remove_all(path);
+}
+
+TEST(ChunkOccupancy, readOccupiedQuantized) {
+  const std::string path = "zarrs/occupancy";
+  auto json = GetSparseToy();
+  json["variables"][0]["metadata"]["attributes"]["quantization"] = {
+      {"dtype", "int16"}, {"scale", 0.5}};
+  auto dsRes = MakeSparseDataset(path, json);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+  // The codes are listed through the stored int16 array.
+  auto codes = dsRes.value().variables.at("image").value();
+  auto occ = mdio::BuildChunkOccupancy(codes).result().value();
+  EXPECT_EQ(occ.count(), 3);
+
+  auto readRes = mdio::ReadOccupied(image, occ).result();
+  ASSERT_TRUE(readRes.status().ok()) << readRes.status();
+  auto data = readRes.value().get_data_accessor();
+  EXPECT_EQ(data({0, 16, 0}), 1.0f) << "Codes are dequantized";
+  EXPECT_EQ(data({55, 63, 31}), 1.0f);
+  EXPECT_TRUE(std::isnan(data({0, 0, 0}))) << "Missing chunks are NaN";
+  std::filesystem::remove_all(path);
+}
+
+TEST(ChunkOccupancy, storedBitmap) {
+  const std::string path = "zarrs/occupancy";
+  auto dsRes = MakeSparseDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto updateRes = dsRes.value().UpdateChunkOccupancy("image").result();
+  ASSERT_TRUE(updateRes.status().ok()) << updateRes.status();
+  ASSERT_TRUE(dsRes.value().CommitMetadata().result().ok());
+
+  mdio::SimKvStoreOptions sim;
+  sim.name = "storedBitmap";
+  sim.latencyMedianMs = 0;
+  sim.latencyP99Ms = 0;
+  sim.bandwidthMiBps = 0;
+  sim.concurrency = 0;
+  auto ds = mdio::Dataset::Open(path, sim, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image").value();
+
+  // Only the 3 occupied of the 16 chunks are requested.
+  mdio::ResetSimKvStoreStats(sim.name);
+  auto readRes = image.Read().result();
+  ASSERT_TRUE(readRes.status().ok()) << readRes.status();
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 3);
+  auto data = readRes.value().get_data_accessor();
+  EXPECT_EQ(data({0, 16, 0}), 1.0f);
+  EXPECT_TRUE(std::isnan(data({0, 0, 0})));
+
+  // Writes mark their chunks, so they are read back.
+  mdio::RangeDescriptor<mdio::Index> il = {"inline", 0, 16, 1};
+  mdio::RangeDescriptor<mdio::Index> xl = {"crossline", 0, 16, 1};
+  auto patch = image.slice(il, xl).value();
+  auto patchData = mdio::from_variable<float>(patch).value();
+  auto accessor = patchData.get_data_accessor();
+  for (mdio::Index i = 0; i < 16; ++i) {
+    for (mdio::Index j = 0; j < 16; ++j) {
+      for (mdio::Index k = 0; k < 32; ++k) {
+        accessor({i, j, k}) = 2.0f;
+      }
+    }
+  }
+  ASSERT_TRUE(patch.Write(patchData).commit_future.result().ok());
+  EXPECT_EQ(ds.value().GetChunkOccupancy("image").value().count(), 4);
+  auto rereadRes = image.Read().result();
+  ASSERT_TRUE(rereadRes.status().ok()) << rereadRes.status();
+  EXPECT_EQ(rereadRes.value().get_data_accessor()({0, 0, 0}), 2.0f);
+
+  // A strided view reads everything and drops the bitmap when written.
+  mdio::RangeDescriptor<mdio::Index> strided = {"inline", 0, 64, 2};
+  auto everyOther = image.slice(strided).value();
+  auto stridedRes = everyOther.Read().result();
+  ASSERT_TRUE(stridedRes.status().ok()) << stridedRes.status();
+  EXPECT_EQ(stridedRes.value().get_data_accessor()({0, 0, 0}), 2.0f);
+  ASSERT_TRUE(everyOther.Write(stridedRes.value()).commit_future.result().ok());
+  EXPECT_FALSE(ds.value().GetChunkOccupancy("image").ok());
+  std::filesystem::remove_all(path);
+}
+
+TEST(ChunkOccupancy, datasetFootprint) {
+  const std::string path = "zarrs/occupancy";
+  auto dsRes = MakeSparseDataset(path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  EXPECT_FALSE(ds.GetChunkOccupancy("image").status().ok())
+      << "No bitmap should exist before one is built";
+
+  auto updateRes = ds.UpdateChunkOccupancy("image").result();
+  ASSERT_TRUE(updateRes.status().ok()) << updateRes.status();
+  auto commitRes = ds.CommitMetadata().result();
+  ASSERT_TRUE(commitRes.ok()) << commitRes.status();
+
+  auto reopened = mdio::Dataset::Open(path, mdio::constants::kOpen).result();
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  auto footprintRes = reopened.value().GetLiveTraceFootprint("image");
+  ASSERT_TRUE(footprintRes.status().ok()) << footprintRes.status();
+  auto footprint = footprintRes.value();
+  EXPECT_EQ(footprint.rank(), 2);
+  EXPECT_EQ(footprint.count(), 3);
+  EXPECT_TRUE(footprint.test({0, 1}));
+  EXPECT_FALSE(footprint.test({0, 0}));
+
+  EXPECT_FALSE(reopened.value().GetLiveTraceFootprint("inline").status().ok());
+  std::filesystem::remove_all(path);
+}
+
+}  // namespace
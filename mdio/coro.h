@@ -0,0 +1,661 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_CORO_H_
+#define MDIO_CORO_H_
+
+// Coroutine adapters are optional: the rest of MDIO is C++17 and never
+// includes this header.
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "mdio/coro.h needs C++20 coroutines, compile with -std=c++20."
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <thread>  // NOLINT
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "tensorstore/util/executor.h"
+#include "tensorstore/util/future.h"
+
+namespace mdio {
+namespace coro {
+
+/// Runs the continuations of tasks, see ThreadPool.
+using Executor = tensorstore::Executor;
+
+template <typename T = void>
+class Task;
+
+/**
+ * @brief Awaits a Future, resuming on an executor once it is ready.
+ * Tasks await Futures directly; this is for other coroutine types.
+ * @return The Result of the Future.
+ */
+template <typename T>
+struct FutureAwaiter {
+  bool await_ready() const noexcept { return future.ready(); }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    // The callback may run before ExecuteWhenReady returns, when the frame
+    // holding this awaiter may be gone, so a copy of the Future registers it.
+    Future<T>(future).ExecuteWhenReady(
+        [handle, executor = executor](tensorstore::ReadyFuture<T>) {
+          executor([handle] { handle.resume(); });
+        });
+  }
+
+  auto await_resume() { return future.result(); }
+
+  Future<T> future;
+  Executor executor = tensorstore::InlineExecutor{};
+};
+
+namespace internal {
+
+template <typename T>
+struct IsFuture : std::false_type {};
+template <typename T>
+struct IsFuture<tensorstore::Future<T>> : std::true_type {};
+
+// The part of a promise common to every task.
+struct PromiseBase {
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<P> handle) noexcept {
+      auto continuation = handle.promise().continuation;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() noexcept {}
+  };
+
+  // Tasks are lazy: they start when awaited.
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  FinalAwaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  template <typename T>
+  FutureAwaiter<T> await_transform(Future<T> future) {
+    return {std::move(future), executor};
+  }
+
+  template <typename Awaitable>
+    requires(!IsFuture<std::remove_cvref_t<Awaitable>>::value)
+  Awaitable&& await_transform(Awaitable&& awaitable) {
+    return std::forward<Awaitable>(awaitable);
+  }
+
+  // Where the task resumes once a Future it awaits is ready. Tasks inherit it
+  // from the task that awaits them.
+  Executor executor = tensorstore::InlineExecutor{};
+  // The coroutine awaiting the task.
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+};
+
+template <typename T>
+struct TaskPromise : PromiseBase {
+  void return_value(T v) { value.emplace(std::move(v)); }
+
+  T Take() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+
+template <>
+struct TaskPromise<void> : PromiseBase {
+  void return_void() {}
+
+  void Take() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+// Sets the executor of the promise of `handle` if it is a task's.
+template <typename P>
+void InheritExecutor(std::coroutine_handle<P> handle, Executor& executor) {
+  if constexpr (std::is_base_of_v<PromiseBase, P>) {
+    executor = handle.promise().executor;
+  }
+}
+
+// A coroutine that runs to completion on its own once started, and frees
+// itself.
+struct Runner {
+  struct promise_type : PromiseBase {
+    Runner get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+// Starts a runner on an executor.
+inline void Start(Runner runner, const Executor& executor) {
+  runner.handle.promise().executor = executor;
+  executor([handle = runner.handle] { handle.resume(); });
+}
+
+// The value or exception of a finished task.
+template <typename T>
+struct Outcome {
+  T Take() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+  std::exception_ptr exception;
+};
+
+template <>
+struct Outcome<void> {
+  void Take() {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  std::exception_ptr exception;
+};
+
+// Awaits `task` into `outcome`, then calls `done`, which must be the last
+// use of anything the runner points to.
+template <typename T, typename Done>
+Runner Run(Task<T> task, Outcome<T>* outcome, Done done) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(task);
+    } else {
+      outcome->value.emplace(co_await std::move(task));
+    }
+  } catch (...) {
+    outcome->exception = std::current_exception();
+  }
+  done();
+}
+
+// Counts down the tasks of a WhenAll and resumes it after the last.
+struct WhenAllState {
+  void Arrive() {
+    if (pending.fetch_sub(1) == 1) {
+      parent.resume();
+    }
+  }
+
+  std::atomic<size_t> pending{0};
+  std::coroutine_handle<> parent;
+};
+
+// Starts every runner of a WhenAll from the awaiting task.
+struct StartAll {
+  bool await_ready() noexcept { return runners.empty(); }
+
+  template <typename P>
+  bool await_suspend(std::coroutine_handle<P> parent) {
+    Executor executor = tensorstore::InlineExecutor{};
+    InheritExecutor(parent, executor);
+    state->parent = parent;
+    // One more than the runners, so that none resumes the parent before all
+    // have started.
+    state->pending = runners.size() + 1;
+    for (auto& runner : runners) {
+      runner.handle.promise().executor = executor;
+      runner.handle.resume();
+    }
+    // Carries on without suspending if every runner has finished.
+    return state->pending.fetch_sub(1) != 1;
+  }
+
+  void await_resume() noexcept {}
+
+  WhenAllState* state;
+  std::vector<Runner> runners;
+};
+
+// Resumes the awaiting task on an executor, which it keeps.
+struct ScheduleAwaiter {
+  bool await_ready() noexcept { return false; }
+
+  template <typename P>
+  void await_suspend(std::coroutine_handle<P> handle) {
+    if constexpr (std::is_base_of_v<PromiseBase, P>) {
+      handle.promise().executor = executor;
+    }
+    // The task may resume, and free this awaiter, before the call returns.
+    Executor target = executor;
+    target([handle] { handle.resume(); });
+  }
+
+  void await_resume() noexcept {}
+
+  Executor executor;
+};
+
+}  // namespace internal
+
+/**
+ * @brief A lazily started coroutine with a result of type T.
+ * A task starts when it is awaited and resumes its awaiter when it finishes.
+ * Within a task, `co_await` on a Future suspends without blocking a thread
+ * and resumes on the task's executor, inherited from the task that awaits it
+ * or set by SyncWait, Spawn or Schedule. The default executor resumes on
+ * the thread that completed the Future, so tasks that compute should run on a
+ * ThreadPool. The result of awaiting a Future<T> is its Result<T>.
+ * @details \b Usage
+ * @code
+ * mdio::coro::Task<mdio::Result<float>> PeakOfInline(mdio::Variable<> seismic,
+ *                                                    mdio::Index inline_) {
+ *   mdio::SliceDescriptor desc = {"inline", inline_, inline_ + 1, 1};
+ *   auto slice = seismic.slice(desc);
+ *   if (!slice.ok()) co_return slice.status();
+ *   auto data = co_await slice.value().Read();
+ *   if (!data.ok()) co_return data.status();
+ *   ...
+ * }
+ * @endcode
+ * MDIO_ASSIGN_OR_RETURN expands to `return`, which coroutines cannot use, so
+ * tasks check their Results and `co_return` the status.
+ */
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  struct promise_type : internal::TaskPromise<T> {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+  struct Awaiter {
+    bool await_ready() noexcept { return false; }
+
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> parent) {
+      handle.promise().continuation = parent;
+      internal::InheritExecutor(parent, handle.promise().executor);
+      return handle;
+    }
+
+    T await_resume() { return handle.promise().Take(); }
+
+    std::coroutine_handle<promise_type> handle;
+  };
+
+  Task(Task&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      if (handle_) {
+        handle_.destroy();
+      }
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  /// Runs the task and gives its result, or rethrows its exception.
+  Awaiter operator co_await() && noexcept { return Awaiter{handle_}; }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/**
+ * @brief A fixed set of threads that run tasks.
+ * Thousands of tasks awaiting reads need only a few threads, as a suspended
+ * task holds none.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief Starts the threads.
+   * @param numThreads The number of threads; 0 uses the hardware concurrency.
+   */
+  explicit ThreadPool(int numThreads = 0) {
+    if (numThreads <= 0) {
+      numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+      threads_.emplace_back([this] { Work(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Runs what is queued, then joins the threads.
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  /// The executor that queues work on the pool, valid while it lives.
+  Executor executor() {
+    return [this](tensorstore::ExecutorTask task) { Post(std::move(task)); };
+  }
+
+  /// Queues work to run on one of the threads.
+  void Post(tensorstore::ExecutorTask task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(task));
+    }
+    ready_.notify_one();
+  }
+
+ private:
+  void Work() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      auto task = std::move(queue_.front());
+      queue_.pop_front();
+      lock.unlock();
+      std::move(task)();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<tensorstore::ExecutorTask> queue_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+/**
+ * @brief Moves the awaiting task onto an executor.
+ * The task resumes there, and so do its later awaits of Futures.
+ * @code
+ * co_await mdio::coro::Schedule(pool.executor());
+ * @endcode
+ */
+inline internal::ScheduleAwaiter Schedule(Executor executor) {
+  return {std::move(executor)};
+}
+
+/**
+ * @brief Bounds how many tasks hold a permit at once, such as the reads in
+ * flight.
+ * Tasks that await Acquire beyond the bound suspend until a permit is
+ * released, and resume on their executor.
+ * @code
+ * mdio::coro::Semaphore inflight(256);
+ * ...
+ * auto permit = co_await inflight.Acquire();
+ * auto data = co_await variable.Read();
+ * @endcode
+ */
+class Semaphore {
+ public:
+  /// A permit, released when destroyed.
+  class Permit {
+   public:
+    explicit Permit(Semaphore* semaphore) : semaphore_(semaphore) {}
+    Permit(Permit&& other) noexcept
+        : semaphore_(std::exchange(other.semaphore_, nullptr)) {}
+    Permit& operator=(Permit&& other) noexcept {
+      if (this != &other) {
+        Release();
+        semaphore_ = std::exchange(other.semaphore_, nullptr);
+      }
+      return *this;
+    }
+    ~Permit() { Release(); }
+
+    /// Releases the permit before the end of its scope.
+    void Release() {
+      if (semaphore_) {
+        std::exchange(semaphore_, nullptr)->Release();
+      }
+    }
+
+   private:
+    Semaphore* semaphore_;
+  };
+
+  explicit Semaphore(Index permits) : permits_(permits) {}
+
+  Semaphore(const Semaphore&) = delete;
+  Semaphore& operator=(const Semaphore&) = delete;
+
+  class AcquireAwaiter {
+   public:
+    explicit AcquireAwaiter(Semaphore* semaphore) : semaphore_(semaphore) {}
+
+    bool await_ready() {
+      std::lock_guard<std::mutex> lock(semaphore_->mutex_);
+      return semaphore_->TakeLocked();
+    }
+
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> handle) {
+      Executor executor = tensorstore::InlineExecutor{};
+      internal::InheritExecutor(handle, executor);
+      std::lock_guard<std::mutex> lock(semaphore_->mutex_);
+      if (semaphore_->TakeLocked()) {
+        return false;
+      }
+      semaphore_->waiters_.push_back({handle, std::move(executor)});
+      return true;
+    }
+
+    Permit await_resume() { return Permit(semaphore_); }
+
+   private:
+    Semaphore* semaphore_;
+  };
+
+  /// Awaits a permit.
+  AcquireAwaiter Acquire() { return AcquireAwaiter(this); }
+
+  /// The permits not held.
+  Index available() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return permits_;
+  }
+
+ private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    Executor executor;
+  };
+
+  bool TakeLocked() {
+    if (permits_ > 0) {
+      --permits_;
+      return true;
+    }
+    return false;
+  }
+
+  // Hands the permit to the first waiter, if any.
+  void Release() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (waiters_.empty()) {
+      ++permits_;
+      return;
+    }
+    Waiter waiter = std::move(waiters_.front());
+    waiters_.pop_front();
+    lock.unlock();
+    waiter.executor([handle = waiter.handle] { handle.resume(); });
+  }
+
+  std::mutex mutex_;
+  Index permits_;
+  std::deque<Waiter> waiters_;
+};
+
+/**
+ * @brief Runs tasks concurrently and gives all their results, in order.
+ * The tasks start on the awaiting thread and run until their first suspension,
+ * so their reads are all issued before any result is awaited. If tasks throw,
+ * the exception of the first in order is rethrown once all have finished.
+ */
+template <typename T>
+Task<std::vector<T>> WhenAll(std::vector<Task<T>> tasks) {
+  std::vector<internal::Outcome<T>> outcomes(tasks.size());
+  internal::WhenAllState state;
+  internal::StartAll start{&state, {}};
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    start.runners.push_back(internal::Run(std::move(tasks[i]), &outcomes[i],
+                                          [&state] { state.Arrive(); }));
+  }
+  co_await std::move(start);
+  std::vector<T> results;
+  results.reserve(outcomes.size());
+  for (auto& outcome : outcomes) {
+    results.push_back(outcome.Take());
+  }
+  co_return results;
+}
+
+/**
+ * @brief Runs tasks without results concurrently, see the overload with
+ * results.
+ */
+inline Task<void> WhenAll(std::vector<Task<void>> tasks) {
+  std::vector<internal::Outcome<void>> outcomes(tasks.size());
+  internal::WhenAllState state;
+  internal::StartAll start{&state, {}};
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    start.runners.push_back(internal::Run(std::move(tasks[i]), &outcomes[i],
+                                          [&state] { state.Arrive(); }));
+  }
+  co_await std::move(start);
+  for (auto& outcome : outcomes) {
+    outcome.Take();
+  }
+}
+
+/**
+ * @brief Awaits Futures that are already in flight and gives their Results,
+ * in order.
+ */
+template <typename T>
+Task<std::vector<Result<T>>> WhenAll(std::vector<Future<T>> futures) {
+  std::vector<Result<T>> results;
+  results.reserve(futures.size());
+  for (auto& future : futures) {
+    results.push_back(co_await std::move(future));
+  }
+  co_return results;
+}
+
+/**
+ * @brief Runs a task on an executor and blocks until it finishes.
+ * This is the bridge from ordinary code, such as `main`, into tasks.
+ * @param task The task.
+ * @param executor Where the task starts and resumes.
+ * @return The result of the task; its exception is rethrown.
+ */
+template <typename T>
+T SyncWait(Task<T> task,
+           Executor executor = tensorstore::InlineExecutor{}) {
+  internal::Outcome<T> outcome;
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;
+  internal::Start(internal::Run(std::move(task), &outcome,
+                                [&] {
+                                  std::lock_guard<std::mutex> lock(mutex);
+                                  done = true;
+                                  finished.notify_all();
+                                }),
+                  executor);
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return done; });
+  return outcome.Take();
+}
+
+namespace internal {
+
+template <typename T>
+Runner Fulfill(Task<Result<T>> task, tensorstore::Promise<T> promise) {
+  std::optional<Result<T>> result;
+  try {
+    result.emplace(co_await std::move(task));
+  } catch (...) {
+    result.emplace(absl::UnknownError("The task threw an exception."));
+  }
+  promise.SetResult(std::move(*result));
+}
+
+}  // namespace internal
+
+/**
+ * @brief Runs a task on an executor and gives its result as a Future.
+ * This is the bridge from tasks back to the Future based API.
+ * @param task The task.
+ * @param executor Where the task starts and resumes.
+ * @return A Future of the result. An exception of the task becomes an
+ * unknown error.
+ */
+template <typename T>
+Future<T> Spawn(Task<Result<T>> task, const Executor& executor) {
+  auto pair = tensorstore::PromiseFuturePair<T>::Make();
+  internal::Start(internal::Fulfill(std::move(task), std::move(pair.promise)),
+                  executor);
+  return std::move(pair.future);
+}
+
+}  // namespace coro
+}  // namespace mdio
+
+#endif  // MDIO_CORO_H_
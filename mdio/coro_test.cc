@@ -0,0 +1,191 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/coro.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/coro.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "seismic",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 64},
+      {"name": "crossline", "size": 4},
+      {"name": "time", "size": 8}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4, 8] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("coro", variables));
+  return mdio::test_util::Fill<float>(ds, "seismic", [](auto index) {
+    return index[0] * 100 + index[1] * 10 + index[2];
+  });
+}
+
+struct Counters {
+  std::atomic<int> inflight{0};
+  std::atomic<int> peak{0};
+};
+
+// Reads one inline and sums it, holding a permit while the read is in
+// flight.
+mdio::coro::Task<mdio::Result<double>> SumInline(
+    mdio::Variable<float> seismic, mdio::Index inline_,
+    mdio::coro::Semaphore& permits, Counters& counters) {
+  mdio::SliceDescriptor desc = {"inline", inline_, inline_ + 1, 1};
+  auto slice = seismic.slice(desc);
+  if (!slice.ok()) {
+    co_return slice.status();
+  }
+  auto permit = co_await permits.Acquire();
+  int now = ++counters.inflight;
+  int peak = counters.peak.load();
+  while (now > peak && !counters.peak.compare_exchange_weak(peak, now)) {
+  }
+  auto data = co_await slice.value().Read();
+  --counters.inflight;
+  permit.Release();
+  if (!data.ok()) {
+    co_return data.status();
+  }
+  auto values = data.value().get_data_accessor();
+  double sum = 0;
+  for (int j = 0; j < 4; ++j) {
+    for (int k = 0; k < 8; ++k) {
+      sum += values({inline_, j, k});
+    }
+  }
+  co_return sum;
+}
+
+mdio::coro::Task<std::vector<mdio::Result<double>>> SumInlines(
+    mdio::Variable<float> seismic, mdio::coro::Semaphore& permits,
+    Counters& counters) {
+  std::vector<mdio::coro::Task<mdio::Result<double>>> tasks;
+  for (mdio::Index i = 0; i < 64; ++i) {
+    tasks.push_back(SumInline(seismic, i, permits, counters));
+  }
+  co_return co_await mdio::coro::WhenAll(std::move(tasks));
+}
+
+double ExpectedSum(int i) {
+  // 32 samples of i * 100, plus 8 * (0 + 10 + 20 + 30) and 4 * (0 + ... + 7).
+  return 32.0 * i * 100 + 8 * 60 + 4 * 28;
+}
+
+TEST(Coro, whenAllReads) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto seismic = ds.value().variables.get<float>("seismic");
+  ASSERT_TRUE(seismic.ok()) << seismic.status();
+
+  mdio::coro::ThreadPool pool(2);
+  mdio::coro::Semaphore permits(8);
+  Counters counters;
+  auto sums = mdio::coro::SyncWait(
+      SumInlines(seismic.value(), permits, counters), pool.executor());
+  ASSERT_EQ(sums.size(), 64);
+  for (int i = 0; i < 64; ++i) {
+    ASSERT_TRUE(sums[i].ok()) << sums[i].status();
+    EXPECT_DOUBLE_EQ(sums[i].value(), ExpectedSum(i)) << i;
+  }
+  EXPECT_LE(counters.peak, 8);
+  EXPECT_EQ(permits.available(), 8);
+}
+
+mdio::coro::Task<double> SumFutures(mdio::Variable<float> seismic) {
+  std::vector<mdio::Future<mdio::VariableData<float>>> reads;
+  for (mdio::Index i = 0; i < 4; ++i) {
+    mdio::SliceDescriptor desc = {"inline", i, i + 1, 1};
+    reads.push_back(seismic.slice(desc).value().Read());
+  }
+  auto results = co_await mdio::coro::WhenAll(std::move(reads));
+  double sum = 0;
+  for (mdio::Index i = 0; i < 4; ++i) {
+    sum += results[i].value().get_data_accessor()({i, 3, 7});
+  }
+  co_return sum;
+}
+
+TEST(Coro, futures) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto seismic = ds.value().variables.get<float>("seismic");
+  ASSERT_TRUE(seismic.ok()) << seismic.status();
+  // Sample (i, 3, 7) of the first four inlines.
+  EXPECT_DOUBLE_EQ(mdio::coro::SyncWait(SumFutures(seismic.value())),
+                   600 + 4 * 37.0);
+}
+
+mdio::coro::Task<mdio::Result<std::thread::id>> ThreadOf(
+    mdio::coro::ThreadPool& pool) {
+  co_await mdio::coro::Schedule(pool.executor());
+  co_return std::this_thread::get_id();
+}
+
+TEST(Coro, spawn) {
+  mdio::coro::ThreadPool pool(1);
+  auto future = mdio::coro::Spawn(ThreadOf(pool), pool.executor());
+  auto id = future.result();
+  ASSERT_TRUE(id.ok()) << id.status();
+  EXPECT_NE(id.value(), std::this_thread::get_id());
+}
+
+mdio::coro::Task<> Fails() {
+  throw std::runtime_error("failed");
+  co_return;
+}
+
+mdio::coro::Task<bool> CatchesFailure() {
+  std::vector<mdio::coro::Task<>> tasks;
+  tasks.push_back(Fails());
+  bool threw = false;
+  try {
+    co_await mdio::coro::WhenAll(std::move(tasks));
+  } catch (const std::runtime_error&) {
+    threw = true;
+  }
+  co_return threw;
+}
+
+TEST(Coro, exceptions) {
+  EXPECT_TRUE(mdio::coro::SyncWait(CatchesFailure()));
+}
+
+}  // namespace
@@ -21,6 +21,7 @@
 #include <limits>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <stdexcept>
 #include <string>
@@ -30,7 +31,13 @@
 #include <utility>
 #include <vector>
 
+#include "mdio/analytic_coordinate.h"
+#include "mdio/chunk_grid.h"
+#include "mdio/chunk_occupancy.h"
 #include "mdio/dataset_factory.h"
+#include "mdio/disk_cache.h"
+#include "mdio/shared_json.h"
+#include "mdio/sim_kvstore.h"
 #include "mdio/variable.h"
 #include "mdio/variable_collection.h"
 #include "tensorstore/driver/zarr/metadata.h"
@@ -122,11 +129,13 @@ Result<nlohmann::json> get_zarray(const ::nlohmann::json metadata) {
  *
  * @param dataset_metadata The metadata for the dataset.
  * @param json_variables The JSON variables.
+ * @param transaction The transaction to stage the writes in, if any.
  * @return An `mdio::Future<void>` representing the asynchronous write.
  */
 Future<void> write_zmetadata(
     const ::nlohmann::json& dataset_metadata,
-    const std::vector<::nlohmann::json>& json_variables) {
+    const std::vector<::nlohmann::json>& json_variables,
+    const tensorstore::Transaction& transaction = tensorstore::no_transaction) {
   // header material at the root of the dataset ...
   // Configure a kvstore (we can't deduce if it's in memory etc).
   // {
@@ -136,6 +145,15 @@ Future<void> write_zmetadata(
   //        {"path", "name"}
   //    }
   //}
+  if (!json_variables.empty() &&
+      json_variables[0]["kvstore"].contains("base")) {
+    // The metadata is written straight to the wrapped store.
+    std::vector<::nlohmann::json> unwrapped = json_variables;
+    for (auto& json : unwrapped) {
+      json["kvstore"] = UnwrapKvStore(json["kvstore"]);
+    }
+    return write_zmetadata(dataset_metadata, unwrapped, transaction);
+  }
   auto zattrs = dataset_metadata;
 
   // FIXME - generalize for zarr v3
@@ -214,7 +232,7 @@ Future<void> write_zmetadata(
     kvstore["path"] = cloudPath;
   }
 
-  auto kvs_future = tensorstore::kvstore::Open(kvstore);
+  auto kvs_future = tensorstore::kvstore::Open(kvstore, transaction);
 
   auto zattrs_future = tensorstore::MapFutureValue(
       tensorstore::InlineExecutor{},
@@ -301,18 +319,25 @@ Future<std::tuple<::nlohmann::json, std::vector<::nlohmann::json>>>
 from_zmetadata(const std::string& dataset_path) {
   // e.g. dataset_path = "zarrs/acceptance/";
   //  FIXME - enable async
+  trace::Span span("from_zmetadata", "dataset");
+  span.Arg("path", dataset_path);
   auto kvs_future = mdio::internal::dataset_kvs_store(dataset_path).result();
 
   if (!kvs_future.ok()) {
     return internal::CheckMissingDriverStatus(kvs_future.status());
   }
+  trace::Span read("kvstore::Read", "kvstore");
+  read.Arg("key", ".zmetadata");
   auto kvs_read_result =
       tensorstore::kvstore::Read(kvs_future.value(), ".zmetadata").result();
   if (!kvs_read_result.ok()) {
     return internal::CheckMissingDriverStatus(kvs_read_result.status());
   }
+  read.Arg("bytes", kvs_read_result.value().value.size());
+  read.End();
 
   ::nlohmann::json zmetadata;
+  trace::Span parse("parse .zmetadata", "dataset");
   try {
     zmetadata =
         ::nlohmann::json::parse(std::string(kvs_read_result.value().value));
@@ -325,6 +350,8 @@ from_zmetadata(const std::string& dataset_path) {
     return absl::Status(absl::StatusCode::kInvalidArgument, e.what());
   }
 
+  parse.End();
+
   if (!zmetadata.contains("metadata")) {
     return absl::Status(absl::StatusCode::kInvalidArgument,
                         "zmetadata does not contain metadata.");
@@ -396,10 +423,14 @@ using coordinate_map =
 /**
  * @brief The Dataset class
  * The dataset represents a collection of variables sharing a common grid.
+ * One opened Dataset may be shared by any number of threads calling isel, sel
+ * and reading or writing its Variables, also while its VariableCollection is
+ * added to (e.g. by SelectField). Changing the root metadata, domain or
+ * coordinates still needs to be serialized with the readers.
  */
 class Dataset {
  public:
-  Dataset(const nlohmann::json& metadata, const VariableCollection& variables,
+  Dataset(const SharedJson& metadata, const VariableCollection& variables,
           const coordinate_map& coordinates,
           const tensorstore::IndexDomain<>& domain)
       : metadata(metadata),
@@ -525,7 +556,9 @@ class Dataset {
    */
   template <typename... Descriptors>
   Result<Dataset> isel(Descriptors&... descriptors) {
-    VariableCollection vars;
+    trace::Span span("Dataset::isel", "dataset");
+    auto vars = std::make_shared<std::unordered_map<
+        std::string, std::shared_ptr<const Variable<>>>>();
 
     // the shape of the new domain
     std::map<std::string, tensorstore::IndexDomainDimension<>> dims;
@@ -535,8 +568,8 @@ class Dataset {
       MDIO_ASSIGN_OR_RETURN(auto variable,
                             variables.at(name).value().slice(
                                 std::forward<Descriptors>(descriptors)...))
-      // add to variable
-      vars.add(name, variable);
+      // add to variable, publishing the collection once at the end
+      vars->emplace(name, std::make_shared<const Variable<>>(variable));
 
       // FIXME - check consistent dims ...
       DimensionIndex idx = 0;
@@ -568,7 +601,9 @@ class Dataset {
                               .shape(shape)
                               .labels(labels)
                               .Finalize())
-    return Dataset{metadata, vars, coordinates, new_domain};
+    return Dataset{metadata,
+                   VariableCollection(VariableCollection::Snapshot(vars)),
+                   coordinates, new_domain};
   }
 
   /**
@@ -634,6 +669,19 @@ class Dataset {
         slicesCopy, std::make_index_sequence<internal::kMaxNumSlices>{});
   }
 
+  /**
+   * @brief Internal use only.
+   * Looks up a dimension coordinate declared as analytic.
+   * @return The coordinate Variable and its analytic description, or a
+   * NotFoundError if the label is not an analytic coordinate.
+   */
+  Result<std::pair<Variable<>, AnalyticCoordinate>> get_analytic_coordinate(
+      const std::string& label) const {
+    MDIO_ASSIGN_OR_RETURN(auto var, variables.at(label))
+    MDIO_ASSIGN_OR_RETURN(auto coord, GetAnalyticCoordinate(var))
+    return std::make_pair(var, coord);
+  }
+
   /**
    * @brief Internal use only.
    * Converts the `sel` descriptors to their `isel` equivalents.
@@ -649,6 +697,45 @@ class Dataset {
       using ValueType =
           typename extract_descriptor_Ttype<decltype(descriptor)>::type;
 
+      // Analytic coordinates are resolved without reading the Variable.
+      auto analyticRes =
+          get_analytic_coordinate(std::string(descriptor.label.label()));
+      if (analyticRes.ok()) {
+        auto [coordVar, coord] = analyticRes.value();
+        if constexpr ((std::is_same_v<
+                           Descriptors,
+                           ListDescriptor<typename Descriptors::type>> &&
+                       ...)) {
+          std::set<ValueType> values;
+          for (auto val : descriptor.values) {
+            if (values.count(val) > 0) {
+              trueStatus = absl::InvalidArgumentError(
+                  "Repeated value found in ListDescriptor.");
+              return trueStatus;
+            }
+            values.insert(val);
+            auto index = AnalyticIndexOf(coordVar, coord, val);
+            if (!index.ok()) {
+              trueStatus = absl::InvalidArgumentError(
+                  "Value not found in ListDescriptor.");
+              return trueStatus;
+            }
+            label_to_indices[descriptor.label.label()].push_back(
+                index.value());
+          }
+        } else {
+          auto index = AnalyticIndexOf(coordVar, coord, descriptor.value);
+          if (index.ok()) {
+            label_to_indices[descriptor.label.label()].push_back(
+                index.value());
+          }
+        }
+        return absl::OkStatus();
+      } else if (!absl::IsNotFound(analyticRes.status())) {
+        trueStatus = analyticRes.status();
+        return trueStatus;
+      }
+
       auto varRes =
           variables.get<ValueType>(std::string(descriptor.label.label()));
       if (!varRes.status().ok()) {
@@ -888,39 +975,58 @@ class Dataset {
           return trueStatus;
         }
 
-        auto varRes =
-            variables.get<ValueType>(std::string(descriptor.label.label()));
-        if (!varRes.status().ok()) {
-          trueStatus = varRes.status();
-          return trueStatus;
-        }
-        auto var = varRes.value();
-        auto varFut = var.Read();
-        if (!varFut.status().ok()) {
-          trueStatus = varFut.status();
-          return trueStatus;
-        }
-        auto varDat = varFut.value();
-        auto varAccessor = varDat.get_data_accessor();
-
         std::pair<bool, Index> start = {false, 0};
         std::pair<bool, Index> stop = {false, 0};
-        auto offset = varDat.get_flattened_offset();
 
-        for (Index i = offset; i < var.num_samples() + offset; i++) {
-          if (varAccessor({i}) == descriptor.start) {
-            if (start.first) {
-              trueStatus = absl::InvalidArgumentError("Repeated start value.");
-              return trueStatus;
-            }
-            start = {true, i};
+        // Analytic coordinates are resolved without reading the Variable.
+        auto analyticRes =
+            get_analytic_coordinate(std::string(descriptor.label.label()));
+        if (analyticRes.ok()) {
+          auto [coordVar, coord] = analyticRes.value();
+          auto startIndex = AnalyticIndexOf(coordVar, coord, descriptor.start);
+          auto stopIndex = AnalyticIndexOf(coordVar, coord, descriptor.stop);
+          if (startIndex.ok()) {
+            start = {true, startIndex.value()};
           }
-          if (varAccessor({i}) == descriptor.stop) {
-            if (stop.first) {
-              trueStatus = absl::InvalidArgumentError("Repeated stop value.");
-              return trueStatus;
+          if (stopIndex.ok()) {
+            stop = {true, stopIndex.value()};
+          }
+        } else if (!absl::IsNotFound(analyticRes.status())) {
+          trueStatus = analyticRes.status();
+          return trueStatus;
+        } else {
+          auto varRes =
+              variables.get<ValueType>(std::string(descriptor.label.label()));
+          if (!varRes.status().ok()) {
+            trueStatus = varRes.status();
+            return trueStatus;
+          }
+          auto var = varRes.value();
+          auto varFut = var.Read();
+          if (!varFut.status().ok()) {
+            trueStatus = varFut.status();
+            return trueStatus;
+          }
+          auto varDat = varFut.value();
+          auto varAccessor = varDat.get_data_accessor();
+          auto offset = varDat.get_flattened_offset();
+
+          for (Index i = offset; i < var.num_samples() + offset; i++) {
+            if (varAccessor({i}) == descriptor.start) {
+              if (start.first) {
+                trueStatus =
+                    absl::InvalidArgumentError("Repeated start value.");
+                return trueStatus;
+              }
+              start = {true, i};
+            }
+            if (varAccessor({i}) == descriptor.stop) {
+              if (stop.first) {
+                trueStatus = absl::InvalidArgumentError("Repeated stop value.");
+                return trueStatus;
+              }
+              stop = {true, i};
             }
-            stop = {true, i};
           }
         }
 
@@ -1043,6 +1149,95 @@ class Dataset {
                                std::forward<Option>(options)...);
   }
 
+  /**
+   * @brief Opens a Dataset from a path, reading its chunks through a
+   * local-disk cache.
+   * Chunks of remote datasets are kept on local disk across processes and
+   * restarts, on top of the in-memory cache of the Context. The consolidated
+   * metadata is always read from the remote store.
+   * @param dataset_path The path to the dataset, e.g. "gs://bucket/path".
+   * @param cache The cache directory, size limit and validation.
+   * @details \b Usage
+   * @code
+   * mdio::DiskCacheOptions cache;
+   * cache.directory = "/mnt/ssd/mdio-cache";
+   * auto dataset = mdio::Dataset::Open(
+   *      "s3://bucket/survey.mdio", cache, mdio::constants::kOpen
+   * );
+   * @endcode
+   * @return An `mdio::Future` containing a Dataset if successful, or an error
+   * if the path is invalid.
+   */
+  template <typename... Option>
+  static Future<Dataset> Open(const std::string& dataset_path,
+                              DiskCacheOptions cache, Option&&... options) {
+    TENSORSTORE_INTERNAL_ASSIGN_OPTIONS_OR_RETURN(TransactionalOpenOptions,
+                                                  transact_options, options)
+
+    if (transact_options.open_mode != constants::kOpen) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          "Open from path is only valid in open-mode.");
+    }
+    if (cache.directory.empty()) {
+      return absl::InvalidArgumentError("The disk cache needs a directory.");
+    }
+
+    MDIO_ASSIGN_OR_RETURN(auto params_from_zmetadata,
+                          mdio::internal::from_zmetadata(dataset_path).result())
+    auto [dataset_metadata, json_vars] = params_from_zmetadata;
+    for (auto& json : json_vars) {
+      json["kvstore"] = internal::WrapWithDiskCache(json["kvstore"], cache);
+    }
+
+    return mdio::Dataset::Open(dataset_metadata, json_vars,
+                               std::forward<Option>(options)...);
+  }
+
+  /**
+   * @brief Opens a Dataset from a path, serving its chunks as a remote store
+   * would.
+   * The requests to the chunks get the latency, bandwidth and throttling of
+   * the simulated store and are counted under its name. Meant for tuning
+   * prefetch depth, concurrency and caching against a local copy of a
+   * dataset. The consolidated metadata is read without delay.
+   * @param dataset_path The path to a local dataset.
+   * @param sim The conditions to simulate.
+   * @details \b Usage
+   * @code
+   * mdio::SimKvStoreOptions sim;
+   * sim.latencyMedianMs = 50;
+   * sim.throttleRate = 0.01;
+   * auto dataset = mdio::Dataset::Open(
+   *      "zarrs/survey.mdio", sim, mdio::constants::kOpen
+   * );
+   * // ... read from the dataset
+   * auto stats = mdio::GetSimKvStoreStats(sim.name);
+   * @endcode
+   * @return An `mdio::Future` containing a Dataset if successful, or an error
+   * if the path is invalid.
+   */
+  template <typename... Option>
+  static Future<Dataset> Open(const std::string& dataset_path,
+                              SimKvStoreOptions sim, Option&&... options) {
+    TENSORSTORE_INTERNAL_ASSIGN_OPTIONS_OR_RETURN(TransactionalOpenOptions,
+                                                  transact_options, options)
+
+    if (transact_options.open_mode != constants::kOpen) {
+      return absl::Status(absl::StatusCode::kInvalidArgument,
+                          "Open from path is only valid in open-mode.");
+    }
+
+    MDIO_ASSIGN_OR_RETURN(auto params_from_zmetadata,
+                          mdio::internal::from_zmetadata(dataset_path).result())
+    auto [dataset_metadata, json_vars] = params_from_zmetadata;
+    for (auto& json : json_vars) {
+      json["kvstore"] = internal::WrapWithSim(json["kvstore"], sim);
+    }
+
+    return mdio::Dataset::Open(dataset_metadata, json_vars,
+                               std::forward<Option>(options)...);
+  }
+
   /**
    * @brief Opens the Dataset from a constructed JSON schema.
    * This method should be used in conjunction with the dataset_factory
@@ -1063,6 +1258,8 @@ class Dataset {
                                                   transact_options, options)
     bool do_create = transact_options.open_mode == constants::kCreateClean ||
                      transact_options.open_mode == constants::kCreate;
+    trace::Span span("Dataset::Open", "dataset");
+    span.Arg("variables", json_variables.size());
 
     // FIXME - publish dataset
     std::vector<Future<mdio::Variable<>>> variables;
@@ -1160,6 +1357,7 @@ class Dataset {
                               dataset_domain.value()};
           promise.SetResult(std::move(new_dataset));
         });
+    trace::EndWhenReady(std::move(span), pair.future);
     return pair.future;
   }
 
@@ -1250,6 +1448,10 @@ class Dataset {
     }
     base["kvstore"]["driver"] = specJson["kvstore"]["driver"];
     base["kvstore"]["path"] = specJson["kvstore"]["path"];
+    if (specJson["kvstore"].contains("base")) {
+      // Keep the store a wrapping store, e.g. the disk cache, wraps.
+      base["kvstore"] = specJson["kvstore"];
+    }
     // Remove trailing slashes. This causes issue #130
     while (base["kvstore"]["path"].get<std::string>().back() == '/') {
       base["kvstore"]["path"] =
@@ -1296,6 +1498,161 @@ class Dataset {
     return pair.future;
   }
 
+  /**
+   * @brief Writes every analytic coordinate out as a real Zarr array.
+   * Analytic coordinates never need to be stored for MDIO readers, but other
+   * Zarr readers only see the values once they are materialized.
+   * @return An `mdio::Future` that resolves once every write has committed.
+   */
+  Future<void> MaterializeAnalyticCoordinates() {
+    std::vector<Future<void>> commits;
+    std::vector<tensorstore::AnyFuture> futures;
+    for (const auto& key : variables.get_iterable_accessor()) {
+      auto analyticRes = get_analytic_coordinate(key);
+      if (!analyticRes.ok()) {
+        if (absl::IsNotFound(analyticRes.status())) {
+          continue;
+        }
+        return analyticRes.status();
+      }
+      auto var = analyticRes.value().first;
+      MDIO_ASSIGN_OR_RETURN(auto writeFutures,
+                            MaterializeAnalyticCoordinate(var))
+      commits.push_back(writeFutures.commit_future);
+      futures.push_back(writeFutures.commit_future);
+    }
+
+    auto all_done_future = tensorstore::WaitAllFuture(futures);
+    auto pair = tensorstore::PromiseFuturePair<void>::Make();
+    all_done_future.ExecuteWhenReady(
+        [promise = std::move(pair.promise), commits = std::move(commits)](
+            tensorstore::ReadyFuture<void> readyFut) {
+          for (const auto& commit : commits) {
+            auto _commit = commit.result();
+            if (!_commit.ok()) {
+              promise.SetResult(_commit.status());
+              return;
+            }
+          }
+          promise.SetResult(absl::OkStatus());
+        });
+    return pair.future;
+  }
+
+  /**
+   * @brief Builds the chunk occupancy bitmap of a Variable and stores it in the
+   * Variable's attributes.
+   * The bitmap is built with a parallel listing pass; no bulk data is read.
+   * NOTE: This does not commit changes to durable media. Please see the
+   * CommitMetadata method to commit changes.
+   * @param variableName The name of the Variable to scan.
+   * @return An `mdio::Future` resolving to the occupancy bitmap.
+   */
+  Future<ChunkOccupancy> UpdateChunkOccupancy(const std::string& variableName) {
+    MDIO_ASSIGN_OR_RETURN(auto var, variables.at(variableName));
+    auto occupancyFuture = BuildChunkOccupancy(var);
+    auto pair = tensorstore::PromiseFuturePair<ChunkOccupancy>::Make();
+    occupancyFuture.ExecuteWhenReady(
+        [var, promise = pair.promise](
+            tensorstore::ReadyFuture<ChunkOccupancy> readyFut) mutable {
+          auto ready_result = readyFut.result();
+          if (!ready_result.ok()) {
+            promise.SetResult(ready_result.status());
+            return;
+          }
+          auto setRes = SetChunkOccupancy(var, ready_result.value());
+          if (!setRes.status().ok()) {
+            promise.SetResult(setRes.status());
+            return;
+          }
+          promise.SetResult(std::move(ready_result).value());
+        });
+    return pair.future;
+  }
+
+  /**
+   * @brief Retrieves the stored chunk occupancy bitmap of a Variable.
+   * @param variableName The name of the Variable.
+   * @return The bitmap, or a NotFoundError if none was stored.
+   */
+  Result<ChunkOccupancy> GetChunkOccupancy(const std::string& variableName) {
+    MDIO_ASSIGN_OR_RETURN(auto var, variables.at(variableName));
+    return mdio::GetChunkOccupancy(var);
+  }
+
+  /**
+   * @brief Returns the live-trace footprint of a seismic Variable.
+   * The footprint is the occupancy bitmap with the sample (last) dimension
+   * dropped, e.g. the inline x crossline chunks that hold any traces. It is
+   * derived from the stored bitmap without reading any bulk data.
+   * @param variableName The name of the seismic Variable.
+   * @return The projected bitmap, or an error if no bitmap was stored.
+   */
+  Result<ChunkOccupancy> GetLiveTraceFootprint(
+      const std::string& variableName) {
+    MDIO_ASSIGN_OR_RETURN(auto occupancy, GetChunkOccupancy(variableName));
+    if (occupancy.rank() < 2) {
+      return absl::InvalidArgumentError(
+          "Variable '" + variableName +
+          "' needs at least two dimensions to have a trace footprint.");
+    }
+    std::vector<DimensionIndex> keep(occupancy.rank() - 1);
+    std::iota(keep.begin(), keep.end(), 0);
+    return occupancy.Project(keep);
+  }
+
+  /**
+   * @brief Merges user attributes into the Dataset's root metadata.
+   * Keys set to null are removed. Call CommitMetadata to persist the change.
+   * @param attributes A JSON object of attributes.
+   */
+  void UpdateAttributes(const nlohmann::json& attributes) {
+    if (!metadata.contains("attributes") ||
+        !metadata["attributes"].is_object()) {
+      metadata["attributes"] = nlohmann::json::object();
+    }
+    metadata["attributes"].merge_patch(attributes);
+    metadataUpdated = true;
+  }
+
+  /**
+   * @brief Binds every Variable of the Dataset to a transaction.
+   * Writes through the returned Dataset, and its CommitMetadata, are staged in
+   * the transaction and reach durable media only when it commits. Do not wait
+   * on their commit futures before committing the transaction.
+   * @details \b Usage
+   * @code
+   * tensorstore::Transaction txn(tensorstore::isolated);
+   * MDIO_ASSIGN_OR_RETURN(auto staged, dataset.with_transaction(txn))
+   * MDIO_ASSIGN_OR_RETURN(auto seismic, staged.variables.at("seismic"))
+   * seismic.Write(seismicData);
+   * staged.CommitMetadata();
+   * MDIO_ASSIGN_OR_RETURN(auto committed, txn.CommitAsync().result())
+   * @endcode
+   * See also `mdio::Transaction`, which bounds the staged memory.
+   * @param transaction The transaction to bind to.
+   * @return The bound Dataset or an error if the Dataset is already bound to a
+   * different transaction.
+   */
+  Result<Dataset> with_transaction(
+      const tensorstore::Transaction& transaction) const {
+    VariableCollection vars;
+    for (const auto& key : variables.get_iterable_accessor()) {
+      MDIO_ASSIGN_OR_RETURN(auto variable, variables.at(key))
+      MDIO_ASSIGN_OR_RETURN(auto bound, variable.with_transaction(transaction))
+      vars.add(key, bound);
+    }
+    Dataset dataset{metadata, vars, coordinates, domain};
+    dataset.metadataUpdated = metadataUpdated;
+    dataset.transaction = transaction;
+    return dataset;
+  }
+
+  /// The transaction the Dataset is bound to, or `no_transaction`.
+  const tensorstore::Transaction& get_transaction() const {
+    return transaction;
+  }
+
   tensorstore::Future<void> CommitMetadata() {
     auto keys = variables.get_iterable_accessor();
 
@@ -1313,7 +1670,7 @@ class Dataset {
     }
 
     // If nothing changed, we don't want to perform any writes
-    if (modifiedVariables.empty()) {
+    if (modifiedVariables.empty() && !metadataUpdated) {
       tensorstore::Future<void> err =
           tensorstore::MakeResult<tensorstore::Future<void>>(
               absl::InvalidArgumentError("No variables were modified."));
@@ -1368,8 +1725,9 @@ class Dataset {
     }
 
     // Now let's get the .zmetadata going.
+    metadataUpdated = false;
     auto zmetadata_future =
-        mdio::internal::write_zmetadata(metadata, json_vars);
+        mdio::internal::write_zmetadata(metadata, json_vars, transaction);
     // Finally we can loop through the updated Variables and update them.
 
     std::vector<tensorstore::Future<tensorstore::TimestampedStorageGeneration>>
@@ -1426,7 +1784,15 @@ class Dataset {
   tensorstore::IndexDomain<> domain;
 
  private:
-  // the metadata associated with the dataset (root .zattrs)
-  ::nlohmann::json metadata;
+  // the metadata associated with the dataset (root .zattrs), shared by copies
+  SharedJson metadata;
+
+  // set when the root metadata has changed since the last commit
+  bool metadataUpdated = false;
+
+  // the transaction writes are staged in, if any
+  tensorstore::Transaction transaction{tensorstore::no_transaction};
+
+  friend class Transaction;
 };
 }  // namespace mdio
@@ -0,0 +1,187 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/concurrency.mdio";
+constexpr int kChunks = 16;
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 128},
+      {"name": "time", "size": 64}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 64] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("concurrency", variables));
+  return mdio::test_util::Fill<float>(ds, "image", [](auto index) {
+    return index[0];
+  });
+}
+
+// Reads one chunk through isel and checks its values.
+bool ReadChunk(mdio::Dataset& ds, int chunk) {  // NOLINT
+  mdio::RangeDescriptor<mdio::Index> range = {"inline", chunk * 8,
+                                              chunk * 8 + 8, 1};
+  auto slice = ds.isel(range);
+  if (!slice.ok()) {
+    return false;
+  }
+  auto image = slice.value().variables.get<float>("image");
+  if (!image.ok()) {
+    return false;
+  }
+  auto data = image.value().Read().result();
+  return data.ok() &&
+         data.value().get_data_accessor()({chunk * 8 + 3, 5}) == chunk * 8 + 3;
+}
+
+// Runs `reads` chunk reads on each of `threads` threads against one Dataset.
+void ReadConcurrently(mdio::Dataset& ds, int threads,  // NOLINT
+                      int reads, std::atomic<int>* failures) {
+  std::vector<std::thread> readers;
+  for (int t = 0; t < threads; ++t) {
+    readers.emplace_back([&ds, t, reads, failures] {
+      for (int i = 0; i < reads; ++i) {
+        if (!ReadChunk(ds, (t + i) % kChunks)) {
+          ++*failures;
+        }
+      }
+    });
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+}
+
+TEST(DatasetConcurrency, readersWhileAdding) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.at("image").value();
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 0; !done; ++i) {
+      ds.value().variables.add("image_" + std::to_string(i % 64), image);
+    }
+  });
+  std::atomic<int> failures{0};
+  std::vector<std::thread> listers;
+  for (int t = 0; t < 2; ++t) {
+    listers.emplace_back([&] {
+      while (!done) {
+        for (const auto& key : ds.value().variables.get_iterable_accessor()) {
+          if (!ds.value().variables.at(key).ok()) {
+            ++failures;
+          }
+        }
+      }
+    });
+  }
+  ReadConcurrently(ds.value(), 8, 50, &failures);
+  done = true;
+  writer.join();
+  for (auto& lister : listers) {
+    lister.join();
+  }
+  EXPECT_EQ(failures, 0);
+  EXPECT_TRUE(ds.value().variables.contains_key("image_0"));
+  std::filesystem::remove_all(kPath);
+}
+
+TEST(DatasetConcurrency, snapshot) {
+  mdio::VariableCollection collection;
+  auto before = collection.snapshot();
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  collection.add("image", ds.value().variables.at("image").value());
+  EXPECT_TRUE(before->empty()) << "Snapshots are immutable";
+  EXPECT_EQ(collection.snapshot()->size(), 1);
+
+  auto copy = collection;
+  copy.add("other", ds.value().variables.at("image").value());
+  EXPECT_FALSE(collection.contains_key("other")) << "Copies are independent";
+  std::filesystem::remove_all(kPath);
+}
+
+TEST(DatasetConcurrency, lockFree) {
+  ASSERT_TRUE(SETUP(kPath).status().ok());
+  // Every chunk read waits a second on the simulated store.
+  mdio::SimKvStoreOptions sim;
+  sim.name = "lockFree";
+  sim.latencyMedianMs = 1000;
+  sim.latencyP99Ms = 1000;
+  sim.bandwidthMiBps = 0;
+  sim.concurrency = 0;
+  auto ds = mdio::Dataset::Open(kPath, sim, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image");
+  ASSERT_TRUE(image.ok()) << image.status();
+
+  // Lookups, slices and additions on other threads never wait for a read in
+  // flight, so they all finish while it is still pending.
+  auto inflight = image.value().Read();
+  std::atomic<int> failures{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 50; ++i) {
+        mdio::RangeDescriptor<mdio::Index> range = {"inline", t * 8,
+                                                    t * 8 + 8, 1};
+        auto slice = ds.value().isel(range);
+        if (!slice.ok() || !slice.value().variables.at("image").ok()) {
+          ++failures;
+        }
+        ds.value().variables.add("image_" + std::to_string(t), image.value());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_FALSE(inflight.ready()) << "Metadata access waited for the read";
+  EXPECT_EQ(failures, 0);
+
+  auto data = inflight.result();
+  ASSERT_TRUE(data.ok()) << data.status();
+  EXPECT_EQ(data.value().get_data_accessor()({77, 5}), 77);
+  std::filesystem::remove_all(kPath);
+}
+
+}  // namespace
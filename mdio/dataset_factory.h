@@ -21,8 +21,11 @@
 #include <unordered_map>
 #include <vector>
 
+#include "mdio/chunk_advisor.h"
+#include "mdio/chunk_grid.h"
 #include "mdio/dataset_validator.h"
 #include "mdio/impl.h"
+#include "mdio/quantization.h"
 // #include "tensorstore/tensorstore.h"
 
 #include "absl/strings/escaping.h"
@@ -105,6 +108,27 @@ absl::Status transform_dtype(nlohmann::json& input /*NOLINT*/,
       dtypeFields.emplace_back(nlohmann::json{field["name"], dtype.value()});
     }
     variable["metadata"]["dtype"] = dtypeFields;
+  } else if (input.contains("metadata") &&
+             input["metadata"].contains("attributes") &&
+             input["metadata"]["attributes"].contains(
+                 mdio::internal::kQuantizationKey)) {
+    // Quantized Variables store the integer codes.
+    auto& declared =
+        input["metadata"]["attributes"][mdio::internal::kQuantizationKey];
+    auto quantization = mdio::Quantization::FromJson(declared);
+    if (!quantization.status().ok()) {
+      return quantization.status();
+    }
+    if (input["dataType"] != "float32") {
+      return absl::InvalidArgumentError(
+          "Only float32 Variables may be quantized");
+    }
+    declared = quantization.value().ToJson();
+    auto dtype = to_zarr_dtype(quantization.value().dtype);
+    if (!dtype.status().ok()) {
+      return dtype.status();
+    }
+    variable["metadata"]["dtype"] = dtype.value();
   } else {
     auto dtype = to_zarr_dtype(input["dataType"]);
     if (!dtype.status().ok()) {
@@ -119,6 +143,8 @@ absl::Status transform_dtype(nlohmann::json& input /*NOLINT*/,
  * @brief Modifies a Variable spec to use proper Zarr compressor
  * This function is intended to be an internal helper function for formatting
  * Variable specs It will modify with side-effect on "input"
+ * Supports the compressors of the Zarr driver: blosc, zstd, gzip, zlib and
+ * bz2.
  * @param input A MDIO Variable spec
  * @param variable A Variable stub (Will be modified)
  * @return OkStatus if successful, InvalidArgumentError if compressor is invalid
@@ -126,47 +152,65 @@ absl::Status transform_dtype(nlohmann::json& input /*NOLINT*/,
  */
 absl::Status transform_compressor(nlohmann::json& input /*NOLINT*/,
                                   nlohmann::json& variable /*NOLINT*/) {
-  if (input.contains("compressor")) {
-    if (input["compressor"].contains("name")) {
-      if (input["compressor"]["name"] != "blosc") {
-        return absl::InvalidArgumentError("Only blosc compressor is supported");
-      }
-      variable["metadata"]["compressor"]["id"] = input["compressor"]["name"];
-    } else {
-      return absl::InvalidArgumentError("Compressor name must be specified");
-    }
+  if (!input.contains("compressor") || input["compressor"].is_null()) {
+    variable["metadata"]["compressor"] = nullptr;
+    return absl::OkStatus();
+  }
+  if (!input["compressor"].contains("name")) {
+    return absl::InvalidArgumentError("Compressor name must be specified");
+  }
+  std::string name = input["compressor"]["name"];
+  variable["metadata"]["compressor"]["id"] = name;
 
-    if (input["compressor"].contains("algorithm")) {
-      variable["metadata"]["compressor"]["cname"] =
-          input["compressor"]["algorithm"];
-    } else {  // DEFAULT
-      variable["metadata"]["compressor"]["cname"] = "lz4";
-    }
+  if (name == "zstd" || name == "gzip" || name == "zlib" || name == "bz2") {
+    int minLevel = name == "zstd" ? -131072 : (name == "bz2" ? 1 : 0);
+    int maxLevel = name == "zstd" ? 22 : 9;
     if (input["compressor"].contains("level")) {
-      if (input["compressor"]["level"] > 9 ||
-          input["compressor"]["level"] < 0) {
+      if (input["compressor"]["level"] > maxLevel ||
+          input["compressor"]["level"] < minLevel) {
         return absl::InvalidArgumentError(
-            "Compressor level must be between 0 and 9");
+            "Compressor level for " + name + " must be between " +
+            std::to_string(minLevel) + " and " + std::to_string(maxLevel));
       }
-      variable["metadata"]["compressor"]["clevel"] =
+      variable["metadata"]["compressor"]["level"] =
           input["compressor"]["level"];
     } else {  // DEFAULT
-      variable["metadata"]["compressor"]["clevel"] = 5;
-    }
-    if (input["compressor"].contains("shuffle")) {
-      variable["metadata"]["compressor"]["shuffle"] =
-          input["compressor"]["shuffle"];
-    } else {  // DEFAULT
-      variable["metadata"]["compressor"]["shuffle"] = 1;
+      variable["metadata"]["compressor"]["level"] = 1;
     }
-    if (input["compressor"].contains("blocksize")) {
-      variable["metadata"]["compressor"]["blocksize"] =
-          input["compressor"]["blocksize"];
-    } else {  // DEFAULT
-      variable["metadata"]["compressor"]["blocksize"] = 0;
+    return absl::OkStatus();
+  }
+  if (name != "blosc") {
+    return absl::InvalidArgumentError(
+        "Unsupported compressor '" + name +
+        "'. Supported compressors are blosc, zstd, gzip, zlib and bz2");
+  }
+
+  if (input["compressor"].contains("algorithm")) {
+    variable["metadata"]["compressor"]["cname"] =
+        input["compressor"]["algorithm"];
+  } else {  // DEFAULT
+    variable["metadata"]["compressor"]["cname"] = "lz4";
+  }
+  if (input["compressor"].contains("level")) {
+    if (input["compressor"]["level"] > 9 || input["compressor"]["level"] < 0) {
+      return absl::InvalidArgumentError(
+          "Compressor level must be between 0 and 9");
     }
-  } else {
-    variable["metadata"]["compressor"] = nullptr;
+    variable["metadata"]["compressor"]["clevel"] = input["compressor"]["level"];
+  } else {  // DEFAULT
+    variable["metadata"]["compressor"]["clevel"] = 5;
+  }
+  if (input["compressor"].contains("shuffle")) {
+    variable["metadata"]["compressor"]["shuffle"] =
+        input["compressor"]["shuffle"];
+  } else {  // DEFAULT
+    variable["metadata"]["compressor"]["shuffle"] = 1;
+  }
+  if (input["compressor"].contains("blocksize")) {
+    variable["metadata"]["compressor"]["blocksize"] =
+        input["compressor"]["blocksize"];
+  } else {  // DEFAULT
+    variable["metadata"]["compressor"]["blocksize"] = 0;
   }
   return absl::OkStatus();
 }
@@ -253,6 +297,65 @@ absl::Status transform_metadata(const std::string& path,
   return absl::OkStatus();
 }
 
+/**
+ * @brief Fills in a missing chunkGrid from the Variable's declared access
+ * patterns
+ * This function is intended to be an internal helper function for formatting
+ * Variable specs. It must run after the dtype, compressor and shape have been
+ * transformed. The advised chunkGrid is written back to the input so that the
+ * Variable's metadata records it.
+ * @param input A Variable list element with an accessPatterns attribute
+ * @param variable A Variable stub
+ * @return OkStatus if successful, InvalidArgumentError if the access patterns
+ * are malformed
+ */
+absl::Status advise_chunks(nlohmann::json& input /*NOLINT*/,
+                           nlohmann::json& variable /*NOLINT*/) {
+  std::vector<std::string> dimensions;
+  if (input.contains("dimensions")) {
+    for (const auto& dimension : input["dimensions"]) {
+      dimensions.push_back(dimension.is_object()
+                               ? dimension["name"].get<std::string>()
+                               : dimension.get<std::string>());
+    }
+  } else {
+    dimensions.push_back(input["name"].get<std::string>());
+  }
+  MDIO_ASSIGN_OR_RETURN(
+      auto patterns,
+      ParseAccessPatterns(
+          input["metadata"]["attributes"][internal::kAccessPatternsKey],
+          dimensions))
+
+  // The dtype has already been converted to Zarr, e.g. "<f4" or "|u1".
+  Index itemSize = 0;
+  auto add_item = [&itemSize](const std::string& dtype) {
+    itemSize += std::stoi(dtype.substr(2));
+  };
+  if (variable["metadata"]["dtype"].is_array()) {
+    for (const auto& field : variable["metadata"]["dtype"]) {
+      add_item(field[1].get<std::string>());
+    }
+  } else {
+    add_item(variable["metadata"]["dtype"].get<std::string>());
+  }
+
+  ChunkAdvisorOptions options;
+  // A typical ratio for seismic; the tuner in utils/compression.h measures it.
+  if (!variable["metadata"]["compressor"].is_null()) {
+    options.compressionRatio = 2;
+  }
+  MDIO_ASSIGN_OR_RETURN(
+      auto advice,
+      AdviseChunkShape(variable["metadata"]["shape"].get<std::vector<Index>>(),
+                       itemSize, patterns, options))
+  variable["metadata"]["chunks"] = advice.chunkShape;
+  input["metadata"]["chunkGrid"] = {
+      {"name", "regular"},
+      {"configuration", {{"chunkShape", advice.chunkShape}}}};
+  return absl::OkStatus();
+}
+
 /**
  * @brief Constructs an MDIO Variable spec from an MDIO Dataset Variable list
  * element This function is intended to be an internal helper function for
@@ -296,9 +399,29 @@ tensorstore::Result<nlohmann::json> from_json_to_spec(
   transform_shape(json, variableStub, dimensionMap);
 
   if (json.contains("metadata")) {
-    if (json["metadata"].contains("chunkGrid")) {
+    if (json["metadata"].contains("chunkGrid") &&
+        mdio::ChunkGrid::IsRectilinear(json["metadata"]["chunkGrid"])) {
+      // Zarr only stores regular grids, the rectilinear one is recorded in the
+      // attributes.
+      auto grid = mdio::ChunkGrid::FromJson(
+          json["metadata"]["chunkGrid"],
+          variableStub["metadata"]["shape"].get<std::vector<mdio::Index>>());
+      if (!grid.status().ok()) {
+        return grid.status();
+      }
+      variableStub["metadata"]["chunks"] = grid.value().storage_chunk_shape();
+      json["metadata"]["attributes"][mdio::internal::kRectilinearChunkGridKey] =
+          grid.value().ToJson();
+    } else if (json["metadata"].contains("chunkGrid")) {
       variableStub["metadata"]["chunks"] =
           json["metadata"]["chunkGrid"]["configuration"]["chunkShape"];
+    } else if (json["metadata"].contains("attributes") &&
+               json["metadata"]["attributes"].contains(
+                   mdio::internal::kAccessPatternsKey)) {
+      auto adviceStatus = advise_chunks(json, variableStub);
+      if (!adviceStatus.ok()) {
+        return adviceStatus;
+      }
     } else {  // No chunking specified
       variableStub["metadata"]["chunks"] = variableStub["metadata"]["shape"];
     }
@@ -311,6 +434,14 @@ tensorstore::Result<nlohmann::json> from_json_to_spec(
       } else if (json["dataType"] == "complex128") {
         std::string raw(16, '\0');
         variableStub["metadata"]["fill_value"] = encode_base64(raw);
+      } else if (json["metadata"].contains("attributes") &&
+                 json["metadata"]["attributes"].contains(
+                     mdio::internal::kQuantizationKey)) {
+        // Already validated by transform_dtype.
+        auto quantization = mdio::Quantization::FromJson(
+            json["metadata"]["attributes"][mdio::internal::kQuantizationKey]);
+        variableStub["metadata"]["fill_value"] =
+            static_cast<int>(quantization.value().fill_code());
       } else if (json["dataType"].get<std::string>()[0] == 'f') {
         variableStub["metadata"]["fill_value"] = std::nan("");
       }
@@ -632,6 +632,34 @@ TEST(Variable, maxSizeReached) {
   ASSERT_TRUE(res.status().ok()) << res.status();
 }
 
+TEST(Variable, compressors) {
+  for (const auto& compressor :
+       {nlohmann::json{{"name", "zstd"}, {"level", 19}},
+        nlohmann::json{{"name", "gzip"}, {"level", 6}},
+        nlohmann::json{{"name", "zlib"}}, nlohmann::json{{"name", "bz2"}}}) {
+    nlohmann::json j = nlohmann::json::parse(manifest);
+    j["variables"][0]["compressor"] = compressor;
+    auto res = Construct(j, "zarrs/simple_dataset");
+    ASSERT_TRUE(res.status().ok()) << res.status();
+    auto zarr = std::get<1>(res.value())[0]["metadata"]["compressor"];
+    EXPECT_EQ(zarr["id"], compressor["name"]);
+    EXPECT_EQ(zarr["level"], compressor.value("level", 1));
+    auto varStatus = mdio::Variable<>::Open(std::get<1>(res.value())[0],
+                                            mdio::constants::kCreateClean);
+    EXPECT_TRUE(varStatus.status().ok()) << varStatus.status();
+  }
+
+  for (const auto& compressor :
+       {nlohmann::json{{"name", "zstd"}, {"level", 23}},
+        nlohmann::json{{"name", "bz2"}, {"level", 0}},
+        nlohmann::json{{"name", "lzma"}}}) {
+    nlohmann::json j = nlohmann::json::parse(manifest);
+    j["variables"][0]["compressor"] = compressor;
+    EXPECT_FALSE(Construct(j, "zarrs/simple_dataset").status().ok())
+        << compressor;
+  }
+}
+
 TEST(Xarray, open) {
   nlohmann::json j = nlohmann::json::parse(manifest);
   auto res = Construct(j, "zarrs/simple_dataset");
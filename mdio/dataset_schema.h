@@ -215,6 +215,31 @@ It should NOT be modified unless the MDIO Dataset model schema is updated.
          "title": "BloscShuffle",
          "type": "integer"
       },
+      "Bz2": {
+         "additionalProperties": false,
+         "description": "Data Model for bzip2 options.",
+         "properties": {
+            "name": {
+               "const": "bz2",
+               "description": "Name of the compressor.",
+               "title": "Name",
+               "type": "string"
+            },
+            "level": {
+               "default": 1,
+               "description": "The compression level.",
+               "maximum": 9,
+               "minimum": 1,
+               "title": "Level",
+               "type": "integer"
+            }
+         },
+         "required": [
+            "name"
+         ],
+         "title": "Bz2",
+         "type": "object"
+      },
       "CenteredBinHistogram": {
          "additionalProperties": false,
          "description": "Class representing a center bin histogram.",
@@ -288,6 +313,15 @@ It should NOT be modified unless the MDIO Dataset model schema is updated.
                   {
                      "$ref": "#/$defs/ZFP"
                   },
+                  {
+                     "$ref": "#/$defs/Zstd"
+                  },
+                  {
+                     "$ref": "#/$defs/Gzip"
+                  },
+                  {
+                     "$ref": "#/$defs/Bz2"
+                  },
                   {
                      "type": "null"
                   }
@@ -496,6 +530,34 @@ It should NOT be modified unless the MDIO Dataset model schema is updated.
          "title": "FrequencyUnitModel",
          "type": "object"
       },
+      "Gzip": {
+         "additionalProperties": false,
+         "description": "Data Model for gzip and zlib options.",
+         "properties": {
+            "name": {
+               "enum": [
+                  "gzip",
+                  "zlib"
+               ],
+               "description": "Name of the compressor.",
+               "title": "Name",
+               "type": "string"
+            },
+            "level": {
+               "default": 1,
+               "description": "The compression level.",
+               "maximum": 9,
+               "minimum": 0,
+               "title": "Level",
+               "type": "integer"
+            }
+         },
+         "required": [
+            "name"
+         ],
+         "title": "Gzip",
+         "type": "object"
+      },
       "LengthUnitEnum": {
          "description": "Enum class representing metric units of length.",
          "enum": [
@@ -881,6 +943,15 @@ It should NOT be modified unless the MDIO Dataset model schema is updated.
                   {
                      "$ref": "#/$defs/ZFP"
                   },
+                  {
+                     "$ref": "#/$defs/Zstd"
+                  },
+                  {
+                     "$ref": "#/$defs/Gzip"
+                  },
+                  {
+                     "$ref": "#/$defs/Bz2"
+                  },
                   {
                      "type": "null"
                   }
@@ -1167,6 +1238,31 @@ It should NOT be modified unless the MDIO Dataset model schema is updated.
          ],
          "title": "ZFPMode",
          "type": "string"
+      },
+      "Zstd": {
+         "additionalProperties": false,
+         "description": "Data Model for Zstandard options.",
+         "properties": {
+            "name": {
+               "const": "zstd",
+               "description": "Name of the compressor.",
+               "title": "Name",
+               "type": "string"
+            },
+            "level": {
+               "default": 1,
+               "description": "The compression level. Negative levels trade ratio for speed.",
+               "maximum": 22,
+               "minimum": -131072,
+               "title": "Level",
+               "type": "integer"
+            }
+         },
+         "required": [
+            "name"
+         ],
+         "title": "Zstd",
+         "type": "object"
       }
    },
    "$schema": "https://json-schema.org/draft/2020-12/schema",
@@ -0,0 +1,533 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_DISK_CACHE_H_
+#define MDIO_DISK_CACHE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/cord.h"
+#include "mdio/impl.h"
+#include "tensorstore/internal/intrusive_ptr.h"
+#include "tensorstore/internal/thread/thread_pool.h"
+#include "tensorstore/internal/json_binding/bindable.h"
+#include "tensorstore/internal/json_binding/json_binding.h"
+#include "tensorstore/kvstore/driver.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/kvstore/registry.h"
+#include "tensorstore/kvstore/spec.h"
+#include "tensorstore/util/future.h"
+#include "tensorstore/util/garbage_collection/garbage_collection.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+
+/**
+ * @brief Options of the local-disk chunk cache.
+ * Every process pointing at the same directory shares the cache.
+ */
+struct DiskCacheOptions {
+  /// The directory holding the cached objects, ideally on a local SSD.
+  std::string directory;
+  /// The size beyond which the least recently used objects are evicted.
+  Index maxBytes = Index{16} << 30;
+  /**
+   * Whether each read asks the remote store if the cached object is still
+   * current, which costs a request but no transfer. Disable only for datasets
+   * that no longer change.
+   */
+  bool validate = true;
+};
+
+namespace internal {
+
+// The leading bytes of a cache file, bumped if the layout changes.
+constexpr char kDiskCacheMagic[] = "MDIOCACHE1";
+// Eviction leaves the cache this fraction of its limit full.
+constexpr double kDiskCacheLowWater = 0.9;
+// The threads doing the cache's file I/O, shared by every cached store.
+constexpr size_t kDiskCacheThreads = 4;
+
+/**
+ * @brief The executor of the cache's file I/O, so that neither the caller nor
+ * the base store's threads block on the local disk.
+ */
+inline const tensorstore::Executor& DiskCacheExecutor() {
+  static const tensorstore::Executor executor =
+      tensorstore::internal::DetachedThreadPool(kDiskCacheThreads);
+  return executor;
+}
+
+/**
+ * @brief Objects cached as files in a directory, keyed by object path and
+ * storage generation.
+ * Files are written to a temporary name and renamed into place, so processes
+ * sharing the directory only ever see whole files. The file times record the
+ * last use, and any process may evict the least recently used files once the
+ * directory exceeds its limit.
+ */
+class DiskChunkCache {
+ public:
+  struct Entry {
+    std::string generation;
+    std::string value;
+  };
+
+  DiskChunkCache(std::string directory, Index maxBytes)
+      : directory_(std::move(directory)), maxBytes_(maxBytes) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+  }
+
+  /**
+   * @brief Looks up an object and marks it as recently used.
+   * @return The cached generation and value, or nullopt on a miss.
+   */
+  std::optional<Entry> Lookup(const std::string& key) const {
+    auto path = PathOf(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      return std::nullopt;
+    }
+    std::string magic(sizeof(kDiskCacheMagic) - 1, '\0');
+    std::string storedKey;
+    Entry entry;
+    if (!file.read(magic.data(), magic.size()) || magic != kDiskCacheMagic ||
+        !ReadField(file, &storedKey) || storedKey != key ||
+        !ReadField(file, &entry.generation) || !ReadField(file, &entry.value)) {
+      // A hash collision, or a file of an older layout.
+      return std::nullopt;
+    }
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        path, std::filesystem::file_time_type::clock::now(), ec);
+    return entry;
+  }
+
+  /// Stores an object, replacing any cached version of it.
+  void Insert(const std::string& key, const std::string& generation,
+              const std::string& value) {
+    if (static_cast<Index>(value.size()) > maxBytes_) {
+      return;
+    }
+    auto path = PathOf(key);
+    auto temporary = path;
+    temporary += "." + std::to_string(NextTemporaryId()) + ".tmp";
+    {
+      std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+      file.write(kDiskCacheMagic, sizeof(kDiskCacheMagic) - 1);
+      WriteField(file, key);
+      WriteField(file, generation);
+      WriteField(file, value);
+      if (!file) {
+        std::error_code ec;
+        std::filesystem::remove(temporary, ec);
+        return;
+      }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec) {
+      std::filesystem::remove(temporary, ec);
+      return;
+    }
+    // Scanning the directory is costly, so only check the size periodically.
+    Index added = insertedBytes_ += value.size();
+    if (added > maxBytes_ / 16) {
+      insertedBytes_ = 0;
+      Evict();
+    }
+  }
+
+  /// Drops the cached version of an object, if any.
+  void Erase(const std::string& key) {
+    std::error_code ec;
+    std::filesystem::remove(PathOf(key), ec);
+  }
+
+  /**
+   * @brief Evicts the least recently used files once the directory exceeds its
+   * limit, and the temporary files of writers that died.
+   * @return The bytes left in the cache.
+   */
+  Index Evict() {
+    std::lock_guard<std::mutex> lock(evictMutex_);
+    namespace fs = std::filesystem;
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    std::map<fs::path, Index> sizes;
+    Index total = 0;
+    const auto now = fs::file_time_type::clock::now();
+    std::error_code ec;
+    for (fs::directory_iterator it(directory_, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      const auto& item = *it;
+      std::error_code itemEc;
+      if (!item.is_regular_file(itemEc)) {
+        continue;
+      }
+      auto time = item.last_write_time(itemEc);
+      Index size = item.file_size(itemEc);
+      if (itemEc) {
+        // Evicted by another process meanwhile.
+        continue;
+      }
+      if (item.path().extension() == ".tmp") {
+        if (now - time > std::chrono::hours(1)) {
+          fs::remove(item.path(), itemEc);
+        }
+        continue;
+      }
+      files.emplace_back(time, item.path());
+      sizes[item.path()] = size;
+      total += size;
+    }
+    if (total <= maxBytes_) {
+      return total;
+    }
+    std::sort(files.begin(), files.end());
+    const Index target = static_cast<Index>(maxBytes_ * kDiskCacheLowWater);
+    for (const auto& file : files) {
+      if (total <= target) {
+        break;
+      }
+      std::error_code removeEc;
+      fs::remove(file.second, removeEc);
+      total -= sizes[file.second];
+    }
+    return total;
+  }
+
+  const std::string& directory() const { return directory_; }
+
+ private:
+  // FNV-1a, which unlike std::hash is the same in every process.
+  static uint64_t Fingerprint(std::string_view key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+      hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+  }
+
+  std::filesystem::path PathOf(const std::string& key) const {
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx",
+                  static_cast<unsigned long long>(Fingerprint(key)));  // NOLINT
+    return std::filesystem::path(directory_) / name;
+  }
+
+  static uint64_t NextTemporaryId() {
+    static std::atomic<uint64_t> next{std::random_device{}()};
+    return next.fetch_add(1) * 6364136223846793005ull;
+  }
+
+  static void WriteField(std::ofstream& file,  // NOLINT
+                         const std::string& field) {
+    uint64_t size = field.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(field.data(), field.size());
+  }
+
+  static bool ReadField(std::ifstream& file, std::string* field) {  // NOLINT
+    uint64_t size = 0;
+    if (!file.read(reinterpret_cast<char*>(&size), sizeof(size)) ||
+        size > (uint64_t{1} << 40)) {
+      return false;
+    }
+    field->resize(size);
+    return static_cast<bool>(file.read(field->data(), size));
+  }
+
+  std::string directory_;
+  Index maxBytes_;
+  std::atomic<Index> insertedBytes_{0};
+  std::mutex evictMutex_;
+};
+
+/**
+ * @brief The cache of a directory, shared by every store of this process
+ * that uses it.
+ */
+inline std::shared_ptr<DiskChunkCache> GetDiskChunkCache(
+    const std::string& directory, Index maxBytes) {
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<DiskChunkCache>> caches;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto cache = caches[directory].lock();
+  if (!cache) {
+    cache = std::make_shared<DiskChunkCache>(directory, maxBytes);
+    caches[directory] = cache;
+  }
+  return cache;
+}
+
+namespace jb = tensorstore::internal_json_binding;
+
+struct DiskCacheSpecData {
+  tensorstore::kvstore::Spec base;
+  std::string directory;
+  Index maxBytes;
+  bool validate;
+
+  constexpr static auto ApplyMembers = [](auto&& x, auto f) {
+    return f(x.base, x.directory, x.maxBytes, x.validate);
+  };
+
+  constexpr static auto default_json_binder = jb::Object(
+      jb::Member("base", jb::Projection<&DiskCacheSpecData::base>()),
+      jb::Member("directory", jb::Projection<&DiskCacheSpecData::directory>()),
+      jb::Member("max_bytes",
+                 jb::Projection<&DiskCacheSpecData::maxBytes>(
+                     jb::DefaultValue([](auto* v) { *v = Index{16} << 30; }))),
+      jb::Member("validate",
+                 jb::Projection<&DiskCacheSpecData::validate>(
+                     jb::DefaultValue([](auto* v) { *v = true; }))));
+};
+
+class DiskCacheSpec
+    : public tensorstore::internal_kvstore::RegisteredDriverSpec<
+          DiskCacheSpec, DiskCacheSpecData> {
+ public:
+  static constexpr char id[] = "mdio_disk_cache";
+
+  tensorstore::Future<tensorstore::kvstore::DriverPtr> DoOpen() const override;
+
+  absl::Status ApplyOptions(
+      tensorstore::kvstore::DriverSpecOptions&& options) override {
+    return data_.base.driver.Set(std::move(options));
+  }
+};
+
+/**
+ * @brief A key-value store that keeps the objects read from a base store in a
+ * DiskChunkCache.
+ * Full reads are served from the cache, after asking the base store whether
+ * the cached generation is still current unless validation is disabled.
+ * Writes go to the base store and drop the cached version. Objects are cached
+ * under the base store's description of their key, which names the bucket or
+ * root, and the cache files are only touched on `DiskCacheExecutor`.
+ */
+class DiskCacheDriver
+    : public tensorstore::internal_kvstore::RegisteredDriver<DiskCacheDriver,
+                                                             DiskCacheSpec> {
+ public:
+  tensorstore::Future<tensorstore::kvstore::ReadResult> Read(
+      tensorstore::kvstore::Key key,
+      tensorstore::kvstore::ReadOptions options) override {
+    std::string path = base_.path + key;
+    const auto& conditions = options.generation_conditions;
+    if (!options.byte_range.IsFull() ||
+        !tensorstore::StorageGeneration::IsUnknown(conditions.if_equal) ||
+        !tensorstore::StorageGeneration::IsUnknown(conditions.if_not_equal)) {
+      // Partial and conditional reads are the caller's own caching.
+      return base_.driver->Read(std::move(path), std::move(options));
+    }
+
+    using ReadResult = tensorstore::kvstore::ReadResult;
+    auto pair = tensorstore::PromiseFuturePair<ReadResult>::Make();
+    DiskCacheExecutor()(
+        [self = tensorstore::internal::IntrusivePtr<DiskCacheDriver>(this),
+         path = std::move(path), options = std::move(options),
+         promise = std::move(pair.promise)]() mutable {
+          std::string cacheKey = self->base_.driver->DescribeKey(path);
+          auto cached = self->cache_->Lookup(cacheKey);
+          if (cached && !self->validate_) {
+            promise.SetResult(ReadResult::Value(
+                absl::Cord(std::move(cached->value)),
+                tensorstore::TimestampedStorageGeneration(
+                    tensorstore::StorageGeneration{
+                        std::move(cached->generation)},
+                    absl::Now())));
+            return;
+          }
+          if (cached) {
+            options.generation_conditions.if_not_equal =
+                tensorstore::StorageGeneration{cached->generation};
+          }
+          auto read = self->base_.driver->Read(path, std::move(options));
+          read.ExecuteWhenReady(
+              [self, cacheKey = std::move(cacheKey),
+               cached = std::move(cached), promise = std::move(promise)](
+                  tensorstore::ReadyFuture<ReadResult> ready) mutable {
+                auto& result = ready.result();
+                if (!result.ok()) {
+                  promise.SetResult(result.status());
+                  return;
+                }
+                if (cached && result->aborted()) {
+                  // Unchanged since it was cached.
+                  promise.SetResult(ReadResult::Value(
+                      absl::Cord(std::move(cached->value)),
+                      tensorstore::TimestampedStorageGeneration(
+                          tensorstore::StorageGeneration{
+                              std::move(cached->generation)},
+                          result->stamp.time)));
+                  return;
+                }
+                // Update the cache before the read completes, so the object
+                // is on disk once a caller sees it.
+                DiskCacheExecutor()([self = std::move(self),
+                                     cacheKey = std::move(cacheKey),
+                                     read = std::move(result.value()),
+                                     promise = std::move(promise)]() mutable {
+                  if (read.has_value() &&
+                      !tensorstore::StorageGeneration::IsUnknown(
+                          read.stamp.generation)) {
+                    self->cache_->Insert(cacheKey, read.stamp.generation.value,
+                                         std::string(read.value));
+                  } else if (read.not_found()) {
+                    self->cache_->Erase(cacheKey);
+                  }
+                  promise.SetResult(std::move(read));
+                });
+              });
+        });
+    return std::move(pair.future);
+  }
+
+  tensorstore::Future<tensorstore::TimestampedStorageGeneration> Write(
+      tensorstore::kvstore::Key key,
+      std::optional<tensorstore::kvstore::Value> value,
+      tensorstore::kvstore::WriteOptions options) override {
+    using Generation = tensorstore::TimestampedStorageGeneration;
+    auto pair = tensorstore::PromiseFuturePair<Generation>::Make();
+    // The cached version is dropped before the write is issued.
+    DiskCacheExecutor()(
+        [self = tensorstore::internal::IntrusivePtr<DiskCacheDriver>(this),
+         path = base_.path + key, value = std::move(value),
+         options = std::move(options),
+         promise = std::move(pair.promise)]() mutable {
+          self->cache_->Erase(self->base_.driver->DescribeKey(path));
+          self->base_.driver
+              ->Write(std::move(path), std::move(value), std::move(options))
+              .ExecuteWhenReady([promise = std::move(promise)](
+                                    tensorstore::ReadyFuture<Generation>
+                                        written) {
+                promise.SetResult(written.result());
+              });
+        });
+    return std::move(pair.future);
+  }
+
+  /// Deleted objects are caught by validation, or linger until evicted.
+  tensorstore::Future<const void> DeleteRange(
+      tensorstore::KeyRange range) override {
+    return base_.driver->DeleteRange(
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(range)));
+  }
+
+  void ListImpl(tensorstore::kvstore::ListOptions options,
+                tensorstore::kvstore::ListReceiver receiver) override {
+    options.range =
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(options.range));
+    options.strip_prefix_length += base_.path.size();
+    base_.driver->ListImpl(std::move(options), std::move(receiver));
+  }
+
+  std::string DescribeKey(std::string_view key) override {
+    return base_.driver->DescribeKey(base_.path + std::string(key));
+  }
+
+  absl::Status GetBoundSpecData(DiskCacheSpecData& spec) const {  // NOLINT
+    MDIO_ASSIGN_OR_RETURN(spec.base, base_.spec())
+    spec.directory = cache_->directory();
+    spec.maxBytes = maxBytes_;
+    spec.validate = validate_;
+    return absl::OkStatus();
+  }
+
+  tensorstore::KvStore base_;
+  std::shared_ptr<DiskChunkCache> cache_;
+  Index maxBytes_ = 0;
+  bool validate_ = true;
+};
+
+inline tensorstore::Future<tensorstore::kvstore::DriverPtr>
+DiskCacheSpec::DoOpen() const {
+  return tensorstore::MapFutureValue(
+      tensorstore::InlineExecutor{},
+      [spec = tensorstore::internal::IntrusivePtr<const DiskCacheSpec>(this)](
+          tensorstore::KvStore& base) -> tensorstore::kvstore::DriverPtr {
+        auto driver =
+            tensorstore::internal::MakeIntrusivePtr<DiskCacheDriver>();
+        driver->base_ = std::move(base);
+        driver->cache_ = GetDiskChunkCache(spec->data_.directory,
+                                           spec->data_.maxBytes);
+        driver->maxBytes_ = spec->data_.maxBytes;
+        driver->validate_ = spec->data_.validate;
+        return driver;
+      },
+      tensorstore::kvstore::Open(data_.base));
+}
+
+inline const tensorstore::internal_kvstore::DriverRegistration<DiskCacheSpec>
+    kDiskCacheRegistration;
+
+/**
+ * @brief Routes a Variable's key-value store through the disk cache.
+ * @param kvstore The kvstore spec JSON, e.g. a "gcs" or "s3" store.
+ * @param options The cache to use.
+ * @return The kvstore spec JSON of the cached store, with the same path.
+ */
+inline nlohmann::json WrapWithDiskCache(const nlohmann::json& kvstore,
+                                        const DiskCacheOptions& options) {
+  nlohmann::json base = kvstore;
+  base.erase("path");
+  return {{"driver", DiskCacheSpec::id},
+          {"base", base},
+          {"path", kvstore.value("path", "")},
+          {"directory", options.directory},
+          {"max_bytes", options.maxBytes},
+          {"validate", options.validate}};
+}
+
+/**
+ * @brief The kvstore spec JSON of the store at the bottom of a stack of
+ * wrapping stores, e.g. the disk cache, to write through it.
+ */
+inline nlohmann::json UnwrapKvStore(const nlohmann::json& kvstore) {
+  if (!kvstore.contains("base")) {
+    return kvstore;
+  }
+  nlohmann::json base = UnwrapKvStore(kvstore["base"]);
+  base["path"] = base.value("path", "") + kvstore.value("path", "");
+  return base;
+}
+
+}  // namespace internal
+}  // namespace mdio
+
+TENSORSTORE_DECLARE_GARBAGE_COLLECTION_NOT_REQUIRED(
+    mdio::internal::DiskCacheDriver)
+
+#endif  // MDIO_DISK_CACHE_H_
@@ -0,0 +1,180 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/disk_cache.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>  // NOLINT
+#include <filesystem>
+#include <string>
+#include <thread>  // NOLINT
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+// A file-backed store stands in for the remote one.
+/*NOLINT*/ const std::string kRemotePath = "zarrs/testing/remote.mdio";
+/*NOLINT*/ const std::string kCachePath = "zarrs/testing/disk_cache";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 16},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 32] }
+      }
+    }
+  }
+]
+  )";
+  std::filesystem::remove_all(kCachePath);
+  return mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("remote", variables));
+}
+
+void WriteImage(const mdio::Dataset& ds, float value) {
+  auto image = ds.variables.get<float>("image").value();
+  auto data = mdio::from_variable<float>(image).value();
+  auto samples = data.get_data_accessor();
+  for (int i = 0; i < 16; ++i) {
+    for (int k = 0; k < 32; ++k) {
+      samples({i, k}) = value;
+    }
+  }
+  ASSERT_TRUE(image.Write(data).result().ok());
+}
+
+float ReadSample(const mdio::Dataset& ds) {
+  auto image = ds.variables.get<float>("image").value();
+  auto data = image.Read().result();
+  EXPECT_TRUE(data.status().ok()) << data.status();
+  return data.ok() ? data.value().get_data_accessor()({9, 9}) : -1;
+}
+
+size_t CachedFiles() {
+  size_t count = 0;
+  for (const auto& item : std::filesystem::directory_iterator(kCachePath)) {
+    count += item.is_regular_file();
+  }
+  return count;
+}
+
+TEST(DiskChunkCache, lookupAndEvict) {
+  std::filesystem::remove_all(kCachePath);
+  mdio::internal::DiskChunkCache cache(kCachePath, 1000);
+  EXPECT_FALSE(cache.Lookup("image/0/0"));
+  cache.Insert("image/0/0", "gen1", std::string(100, 'x'));
+  auto entry = cache.Lookup("image/0/0");
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(entry->generation, "gen1");
+  EXPECT_EQ(entry->value, std::string(100, 'x'));
+  cache.Insert("image/0/0", "gen2", "y");
+  EXPECT_EQ(cache.Lookup("image/0/0")->generation, "gen2");
+  cache.Erase("image/0/0");
+  EXPECT_FALSE(cache.Lookup("image/0/0"));
+
+  for (int i = 0; i < 20; ++i) {
+    cache.Insert("image/" + std::to_string(i), "g", std::string(100, 'z'));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    cache.Lookup("image/0");
+  }
+  EXPECT_LE(cache.Evict(), 1000);
+  EXPECT_TRUE(cache.Lookup("image/0")) << "Recently used";
+  EXPECT_TRUE(cache.Lookup("image/19"));
+  EXPECT_FALSE(cache.Lookup("image/1")) << "Least recently used";
+  std::filesystem::remove_all(kCachePath);
+}
+
+TEST(DiskCache, validated) {
+  auto remote = SETUP(kRemotePath).result();
+  ASSERT_TRUE(remote.status().ok()) << remote.status();
+  WriteImage(remote.value(), 1.0f);
+
+  mdio::DiskCacheOptions options;
+  options.directory = kCachePath;
+  auto cached =
+      mdio::Dataset::Open(kRemotePath, options, mdio::constants::kOpen)
+          .result();
+  ASSERT_TRUE(cached.status().ok()) << cached.status();
+  EXPECT_EQ(ReadSample(cached.value()), 1.0f);
+  EXPECT_GE(CachedFiles(), 2) << "Both chunks are cached";
+
+  // A change to the remote store is picked up by the next read.
+  WriteImage(remote.value(), 2.0f);
+  EXPECT_EQ(ReadSample(cached.value()), 2.0f);
+
+  // Writes and metadata go through to the remote store.
+  WriteImage(cached.value(), 3.0f);
+  cached.value().UpdateAttributes({{"cached", true}});
+  ASSERT_TRUE(cached.value().CommitMetadata().result().ok());
+  auto reopened =
+      mdio::Dataset::Open(kRemotePath, mdio::constants::kOpen).result();
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  EXPECT_EQ(ReadSample(reopened.value()), 3.0f);
+  EXPECT_EQ(reopened.value().getMetadata()["attributes"]["cached"], true);
+  std::filesystem::remove_all(kRemotePath);
+  std::filesystem::remove_all(kCachePath);
+}
+
+TEST(DiskCache, sharedAcrossOpens) {
+  auto remote = SETUP(kRemotePath).result();
+  ASSERT_TRUE(remote.status().ok()) << remote.status();
+  WriteImage(remote.value(), 4.0f);
+
+  mdio::DiskCacheOptions options;
+  options.directory = kCachePath;
+  options.validate = false;
+  {
+    auto warm =
+        mdio::Dataset::Open(kRemotePath, options, mdio::constants::kOpen)
+            .result();
+    ASSERT_TRUE(warm.status().ok()) << warm.status();
+    EXPECT_EQ(ReadSample(warm.value()), 4.0f);
+  }
+
+  // Without validation a later open is served from disk alone, even once the
+  // remote chunks are gone.
+  auto cached =
+      mdio::Dataset::Open(kRemotePath, options, mdio::constants::kOpen)
+          .result();
+  ASSERT_TRUE(cached.status().ok()) << cached.status();
+  std::filesystem::remove_all(kRemotePath + "/image/0");
+  std::filesystem::remove_all(kRemotePath + "/image/1");
+  EXPECT_EQ(ReadSample(cached.value()), 4.0f);
+  std::filesystem::remove_all(kRemotePath);
+  std::filesystem::remove_all(kCachePath);
+}
+
+TEST(DiskCache, noDirectory) {
+  auto remote = SETUP(kRemotePath).result();
+  ASSERT_TRUE(remote.status().ok()) << remote.status();
+  auto cached = mdio::Dataset::Open(kRemotePath, mdio::DiskCacheOptions{},
+                                    mdio::constants::kOpen);
+  EXPECT_FALSE(cached.status().ok());
+  std::filesystem::remove_all(kRemotePath);
+}
+
+}  // namespace
@@ -0,0 +1,926 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_EXPRESSION_H_
+#define MDIO_EXPRESSION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "mdio/map_blocks.h"
+#include "mdio/quantization.h"
+#include "mdio/variable.h"
+#include "tensorstore/util/executor.h"
+#include "tensorstore/util/future.h"
+
+namespace mdio {
+
+/**
+ * @brief The operations of an Expr.
+ */
+enum class ExprOp {
+  kInput,
+  kConstant,
+  // Unary.
+  kNegate,
+  kNot,
+  kAbs,
+  kSqrt,
+  kExp,
+  kLog,
+  kSin,
+  kCos,
+  kCast,
+  // Binary.
+  kAdd,
+  kSubtract,
+  kMultiply,
+  kDivide,
+  kPow,
+  kMinimum,
+  kMaximum,
+  kLess,
+  kLessEqual,
+  kGreater,
+  kGreaterEqual,
+  kEqual,
+  kNotEqual,
+  kAnd,
+  kOr,
+  // Ternary.
+  kWhere,
+};
+
+namespace internal {
+
+// One node of an expression graph. Nodes are immutable once built, so graphs
+// share subexpressions freely.
+struct ExprNode {
+  ExprOp op;
+  std::vector<std::shared_ptr<const ExprNode>> args;
+  // The Variable of an input.
+  std::optional<Variable<>> variable;
+  // The value of a constant.
+  double value = 0;
+  // The data type of a cast.
+  DataType dtype;
+};
+
+}  // namespace internal
+
+/**
+ * @brief A lazy elementwise expression over Variables.
+ * Arithmetic, comparisons and math on Variables and constants build a graph
+ * without reading anything. Evaluate then computes it in one pass: the inputs
+ * of every block are read together and the whole graph is applied to small
+ * tiles that stay in cache, so `(a - b) * mask / rms` reads each Variable once
+ * and writes no temporaries.
+ * Comparisons and logical operations give 1 where true and 0 where false, and
+ * conditions are true where nonzero. Variables broadcast by their dimension
+ * labels, so a map over (inline, crossline) combines with a volume over
+ * (inline, crossline, time).
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto a, ds.variables.at("seismic"))
+ * MDIO_ASSIGN_OR_RETURN(auto b, ds.variables.at("model"))
+ * MDIO_ASSIGN_OR_RETURN(auto mask, ds.variables.at("live_mask"))
+ * MDIO_ASSIGN_OR_RETURN(auto rms, ds.variables.at("rms_amplitude"))
+ * MDIO_ASSIGN_OR_RETURN(auto residual, ds.variables.at("residual"))
+ * mdio::Expr expr = (mdio::Expr(a) - b) * mask / rms;
+ * MDIO_ASSIGN_OR_RETURN(auto summary, mdio::Evaluate(expr, residual))
+ * @endcode
+ */
+class Expr {
+ public:
+  /**
+   * @brief An input Variable, read when the expression is evaluated.
+   */
+  template <typename T, DimensionIndex R, ReadWriteMode M>
+  Expr(const Variable<T, R, M>& variable)  // NOLINT
+      : Expr(ExprOp::kInput, {}) {
+    node_->variable = Variable<>(variable);
+  }
+
+  /**
+   * @brief A constant, broadcast to every sample.
+   */
+  Expr(double value) : Expr(ExprOp::kConstant, {}) {  // NOLINT
+    node_->value = value;
+  }
+
+  /**
+   * @brief An operation on other expressions.
+   */
+  Expr(ExprOp op, const std::vector<Expr>& args)
+      : node_(std::make_shared<internal::ExprNode>()) {
+    node_->op = op;
+    for (const auto& arg : args) {
+      node_->args.push_back(arg.node_);
+    }
+  }
+
+  /**
+   * @brief The values of `expr` converted to `dtype`, as stored.
+   * Integers saturate and NaN converts to 0.
+   */
+  static Expr Cast(const Expr& expr, DataType dtype) {
+    Expr cast(ExprOp::kCast, {expr});
+    cast.node_->dtype = dtype;
+    return cast;
+  }
+
+  const internal::ExprNode& node() const { return *node_; }
+
+ private:
+  // Only written while the expression is being built.
+  std::shared_ptr<internal::ExprNode> node_;
+};
+
+inline Expr operator-(const Expr& a) { return Expr(ExprOp::kNegate, {a}); }
+inline Expr operator!(const Expr& a) { return Expr(ExprOp::kNot, {a}); }
+inline Expr operator+(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kAdd, {a, b});
+}
+inline Expr operator-(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kSubtract, {a, b});
+}
+inline Expr operator*(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kMultiply, {a, b});
+}
+inline Expr operator/(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kDivide, {a, b});
+}
+inline Expr operator<(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kLess, {a, b});
+}
+inline Expr operator<=(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kLessEqual, {a, b});
+}
+inline Expr operator>(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kGreater, {a, b});
+}
+inline Expr operator>=(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kGreaterEqual, {a, b});
+}
+inline Expr operator==(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kEqual, {a, b});
+}
+inline Expr operator!=(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kNotEqual, {a, b});
+}
+/// Logical and; both sides are always evaluated.
+inline Expr operator&(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kAnd, {a, b});
+}
+/// Logical or; both sides are always evaluated.
+inline Expr operator|(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kOr, {a, b});
+}
+
+inline Expr Abs(const Expr& a) { return Expr(ExprOp::kAbs, {a}); }
+inline Expr Sqrt(const Expr& a) { return Expr(ExprOp::kSqrt, {a}); }
+inline Expr Exp(const Expr& a) { return Expr(ExprOp::kExp, {a}); }
+inline Expr Log(const Expr& a) { return Expr(ExprOp::kLog, {a}); }
+inline Expr Sin(const Expr& a) { return Expr(ExprOp::kSin, {a}); }
+inline Expr Cos(const Expr& a) { return Expr(ExprOp::kCos, {a}); }
+inline Expr Pow(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kPow, {a, b});
+}
+/// The smaller of two values, NaN if either is.
+inline Expr Minimum(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kMinimum, {a, b});
+}
+/// The larger of two values, NaN if either is.
+inline Expr Maximum(const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kMaximum, {a, b});
+}
+/// `a` where `condition` is nonzero, `b` elsewhere.
+inline Expr Where(const Expr& condition, const Expr& a, const Expr& b) {
+  return Expr(ExprOp::kWhere, {condition, a, b});
+}
+/// See Expr::Cast.
+inline Expr Cast(const Expr& a, DataType dtype) { return Expr::Cast(a, dtype); }
+
+/**
+ * @brief Options of Evaluate, on top of those of MapBlocks.
+ * The block shape is over the dimensions of the output, or of the input with
+ * the most dimensions when evaluating into memory.
+ */
+struct EvaluateOptions : MapBlocksOptions {
+  // The samples every node computes at once. The tiles of all the nodes should
+  // fit in the L1 or L2 cache.
+  Index tileSize = 1024;
+};
+
+namespace internal {
+
+// Calls `fn` with a null pointer to the element type of a numeric data type.
+// Returns false for other data types.
+template <typename Fn>
+bool VisitNumeric(DataType dtype, Fn&& fn) {
+  if (dtype == constants::kBool) {
+    fn(static_cast<dtypes::bool_t*>(nullptr));
+  } else if (dtype == constants::kInt8) {
+    fn(static_cast<dtypes::int8_t*>(nullptr));
+  } else if (dtype == constants::kInt16) {
+    fn(static_cast<dtypes::int16_t*>(nullptr));
+  } else if (dtype == constants::kInt32) {
+    fn(static_cast<dtypes::int32_t*>(nullptr));
+  } else if (dtype == constants::kInt64) {
+    fn(static_cast<dtypes::int64_t*>(nullptr));
+  } else if (dtype == constants::kUint8) {
+    fn(static_cast<dtypes::uint8_t*>(nullptr));
+  } else if (dtype == constants::kUint16) {
+    fn(static_cast<dtypes::uint16_t*>(nullptr));
+  } else if (dtype == constants::kUint32) {
+    fn(static_cast<dtypes::uint32_t*>(nullptr));
+  } else if (dtype == constants::kUint64) {
+    fn(static_cast<dtypes::uint64_t*>(nullptr));
+  } else if (dtype == constants::kFloat16) {
+    fn(static_cast<dtypes::float_16_t*>(nullptr));
+  } else if (dtype == constants::kFloat32) {
+    fn(static_cast<dtypes::float32_t*>(nullptr));
+  } else if (dtype == constants::kFloat64) {
+    fn(static_cast<dtypes::float64_t*>(nullptr));
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// A stored value as the type expressions compute in.
+template <typename T, typename U>
+T FromStored(U value) {
+  if constexpr (std::is_arithmetic_v<U>) {
+    return static_cast<T>(value);
+  } else {
+    // float16.
+    return static_cast<T>(static_cast<float>(value));
+  }
+}
+
+// A computed value as a stored type. Integers saturate and NaN is 0.
+template <typename U, typename T>
+U ToStored(T value) {
+  if constexpr (std::is_same_v<U, bool>) {
+    return value != 0;
+  } else if constexpr (std::is_integral_v<U>) {
+    if (value != value) {
+      return 0;
+    }
+    if (value <= static_cast<T>(std::numeric_limits<U>::lowest())) {
+      return std::numeric_limits<U>::lowest();
+    }
+    if (value >= static_cast<T>(std::numeric_limits<U>::max())) {
+      return std::numeric_limits<U>::max();
+    }
+    return static_cast<U>(value);
+  } else if constexpr (std::is_arithmetic_v<U>) {
+    return static_cast<U>(value);
+  } else {
+    return static_cast<U>(static_cast<float>(value));
+  }
+}
+
+template <typename T>
+using LoadFn = void (*)(const std::byte* src, T* dst, Index n);
+template <typename T>
+using StoreFn = void (*)(const T* src, std::byte* dst, Index n);
+
+template <typename U, typename T>
+void LoadAs(const std::byte* src, T* dst, Index n) {
+  const U* values = reinterpret_cast<const U*>(src);
+  for (Index i = 0; i < n; ++i) {
+    dst[i] = FromStored<T>(values[i]);
+  }
+}
+
+template <typename U, typename T>
+void StoreAs(const T* src, std::byte* dst, Index n) {
+  U* values = reinterpret_cast<U*>(dst);
+  for (Index i = 0; i < n; ++i) {
+    values[i] = ToStored<U>(src[i]);
+  }
+}
+
+template <typename T>
+Result<LoadFn<T>> GetLoad(DataType dtype) {
+  LoadFn<T> load = nullptr;
+  VisitNumeric(dtype, [&](auto* tag) {
+    load = &LoadAs<std::remove_pointer_t<decltype(tag)>, T>;
+  });
+  if (load == nullptr) {
+    return absl::InvalidArgumentError("Expressions cannot read " +
+                                      std::string(dtype.name()) + ".");
+  }
+  return load;
+}
+
+template <typename T>
+Result<StoreFn<T>> GetStore(DataType dtype) {
+  StoreFn<T> store = nullptr;
+  VisitNumeric(dtype, [&](auto* tag) {
+    store = &StoreAs<std::remove_pointer_t<decltype(tag)>, T>;
+  });
+  if (store == nullptr) {
+    return absl::InvalidArgumentError("Expressions cannot write " +
+                                      std::string(dtype.name()) + ".");
+  }
+  return store;
+}
+
+// Whether values of the data type lose precision as float32.
+inline bool NeedsFloat64(DataType dtype) {
+  return dtype == constants::kFloat64 || dtype == constants::kInt32 ||
+         dtype == constants::kUint32 || dtype == constants::kInt64 ||
+         dtype == constants::kUint64;
+}
+
+// An expression flattened into the order its nodes are computed, each node
+// once however often it is used.
+struct ExprProgram {
+  std::vector<const ExprNode*> nodes;
+  // The positions in `nodes` of the arguments of every node.
+  std::vector<std::vector<size_t>> args;
+  // The position in `inputs` of every input node.
+  std::vector<size_t> inputOf;
+  std::vector<Variable<>> inputs;
+  std::vector<bool> quantized;
+  // Whether to compute in float64 rather than float32.
+  bool wide = false;
+};
+
+inline size_t ExprArity(ExprOp op) {
+  switch (op) {
+    case ExprOp::kInput:
+    case ExprOp::kConstant:
+      return 0;
+    case ExprOp::kNegate:
+    case ExprOp::kNot:
+    case ExprOp::kAbs:
+    case ExprOp::kSqrt:
+    case ExprOp::kExp:
+    case ExprOp::kLog:
+    case ExprOp::kSin:
+    case ExprOp::kCos:
+    case ExprOp::kCast:
+      return 1;
+    case ExprOp::kWhere:
+      return 3;
+    default:
+      return 2;
+  }
+}
+
+inline absl::Status AddExprNode(
+    const ExprNode* node, ExprProgram& program,
+    std::unordered_map<const ExprNode*, size_t>& positions) {
+  if (positions.count(node)) {
+    return absl::OkStatus();
+  }
+  if (node->args.size() != ExprArity(node->op)) {
+    return absl::InvalidArgumentError(
+        "An expression has the wrong number of arguments.");
+  }
+  std::vector<size_t> args;
+  for (const auto& arg : node->args) {
+    auto status = AddExprNode(arg.get(), program, positions);
+    if (!status.ok()) {
+      return status;
+    }
+    args.push_back(positions.at(arg.get()));
+  }
+  size_t input = 0;
+  if (node->op == ExprOp::kInput) {
+    const Variable<>& variable = *node->variable;
+    const bool quantized = GetQuantization(variable).ok();
+    if (!quantized && !VisitNumeric(variable.dtype(), [](auto*) {})) {
+      return absl::InvalidArgumentError(
+          "Expressions cannot read Variable " + variable.get_variable_name() +
+          " of " + std::string(variable.dtype().name()) + ".");
+    }
+    input = program.inputs.size();
+    program.inputs.push_back(variable);
+    program.quantized.push_back(quantized);
+    program.wide =
+        program.wide || (!quantized && NeedsFloat64(variable.dtype()));
+  } else if (node->op == ExprOp::kCast) {
+    if (!VisitNumeric(node->dtype, [](auto*) {})) {
+      return absl::InvalidArgumentError(
+          "Expressions cannot cast to " + std::string(node->dtype.name()) +
+          ".");
+    }
+    program.wide = program.wide || NeedsFloat64(node->dtype);
+  }
+  positions[node] = program.nodes.size();
+  program.nodes.push_back(node);
+  program.args.push_back(std::move(args));
+  program.inputOf.push_back(input);
+  return absl::OkStatus();
+}
+
+inline Result<ExprProgram> CompileExpr(const Expr& expr) {
+  ExprProgram program;
+  std::unordered_map<const ExprNode*, size_t> positions;
+  auto status = AddExprNode(&expr.node(), program, positions);
+  if (!status.ok()) {
+    return status;
+  }
+  if (program.inputs.empty()) {
+    return absl::InvalidArgumentError("An expression needs a Variable.");
+  }
+  return program;
+}
+
+// Checks that every input lies over `domain`: its dimensions are labeled
+// dimensions of the domain with the same extent.
+inline absl::Status CheckExprDomain(const ExprProgram& program,
+                                    const IndexDomainView<>& domain) {
+  for (const auto& input : program.inputs) {
+    const auto inputDomain = input.get_store().domain();
+    for (DimensionIndex d = 0; d < inputDomain.rank(); ++d) {
+      const std::string label(inputDomain.labels()[d]);
+      auto labels = domain.labels();
+      auto found = std::find(labels.begin(), labels.end(), label);
+      if (label.empty() || found == labels.end()) {
+        return absl::InvalidArgumentError(
+            "Every dimension of " + input.get_variable_name() +
+            " must be a labeled dimension of the result.");
+      }
+      if (domain[found - labels.begin()].interval() !=
+          inputDomain[d].interval()) {
+        return absl::InvalidArgumentError(
+            "Dimension '" + label + "' of " + input.get_variable_name() +
+            " does not match the result.");
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Issues the read of every input over `domain`.
+inline Result<std::vector<Future<VariableData<>>>> ReadExprInputs(
+    const ExprProgram& program, const IndexDomainView<>& domain) {
+  std::vector<Future<VariableData<>>> reads;
+  for (size_t i = 0; i < program.inputs.size(); ++i) {
+    MDIO_ASSIGN_OR_RETURN(auto sliced,
+                          SliceToDomain(program.inputs[i], domain))
+    if (!program.quantized[i]) {
+      reads.push_back(sliced.Read());
+      continue;
+    }
+    MDIO_ASSIGN_OR_RETURN(
+        auto floats,
+        (CastVariable<float, dynamic_rank, ReadWriteMode::dynamic>(sliced)))
+    reads.push_back(tensorstore::MapFutureValue(
+        tensorstore::InlineExecutor{},
+        [](const VariableData<float>& data) { return VariableData<>(data); },
+        floats.Read()));
+  }
+  return reads;
+}
+
+// Calls `fn(offset, done, run, stride)` for every run of a tile along the
+// last dimension of `shape`, where `offset` is the byte offset of the run
+// given the byte `strides` and `done` the samples of the tile before it.
+template <typename Fn>
+void ForEachRun(const std::vector<Index>& shape,
+                const std::vector<Index>& strides, Index start, Index n,
+                Fn&& fn) {
+  const DimensionIndex rank = static_cast<DimensionIndex>(shape.size());
+  if (rank == 0) {
+    fn(Index{0}, Index{0}, n, Index{0});
+    return;
+  }
+  std::vector<Index> position(rank);
+  Index offset = 0;
+  for (DimensionIndex d = rank - 1; d >= 0; --d) {
+    position[d] = start % shape[d];
+    start /= shape[d];
+    offset += position[d] * strides[d];
+  }
+  const DimensionIndex last = rank - 1;
+  for (Index done = 0; done < n;) {
+    const Index run = std::min(n - done, shape[last] - position[last]);
+    fn(offset, done, run, strides[last]);
+    done += run;
+    offset += run * strides[last];
+    position[last] += run;
+    for (DimensionIndex d = last; d > 0 && position[d] == shape[d]; --d) {
+      offset += strides[d - 1] - shape[d] * strides[d];
+      position[d] = 0;
+      ++position[d - 1];
+    }
+  }
+}
+
+// Where the samples of an input or of the result lie over a block.
+struct TileLayout {
+  std::byte* origin = nullptr;
+  Index elementSize = 0;
+  // The byte strides along the dimensions of the block, 0 to broadcast.
+  std::vector<Index> strides;
+  // Whether the samples are in C order over the block.
+  bool contiguous = false;
+};
+
+inline Result<TileLayout> GetTileLayout(
+    const SharedArray<void, dynamic_rank, offset_origin>& data,
+    const std::vector<std::string>& labels,
+    const IndexDomainView<>& blockDomain) {
+  TileLayout layout;
+  layout.origin = static_cast<std::byte*>(
+      const_cast<void*>(data.byte_strided_origin_pointer().get()));
+  layout.elementSize = data.dtype().size();
+  const DimensionIndex rank = blockDomain.rank();
+  layout.strides.assign(rank, 0);
+  layout.contiguous = true;
+  Index expected = layout.elementSize;
+  for (DimensionIndex d = rank - 1; d >= 0; --d) {
+    auto found = std::find(labels.begin(), labels.end(),
+                           std::string(blockDomain.labels()[d]));
+    if (found != labels.end()) {
+      layout.strides[d] = data.byte_strides()[found - labels.begin()];
+    }
+    if (blockDomain.shape()[d] > 1 && layout.strides[d] != expected) {
+      layout.contiguous = false;
+    }
+    expected *= blockDomain.shape()[d];
+  }
+  return layout;
+}
+
+template <typename T>
+void ApplyExprOp(const ExprNode& node, const T* const* args, T* out, Index n) {
+  const T* a = args[0];
+  const T* b = args[1];
+  const T* c = args[2];
+  // Every case is a plain loop over contiguous tiles, which compilers
+  // vectorize; expression_benchmark compares them with the SIMD kernels.
+  switch (node.op) {
+    case ExprOp::kInput:
+    case ExprOp::kConstant:
+      break;
+    case ExprOp::kNegate:
+      for (Index i = 0; i < n; ++i) out[i] = -a[i];
+      break;
+    case ExprOp::kNot:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] == 0 ? T(1) : T(0);
+      break;
+    case ExprOp::kAbs:
+      for (Index i = 0; i < n; ++i) out[i] = std::abs(a[i]);
+      break;
+    case ExprOp::kSqrt:
+      for (Index i = 0; i < n; ++i) out[i] = std::sqrt(a[i]);
+      break;
+    case ExprOp::kExp:
+      for (Index i = 0; i < n; ++i) out[i] = std::exp(a[i]);
+      break;
+    case ExprOp::kLog:
+      for (Index i = 0; i < n; ++i) out[i] = std::log(a[i]);
+      break;
+    case ExprOp::kSin:
+      for (Index i = 0; i < n; ++i) out[i] = std::sin(a[i]);
+      break;
+    case ExprOp::kCos:
+      for (Index i = 0; i < n; ++i) out[i] = std::cos(a[i]);
+      break;
+    case ExprOp::kCast:
+      VisitNumeric(node.dtype, [&](auto* tag) {
+        using U = std::remove_pointer_t<decltype(tag)>;
+        for (Index i = 0; i < n; ++i) {
+          out[i] = FromStored<T>(ToStored<U>(a[i]));
+        }
+      });
+      break;
+    case ExprOp::kAdd:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] + b[i];
+      break;
+    case ExprOp::kSubtract:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] - b[i];
+      break;
+    case ExprOp::kMultiply:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] * b[i];
+      break;
+    case ExprOp::kDivide:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] / b[i];
+      break;
+    case ExprOp::kPow:
+      for (Index i = 0; i < n; ++i) out[i] = std::pow(a[i], b[i]);
+      break;
+    case ExprOp::kMinimum:
+      for (Index i = 0; i < n; ++i) {
+        out[i] = a[i] < b[i] || a[i] != a[i] ? a[i] : b[i];
+      }
+      break;
+    case ExprOp::kMaximum:
+      for (Index i = 0; i < n; ++i) {
+        out[i] = a[i] > b[i] || a[i] != a[i] ? a[i] : b[i];
+      }
+      break;
+    case ExprOp::kLess:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] < b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kLessEqual:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] <= b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kGreater:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] > b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kGreaterEqual:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] >= b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kEqual:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] == b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kNotEqual:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] != b[i] ? T(1) : T(0);
+      break;
+    case ExprOp::kAnd:
+      for (Index i = 0; i < n; ++i) {
+        out[i] = a[i] != 0 && b[i] != 0 ? T(1) : T(0);
+      }
+      break;
+    case ExprOp::kOr:
+      for (Index i = 0; i < n; ++i) {
+        out[i] = a[i] != 0 || b[i] != 0 ? T(1) : T(0);
+      }
+      break;
+    case ExprOp::kWhere:
+      for (Index i = 0; i < n; ++i) out[i] = a[i] != 0 ? b[i] : c[i];
+      break;
+  }
+}
+
+// Computes the expression over one block, tile by tile. `inputs` are the
+// data of the program's inputs over the block and `output` receives the
+// result, laid out as the block.
+template <typename T>
+absl::Status EvaluateExprBlock(
+    const ExprProgram& program, const std::vector<VariableData<>>& inputs,
+    const SharedArray<void, dynamic_rank, offset_origin>& output,
+    const IndexDomainView<>& blockDomain, Index tileSize) {
+  const std::vector<Index> shape(blockDomain.shape().begin(),
+                                 blockDomain.shape().end());
+  const std::vector<std::string> blockLabels(blockDomain.labels().begin(),
+                                             blockDomain.labels().end());
+  const Index numSamples = blockDomain.num_elements();
+  tileSize = std::max<Index>(tileSize, 1);
+  const size_t numNodes = program.nodes.size();
+
+  std::vector<TileLayout> layouts;
+  std::vector<LoadFn<T>> loads;
+  for (const auto& input : inputs) {
+    const auto inputDomain = input.data.domain;
+    std::vector<std::string> labels(inputDomain.labels().begin(),
+                                    inputDomain.labels().end());
+    MDIO_ASSIGN_OR_RETURN(
+        auto layout, GetTileLayout(input.data.data, labels, blockDomain))
+    MDIO_ASSIGN_OR_RETURN(auto load, GetLoad<T>(input.dtype()))
+    layouts.push_back(std::move(layout));
+    loads.push_back(load);
+  }
+  MDIO_ASSIGN_OR_RETURN(auto target,
+                        GetTileLayout(output, blockLabels, blockDomain))
+  MDIO_ASSIGN_OR_RETURN(auto store, GetStore<T>(output.dtype()))
+  const bool sameType = output.dtype() == tensorstore::dtype_v<T>;
+
+  // A tile per computed node; inputs of type T in C order are used in place.
+  std::vector<std::vector<T>> tiles(numNodes);
+  std::vector<const T*> values(numNodes, nullptr);
+  for (size_t i = 0; i < numNodes; ++i) {
+    const ExprNode& node = *program.nodes[i];
+    if (node.op == ExprOp::kInput) {
+      const size_t k = program.inputOf[i];
+      if (layouts[k].contiguous &&
+          inputs[k].dtype() == tensorstore::dtype_v<T>) {
+        continue;
+      }
+    }
+    tiles[i].resize(std::min(tileSize, std::max<Index>(numSamples, 1)));
+    if (node.op == ExprOp::kConstant) {
+      std::fill(tiles[i].begin(), tiles[i].end(), static_cast<T>(node.value));
+    }
+    values[i] = tiles[i].data();
+  }
+  const size_t root = numNodes - 1;
+  const ExprOp rootOp = program.nodes[root]->op;
+  const bool direct = target.contiguous && sameType &&
+                      rootOp != ExprOp::kInput && rootOp != ExprOp::kConstant;
+
+  for (Index start = 0; start < numSamples; start += tileSize) {
+    const Index n = std::min(tileSize, numSamples - start);
+    for (size_t i = 0; i < numNodes; ++i) {
+      const ExprNode& node = *program.nodes[i];
+      if (node.op == ExprOp::kConstant) {
+        continue;
+      }
+      if (node.op == ExprOp::kInput) {
+        const size_t k = program.inputOf[i];
+        const TileLayout& layout = layouts[k];
+        if (tiles[i].empty()) {
+          values[i] = reinterpret_cast<const T*>(layout.origin) + start;
+        } else if (layout.contiguous) {
+          loads[k](layout.origin + start * layout.elementSize, tiles[i].data(),
+                   n);
+        } else {
+          T* tile = tiles[i].data();
+          ForEachRun(shape, layout.strides, start, n,
+                     [&](Index offset, Index done, Index run, Index stride) {
+                       if (stride == layout.elementSize) {
+                         loads[k](layout.origin + offset, tile + done, run);
+                         return;
+                       }
+                       loads[k](layout.origin + offset, tile + done, 1);
+                       for (Index s = 1; s < run; ++s) {
+                         if (stride == 0) {
+                           tile[done + s] = tile[done];
+                         } else {
+                           loads[k](layout.origin + offset + s * stride,
+                                    tile + done + s, 1);
+                         }
+                       }
+                     });
+        }
+        continue;
+      }
+      const T* args[3] = {nullptr, nullptr, nullptr};
+      for (size_t a = 0; a < program.args[i].size(); ++a) {
+        args[a] = values[program.args[i][a]];
+      }
+      T* out = i == root && direct
+                   ? reinterpret_cast<T*>(target.origin) + start
+                   : tiles[i].data();
+      ApplyExprOp(node, args, out, n);
+      values[i] = out;
+    }
+    if (direct) {
+      continue;
+    }
+    const T* result = values[root];
+    if (target.contiguous) {
+      store(result, target.origin + start * target.elementSize, n);
+      continue;
+    }
+    ForEachRun(shape, target.strides, start, n,
+               [&](Index offset, Index done, Index run, Index stride) {
+                 if (stride == target.elementSize) {
+                   store(result + done, target.origin + offset, run);
+                   return;
+                 }
+                 for (Index s = 0; s < run; ++s) {
+                   store(result + done + s, target.origin + offset + s * stride,
+                         1);
+                 }
+               });
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+Result<VariableData<>> EvaluateExprInMemory(const ExprProgram& program,
+                                            const Variable<>& driver,
+                                            const std::string& name,
+                                            const EvaluateOptions& options) {
+  const auto domain = driver.get_store().domain();
+  MDIO_ASSIGN_OR_RETURN(auto blockShape, ResolveBlockShape(driver, options))
+  auto result = tensorstore::AllocateArray<T>(
+      domain.box(), mdio::ContiguousLayoutOrder::c, tensorstore::default_init);
+  auto metadata = driver.getSharedReducedMetadata();
+  auto sink = MemorySink(domain, result, name, metadata);
+  auto issue = [&](PendingBlock& pending) -> absl::Status {
+    MDIO_ASSIGN_OR_RETURN(
+        pending.reads,
+        ReadExprInputs(program, IndexDomainView<>(pending.block.domain)))
+    return absl::OkStatus();
+  };
+  auto evaluate = [&](Block& block) -> absl::Status {
+    return EvaluateExprBlock<T>(program, block.inputs,
+                                block.outputs[0].data.data,
+                                IndexDomainView<>(block.domain),
+                                options.tileSize);
+  };
+  auto progress = RunBlocks(sink, evaluate, options, blockShape, issue);
+  if (!progress.ok()) {
+    return progress.status();
+  }
+  return VariableData<>{
+      name, "", metadata,
+      LabeledArray<void, dynamic_rank, offset_origin>{domain, result}};
+}
+
+}  // namespace internal
+
+/**
+ * @brief Evaluates an expression into a Variable, in one pass.
+ * The output is divided into blocks as in MapBlocks. The inputs of a block are
+ * read together, while the previous block is computed, and the expression is
+ * applied to tiles of `options.tileSize` samples, each node once however often
+ * it is used. The results go straight into the block of the output, so no
+ * intermediate is ever as large as a block.
+ * Computation is in float32, or float64 if an input or a cast is float64 or a
+ * 32 or 64 bit integer. Quantized inputs are dequantized. Results are
+ * converted to the data type of the output, saturating integers.
+ * @param expr The expression.
+ * @param output The Variable to write. Every dimension of every input must be
+ * one of its labeled dimensions with the same extent; inputs are broadcast
+ * over the others.
+ * @param options The tile size, block shape, threads and progress.
+ * @return The final progress, or the first error of a read or a write.
+ */
+inline Result<MapBlocksProgress> Evaluate(const Expr& expr,
+                                          const Variable<>& output,
+                                          const EvaluateOptions& options = {}) {
+  MDIO_ASSIGN_OR_RETURN(auto program, internal::CompileExpr(expr))
+  const auto domain = output.get_store().domain();
+  auto status = internal::CheckExprDomain(program, IndexDomainView<>(domain));
+  if (!status.ok()) {
+    return status;
+  }
+  if (!internal::VisitNumeric(output.dtype(), [](auto*) {})) {
+    return absl::InvalidArgumentError(
+        "Expressions cannot write Variable " + output.get_variable_name() +
+        " of " + std::string(output.dtype().name()) + ".");
+  }
+  program.wide = program.wide || internal::NeedsFloat64(output.dtype());
+  MDIO_ASSIGN_OR_RETURN(auto blockShape,
+                        internal::ResolveBlockShape(output, options))
+  auto issue = [&](internal::PendingBlock& pending) -> absl::Status {
+    MDIO_ASSIGN_OR_RETURN(
+        pending.reads,
+        internal::ReadExprInputs(program,
+                                 IndexDomainView<>(pending.block.domain)))
+    return absl::OkStatus();
+  };
+  auto evaluate = [&](Block& block) -> absl::Status {
+    const IndexDomainView<> blockDomain(block.domain);
+    if (program.wide) {
+      return internal::EvaluateExprBlock<double>(
+          program, block.inputs, block.outputs[0].data.data, blockDomain,
+          options.tileSize);
+    }
+    return internal::EvaluateExprBlock<float>(program, block.inputs,
+                                              block.outputs[0].data.data,
+                                              blockDomain, options.tileSize);
+  };
+  return internal::RunBlocks({output}, evaluate, options, blockShape, issue);
+}
+
+/**
+ * @brief Evaluates an expression into memory, in one pass.
+ * The result is over the input with the most dimensions, which every other
+ * input must lie over, and is float32 or float64 as the computation. Blocks
+ * follow the chunks of that input and are computed in parallel as by the
+ * overload that writes a Variable.
+ * @param expr The expression.
+ * @param name The name of the result.
+ * @param options The tile size, block shape and threads.
+ * @return The result, or the first error of a read.
+ */
+inline Result<VariableData<>> Evaluate(const Expr& expr,
+                                       const std::string& name,
+                                       const EvaluateOptions& options = {}) {
+  MDIO_ASSIGN_OR_RETURN(auto program, internal::CompileExpr(expr))
+  size_t driver = 0;
+  for (size_t i = 1; i < program.inputs.size(); ++i) {
+    if (program.inputs[i].rank() > program.inputs[driver].rank()) {
+      driver = i;
+    }
+  }
+  const Variable<> variable = program.inputs[driver];
+  const auto domain = variable.get_store().domain();
+  auto status = internal::CheckExprDomain(program, IndexDomainView<>(domain));
+  if (!status.ok()) {
+    return status;
+  }
+  if (program.wide) {
+    return internal::EvaluateExprInMemory<double>(program, variable, name,
+                                                  options);
+  }
+  return internal::EvaluateExprInMemory<float>(program, variable, name,
+                                               options);
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_EXPRESSION_H_
@@ -0,0 +1,106 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The tile loops of expressions, which rely on the compiler to vectorize,
+// against the hand written kernels of the same arithmetic. a * scale + offset
+// is the kernels' dequantize, so the two are directly comparable:
+//   mdio_expression_benchmark --benchmark_filter=Affine
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mdio/expression.h"
+#include "mdio/kernels/kernels.h"
+
+namespace {
+
+using mdio::Index;
+using mdio::internal::ExprNode;
+using mdio::kernels::Isa;
+
+// 4 MiB of float32, about the size of a chunk.
+constexpr Index kSamples = Index{1} << 20;
+constexpr float kScale = 0.001f;
+constexpr float kOffset = 0.5f;
+
+std::vector<float> Pattern() {
+  std::vector<float> values(kSamples);
+  uint32_t x = 0x9e3779b9u;
+  for (auto& value : values) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    value = static_cast<float>(static_cast<int16_t>(x));
+  }
+  return values;
+}
+
+// a * scale + offset as Evaluate computes it: one node after the other over
+// tiles of state.range(0) samples, with the constants filled into tiles.
+void BM_ExprAffine(benchmark::State& state) {  // NOLINT
+  const Index tileSize = state.range(0);
+  auto src = Pattern();
+  std::vector<float> dst(kSamples);
+  std::vector<float> scale(tileSize, kScale), offset(tileSize, kOffset);
+  std::vector<float> product(tileSize);
+  ExprNode multiply{mdio::ExprOp::kMultiply};
+  ExprNode add{mdio::ExprOp::kAdd};
+  for (auto _ : state) {
+    for (Index start = 0; start < kSamples; start += tileSize) {
+      const Index n = std::min(tileSize, kSamples - start);
+      const float* products[3] = {src.data() + start, scale.data(), nullptr};
+      mdio::internal::ApplyExprOp(multiply, products, product.data(), n);
+      const float* sums[3] = {product.data(), offset.data(), nullptr};
+      mdio::internal::ApplyExprOp(add, sums, dst.data() + start, n);
+    }
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetLabel("tile " + std::to_string(tileSize));
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+// The same arithmetic by the dequantize kernel of each instruction set.
+void BM_KernelAffine(benchmark::State& state) {  // NOLINT
+  auto isa = static_cast<Isa>(state.range(0));
+  auto table = mdio::kernels::GetKernelTable(isa);
+  if (!table.ok()) {
+    state.SkipWithError("Instruction set not supported.");
+    return;
+  }
+  state.SetLabel(std::string(mdio::kernels::IsaName(isa)));
+  auto src = Pattern();
+  std::vector<float> dst(kSamples);
+  for (auto _ : state) {
+    dst = src;
+    // The fill code is outside the int16 range, so no sample becomes NaN.
+    table.value()->dequantize(dst.data(), kSamples, kScale, kOffset, -1e9f);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void AllIsas(benchmark::internal::Benchmark* b) {
+  for (Isa isa : {Isa::kScalar, Isa::kNeon, Isa::kAvx2, Isa::kAvx512}) {
+    b->Arg(static_cast<int>(isa));
+  }
+}
+
+BENCHMARK(BM_ExprAffine)->Arg(256)->Arg(1024)->Arg(4096);
+BENCHMARK(BM_KernelAffine)->Apply(AllIsas);
+
+}  // namespace
@@ -0,0 +1,241 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/expression.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/expression.mdio";
+
+float A(mdio::Index i, mdio::Index j, mdio::Index k) {
+  return (i + 1) * (j + 1) + k * 0.25f - 2;
+}
+float B(mdio::Index k) { return k * 0.5f; }
+bool Live(mdio::Index i, mdio::Index j) { return (i + j) % 3 != 0; }
+float Rms(mdio::Index j) { return j + 1.0f; }
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "a",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4, 8] }
+      }
+    }
+  },
+  {
+    "name": "b",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4, 8] }
+      }
+    }
+  },
+  {
+    "name": "live_mask",
+    "dataType": "bool",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ]
+  },
+  {
+    "name": "rms",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ]
+  },
+  {
+    "name": "residual",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4, 8] }
+      }
+    }
+  },
+  {
+    "name": "codes",
+    "dataType": "int16",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ]
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("expression", variables));
+  ds = mdio::test_util::Fill<float>(ds, "a", [](auto index) {
+    return A(index[0], index[1], index[2]);
+  });
+  ds = mdio::test_util::Fill<float>(ds, "b", [](auto index) {
+    return B(index[2]);
+  });
+  ds = mdio::test_util::Fill<bool>(ds, "live_mask", [](auto index) {
+    return Live(index[0], index[1]);
+  });
+  return mdio::test_util::Fill<float>(ds, "rms", [](auto index) {
+    return Rms(index[1]);
+  });
+}
+
+TEST(Expression, fused) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  mdio::Expr a = vars.at("a").value();
+  mdio::Expr expr = (a - vars.at("b").value()) * vars.at("live_mask").value() /
+                    vars.at("rms").value();
+
+  mdio::EvaluateOptions options;
+  options.numThreads = 4;
+  // Tiles that end partway through traces.
+  options.tileSize = 7;
+  auto summary = mdio::Evaluate(expr, vars.at("residual").value(), options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  EXPECT_EQ(summary.value().blocksTotal, 8);
+  // The volumes are read once, the maps once per block along time.
+  EXPECT_EQ(summary.value().bytesRead, 2 * 6 * 5 * 16 * 4 + 2 * 6 * 5 * 5);
+  EXPECT_EQ(summary.value().bytesWritten, 6 * 5 * 16 * 4);
+
+  auto residual = vars.get<float>("residual").value().Read().result();
+  ASSERT_TRUE(residual.ok()) << residual.status();
+  auto data = residual.value().get_data_accessor();
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      for (int k = 0; k < 16; ++k) {
+        float expected = (A(i, j, k) - B(k)) * Live(i, j) / Rms(j);
+        EXPECT_FLOAT_EQ(data({i, j, k}), expected) << i << " " << j << " " << k;
+      }
+    }
+  }
+}
+
+TEST(Expression, inMemory) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  mdio::Expr a = vars.at("a").value();
+  mdio::Expr b = vars.at("b").value();
+  // `a` is used three times and read once.
+  auto expr = mdio::Where((a > 0) & !(a == b), a, -a) +
+              mdio::Sqrt(mdio::Abs(b)) + mdio::Minimum(a, 1);
+
+  mdio::EvaluateOptions options;
+  options.numThreads = 2;
+  auto result = mdio::Evaluate(expr, "derived", options);
+  ASSERT_TRUE(result.ok()) << result.status();
+  EXPECT_EQ(result.value().variableName, "derived");
+  EXPECT_EQ(result.value().dtype(), mdio::constants::kFloat32);
+  auto domain = result.value().dimensions();
+  ASSERT_EQ(domain.rank(), 3);
+  EXPECT_EQ(domain.labels()[2], "time");
+  auto values =
+      tensorstore::StaticDataTypeCast<float>(result.value().data.data);
+  ASSERT_TRUE(values.ok()) << values.status();
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      for (int k = 0; k < 16; ++k) {
+        float x = A(i, j, k), y = B(k);
+        float expected = (x > 0 && x != y ? x : -x) + std::sqrt(std::abs(y)) +
+                         std::min(x, 1.0f);
+        EXPECT_FLOAT_EQ(values.value()({i, j, k}), expected)
+            << i << " " << j << " " << k;
+      }
+    }
+  }
+}
+
+TEST(Expression, cast) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  mdio::Expr a = vars.at("a").value();
+
+  // Integers saturate when written.
+  auto summary = mdio::Evaluate(a * 10000, vars.at("codes").value());
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  auto codes = vars.get<int16_t>("codes").value().Read().result();
+  ASSERT_TRUE(codes.ok()) << codes.status();
+  EXPECT_EQ(codes.value().get_data_accessor()({0, 0, 0}), -10000);
+  EXPECT_EQ(codes.value().get_data_accessor()({5, 4, 15}),
+            std::numeric_limits<int16_t>::max());
+
+  // A cast to int32 computes in float64 and truncates.
+  auto truncated =
+      mdio::Evaluate(mdio::Cast(a, mdio::constants::kInt32), "truncated");
+  ASSERT_TRUE(truncated.ok()) << truncated.status();
+  EXPECT_EQ(truncated.value().dtype(), mdio::constants::kFloat64);
+  auto values =
+      tensorstore::StaticDataTypeCast<double>(truncated.value().data.data);
+  ASSERT_TRUE(values.ok()) << values.status();
+  // 1 + 3 * 0.25 - 2.
+  EXPECT_EQ(values.value()({0, 0, 3}), 0);
+  EXPECT_EQ(values.value()({0, 0, 15}), 2);
+}
+
+TEST(Expression, errors) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  mdio::Expr a = vars.at("a").value();
+
+  auto constant = mdio::Evaluate(mdio::Expr(1) + 2, "constant");
+  EXPECT_EQ(constant.status().code(), absl::StatusCode::kInvalidArgument);
+  // `rms` has no time dimension to hold `a`.
+  auto wrongOutput = mdio::Evaluate(a * 2, vars.at("rms").value());
+  EXPECT_EQ(wrongOutput.status().code(), absl::StatusCode::kInvalidArgument);
+  auto wrongCast = mdio::Evaluate(
+      mdio::Cast(a, mdio::constants::kComplex64), vars.at("residual").value());
+  EXPECT_EQ(wrongCast.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
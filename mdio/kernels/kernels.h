@@ -0,0 +1,363 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_KERNELS_KERNELS_H_
+#define MDIO_KERNELS_KERNELS_H_
+
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "mdio/kernels/neon.h"
+#include "mdio/kernels/scalar.h"
+#include "mdio/kernels/x86.h"
+
+namespace mdio {
+namespace kernels {
+
+/**
+ * @brief The instruction sets the conversion kernels are built for.
+ */
+enum class Isa { kScalar, kAvx2, kAvx512, kNeon };
+
+/**
+ * @brief One implementation of every conversion kernel.
+ * Sources and destinations are raw buffers with no alignment requirement.
+ */
+struct KernelTable {
+  Isa isa;
+  void (*ibmToIeee)(const void* src, float* dst, Index n);
+  void (*ieeeToIbm)(const float* src, void* dst, Index n);
+  void (*byteSwap16)(const void* src, void* dst, Index n);
+  void (*byteSwap32)(const void* src, void* dst, Index n);
+  void (*byteSwap64)(const void* src, void* dst, Index n);
+  void (*int16ToFloat)(const void* src, float* dst, Index n, float scale,
+                       bool bigEndian);
+  void (*int32ToFloat)(const void* src, float* dst, Index n, float scale,
+                       bool bigEndian);
+  void (*dequantize)(float* values, Index n, float scale, float offset,
+                     float fill);
+  Index (*quantize)(const float* src, float* codes, Index n, float scale,
+                    float offset, float lo, float hi);
+  void (*accumulateSum)(const float* src, double* sum, double* count, Index n);
+  void (*accumulateSquares)(const float* src, double* sum, double* count,
+                            Index n);
+  void (*accumulateMin)(const float* src, float* min, Index n);
+  void (*accumulateMax)(const float* src, float* max, Index* argmax,
+                        Index position, Index n);
+  void (*countNonzero)(const float* src, double* count, Index n);
+};
+
+/// The lower case name of an instruction set, as accepted by `ParseIsa`.
+inline std::string_view IsaName(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar:
+      return "scalar";
+    case Isa::kAvx2:
+      return "avx2";
+    case Isa::kAvx512:
+      return "avx512";
+    case Isa::kNeon:
+      return "neon";
+  }
+  return "unknown";
+}
+
+/**
+ * @brief Parses an instruction set name.
+ * @return The instruction set or an InvalidArgumentError for unknown names.
+ */
+inline Result<Isa> ParseIsa(std::string_view name) {
+  for (Isa isa : {Isa::kScalar, Isa::kAvx2, Isa::kAvx512, Isa::kNeon}) {
+    if (name == IsaName(isa)) {
+      return isa;
+    }
+  }
+  return absl::InvalidArgumentError("Unknown kernel instruction set '" +
+                                    std::string(name) + "'.");
+}
+
+/**
+ * @brief Whether this build and the running CPU can execute the kernels of an
+ * instruction set.
+ */
+inline bool IsaSupported(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar:
+      return true;
+    case Isa::kAvx2:
+#ifdef MDIO_KERNELS_X86
+      return x86::HasAvx2();
+#else
+      return false;
+#endif
+    case Isa::kAvx512:
+#ifdef MDIO_KERNELS_X86
+      return x86::HasAvx2() && x86::HasAvx512();
+#else
+      return false;
+#endif
+    case Isa::kNeon:
+#ifdef MDIO_KERNELS_NEON
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+/// The supported instruction sets, from the reference to the widest.
+inline std::vector<Isa> SupportedIsas() {
+  std::vector<Isa> isas;
+  for (Isa isa : {Isa::kScalar, Isa::kNeon, Isa::kAvx2, Isa::kAvx512}) {
+    if (IsaSupported(isa)) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+/// The widest instruction set supported by this build and CPU.
+inline Isa DetectIsa() { return SupportedIsas().back(); }
+
+/**
+ * @brief The kernels of an instruction set.
+ * @return The kernel table, or an UnimplementedError if the instruction set
+ * is not supported by this build or CPU.
+ */
+inline Result<const KernelTable*> GetKernelTable(Isa isa) {
+  if (!IsaSupported(isa)) {
+    return absl::UnimplementedError("The '" + std::string(IsaName(isa)) +
+                                    "' kernels are not available.");
+  }
+  static const KernelTable kScalar = {
+      Isa::kScalar,          scalar::IbmToIeee,
+      scalar::IeeeToIbm,     scalar::ByteSwap16,
+      scalar::ByteSwap32,    scalar::ByteSwap64,
+      scalar::Int16ToFloat,  scalar::Int32ToFloat,
+      scalar::Dequantize,    scalar::Quantize,
+      scalar::AccumulateSum, scalar::AccumulateSquares,
+      scalar::AccumulateMin, scalar::AccumulateMax,
+      scalar::CountNonzero};
+  switch (isa) {
+#ifdef MDIO_KERNELS_X86
+    case Isa::kAvx2: {
+      static const KernelTable kAvx2 = {
+          Isa::kAvx2,              x86::IbmToIeeeAvx2,
+          x86::IeeeToIbmAvx2,      x86::ByteSwap16Avx2,
+          x86::ByteSwap32Avx2,     x86::ByteSwap64Avx2,
+          x86::Int16ToFloatAvx2,   x86::Int32ToFloatAvx2,
+          x86::DequantizeAvx2,     x86::QuantizeAvx2,
+          x86::AccumulateSumAvx2,  x86::AccumulateSquaresAvx2,
+          x86::AccumulateMinAvx2,  x86::AccumulateMaxAvx2,
+          x86::CountNonzeroAvx2};
+      return &kAvx2;
+    }
+    case Isa::kAvx512: {
+      // Quantization is bound by the double precision arithmetic and the
+      // reductions by memory, so the AVX2 kernels are used there.
+      static const KernelTable kAvx512 = {
+          Isa::kAvx512,            x86::IbmToIeeeAvx512,
+          x86::IeeeToIbmAvx512,    x86::ByteSwap16Avx512,
+          x86::ByteSwap32Avx512,   x86::ByteSwap64Avx512,
+          x86::Int16ToFloatAvx512, x86::Int32ToFloatAvx512,
+          x86::DequantizeAvx2,     x86::QuantizeAvx2,
+          x86::AccumulateSumAvx2,  x86::AccumulateSquaresAvx2,
+          x86::AccumulateMinAvx2,  x86::AccumulateMaxAvx2,
+          x86::CountNonzeroAvx2};
+      return &kAvx512;
+    }
+#endif
+#ifdef MDIO_KERNELS_NEON
+    case Isa::kNeon: {
+      static const KernelTable kNeon = {
+          Isa::kNeon,          neon::IbmToIeee,
+          neon::IeeeToIbm,     neon::ByteSwap16,
+          neon::ByteSwap32,    neon::ByteSwap64,
+          neon::Int16ToFloat,  neon::Int32ToFloat,
+          neon::Dequantize,    neon::Quantize,
+          neon::AccumulateSum, neon::AccumulateSquares,
+          neon::AccumulateMin, neon::AccumulateMax,
+          neon::CountNonzero};
+      return &kNeon;
+    }
+#endif
+    default:
+      return &kScalar;
+  }
+}
+
+namespace internal {
+
+/**
+ * @brief The kernels used by the free functions below.
+ * They start as the widest supported instruction set, unless the
+ * MDIO_KERNEL_ISA environment variable names another supported one.
+ */
+inline std::atomic<const KernelTable*>& ActiveKernels() {
+  static std::atomic<const KernelTable*> active{[] {
+    const char* name = std::getenv("MDIO_KERNEL_ISA");
+    if (name != nullptr) {
+      auto isa = ParseIsa(name);
+      if (isa.ok()) {
+        auto table = GetKernelTable(isa.value());
+        if (table.ok()) {
+          return table.value();
+        }
+      }
+    }
+    return GetKernelTable(DetectIsa()).value();
+  }()};
+  return active;
+}
+
+inline const KernelTable& Active() {
+  return *ActiveKernels().load(std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+/**
+ * @brief Selects the instruction set used by the conversion kernels.
+ * Calls already in flight finish with the previous selection.
+ * @return An UnimplementedError if the instruction set is not supported.
+ */
+inline absl::Status SetIsa(Isa isa) {
+  MDIO_ASSIGN_OR_RETURN(auto table, GetKernelTable(isa))
+  internal::ActiveKernels().store(table, std::memory_order_relaxed);
+  return absl::OkStatus();
+}
+
+/// The instruction set currently used by the conversion kernels.
+inline Isa ActiveIsa() { return internal::Active().isa; }
+
+/**
+ * @brief Converts big-endian IBM System/360 floats to IEEE float32.
+ * Values beyond the float32 range become +/-inf; the result is correctly
+ * rounded.
+ */
+inline void IbmToIeee(const void* src, float* dst, Index n) {
+  internal::Active().ibmToIeee(src, dst, n);
+}
+
+/**
+ * @brief Converts IEEE float32 to big-endian IBM System/360 floats.
+ * The fraction is rounded to nearest. NaN and inf saturate to the largest
+ * IBM magnitude and both zeros become +0.
+ */
+inline void IeeeToIbm(const float* src, void* dst, Index n) {
+  internal::Active().ieeeToIbm(src, dst, n);
+}
+
+/// Reverses the bytes of `n` 16 bit words. `src` and `dst` may be equal.
+inline void ByteSwap16(const void* src, void* dst, Index n) {
+  internal::Active().byteSwap16(src, dst, n);
+}
+
+/// Reverses the bytes of `n` 32 bit words. `src` and `dst` may be equal.
+inline void ByteSwap32(const void* src, void* dst, Index n) {
+  internal::Active().byteSwap32(src, dst, n);
+}
+
+/// Reverses the bytes of `n` 64 bit words. `src` and `dst` may be equal.
+inline void ByteSwap64(const void* src, void* dst, Index n) {
+  internal::Active().byteSwap64(src, dst, n);
+}
+
+/**
+ * @brief Converts int16 samples to float32, multiplied by `scale`.
+ * @param bigEndian Whether the samples are stored big-endian.
+ */
+inline void Int16ToFloat(const void* src, float* dst, Index n,
+                         float scale = 1.0f, bool bigEndian = false) {
+  internal::Active().int16ToFloat(src, dst, n, scale, bigEndian);
+}
+
+/**
+ * @brief Converts int32 samples to float32, multiplied by `scale`.
+ * The conversion rounds to nearest before scaling.
+ * @param bigEndian Whether the samples are stored big-endian.
+ */
+inline void Int32ToFloat(const void* src, float* dst, Index n,
+                         float scale = 1.0f, bool bigEndian = false) {
+  internal::Active().int32ToFloat(src, dst, n, scale, bigEndian);
+}
+
+/**
+ * @brief Dequantizes integer codes held as float32, in place.
+ * value = code * scale + offset; codes equal to `fill` become NaN.
+ */
+inline void Dequantize(float* values, Index n, float scale, float offset,
+                       float fill) {
+  internal::Active().dequantize(values, n, scale, offset, fill);
+}
+
+/**
+ * @brief Quantizes float32 values to integer codes held as float32.
+ * code = round((value - offset) / scale), rounded to nearest even and clamped
+ * to [lo, hi]. NaN becomes `lo - 1`, the fill code.
+ * @return The number of values that had to be clamped.
+ */
+inline Index Quantize(const float* src, float* codes, Index n, float scale,
+                      float offset, float lo, float hi) {
+  return internal::Active().quantize(src, codes, n, scale, offset, lo, hi);
+}
+
+/**
+ * @brief Adds a row of samples to running sums, element by element.
+ * NaN samples are skipped; `count` counts the others. Each sum is
+ * accumulated in the same order by every instruction set.
+ */
+inline void AccumulateSum(const float* src, double* sum, double* count,
+                          Index n) {
+  internal::Active().accumulateSum(src, sum, count, n);
+}
+
+/**
+ * @brief Adds the squares of a row of samples to running sums.
+ * NaN samples are skipped; `count` counts the others.
+ */
+inline void AccumulateSquares(const float* src, double* sum, double* count,
+                              Index n) {
+  internal::Active().accumulateSquares(src, sum, count, n);
+}
+
+/// Lowers running minima to a row of samples. NaN samples are skipped.
+inline void AccumulateMin(const float* src, float* min, Index n) {
+  internal::Active().accumulateMin(src, min, n);
+}
+
+/**
+ * @brief Raises running maxima to a row of samples, recording `position`
+ * where a sample is the new maximum. NaN samples are skipped and ties keep
+ * the first position.
+ */
+inline void AccumulateMax(const float* src, float* max, Index* argmax,
+                          Index position, Index n) {
+  internal::Active().accumulateMax(src, max, argmax, position, n);
+}
+
+/// Counts the samples of a row that are neither zero nor NaN.
+inline void CountNonzero(const float* src, double* count, Index n) {
+  internal::Active().countNonzero(src, count, n);
+}
+
+}  // namespace kernels
+}  // namespace mdio
+
+#endif  // MDIO_KERNELS_KERNELS_H_
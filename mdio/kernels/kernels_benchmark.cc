@@ -0,0 +1,215 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Throughput of each conversion and reduction kernel on every instruction
+// set this CPU supports. Bytes are counted on the input side:
+//   mdio_kernels_benchmark --benchmark_filter=IbmToIeee
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mdio/kernels/kernels.h"
+
+namespace {
+
+using mdio::Index;
+using mdio::kernels::Isa;
+using mdio::kernels::KernelTable;
+
+// 4 MiB of float32, about the size of a chunk.
+constexpr Index kSamples = Index{1} << 20;
+
+const KernelTable* TableFor(benchmark::State& state) {
+  auto isa = static_cast<Isa>(state.range(0));
+  auto table = mdio::kernels::GetKernelTable(isa);
+  if (!table.ok()) {
+    state.SkipWithError("Instruction set not supported.");
+    return nullptr;
+  }
+  state.SetLabel(std::string(mdio::kernels::IsaName(isa)));
+  return table.value();
+}
+
+std::vector<uint32_t> Pattern() {
+  std::vector<uint32_t> words(kSamples);
+  uint32_t x = 0x9e3779b9u;
+  for (auto& word : words) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    // Keep IBM exponents near 64 and float exponents finite.
+    word = (x & 0x80ffffffu) | (((x >> 24) & 0x0f) + 0x3a) << 24;
+  }
+  return words;
+}
+
+void BM_IbmToIeee(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto src = Pattern();
+  std::vector<float> dst(kSamples);
+  for (auto _ : state) {
+    table->ibmToIeee(src.data(), dst.data(), kSamples);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_IeeeToIbm(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto pattern = Pattern();
+  std::vector<float> src(kSamples);
+  table->ibmToIeee(pattern.data(), src.data(), kSamples);
+  std::vector<uint32_t> dst(kSamples);
+  for (auto _ : state) {
+    table->ieeeToIbm(src.data(), dst.data(), kSamples);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_ByteSwap(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  const int width = static_cast<int>(state.range(1));
+  auto src = Pattern();
+  std::vector<uint32_t> dst(kSamples);
+  const Index bytes = kSamples * 4;
+  for (auto _ : state) {
+    if (width == 2) table->byteSwap16(src.data(), dst.data(), bytes / 2);
+    if (width == 4) table->byteSwap32(src.data(), dst.data(), bytes / 4);
+    if (width == 8) table->byteSwap64(src.data(), dst.data(), bytes / 8);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+void BM_Int16ToFloat(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto src = Pattern();
+  std::vector<float> dst(kSamples);
+  for (auto _ : state) {
+    table->int16ToFloat(src.data(), dst.data(), kSamples, 0.5f, true);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 2);
+}
+
+void BM_Int32ToFloat(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto src = Pattern();
+  std::vector<float> dst(kSamples);
+  for (auto _ : state) {
+    table->int32ToFloat(src.data(), dst.data(), kSamples, 0.5f, true);
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_Dequantize(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto pattern = Pattern();
+  std::vector<float> codes(kSamples);
+  for (Index i = 0; i < kSamples; ++i) {
+    codes[i] = static_cast<float>(static_cast<int16_t>(pattern[i]));
+  }
+  std::vector<float> values(kSamples);
+  for (auto _ : state) {
+    values = codes;
+    table->dequantize(values.data(), kSamples, 0.001f, 0.5f, -32768.0f);
+    benchmark::DoNotOptimize(values.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_Quantize(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto pattern = Pattern();
+  std::vector<float> src(kSamples);
+  table->ibmToIeee(pattern.data(), src.data(), kSamples);
+  std::vector<float> codes(kSamples);
+  for (auto _ : state) {
+    auto clamped = table->quantize(src.data(), codes.data(), kSamples, 0.001f,
+                                   0.5f, -32767.0f, 32767.0f);
+    benchmark::DoNotOptimize(clamped);
+    benchmark::DoNotOptimize(codes.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_AccumulateSquares(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto pattern = Pattern();
+  std::vector<float> src(kSamples);
+  table->ibmToIeee(pattern.data(), src.data(), kSamples);
+  std::vector<double> sum(kSamples), count(kSamples);
+  for (auto _ : state) {
+    table->accumulateSquares(src.data(), sum.data(), count.data(), kSamples);
+    benchmark::DoNotOptimize(sum.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void BM_AccumulateMax(benchmark::State& state) {  // NOLINT
+  const KernelTable* table = TableFor(state);
+  if (table == nullptr) return;
+  auto pattern = Pattern();
+  std::vector<float> src(kSamples);
+  table->ibmToIeee(pattern.data(), src.data(), kSamples);
+  std::vector<float> max(kSamples, -INFINITY);
+  std::vector<Index> argmax(kSamples, -1);
+  Index position = 0;
+  for (auto _ : state) {
+    table->accumulateMax(src.data(), max.data(), argmax.data(), position++,
+                         kSamples);
+    benchmark::DoNotOptimize(max.data());
+  }
+  state.SetBytesProcessed(state.iterations() * kSamples * 4);
+}
+
+void AllIsas(benchmark::internal::Benchmark* b) {
+  for (Isa isa : {Isa::kScalar, Isa::kNeon, Isa::kAvx2, Isa::kAvx512}) {
+    b->Arg(static_cast<int>(isa));
+  }
+}
+
+void AllIsasAndWidths(benchmark::internal::Benchmark* b) {
+  for (Isa isa : {Isa::kScalar, Isa::kNeon, Isa::kAvx2, Isa::kAvx512}) {
+    for (int width : {2, 4, 8}) {
+      b->Args({static_cast<int>(isa), width});
+    }
+  }
+}
+
+BENCHMARK(BM_IbmToIeee)->Apply(AllIsas);
+BENCHMARK(BM_IeeeToIbm)->Apply(AllIsas);
+BENCHMARK(BM_ByteSwap)->Apply(AllIsasAndWidths);
+BENCHMARK(BM_Int16ToFloat)->Apply(AllIsas);
+BENCHMARK(BM_Int32ToFloat)->Apply(AllIsas);
+BENCHMARK(BM_Dequantize)->Apply(AllIsas);
+BENCHMARK(BM_Quantize)->Apply(AllIsas);
+BENCHMARK(BM_AccumulateSquares)->Apply(AllIsas);
+BENCHMARK(BM_AccumulateMax)->Apply(AllIsas);
+
+}  // namespace
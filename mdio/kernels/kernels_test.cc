@@ -0,0 +1,420 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/kernels/kernels.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+using mdio::Index;
+using mdio::kernels::Isa;
+using mdio::kernels::KernelTable;
+
+// Every 32 bit pattern is visited with this stride, plus every exponent and
+// sign with the boundary fractions. A prime stride hits all residues of the
+// low bits.
+constexpr uint64_t kSweepStride = 61;
+// Odd lengths exercise the vector loops and their scalar tails.
+constexpr Index kBlock = (1 << 16) + 13;
+
+std::vector<const KernelTable*> VectorTables() {
+  std::vector<const KernelTable*> tables;
+  for (Isa isa : mdio::kernels::SupportedIsas()) {
+    if (isa != Isa::kScalar) {
+      tables.push_back(mdio::kernels::GetKernelTable(isa).value());
+    }
+  }
+  return tables;
+}
+
+const KernelTable& Reference() {
+  return *mdio::kernels::GetKernelTable(Isa::kScalar).value();
+}
+
+std::string Name(const KernelTable& table) {
+  return std::string(mdio::kernels::IsaName(table.isa));
+}
+
+/// Calls `fn` with blocks of 32 bit patterns covering the sweep.
+template <typename Fn>
+void SweepPatterns(Fn&& fn) {
+  std::vector<uint32_t> block;
+  block.reserve(kBlock);
+  auto flush = [&] {
+    fn(block);
+    block.clear();
+  };
+  for (uint32_t sign = 0; sign < 2; ++sign) {
+    for (uint32_t high = 0; high < 512; ++high) {
+      for (uint32_t low : {0u, 1u, 0x7fffffu, 0x800000u, 0xffffffu,
+                           0x0fffffu, 0x100000u, 0x7ffffeu}) {
+        block.push_back((sign << 31) | (high << 23) | (low & 0x7fffff));
+        block.push_back((sign << 31) | ((high & 0x7f) << 24) | low);
+      }
+    }
+  }
+  flush();
+  for (uint64_t bits = 0; bits <= 0xffffffffu; bits += kSweepStride) {
+    block.push_back(static_cast<uint32_t>(bits));
+    if (static_cast<Index>(block.size()) == kBlock) {
+      flush();
+    }
+  }
+  flush();
+}
+
+TEST(Kernels, isaNames) {
+  for (Isa isa : {Isa::kScalar, Isa::kAvx2, Isa::kAvx512, Isa::kNeon}) {
+    auto parsed = mdio::kernels::ParseIsa(mdio::kernels::IsaName(isa));
+    ASSERT_TRUE(parsed.ok()) << parsed.status();
+    EXPECT_EQ(parsed.value(), isa);
+  }
+  EXPECT_FALSE(mdio::kernels::ParseIsa("sse9").ok());
+}
+
+TEST(Kernels, dispatch) {
+  auto isas = mdio::kernels::SupportedIsas();
+  ASSERT_FALSE(isas.empty());
+  EXPECT_EQ(isas.front(), Isa::kScalar);
+  EXPECT_EQ(mdio::kernels::DetectIsa(), isas.back());
+
+  const Isa initial = mdio::kernels::ActiveIsa();
+  for (Isa isa : isas) {
+    ASSERT_TRUE(mdio::kernels::SetIsa(isa).ok());
+    EXPECT_EQ(mdio::kernels::ActiveIsa(), isa);
+  }
+  for (Isa isa : {Isa::kAvx2, Isa::kAvx512, Isa::kNeon}) {
+    if (!mdio::kernels::IsaSupported(isa)) {
+      auto status = mdio::kernels::SetIsa(isa);
+      EXPECT_EQ(status.code(), absl::StatusCode::kUnimplemented);
+      EXPECT_FALSE(mdio::kernels::GetKernelTable(isa).ok());
+    }
+  }
+  ASSERT_TRUE(mdio::kernels::SetIsa(initial).ok());
+}
+
+TEST(Kernels, ibmReference) {
+  // 0x42640000 is 100.0 and 0xc276a000 is -118.625 in IBM notation.
+  const unsigned char ibm[] = {0x42, 0x64, 0x00, 0x00, 0xc2, 0x76, 0xa0, 0x00,
+                               0x00, 0x00, 0x00, 0x00, 0x41, 0x10, 0x00, 0x00};
+  float ieee[4];
+  mdio::kernels::scalar::IbmToIeee(ibm, ieee, 4);
+  EXPECT_EQ(ieee[0], 100.0f);
+  EXPECT_EQ(ieee[1], -118.625f);
+  EXPECT_EQ(ieee[2], 0.0f);
+  EXPECT_EQ(ieee[3], 1.0f);
+
+  unsigned char back[16];
+  mdio::kernels::scalar::IeeeToIbm(ieee, back, 4);
+  EXPECT_EQ(std::memcmp(ibm, back, sizeof(ibm)), 0);
+
+  const float special[] = {std::numeric_limits<float>::infinity(),
+                           -std::numeric_limits<float>::quiet_NaN(), -0.0f,
+                           std::numeric_limits<float>::denorm_min()};
+  uint32_t out[4];
+  mdio::kernels::scalar::IeeeToIbm(special, out, 4);
+  EXPECT_EQ(out[0], mdio::kernels::scalar::Swap32(0x7fffffffu));
+  EXPECT_EQ(out[1], mdio::kernels::scalar::Swap32(0xffffffffu));
+  EXPECT_EQ(out[2], 0u);
+  // 2^-149 is 0.8 (hex) * 16^-37.
+  EXPECT_EQ(out[3], mdio::kernels::scalar::Swap32(0x1b800000u));
+}
+
+TEST(Kernels, ibmToIeeeMatchesReference) {
+  for (const KernelTable* table : VectorTables()) {
+    Index mismatches = 0;
+    std::vector<float> expected(kBlock);
+    std::vector<float> actual(kBlock);
+    SweepPatterns([&](const std::vector<uint32_t>& block) {
+      const Index n = static_cast<Index>(block.size());
+      Reference().ibmToIeee(block.data(), expected.data(), n);
+      table->ibmToIeee(block.data(), actual.data(), n);
+      for (Index i = 0; i < n; ++i) {
+        mismatches += std::memcmp(&expected[i], &actual[i], sizeof(float)) != 0;
+      }
+    });
+    EXPECT_EQ(mismatches, 0) << Name(*table);
+  }
+}
+
+TEST(Kernels, ieeeToIbmMatchesReference) {
+  for (const KernelTable* table : VectorTables()) {
+    Index mismatches = 0;
+    std::vector<uint32_t> expected(kBlock);
+    std::vector<uint32_t> actual(kBlock);
+    SweepPatterns([&](const std::vector<uint32_t>& block) {
+      const Index n = static_cast<Index>(block.size());
+      const float* src = reinterpret_cast<const float*>(block.data());
+      Reference().ieeeToIbm(src, expected.data(), n);
+      table->ieeeToIbm(src, actual.data(), n);
+      for (Index i = 0; i < n; ++i) {
+        mismatches += expected[i] != actual[i];
+      }
+    });
+    EXPECT_EQ(mismatches, 0) << Name(*table);
+  }
+}
+
+TEST(Kernels, ibmRoundTrip) {
+  // A hex exponent leaves IBM floats at least 21 significant bits.
+  std::vector<float> values = {1.0f,   -1.0f,  0.5f,     8.0f,
+                               15.0f,  100.0f, -118.625f, 1.0e-20f,
+                               1.0e20f, 0.0f};
+  std::vector<uint32_t> ibm(values.size());
+  std::vector<float> back(values.size());
+  mdio::kernels::IeeeToIbm(values.data(), ibm.data(), values.size());
+  mdio::kernels::IbmToIeee(ibm.data(), back.data(), values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_NEAR(back[i], values[i], std::fabs(values[i]) * 1e-6f) << i;
+  }
+}
+
+TEST(Kernels, byteSwapMatchesReference) {
+  std::vector<unsigned char> src(8 * kBlock);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<unsigned char>(i * 131 + (i >> 8));
+  }
+  for (const KernelTable* table : VectorTables()) {
+    for (int width : {2, 4, 8}) {
+      auto expected = src;
+      auto actual = src;
+      // Short lengths around the vector widths, then a long odd one.
+      for (Index n : {Index{0}, Index{1}, Index{3}, Index{7}, Index{15},
+                      Index{16}, Index{31}, Index{33}, Index{65}, kBlock}) {
+        auto swap = [&](const KernelTable& kernels, unsigned char* data) {
+          if (width == 2) kernels.byteSwap16(src.data(), data, n);
+          if (width == 4) kernels.byteSwap32(src.data(), data, n);
+          if (width == 8) kernels.byteSwap64(src.data(), data, n);
+        };
+        swap(Reference(), expected.data());
+        swap(*table, actual.data());
+        EXPECT_EQ(expected, actual) << Name(*table) << " " << width << " " << n;
+      }
+      // In place.
+      table->byteSwap32(actual.data(), actual.data(), 2 * kBlock);
+      Reference().byteSwap32(expected.data(), expected.data(), 2 * kBlock);
+      EXPECT_EQ(expected, actual) << Name(*table) << " in place";
+    }
+  }
+}
+
+TEST(Kernels, byteSwapValues) {
+  const uint16_t a = 0x1234;
+  const uint32_t b = 0x12345678u;
+  const uint64_t c = 0x0123456789abcdefull;
+  uint16_t a2;
+  uint32_t b2;
+  uint64_t c2;
+  mdio::kernels::ByteSwap16(&a, &a2, 1);
+  mdio::kernels::ByteSwap32(&b, &b2, 1);
+  mdio::kernels::ByteSwap64(&c, &c2, 1);
+  EXPECT_EQ(a2, 0x3412);
+  EXPECT_EQ(b2, 0x78563412u);
+  EXPECT_EQ(c2, 0xefcdab8967452301ull);
+}
+
+TEST(Kernels, int16ToFloatExhaustive) {
+  std::vector<uint16_t> all(1 << 16);
+  for (size_t i = 0; i < all.size(); ++i) {
+    all[i] = static_cast<uint16_t>(i);
+  }
+  const Index n = static_cast<Index>(all.size());
+  std::vector<float> expected(n);
+  std::vector<float> actual(n);
+  for (const KernelTable* table : VectorTables()) {
+    for (bool bigEndian : {false, true}) {
+      for (float scale : {1.0f, 0.25f, -3.1f}) {
+        // Offset by one element so the loads are unaligned.
+        Reference().int16ToFloat(all.data() + 1, expected.data(), n - 1,
+                                 scale, bigEndian);
+        table->int16ToFloat(all.data() + 1, actual.data(), n - 1, scale,
+                            bigEndian);
+        EXPECT_EQ(std::memcmp(expected.data(), actual.data(),
+                              (n - 1) * sizeof(float)),
+                  0)
+            << Name(*table) << " " << bigEndian << " " << scale;
+      }
+    }
+  }
+  std::vector<float> samples(2);
+  const unsigned char bigEndian[] = {0xff, 0xfe, 0x01, 0x00};
+  mdio::kernels::Int16ToFloat(bigEndian, samples.data(), 2, 0.5f, true);
+  EXPECT_EQ(samples[0], -1.0f);
+  EXPECT_EQ(samples[1], 128.0f);
+}
+
+TEST(Kernels, int32ToFloatMatchesReference) {
+  for (const KernelTable* table : VectorTables()) {
+    Index mismatches = 0;
+    std::vector<float> expected(kBlock);
+    std::vector<float> actual(kBlock);
+    SweepPatterns([&](const std::vector<uint32_t>& block) {
+      const Index n = static_cast<Index>(block.size());
+      for (bool bigEndian : {false, true}) {
+        Reference().int32ToFloat(block.data(), expected.data(), n, 1e-3f,
+                                 bigEndian);
+        table->int32ToFloat(block.data(), actual.data(), n, 1e-3f, bigEndian);
+        mismatches += std::memcmp(expected.data(), actual.data(),
+                                  n * sizeof(float)) != 0;
+      }
+    });
+    EXPECT_EQ(mismatches, 0) << Name(*table);
+  }
+}
+
+TEST(Kernels, dequantizeExhaustive) {
+  std::vector<float> codes(1 << 16);
+  for (size_t i = 0; i < codes.size(); ++i) {
+    codes[i] = static_cast<float>(static_cast<int>(i) - 32768);
+  }
+  const Index n = static_cast<Index>(codes.size());
+  for (const KernelTable* table : VectorTables()) {
+    for (float scale : {1.0f, 0.001f, -3.75e-5f}) {
+      auto expected = codes;
+      auto actual = codes;
+      Reference().dequantize(expected.data() + 1, n - 1, scale, 12.5f,
+                             -32768.0f);
+      table->dequantize(actual.data() + 1, n - 1, scale, 12.5f, -32768.0f);
+      EXPECT_EQ(std::memcmp(expected.data(), actual.data(), n * sizeof(float)),
+                0)
+          << Name(*table) << " " << scale;
+    }
+  }
+  std::vector<float> values = {-128.0f, 0.0f, 2.0f};
+  mdio::kernels::Dequantize(values.data(), 3, 0.5f, 1.0f, -128.0f);
+  EXPECT_TRUE(std::isnan(values[0]));
+  EXPECT_EQ(values[1], 1.0f);
+  EXPECT_EQ(values[2], 2.0f);
+}
+
+TEST(Kernels, quantizeMatchesReference) {
+  for (const KernelTable* table : VectorTables()) {
+    Index mismatches = 0;
+    Index clampedMismatches = 0;
+    std::vector<float> expected(kBlock);
+    std::vector<float> actual(kBlock);
+    SweepPatterns([&](const std::vector<uint32_t>& block) {
+      const Index n = static_cast<Index>(block.size());
+      const float* src = reinterpret_cast<const float*>(block.data());
+      for (float lo : {-127.0f, -32767.0f}) {
+        Index a = Reference().quantize(src, expected.data(), n, 0.37f, 12.5f,
+                                       lo, -lo);
+        Index b = table->quantize(src, actual.data(), n, 0.37f, 12.5f, lo, -lo);
+        clampedMismatches += a != b;
+        mismatches += std::memcmp(expected.data(), actual.data(),
+                                  n * sizeof(float)) != 0;
+      }
+    });
+    EXPECT_EQ(mismatches, 0) << Name(*table);
+    EXPECT_EQ(clampedMismatches, 0) << Name(*table);
+  }
+  const float values[] = {0.25f, 1.0f, std::nanf(""), 1000.0f, -1000.0f};
+  float codes[5];
+  EXPECT_EQ(mdio::kernels::Quantize(values, codes, 5, 0.5f, 0.0f, -127, 127),
+            2);
+  EXPECT_EQ(codes[0], 0.0f);  // 0.5 rounds to even
+  EXPECT_EQ(codes[1], 2.0f);
+  EXPECT_EQ(codes[2], -128.0f);
+  EXPECT_EQ(codes[3], 127.0f);
+  EXPECT_EQ(codes[4], -127.0f);
+}
+
+TEST(Kernels, reductionsMatchReference) {
+  // Rows of an odd length, accumulated element by element.
+  constexpr Index kRow = 1021;
+  for (const KernelTable* table : VectorTables()) {
+    Index mismatches = 0;
+    SweepPatterns([&](const std::vector<uint32_t>& block) {
+      const float* src = reinterpret_cast<const float*>(block.data());
+      const Index rows = static_cast<Index>(block.size()) / kRow;
+      std::vector<double> sum[2], squares[2], count[2], nonzero[2];
+      std::vector<float> min[2], max[2];
+      std::vector<Index> argmax[2];
+      for (int t = 0; t < 2; ++t) {
+        sum[t].assign(kRow, 0.0);
+        squares[t].assign(kRow, 0.0);
+        count[t].assign(kRow, 0.0);
+        nonzero[t].assign(kRow, 0.0);
+        min[t].assign(kRow, std::numeric_limits<float>::infinity());
+        max[t].assign(kRow, -std::numeric_limits<float>::infinity());
+        argmax[t].assign(kRow, -1);
+        const KernelTable& kernels = t == 0 ? Reference() : *table;
+        for (Index r = 0; r < rows; ++r) {
+          const float* row = src + r * kRow;
+          kernels.accumulateSum(row, sum[t].data(), count[t].data(), kRow);
+          kernels.accumulateSquares(row, squares[t].data(), count[t].data(),
+                                    kRow);
+          kernels.accumulateMin(row, min[t].data(), kRow);
+          kernels.accumulateMax(row, max[t].data(), argmax[t].data(), r,
+                                kRow);
+          kernels.countNonzero(row, nonzero[t].data(), kRow);
+        }
+      }
+      auto differ = [](const auto& a, const auto& b) {
+        return std::memcmp(a.data(), b.data(),
+                           a.size() * sizeof(a.front())) != 0;
+      };
+      mismatches += differ(sum[0], sum[1]) + differ(squares[0], squares[1]) +
+                    differ(count[0], count[1]) + differ(min[0], min[1]) +
+                    differ(max[0], max[1]) + differ(argmax[0], argmax[1]) +
+                    differ(nonzero[0], nonzero[1]);
+    });
+    EXPECT_EQ(mismatches, 0) << Name(*table);
+  }
+}
+
+TEST(Kernels, reductionValues) {
+  const float rows[3][3] = {{1.0f, std::nanf(""), 0.0f},
+                            {-2.0f, 4.0f, 0.0f},
+                            {3.0f, 4.0f, std::nanf("")}};
+  double sum[3] = {}, squares[3] = {}, count[3] = {}, nonzero[3] = {};
+  float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  float min[3] = {INFINITY, INFINITY, INFINITY};
+  Index argmax[3] = {-1, -1, -1};
+  double ignored[3] = {};
+  for (Index r = 0; r < 3; ++r) {
+    mdio::kernels::AccumulateSum(rows[r], sum, count, 3);
+    mdio::kernels::AccumulateSquares(rows[r], squares, ignored, 3);
+    mdio::kernels::AccumulateMin(rows[r], min, 3);
+    mdio::kernels::AccumulateMax(rows[r], max, argmax, r, 3);
+    mdio::kernels::CountNonzero(rows[r], nonzero, 3);
+  }
+  EXPECT_EQ(sum[0], 2.0);
+  EXPECT_EQ(sum[1], 8.0);
+  EXPECT_EQ(sum[2], 0.0);
+  EXPECT_EQ(count[0], 3.0);
+  EXPECT_EQ(count[1], 2.0);
+  EXPECT_EQ(count[2], 2.0);
+  EXPECT_EQ(squares[0], 14.0);
+  EXPECT_EQ(min[0], -2.0f);
+  EXPECT_EQ(max[0], 3.0f);
+  EXPECT_EQ(argmax[0], 2);
+  // Ties keep the first position.
+  EXPECT_EQ(argmax[1], 1);
+  EXPECT_EQ(argmax[2], 0);
+  EXPECT_EQ(nonzero[0], 3.0);
+  EXPECT_EQ(nonzero[1], 2.0);
+  EXPECT_EQ(nonzero[2], 0.0);
+}
+
+}  // namespace
@@ -0,0 +1,327 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_KERNELS_NEON_H_
+#define MDIO_KERNELS_NEON_H_
+
+#include <cstdint>
+#include <limits>
+
+#include "mdio/kernels/scalar.h"
+
+// NEON (Advanced SIMD) is part of the AArch64 baseline, so these kernels need
+// no target attributes or runtime checks.
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define MDIO_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifdef MDIO_KERNELS_NEON
+
+namespace mdio {
+namespace kernels {
+namespace neon {
+
+/**
+ * @brief Scales two IBM fractions by their exponents in double precision,
+ * exactly like the scalar kernel.
+ */
+inline float64x2_t IbmMagnitudeNeon(uint32x2_t fraction,
+                                    uint32x2_t scaleExponent) {
+  float64x2_t scale =
+      vreinterpretq_f64_u64(vshlq_n_u64(vmovl_u32(scaleExponent), 52));
+  return vmulq_f64(vcvtq_f64_u64(vmovl_u32(fraction)), scale);
+}
+
+inline void IbmToIeee(const void* src, float* dst, Index n) {
+  const char* in = static_cast<const char*>(src);
+  const uint32x4_t fractionMask = vdupq_n_u32(0x00ffffff);
+  const uint32x4_t exponentMask = vdupq_n_u32(0x7f);
+  const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+  // The biased double exponent of 2^(4 * (exponent - 64) - 24).
+  const uint32x4_t bias = vdupq_n_u32(1023 - 24 - 256);
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t ibm = vreinterpretq_u32_u8(
+        vrev32q_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(in + 4 * i))));
+    uint32x4_t fraction = vandq_u32(ibm, fractionMask);
+    uint32x4_t scaleExponent = vaddq_u32(
+        vshlq_n_u32(vandq_u32(vshrq_n_u32(ibm, 24), exponentMask), 2), bias);
+    float32x2_t lo = vcvt_f32_f64(IbmMagnitudeNeon(
+        vget_low_u32(fraction), vget_low_u32(scaleExponent)));
+    float32x4_t magnitude = vcvt_high_f32_f64(
+        lo, IbmMagnitudeNeon(vget_high_u32(fraction),
+                             vget_high_u32(scaleExponent)));
+    uint32x4_t result = vorrq_u32(vreinterpretq_u32_f32(magnitude),
+                                  vandq_u32(ibm, signMask));
+    vst1q_f32(dst + i, vreinterpretq_f32_u32(result));
+  }
+  scalar::IbmToIeee(in + 4 * i, dst + i, n - i);
+}
+
+inline void IeeeToIbm(const float* src, void* dst, Index n) {
+  char* out = static_cast<char*>(dst);
+  const uint32x4_t signMask = vdupq_n_u32(0x80000000u);
+  const uint32x4_t absMask = vdupq_n_u32(0x7fffffff);
+  const uint32x4_t zero = vdupq_n_u32(0);
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint32x4_t bits = vreinterpretq_u32_f32(vld1q_f32(src + i));
+    uint32x4_t sign = vandq_u32(bits, signMask);
+    uint32x4_t magnitude = vandq_u32(bits, absMask);
+    uint32x4_t exponent = vshrq_n_u32(magnitude, 23);
+    // Denormals are normalized exactly by scaling them by 2^24.
+    uint32x4_t denormal = vceqq_u32(exponent, zero);
+    uint32x4_t scaled = vreinterpretq_u32_f32(
+        vmulq_n_f32(vreinterpretq_f32_u32(magnitude), 16777216.0f));
+    uint32x4_t normal = vbslq_u32(denormal, scaled, magnitude);
+    uint32x4_t mantissa = vorrq_u32(vandq_u32(normal, vdupq_n_u32(0x7fffff)),
+                                    vdupq_n_u32(0x800000));
+    int32x4_t t = vsubq_s32(
+        vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(normal, 23)),
+                  vdupq_n_s32(126)),
+        vreinterpretq_s32_u32(vandq_u32(denormal, vdupq_n_u32(24))));
+    int32x4_t q = vshrq_n_s32(vaddq_s32(t, vdupq_n_s32(3)), 2);
+    int32x4_t shift = vsubq_s32(vshlq_n_s32(q, 2), t);
+    uint32x4_t half = vshrq_n_u32(vshlq_u32(vdupq_n_u32(1), shift), 1);
+    uint32x4_t fraction =
+        vshlq_u32(vaddq_u32(mantissa, half), vnegq_s32(shift));
+    uint32x4_t carry = vcgtq_u32(fraction, vdupq_n_u32(0xffffff));
+    fraction = vbslq_u32(carry, vshrq_n_u32(fraction, 4), fraction);
+    int32x4_t ibmExponent = vaddq_s32(
+        vsubq_s32(q, vreinterpretq_s32_u32(carry)), vdupq_n_s32(64));
+    uint32x4_t ibm = vorrq_u32(
+        vorrq_u32(sign, vshlq_n_u32(vreinterpretq_u32_s32(ibmExponent), 24)),
+        fraction);
+    uint32x4_t overflow =
+        vorrq_u32(vcgtq_s32(ibmExponent, vdupq_n_s32(127)),
+                  vceqq_u32(exponent, vdupq_n_u32(0xff)));
+    uint32x4_t underflow = vcltq_s32(ibmExponent, vdupq_n_s32(0));
+    ibm = vbslq_u32(underflow, sign, ibm);
+    ibm = vbslq_u32(overflow, vorrq_u32(sign, absMask), ibm);
+    ibm = vbslq_u32(vceqq_u32(magnitude, zero), zero, ibm);
+    vst1q_u8(reinterpret_cast<uint8_t*>(out + 4 * i),
+             vrev32q_u8(vreinterpretq_u8_u32(ibm)));
+  }
+  scalar::IeeeToIbm(src + i, out + 4 * i, n - i);
+}
+
+inline void ByteSwap16(const void* src, void* dst, Index n) {
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  Index b = 0;
+  for (; b + 16 <= 2 * n; b += 16) {
+    vst1q_u8(out + b, vrev16q_u8(vld1q_u8(in + b)));
+  }
+  scalar::ByteSwap16(in + b, out + b, n - b / 2);
+}
+
+inline void ByteSwap32(const void* src, void* dst, Index n) {
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  Index b = 0;
+  for (; b + 16 <= 4 * n; b += 16) {
+    vst1q_u8(out + b, vrev32q_u8(vld1q_u8(in + b)));
+  }
+  scalar::ByteSwap32(in + b, out + b, n - b / 4);
+}
+
+inline void ByteSwap64(const void* src, void* dst, Index n) {
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  uint8_t* out = static_cast<uint8_t*>(dst);
+  Index b = 0;
+  for (; b + 16 <= 8 * n; b += 16) {
+    vst1q_u8(out + b, vrev64q_u8(vld1q_u8(in + b)));
+  }
+  scalar::ByteSwap64(in + b, out + b, n - b / 8);
+}
+
+inline void Int16ToFloat(const void* src, float* dst, Index n, float scale,
+                         bool bigEndian) {
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint8x16_t raw = vld1q_u8(in + 2 * i);
+    if (bigEndian) {
+      raw = vrev16q_u8(raw);
+    }
+    int16x8_t v = vreinterpretq_s16_u8(raw);
+    float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+    float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+    vst1q_f32(dst + i, vmulq_n_f32(lo, scale));
+    vst1q_f32(dst + i + 4, vmulq_n_f32(hi, scale));
+  }
+  scalar::Int16ToFloat(in + 2 * i, dst + i, n - i, scale, bigEndian);
+}
+
+inline void Int32ToFloat(const void* src, float* dst, Index n, float scale,
+                         bool bigEndian) {
+  const uint8_t* in = static_cast<const uint8_t*>(src);
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint8x16_t raw = vld1q_u8(in + 4 * i);
+    if (bigEndian) {
+      raw = vrev32q_u8(raw);
+    }
+    float32x4_t f = vcvtq_f32_s32(vreinterpretq_s32_u8(raw));
+    vst1q_f32(dst + i, vmulq_n_f32(f, scale));
+  }
+  scalar::Int32ToFloat(in + 4 * i, dst + i, n - i, scale, bigEndian);
+}
+
+inline float64x2_t DequantizeNeon(float64x2_t codes, float64x2_t factor,
+                                  float64x2_t shift) {
+  // The product is exact, so fusing it with the addition changes nothing.
+  return vaddq_f64(vmulq_f64(codes, factor), shift);
+}
+
+inline void Dequantize(float* values, Index n, float scale, float offset,
+                       float fill) {
+  const float64x2_t factor = vdupq_n_f64(scale);
+  const float64x2_t shift = vdupq_n_f64(offset);
+  const float32x4_t fillCode = vdupq_n_f32(fill);
+  const float32x4_t nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t codes = vld1q_f32(values + i);
+    float32x2_t lo = vcvt_f32_f64(
+        DequantizeNeon(vcvt_f64_f32(vget_low_f32(codes)), factor, shift));
+    float32x4_t result = vcvt_high_f32_f64(
+        lo, DequantizeNeon(vcvt_high_f64_f32(codes), factor, shift));
+    vst1q_f32(values + i,
+              vbslq_f32(vceqq_f32(codes, fillCode), nan, result));
+  }
+  scalar::Dequantize(values + i, n - i, scale, offset, fill);
+}
+
+inline float64x2_t QuantizeNeon(float64x2_t values, float64x2_t inverse,
+                                float64x2_t shift, float64x2_t low,
+                                float64x2_t high, Index* clamped) {
+  float64x2_t q = vrndnq_f64(vmulq_f64(vsubq_f64(values, shift), inverse));
+  uint64x2_t outside = vorrq_u64(vcltq_f64(q, low), vcgtq_f64(q, high));
+  *clamped += static_cast<Index>(vaddvq_u64(vshrq_n_u64(outside, 63)));
+  return vminq_f64(vmaxq_f64(q, low), high);
+}
+
+inline Index Quantize(const float* src, float* codes, Index n, float scale,
+                      float offset, float lo, float hi) {
+  const float64x2_t inverse = vdupq_n_f64(1.0 / static_cast<double>(scale));
+  const float64x2_t shift = vdupq_n_f64(offset);
+  const float64x2_t low = vdupq_n_f64(lo);
+  const float64x2_t high = vdupq_n_f64(hi);
+  const float32x4_t fillCode = vdupq_n_f32(lo - 1);
+  Index clamped = 0;
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t values = vld1q_f32(src + i);
+    float32x2_t first =
+        vcvt_f32_f64(QuantizeNeon(vcvt_f64_f32(vget_low_f32(values)),
+                                  inverse, shift, low, high, &clamped));
+    float32x4_t result = vcvt_high_f32_f64(
+        first, QuantizeNeon(vcvt_high_f64_f32(values), inverse, shift, low,
+                            high, &clamped));
+    vst1q_f32(codes + i,
+              vbslq_f32(vceqq_f32(values, values), result, fillCode));
+  }
+  return clamped +
+         scalar::Quantize(src + i, codes + i, n - i, scale, offset, lo, hi);
+}
+
+// Two samples as double, zero where they are NaN. `valid` is one where they
+// are not.
+inline float64x2_t ValidNeon(float64x2_t v, float64x2_t* valid) {
+  uint64x2_t ordered = vceqq_f64(v, v);
+  *valid = vreinterpretq_f64_u64(
+      vandq_u64(ordered, vreinterpretq_u64_f64(vdupq_n_f64(1.0))));
+  return vreinterpretq_f64_u64(vandq_u64(ordered, vreinterpretq_u64_f64(v)));
+}
+
+inline void AccumulateSum(const float* src, double* sum, double* count,
+                          Index n) {
+  Index i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t valid;
+    float64x2_t v = ValidNeon(vcvt_f64_f32(vld1_f32(src + i)), &valid);
+    vst1q_f64(sum + i, vaddq_f64(vld1q_f64(sum + i), v));
+    vst1q_f64(count + i, vaddq_f64(vld1q_f64(count + i), valid));
+  }
+  scalar::AccumulateSum(src + i, sum + i, count + i, n - i);
+}
+
+inline void AccumulateSquares(const float* src, double* sum, double* count,
+                              Index n) {
+  Index i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t valid;
+    float64x2_t v = ValidNeon(vcvt_f64_f32(vld1_f32(src + i)), &valid);
+    // The square is exact, so fusing it with the addition changes nothing.
+    vst1q_f64(sum + i, vaddq_f64(vld1q_f64(sum + i), vmulq_f64(v, v)));
+    vst1q_f64(count + i, vaddq_f64(vld1q_f64(count + i), valid));
+  }
+  scalar::AccumulateSquares(src + i, sum + i, count + i, n - i);
+}
+
+inline void AccumulateMin(const float* src, float* min, Index n) {
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vld1q_f32(src + i);
+    float32x4_t m = vld1q_f32(min + i);
+    vst1q_f32(min + i, vbslq_f32(vcltq_f32(v, m), v, m));
+  }
+  scalar::AccumulateMin(src + i, min + i, n - i);
+}
+
+inline void AccumulateMax(const float* src, float* max, Index* argmax,
+                          Index position, Index n) {
+  const int64x2_t where = vdupq_n_s64(position);
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t v = vld1q_f32(src + i);
+    float32x4_t m = vld1q_f32(max + i);
+    uint32x4_t greater = vcgtq_f32(v, m);
+    vst1q_f32(max + i, vbslq_f32(greater, v, m));
+    // Widen the mask to the 64 bit positions, two at a time.
+    uint64x2_t lo = vreinterpretq_u64_s64(
+        vmovl_s32(vreinterpret_s32_u32(vget_low_u32(greater))));
+    uint64x2_t hi = vreinterpretq_u64_s64(
+        vmovl_s32(vreinterpret_s32_u32(vget_high_u32(greater))));
+    auto* index = reinterpret_cast<int64_t*>(argmax + i);
+    vst1q_s64(index, vbslq_s64(lo, where, vld1q_s64(index)));
+    vst1q_s64(index + 2, vbslq_s64(hi, where, vld1q_s64(index + 2)));
+  }
+  scalar::AccumulateMax(src + i, max + i, argmax + i, position, n - i);
+}
+
+inline void CountNonzero(const float* src, double* count, Index n) {
+  const float64x2_t one = vdupq_n_f64(1.0);
+  Index i = 0;
+  for (; i + 2 <= n; i += 2) {
+    float64x2_t v = vcvt_f64_f32(vld1_f32(src + i));
+    // Neither zero nor NaN: |v| > 0.
+    uint64x2_t nonzero = vcgtq_f64(vabsq_f64(v), vdupq_n_f64(0.0));
+    vst1q_f64(count + i,
+              vaddq_f64(vld1q_f64(count + i),
+                        vreinterpretq_f64_u64(vandq_u64(
+                            nonzero, vreinterpretq_u64_f64(one)))));
+  }
+  scalar::CountNonzero(src + i, count + i, n - i);
+}
+
+}  // namespace neon
+}  // namespace kernels
+}  // namespace mdio
+
+#endif  // MDIO_KERNELS_NEON
+
+#endif  // MDIO_KERNELS_NEON_H_
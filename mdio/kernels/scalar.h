@@ -0,0 +1,290 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_KERNELS_SCALAR_H_
+#define MDIO_KERNELS_SCALAR_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "mdio/impl.h"
+
+namespace mdio {
+namespace kernels {
+// The reference implementations of the conversion kernels. Every vectorized
+// kernel must produce output bit-identical to these.
+namespace scalar {
+
+inline uint16_t Swap16(uint16_t v) {
+  return static_cast<uint16_t>((v >> 8) | (v << 8));
+}
+
+inline uint32_t Swap32(uint32_t v) {
+  return (v >> 24) | ((v >> 8) & 0x0000ff00u) | ((v << 8) & 0x00ff0000u) |
+         (v << 24);
+}
+
+inline uint64_t Swap64(uint64_t v) {
+  return (static_cast<uint64_t>(Swap32(static_cast<uint32_t>(v))) << 32) |
+         Swap32(static_cast<uint32_t>(v >> 32));
+}
+
+/**
+ * @brief Converts big-endian IBM System/360 floats to IEEE float32.
+ * Values beyond the float32 range become +/-inf; the result is correctly
+ * rounded.
+ */
+inline void IbmToIeee(const void* src, float* dst, Index n) {
+  const char* in = static_cast<const char*>(src);
+  for (Index i = 0; i < n; ++i) {
+    uint32_t ibm;
+    std::memcpy(&ibm, in + 4 * i, sizeof(ibm));
+    ibm = Swap32(ibm);
+    uint32_t sign = ibm >> 31;
+    int32_t exponent = static_cast<int32_t>((ibm >> 24) & 0x7f);
+    uint32_t fraction = ibm & 0x00ffffff;
+    // value = fraction * 2^(4 * (exponent - 64) - 24), exact in double.
+    uint64_t scaleBits =
+        static_cast<uint64_t>(4 * (exponent - 64) - 24 + 1023) << 52;
+    double scale;
+    std::memcpy(&scale, &scaleBits, sizeof(scale));
+    float magnitude = static_cast<float>(static_cast<double>(fraction) * scale);
+    dst[i] = sign ? -magnitude : magnitude;
+  }
+}
+
+/**
+ * @brief Converts IEEE float32 to big-endian IBM System/360 floats.
+ * The fraction is rounded to nearest. NaN and inf saturate to the largest
+ * IBM magnitude and both zeros become +0.
+ */
+inline void IeeeToIbm(const float* src, void* dst, Index n) {
+  char* out = static_cast<char*>(dst);
+  for (Index i = 0; i < n; ++i) {
+    uint32_t bits;
+    std::memcpy(&bits, &src[i], sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xff);
+    uint32_t mantissa = bits & 0x007fffff;
+    uint32_t ibm = 0;
+    if (exponent == 0xff) {
+      ibm = sign | 0x7fffffffu;
+    } else if (exponent != 0 || mantissa != 0) {
+      if (exponent == 0) {
+        // Normalize denormals.
+        exponent = 1;
+        while (!(mantissa & 0x00800000u)) {
+          mantissa <<= 1;
+          --exponent;
+        }
+      } else {
+        mantissa |= 0x00800000u;
+      }
+      // value = (mantissa / 2^24) * 2^t with mantissa / 2^24 in [0.5, 1)
+      int32_t t = exponent - 126;
+      int32_t q = t >= 0 ? (t + 3) / 4 : -((-t) / 4);
+      int32_t shift = 4 * q - t;
+      uint64_t fraction = mantissa;
+      if (shift > 0) {
+        fraction = (fraction + (uint64_t{1} << (shift - 1))) >> shift;
+      }
+      if (fraction >= (uint64_t{1} << 24)) {
+        fraction >>= 4;
+        ++q;
+      }
+      int32_t ibmExponent = q + 64;
+      if (ibmExponent > 127) {
+        ibm = sign | 0x7fffffffu;
+      } else if (ibmExponent < 0) {
+        ibm = sign;
+      } else {
+        ibm = sign | (static_cast<uint32_t>(ibmExponent) << 24) |
+              static_cast<uint32_t>(fraction);
+      }
+    }
+    ibm = Swap32(ibm);
+    std::memcpy(out + 4 * i, &ibm, sizeof(ibm));
+  }
+}
+
+/// Reverses the bytes of `n` 16 bit words. `src` and `dst` may alias.
+inline void ByteSwap16(const void* src, void* dst, Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  for (Index i = 0; i < n; ++i) {
+    uint16_t v;
+    std::memcpy(&v, in + 2 * i, sizeof(v));
+    v = Swap16(v);
+    std::memcpy(out + 2 * i, &v, sizeof(v));
+  }
+}
+
+/// Reverses the bytes of `n` 32 bit words. `src` and `dst` may alias.
+inline void ByteSwap32(const void* src, void* dst, Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  for (Index i = 0; i < n; ++i) {
+    uint32_t v;
+    std::memcpy(&v, in + 4 * i, sizeof(v));
+    v = Swap32(v);
+    std::memcpy(out + 4 * i, &v, sizeof(v));
+  }
+}
+
+/// Reverses the bytes of `n` 64 bit words. `src` and `dst` may alias.
+inline void ByteSwap64(const void* src, void* dst, Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  for (Index i = 0; i < n; ++i) {
+    uint64_t v;
+    std::memcpy(&v, in + 8 * i, sizeof(v));
+    v = Swap64(v);
+    std::memcpy(out + 8 * i, &v, sizeof(v));
+  }
+}
+
+/**
+ * @brief Converts int16 samples to float32 and multiplies them by `scale`.
+ * @param bigEndian Whether the samples are stored big-endian.
+ */
+inline void Int16ToFloat(const void* src, float* dst, Index n, float scale,
+                         bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  for (Index i = 0; i < n; ++i) {
+    uint16_t v;
+    std::memcpy(&v, in + 2 * i, sizeof(v));
+    if (bigEndian) {
+      v = Swap16(v);
+    }
+    dst[i] = static_cast<float>(static_cast<int16_t>(v)) * scale;
+  }
+}
+
+/**
+ * @brief Converts int32 samples to float32 and multiplies them by `scale`.
+ * The conversion rounds to nearest before scaling.
+ * @param bigEndian Whether the samples are stored big-endian.
+ */
+inline void Int32ToFloat(const void* src, float* dst, Index n, float scale,
+                         bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  for (Index i = 0; i < n; ++i) {
+    uint32_t v;
+    std::memcpy(&v, in + 4 * i, sizeof(v));
+    if (bigEndian) {
+      v = Swap32(v);
+    }
+    dst[i] = static_cast<float>(static_cast<int32_t>(v)) * scale;
+  }
+}
+
+/**
+ * @brief Dequantizes integer codes held as float32, in place.
+ * value = code * scale + offset, evaluated in double. Products of 16 bit
+ * codes and float32 scales are exact there, so the result does not depend on
+ * whether the compiler fuses the multiply and add. Codes equal to `fill`
+ * become NaN.
+ */
+inline void Dequantize(float* values, Index n, float scale, float offset,
+                       float fill) {
+  for (Index i = 0; i < n; ++i) {
+    float v = static_cast<float>(static_cast<double>(values[i]) * scale +
+                                 static_cast<double>(offset));
+    values[i] = values[i] == fill ? std::numeric_limits<float>::quiet_NaN() : v;
+  }
+}
+
+/**
+ * @brief Quantizes float32 values to integer codes held as float32.
+ * code = round((value - offset) / scale), rounded to nearest even and clamped
+ * to [lo, hi]. NaN becomes `lo - 1`, the fill code.
+ * @return The number of values that had to be clamped.
+ */
+inline Index Quantize(const float* src, float* codes, Index n, float scale,
+                      float offset, float lo, float hi) {
+  const double inverse = 1.0 / static_cast<double>(scale);
+  Index clamped = 0;
+  for (Index i = 0; i < n; ++i) {
+    double q = std::nearbyint(
+        (static_cast<double>(src[i]) - static_cast<double>(offset)) * inverse);
+    clamped += (q < lo) | (q > hi);
+    q = q < lo ? lo : (q > hi ? hi : q);
+    codes[i] = std::isnan(src[i]) ? lo - 1 : static_cast<float>(q);
+  }
+  return clamped;
+}
+
+/**
+ * @brief Adds a row of samples to running sums, element by element.
+ * NaN samples are skipped; `count` counts the others.
+ */
+inline void AccumulateSum(const float* src, double* sum, double* count,
+                          Index n) {
+  for (Index i = 0; i < n; ++i) {
+    bool valid = src[i] == src[i];
+    sum[i] += valid ? static_cast<double>(src[i]) : 0.0;
+    count[i] += valid ? 1.0 : 0.0;
+  }
+}
+
+/**
+ * @brief Adds the squares of a row of samples to running sums.
+ * The squares are exact in double. NaN samples are skipped; `count` counts
+ * the others.
+ */
+inline void AccumulateSquares(const float* src, double* sum, double* count,
+                              Index n) {
+  for (Index i = 0; i < n; ++i) {
+    bool valid = src[i] == src[i];
+    double v = valid ? static_cast<double>(src[i]) : 0.0;
+    sum[i] += v * v;
+    count[i] += valid ? 1.0 : 0.0;
+  }
+}
+
+/// Lowers running minima to a row of samples. NaN samples are skipped.
+inline void AccumulateMin(const float* src, float* min, Index n) {
+  for (Index i = 0; i < n; ++i) {
+    min[i] = src[i] < min[i] ? src[i] : min[i];
+  }
+}
+
+/**
+ * @brief Raises running maxima to a row of samples, recording `position`
+ * where a sample is the new maximum. NaN samples are skipped and ties keep
+ * the first position.
+ */
+inline void AccumulateMax(const float* src, float* max, Index* argmax,
+                          Index position, Index n) {
+  for (Index i = 0; i < n; ++i) {
+    bool greater = src[i] > max[i];
+    max[i] = greater ? src[i] : max[i];
+    argmax[i] = greater ? position : argmax[i];
+  }
+}
+
+/// Counts the samples of a row that are neither zero nor NaN.
+inline void CountNonzero(const float* src, double* count, Index n) {
+  for (Index i = 0; i < n; ++i) {
+    count[i] += (src[i] != 0.0f && src[i] == src[i]) ? 1.0 : 0.0;
+  }
+}
+
+}  // namespace scalar
+}  // namespace kernels
+}  // namespace mdio
+
+#endif  // MDIO_KERNELS_SCALAR_H_
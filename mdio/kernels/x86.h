@@ -0,0 +1,565 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_KERNELS_X86_H_
+#define MDIO_KERNELS_X86_H_
+
+#include <limits>
+
+#include "mdio/kernels/scalar.h"
+
+// The AVX2 and AVX-512 kernels are compiled with per-function target
+// attributes so the rest of the library keeps the baseline instruction set.
+// They must only be called after the dispatcher has checked the CPU.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MDIO_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef MDIO_KERNELS_X86
+
+#define MDIO_TARGET_AVX2 __attribute__((target("avx2")))
+#define MDIO_TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+
+namespace mdio {
+namespace kernels {
+namespace x86 {
+
+// Byte shuffles reversing each 16, 32 or 64 bit word of a 128 bit lane.
+#define MDIO_SWAP16_BYTES \
+  1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+#define MDIO_SWAP32_BYTES \
+  3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#define MDIO_SWAP64_BYTES \
+  7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+
+MDIO_TARGET_AVX2 inline __m256i Swap16Mask256() {
+  return _mm256_setr_epi8(MDIO_SWAP16_BYTES, MDIO_SWAP16_BYTES);
+}
+
+MDIO_TARGET_AVX2 inline __m256i Swap32Mask256() {
+  return _mm256_setr_epi8(MDIO_SWAP32_BYTES, MDIO_SWAP32_BYTES);
+}
+
+MDIO_TARGET_AVX2 inline __m256i Swap64Mask256() {
+  return _mm256_setr_epi8(MDIO_SWAP64_BYTES, MDIO_SWAP64_BYTES);
+}
+
+MDIO_TARGET_AVX512 inline __m512i Swap16Mask512() {
+  return _mm512_broadcast_i32x4(_mm_setr_epi8(MDIO_SWAP16_BYTES));
+}
+
+MDIO_TARGET_AVX512 inline __m512i Swap32Mask512() {
+  return _mm512_broadcast_i32x4(_mm_setr_epi8(MDIO_SWAP32_BYTES));
+}
+
+MDIO_TARGET_AVX512 inline __m512i Swap64Mask512() {
+  return _mm512_broadcast_i32x4(_mm_setr_epi8(MDIO_SWAP64_BYTES));
+}
+
+#undef MDIO_SWAP16_BYTES
+#undef MDIO_SWAP32_BYTES
+#undef MDIO_SWAP64_BYTES
+
+// ---------------------------------------------------------------------------
+// AVX2
+// ---------------------------------------------------------------------------
+
+/**
+ * @brief Scales four IBM fractions by their exponents in double precision
+ * and rounds them to float, exactly like the scalar kernel.
+ */
+MDIO_TARGET_AVX2 inline __m128 IbmMagnitudeAvx2(__m128i fraction,
+                                                __m128i scaleExponent) {
+  __m256d scale = _mm256_castsi256_pd(
+      _mm256_slli_epi64(_mm256_cvtepu32_epi64(scaleExponent), 52));
+  return _mm256_cvtpd_ps(_mm256_mul_pd(_mm256_cvtepi32_pd(fraction), scale));
+}
+
+MDIO_TARGET_AVX2 inline void IbmToIeeeAvx2(const void* src, float* dst,
+                                           Index n) {
+  const char* in = static_cast<const char*>(src);
+  const __m256i swap = Swap32Mask256();
+  const __m256i fractionMask = _mm256_set1_epi32(0x00ffffff);
+  const __m256i exponentMask = _mm256_set1_epi32(0x7f);
+  const __m256i signMask = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+  // The biased double exponent of 2^(4 * (exponent - 64) - 24).
+  const __m256i bias = _mm256_set1_epi32(1023 - 24 - 256);
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i ibm = _mm256_shuffle_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * i)),
+        swap);
+    __m256i fraction = _mm256_and_si256(ibm, fractionMask);
+    __m256i exponent =
+        _mm256_and_si256(_mm256_srli_epi32(ibm, 24), exponentMask);
+    __m256i scaleExponent =
+        _mm256_add_epi32(_mm256_slli_epi32(exponent, 2), bias);
+    __m128 lo = IbmMagnitudeAvx2(_mm256_castsi256_si128(fraction),
+                                 _mm256_castsi256_si128(scaleExponent));
+    __m128 hi = IbmMagnitudeAvx2(_mm256_extracti128_si256(fraction, 1),
+                                 _mm256_extracti128_si256(scaleExponent, 1));
+    __m256 magnitude = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    __m256 sign = _mm256_castsi256_ps(_mm256_and_si256(ibm, signMask));
+    _mm256_storeu_ps(dst + i, _mm256_or_ps(magnitude, sign));
+  }
+  scalar::IbmToIeee(in + 4 * i, dst + i, n - i);
+}
+
+MDIO_TARGET_AVX2 inline void IeeeToIbmAvx2(const float* src, void* dst,
+                                           Index n) {
+  char* out = static_cast<char*>(dst);
+  const __m256i swap = Swap32Mask256();
+  const __m256i signMask = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+  const __m256i absMask = _mm256_set1_epi32(0x7fffffff);
+  const __m256i mantissaMask = _mm256_set1_epi32(0x007fffff);
+  const __m256i hiddenBit = _mm256_set1_epi32(0x00800000);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i zero = _mm256_setzero_si256();
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i bits =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    __m256i sign = _mm256_and_si256(bits, signMask);
+    __m256i magnitude = _mm256_and_si256(bits, absMask);
+    __m256i exponent = _mm256_srli_epi32(magnitude, 23);
+    // Denormals are normalized exactly by scaling them by 2^24.
+    __m256i denormal = _mm256_cmpeq_epi32(exponent, zero);
+    __m256i scaled = _mm256_castps_si256(_mm256_mul_ps(
+        _mm256_castsi256_ps(magnitude), _mm256_set1_ps(16777216.0f)));
+    __m256i normal = _mm256_blendv_epi8(magnitude, scaled, denormal);
+    __m256i mantissa = _mm256_or_si256(
+        _mm256_and_si256(normal, mantissaMask), hiddenBit);
+    __m256i t = _mm256_sub_epi32(
+        _mm256_sub_epi32(_mm256_srli_epi32(normal, 23),
+                         _mm256_set1_epi32(126)),
+        _mm256_and_si256(denormal, _mm256_set1_epi32(24)));
+    __m256i q = _mm256_srai_epi32(_mm256_add_epi32(t, _mm256_set1_epi32(3)), 2);
+    __m256i shift = _mm256_sub_epi32(_mm256_slli_epi32(q, 2), t);
+    __m256i half = _mm256_srli_epi32(_mm256_sllv_epi32(one, shift), 1);
+    __m256i fraction =
+        _mm256_srlv_epi32(_mm256_add_epi32(mantissa, half), shift);
+    __m256i carry = _mm256_cmpgt_epi32(fraction, _mm256_set1_epi32(0xffffff));
+    fraction = _mm256_blendv_epi8(fraction, _mm256_srli_epi32(fraction, 4),
+                                  carry);
+    __m256i ibmExponent =
+        _mm256_add_epi32(_mm256_sub_epi32(q, carry), _mm256_set1_epi32(64));
+    __m256i ibm = _mm256_or_si256(
+        _mm256_or_si256(sign, _mm256_slli_epi32(ibmExponent, 24)), fraction);
+    __m256i overflow = _mm256_or_si256(
+        _mm256_cmpgt_epi32(ibmExponent, _mm256_set1_epi32(127)),
+        _mm256_cmpeq_epi32(exponent, _mm256_set1_epi32(0xff)));
+    __m256i underflow = _mm256_cmpgt_epi32(zero, ibmExponent);
+    ibm = _mm256_blendv_epi8(ibm, sign, underflow);
+    ibm = _mm256_blendv_epi8(ibm, _mm256_or_si256(sign, absMask), overflow);
+    ibm = _mm256_andnot_si256(_mm256_cmpeq_epi32(magnitude, zero), ibm);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * i),
+                        _mm256_shuffle_epi8(ibm, swap));
+  }
+  scalar::IeeeToIbm(src + i, out + 4 * i, n - i);
+}
+
+/// Reverses the bytes of each word in 32 byte blocks.
+MDIO_TARGET_AVX2 inline Index ByteSwapBlocksAvx2(const char* in, char* out,
+                                                 Index bytes, __m256i mask) {
+  Index b = 0;
+  for (; b + 32 <= bytes; b += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + b),
+                        _mm256_shuffle_epi8(v, mask));
+  }
+  return b;
+}
+
+MDIO_TARGET_AVX2 inline void ByteSwap16Avx2(const void* src, void* dst,
+                                            Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx2(in, out, 2 * n, Swap16Mask256());
+  scalar::ByteSwap16(in + done, out + done, n - done / 2);
+}
+
+MDIO_TARGET_AVX2 inline void ByteSwap32Avx2(const void* src, void* dst,
+                                            Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx2(in, out, 4 * n, Swap32Mask256());
+  scalar::ByteSwap32(in + done, out + done, n - done / 4);
+}
+
+MDIO_TARGET_AVX2 inline void ByteSwap64Avx2(const void* src, void* dst,
+                                            Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx2(in, out, 8 * n, Swap64Mask256());
+  scalar::ByteSwap64(in + done, out + done, n - done / 8);
+}
+
+MDIO_TARGET_AVX2 inline void Int16ToFloatAvx2(const void* src, float* dst,
+                                              Index n, float scale,
+                                              bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  const __m128i swap = _mm256_castsi256_si128(Swap16Mask256());
+  const __m256 factor = _mm256_set1_ps(scale);
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+    if (bigEndian) {
+      v = _mm_shuffle_epi8(v, swap);
+    }
+    __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, factor));
+  }
+  scalar::Int16ToFloat(in + 2 * i, dst + i, n - i, scale, bigEndian);
+}
+
+MDIO_TARGET_AVX2 inline void Int32ToFloatAvx2(const void* src, float* dst,
+                                              Index n, float scale,
+                                              bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  const __m256i swap = Swap32Mask256();
+  const __m256 factor = _mm256_set1_ps(scale);
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * i));
+    if (bigEndian) {
+      v = _mm256_shuffle_epi8(v, swap);
+    }
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), factor));
+  }
+  scalar::Int32ToFloat(in + 4 * i, dst + i, n - i, scale, bigEndian);
+}
+
+MDIO_TARGET_AVX2 inline void DequantizeAvx2(float* values, Index n,
+                                            float scale, float offset,
+                                            float fill) {
+  const __m256d factor = _mm256_set1_pd(scale);
+  const __m256d shift = _mm256_set1_pd(offset);
+  const __m256 fillCode = _mm256_set1_ps(fill);
+  const __m256 nan = _mm256_set1_ps(std::numeric_limits<float>::quiet_NaN());
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 codes = _mm256_loadu_ps(values + i);
+    __m128 lo = _mm256_cvtpd_ps(_mm256_add_pd(
+        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(codes)), factor),
+        shift));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_add_pd(
+        _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(codes, 1)),
+                      factor),
+        shift));
+    __m256 result = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+    __m256 missing = _mm256_cmp_ps(codes, fillCode, _CMP_EQ_OQ);
+    _mm256_storeu_ps(values + i, _mm256_blendv_ps(result, nan, missing));
+  }
+  scalar::Dequantize(values + i, n - i, scale, offset, fill);
+}
+
+MDIO_TARGET_AVX2 inline Index QuantizeAvx2(const float* src, float* codes,
+                                           Index n, float scale, float offset,
+                                           float lo, float hi) {
+  const __m256d inverse = _mm256_set1_pd(1.0 / static_cast<double>(scale));
+  const __m256d shift = _mm256_set1_pd(offset);
+  const __m256d low = _mm256_set1_pd(lo);
+  const __m256d high = _mm256_set1_pd(hi);
+  const __m128 fillCode = _mm_set1_ps(lo - 1);
+  Index clamped = 0;
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 values = _mm_loadu_ps(src + i);
+    __m256d q = _mm256_round_pd(
+        _mm256_mul_pd(_mm256_sub_pd(_mm256_cvtps_pd(values), shift), inverse),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d outside = _mm256_or_pd(_mm256_cmp_pd(q, low, _CMP_LT_OQ),
+                                   _mm256_cmp_pd(q, high, _CMP_GT_OQ));
+    clamped += __builtin_popcount(_mm256_movemask_pd(outside));
+    __m128 result =
+        _mm256_cvtpd_ps(_mm256_min_pd(_mm256_max_pd(q, low), high));
+    __m128 missing = _mm_cmp_ps(values, values, _CMP_UNORD_Q);
+    _mm_storeu_ps(codes + i, _mm_blendv_ps(result, fillCode, missing));
+  }
+  return clamped +
+         scalar::Quantize(src + i, codes + i, n - i, scale, offset, lo, hi);
+}
+
+// Four samples as double, zero where they are NaN. `valid` is one where they
+// are not.
+MDIO_TARGET_AVX2 inline __m256d ValidAvx2(__m128 values, __m256d* valid) {
+  __m256d v = _mm256_cvtps_pd(values);
+  __m256d ordered = _mm256_cmp_pd(v, v, _CMP_ORD_Q);
+  *valid = _mm256_and_pd(ordered, _mm256_set1_pd(1.0));
+  return _mm256_and_pd(ordered, v);
+}
+
+MDIO_TARGET_AVX2 inline void AccumulateSumAvx2(const float* src, double* sum,
+                                               double* count, Index n) {
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d valid;
+    __m256d v = ValidAvx2(_mm_loadu_ps(src + i), &valid);
+    _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), v));
+    _mm256_storeu_pd(count + i,
+                     _mm256_add_pd(_mm256_loadu_pd(count + i), valid));
+  }
+  scalar::AccumulateSum(src + i, sum + i, count + i, n - i);
+}
+
+MDIO_TARGET_AVX2 inline void AccumulateSquaresAvx2(const float* src,
+                                                   double* sum, double* count,
+                                                   Index n) {
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d valid;
+    __m256d v = ValidAvx2(_mm_loadu_ps(src + i), &valid);
+    // The square is exact, so fusing it with the addition changes nothing.
+    _mm256_storeu_pd(
+        sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), _mm256_mul_pd(v, v)));
+    _mm256_storeu_pd(count + i,
+                     _mm256_add_pd(_mm256_loadu_pd(count + i), valid));
+  }
+  scalar::AccumulateSquares(src + i, sum + i, count + i, n - i);
+}
+
+MDIO_TARGET_AVX2 inline void AccumulateMinAvx2(const float* src, float* min,
+                                               Index n) {
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(src + i);
+    __m256 m = _mm256_loadu_ps(min + i);
+    _mm256_storeu_ps(min + i,
+                     _mm256_blendv_ps(m, v, _mm256_cmp_ps(v, m, _CMP_LT_OQ)));
+  }
+  scalar::AccumulateMin(src + i, min + i, n - i);
+}
+
+MDIO_TARGET_AVX2 inline void AccumulateMaxAvx2(const float* src, float* max,
+                                               Index* argmax, Index position,
+                                               Index n) {
+  const __m256i where = _mm256_set1_epi64x(position);
+  Index i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_loadu_ps(src + i);
+    __m256 m = _mm256_loadu_ps(max + i);
+    __m256 greater = _mm256_cmp_ps(v, m, _CMP_GT_OQ);
+    _mm256_storeu_ps(max + i, _mm256_blendv_ps(m, v, greater));
+    // Widen the mask to the 64 bit positions, four at a time.
+    __m256i mask = _mm256_castps_si256(greater);
+    __m256i lo = _mm256_cvtepi32_epi64(_mm256_castsi256_si128(mask));
+    __m256i hi = _mm256_cvtepi32_epi64(_mm256_extracti128_si256(mask, 1));
+    auto* index = reinterpret_cast<__m256i*>(argmax + i);
+    _mm256_storeu_si256(
+        index, _mm256_blendv_epi8(_mm256_loadu_si256(index), where, lo));
+    _mm256_storeu_si256(
+        index + 1,
+        _mm256_blendv_epi8(_mm256_loadu_si256(index + 1), where, hi));
+  }
+  scalar::AccumulateMax(src + i, max + i, argmax + i, position, n - i);
+}
+
+MDIO_TARGET_AVX2 inline void CountNonzeroAvx2(const float* src, double* count,
+                                              Index n) {
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d one = _mm256_set1_pd(1.0);
+  Index i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_cvtps_pd(_mm_loadu_ps(src + i));
+    __m256d nonzero = _mm256_cmp_pd(v, zero, _CMP_NEQ_OQ);
+    _mm256_storeu_pd(count + i, _mm256_add_pd(_mm256_loadu_pd(count + i),
+                                              _mm256_and_pd(nonzero, one)));
+  }
+  scalar::CountNonzero(src + i, count + i, n - i);
+}
+
+// ---------------------------------------------------------------------------
+// AVX-512 (F and BW)
+// ---------------------------------------------------------------------------
+
+MDIO_TARGET_AVX512 inline __m256 IbmMagnitudeAvx512(__m256i fraction,
+                                                    __m256i scaleExponent) {
+  __m512d scale = _mm512_castsi512_pd(
+      _mm512_slli_epi64(_mm512_cvtepu32_epi64(scaleExponent), 52));
+  return _mm512_cvtpd_ps(_mm512_mul_pd(_mm512_cvtepi32_pd(fraction), scale));
+}
+
+MDIO_TARGET_AVX512 inline void IbmToIeeeAvx512(const void* src, float* dst,
+                                               Index n) {
+  const char* in = static_cast<const char*>(src);
+  const __m512i swap = Swap32Mask512();
+  const __m512i fractionMask = _mm512_set1_epi32(0x00ffffff);
+  const __m512i exponentMask = _mm512_set1_epi32(0x7f);
+  const __m512i signMask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+  const __m512i bias = _mm512_set1_epi32(1023 - 24 - 256);
+  Index i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i ibm = _mm512_shuffle_epi8(_mm512_loadu_si512(in + 4 * i), swap);
+    __m512i fraction = _mm512_and_si512(ibm, fractionMask);
+    __m512i exponent =
+        _mm512_and_si512(_mm512_srli_epi32(ibm, 24), exponentMask);
+    __m512i scaleExponent =
+        _mm512_add_epi32(_mm512_slli_epi32(exponent, 2), bias);
+    __m256 lo = IbmMagnitudeAvx512(_mm512_castsi512_si256(fraction),
+                                   _mm512_castsi512_si256(scaleExponent));
+    __m256 hi = IbmMagnitudeAvx512(_mm512_extracti64x4_epi64(fraction, 1),
+                                   _mm512_extracti64x4_epi64(scaleExponent, 1));
+    __m512i magnitude = _mm512_inserti64x4(
+        _mm512_castsi256_si512(_mm256_castps_si256(lo)),
+        _mm256_castps_si256(hi), 1);
+    __m512i sign = _mm512_and_si512(ibm, signMask);
+    _mm512_storeu_si512(dst + i, _mm512_or_si512(magnitude, sign));
+  }
+  IbmToIeeeAvx2(in + 4 * i, dst + i, n - i);
+}
+
+MDIO_TARGET_AVX512 inline void IeeeToIbmAvx512(const float* src, void* dst,
+                                               Index n) {
+  char* out = static_cast<char*>(dst);
+  const __m512i swap = Swap32Mask512();
+  const __m512i signMask = _mm512_set1_epi32(static_cast<int>(0x80000000u));
+  const __m512i absMask = _mm512_set1_epi32(0x7fffffff);
+  const __m512i mantissaMask = _mm512_set1_epi32(0x007fffff);
+  const __m512i hiddenBit = _mm512_set1_epi32(0x00800000);
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i zero = _mm512_setzero_si512();
+  Index i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i bits = _mm512_loadu_si512(src + i);
+    __m512i sign = _mm512_and_si512(bits, signMask);
+    __m512i magnitude = _mm512_and_si512(bits, absMask);
+    __m512i exponent = _mm512_srli_epi32(magnitude, 23);
+    __mmask16 denormal = _mm512_cmpeq_epi32_mask(exponent, zero);
+    __m512i scaled = _mm512_castps_si512(_mm512_mul_ps(
+        _mm512_castsi512_ps(magnitude), _mm512_set1_ps(16777216.0f)));
+    __m512i normal = _mm512_mask_blend_epi32(denormal, magnitude, scaled);
+    __m512i mantissa = _mm512_or_si512(
+        _mm512_and_si512(normal, mantissaMask), hiddenBit);
+    __m512i t = _mm512_sub_epi32(_mm512_srli_epi32(normal, 23),
+                                 _mm512_set1_epi32(126));
+    t = _mm512_mask_sub_epi32(t, denormal, t, _mm512_set1_epi32(24));
+    __m512i q = _mm512_srai_epi32(_mm512_add_epi32(t, _mm512_set1_epi32(3)), 2);
+    __m512i shift = _mm512_sub_epi32(_mm512_slli_epi32(q, 2), t);
+    __m512i half = _mm512_srli_epi32(_mm512_sllv_epi32(one, shift), 1);
+    __m512i fraction =
+        _mm512_srlv_epi32(_mm512_add_epi32(mantissa, half), shift);
+    __mmask16 carry =
+        _mm512_cmpgt_epi32_mask(fraction, _mm512_set1_epi32(0xffffff));
+    fraction = _mm512_mask_srli_epi32(fraction, carry, fraction, 4);
+    q = _mm512_mask_add_epi32(q, carry, q, one);
+    __m512i ibmExponent = _mm512_add_epi32(q, _mm512_set1_epi32(64));
+    __m512i ibm = _mm512_or_si512(
+        _mm512_or_si512(sign, _mm512_slli_epi32(ibmExponent, 24)), fraction);
+    __mmask16 overflow =
+        _mm512_cmpgt_epi32_mask(ibmExponent, _mm512_set1_epi32(127)) |
+        _mm512_cmpeq_epi32_mask(exponent, _mm512_set1_epi32(0xff));
+    __mmask16 underflow = _mm512_cmplt_epi32_mask(ibmExponent, zero);
+    ibm = _mm512_mask_blend_epi32(underflow, ibm, sign);
+    ibm = _mm512_mask_blend_epi32(overflow, ibm,
+                                  _mm512_or_si512(sign, absMask));
+    ibm = _mm512_maskz_mov_epi32(_mm512_cmpneq_epi32_mask(magnitude, zero),
+                                 ibm);
+    _mm512_storeu_si512(out + 4 * i, _mm512_shuffle_epi8(ibm, swap));
+  }
+  IeeeToIbmAvx2(src + i, out + 4 * i, n - i);
+}
+
+/// Reverses the bytes of each word in 64 byte blocks.
+MDIO_TARGET_AVX512 inline Index ByteSwapBlocksAvx512(const char* in,
+                                                     char* out, Index bytes,
+                                                     __m512i mask) {
+  Index b = 0;
+  for (; b + 64 <= bytes; b += 64) {
+    _mm512_storeu_si512(out + b,
+                        _mm512_shuffle_epi8(_mm512_loadu_si512(in + b), mask));
+  }
+  return b;
+}
+
+MDIO_TARGET_AVX512 inline void ByteSwap16Avx512(const void* src, void* dst,
+                                                Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx512(in, out, 2 * n, Swap16Mask512());
+  ByteSwap16Avx2(in + done, out + done, n - done / 2);
+}
+
+MDIO_TARGET_AVX512 inline void ByteSwap32Avx512(const void* src, void* dst,
+                                                Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx512(in, out, 4 * n, Swap32Mask512());
+  ByteSwap32Avx2(in + done, out + done, n - done / 4);
+}
+
+MDIO_TARGET_AVX512 inline void ByteSwap64Avx512(const void* src, void* dst,
+                                                Index n) {
+  const char* in = static_cast<const char*>(src);
+  char* out = static_cast<char*>(dst);
+  Index done = ByteSwapBlocksAvx512(in, out, 8 * n, Swap64Mask512());
+  ByteSwap64Avx2(in + done, out + done, n - done / 8);
+}
+
+MDIO_TARGET_AVX512 inline void Int16ToFloatAvx512(const void* src, float* dst,
+                                                  Index n, float scale,
+                                                  bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  const __m256i swap = Swap16Mask256();
+  const __m512 factor = _mm512_set1_ps(scale);
+  Index i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+    if (bigEndian) {
+      v = _mm256_shuffle_epi8(v, swap);
+    }
+    __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(v));
+    _mm512_storeu_ps(dst + i, _mm512_mul_ps(f, factor));
+  }
+  Int16ToFloatAvx2(in + 2 * i, dst + i, n - i, scale, bigEndian);
+}
+
+MDIO_TARGET_AVX512 inline void Int32ToFloatAvx512(const void* src, float* dst,
+                                                  Index n, float scale,
+                                                  bool bigEndian) {
+  const char* in = static_cast<const char*>(src);
+  const __m512i swap = Swap32Mask512();
+  const __m512 factor = _mm512_set1_ps(scale);
+  Index i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i v = _mm512_loadu_si512(in + 4 * i);
+    if (bigEndian) {
+      v = _mm512_shuffle_epi8(v, swap);
+    }
+    _mm512_storeu_ps(dst + i, _mm512_mul_ps(_mm512_cvtepi32_ps(v), factor));
+  }
+  Int32ToFloatAvx2(in + 4 * i, dst + i, n - i, scale, bigEndian);
+}
+
+/// Whether the CPU and operating system support the AVX2 kernels.
+inline bool HasAvx2() { return __builtin_cpu_supports("avx2"); }
+
+/// Whether the CPU and operating system support the AVX-512 kernels.
+inline bool HasAvx512() {
+  return __builtin_cpu_supports("avx512f") &&
+         __builtin_cpu_supports("avx512bw");
+}
+
+}  // namespace x86
+}  // namespace kernels
+}  // namespace mdio
+
+#undef MDIO_TARGET_AVX2
+#undef MDIO_TARGET_AVX512
+
+#endif  // MDIO_KERNELS_X86
+
+#endif  // MDIO_KERNELS_X86_H_
@@ -0,0 +1,512 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_MAP_BLOCKS_H_
+#define MDIO_MAP_BLOCKS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "mdio/async_writer.h"
+#include "mdio/impl.h"
+#include "mdio/trace.h"
+#include "mdio/variable.h"
+#include "tensorstore/index_space/index_domain_builder.h"
+
+namespace mdio {
+
+/**
+ * @brief How far a MapBlocks run has come.
+ */
+struct MapBlocksProgress {
+  Index blocksDone = 0;
+  Index blocksTotal = 0;
+  Index bytesRead = 0;
+  // The bytes of output whose writes have completed.
+  Index bytesWritten = 0;
+  double seconds = 0;
+};
+
+/**
+ * @brief Options of MapBlocks.
+ */
+struct MapBlocksOptions {
+  // The block shape over the dimensions of the first output; empty uses its
+  // chunk shape. Blocks that are multiples of the chunk shape never write to
+  // the same chunk.
+  std::vector<Index> blockShape;
+  // The number of worker threads; 0 uses the hardware concurrency.
+  int numThreads = 0;
+  // The bytes of output in flight beyond which the workers wait.
+  Index maxInflightBytes = Index{256} << 20;
+  // Called after every block. Calls are serialized but may come from any
+  // worker.
+  std::function<void(const MapBlocksProgress&)> onProgress;
+};
+
+/**
+ * @brief One block of a MapBlocks run.
+ * The data keeps the stored data type of each Variable, use input<T>() and
+ * output<T>() for typed access.
+ */
+struct Block {
+  /**
+   * @brief Views an input as an array of T.
+   * @return The array, or an error if the input is not of type T.
+   */
+  template <typename T>
+  Result<SharedArray<const T, dynamic_rank, offset_origin>> input(
+      size_t i) const {
+    return tensorstore::StaticDataTypeCast<const T>(inputs[i].data.data);
+  }
+
+  /**
+   * @brief Views an output as an array of T, to be filled.
+   * @return The array, or an error if the output is not of type T.
+   */
+  template <typename T>
+  Result<SharedArray<T, dynamic_rank, offset_origin>> output(size_t i) {
+    return tensorstore::StaticDataTypeCast<T>(outputs[i].data.data);
+  }
+
+  // The region of the block, labeled as the first output.
+  tensorstore::IndexDomain<> domain;
+  // The data of each input in the region. Dimensions the block does not
+  // describe are read whole. MapOverlap grows the region by its halo.
+  std::vector<VariableData<>> inputs;
+  // The data of each output in the region, written once the function returns.
+  std::vector<VariableData<>> outputs;
+};
+
+namespace internal {
+
+// A block whose inputs are being read.
+struct PendingBlock {
+  Block block;
+  std::vector<Future<VariableData<>>> reads;
+  // Fills the inputs of the block from its reads and returns the bytes read.
+  // If empty, each read is one input.
+  std::function<Result<Index>(PendingBlock&)> assemble;
+};
+
+// Issues the reads of a block, whose domain is set.
+using IssueReads = std::function<absl::Status(PendingBlock&)>;
+
+// The block shape over the dimensions of `output`, resolved from the options.
+inline Result<std::vector<Index>> ResolveBlockShape(
+    const Variable<>& output, const MapBlocksOptions& options) {
+  const auto domain = output.get_store().domain();
+  const DimensionIndex rank = domain.rank();
+  std::vector<Index> blockShape = options.blockShape;
+  if (blockShape.empty()) {
+    MDIO_ASSIGN_OR_RETURN(auto chunks, output.get_chunk_shape())
+    blockShape.assign(chunks.begin(), chunks.end());
+    // A structarray opened as void carries a trailing byte dimension.
+    blockShape.resize(rank, 1);
+  }
+  if (static_cast<DimensionIndex>(blockShape.size()) != rank) {
+    return absl::InvalidArgumentError(
+        "The block shape must have the rank of the first output.");
+  }
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    if (domain.labels()[i].empty()) {
+      // Unlabeled dimensions are not divided.
+      blockShape[i] = std::max<Index>(domain[i].size(), 1);
+    }
+    if (blockShape[i] <= 0) {
+      return absl::InvalidArgumentError("The block shape must be positive.");
+    }
+  }
+  return blockShape;
+}
+
+// Rounds towards negative infinity.
+inline Index FloorDiv(Index a, Index b) {
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+// Called with the bytes of output of a block once they are written.
+using BytesWritten = std::function<void(Index)>;
+
+// The bytes of the outputs of a block.
+inline Index OutputBytes(const Block& block) {
+  Index bytes = 0;
+  for (const auto& output : block.outputs) {
+    bytes += output.num_samples() * output.dtype().size();
+  }
+  return bytes;
+}
+
+// Where the outputs of the blocks of a run go.
+struct BlockSink {
+  // The labeled domain divided into blocks.
+  tensorstore::IndexDomain<> domain;
+  // Fills the outputs of a block before `fn` runs.
+  std::function<absl::Status(Block&)> prepare;
+  // Hands on the outputs of a block once `fn` has filled them and reports
+  // their bytes as they are written, possibly from another thread.
+  std::function<absl::Status(Block&, const BytesWritten&)> commit;
+  // Waits for every committed output and its report. May be empty.
+  std::function<absl::Status()> flush;
+};
+
+// A sink writing the blocks to Variables through AsyncWriters.
+inline Result<BlockSink> VariableSink(const std::vector<Variable<>>& outputs,
+                                      const MapBlocksOptions& options) {
+  BlockSink sink;
+  sink.domain = outputs.front().get_store().domain();
+  for (const auto& output : outputs) {
+    auto outputDomain = output.get_store().domain();
+    auto labels = outputDomain.labels();
+    for (const auto& label : sink.domain.labels()) {
+      if (!label.empty() &&
+          std::find(labels.begin(), labels.end(), label) == labels.end()) {
+        return absl::InvalidArgumentError(
+            "Output " + output.get_variable_name() + " has no dimension '" +
+            std::string(label) + "', so it would be written by every block.");
+      }
+    }
+  }
+
+  auto writers = std::make_shared<std::vector<AsyncWriter<>>>();
+  AsyncWriterOptions writerOptions;
+  writerOptions.maxInflightBytes =
+      std::max<Index>(options.maxInflightBytes / outputs.size(), 1);
+  for (const auto& output : outputs) {
+    MDIO_ASSIGN_OR_RETURN(auto writer,
+                          AsyncWriter<>::Create(output, writerOptions))
+    writers->push_back(std::move(writer));
+  }
+  sink.prepare = [outputs](Block& block) -> absl::Status {
+    for (const auto& output : outputs) {
+      MDIO_ASSIGN_OR_RETURN(
+          auto sliced,
+          internal::SliceToDomain(output, IndexDomainView<>(block.domain)))
+      MDIO_ASSIGN_OR_RETURN(auto data, from_variable<void>(sliced))
+      block.outputs.push_back(std::move(data));
+    }
+    return absl::OkStatus();
+  };
+  sink.commit = [writers](Block& block,
+                          const BytesWritten& written) -> absl::Status {
+    for (size_t o = 0; o < writers->size(); ++o) {
+      const auto& data = block.outputs[o];
+      const Index bytes = data.num_samples() * data.dtype().size();
+      // Failed writes are reported by the flush instead.
+      auto status = (*writers)[o].Write(
+          data, [written, bytes](const absl::Status& result) {
+            if (result.ok()) {
+              written(bytes);
+            }
+          });
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return absl::OkStatus();
+  };
+  sink.flush = [writers]() -> absl::Status {
+    absl::Status firstError;
+    for (auto& writer : *writers) {
+      auto status = writer.Flush();
+      if (firstError.ok()) {
+        firstError = status;
+      }
+    }
+    return firstError;
+  };
+  return sink;
+}
+
+// A sink whose blocks are views of one array in memory, which `fn` fills in
+// place.
+inline BlockSink MemorySink(
+    const tensorstore::IndexDomain<>& domain,
+    const SharedArray<void, dynamic_rank, offset_origin>& result,
+    const std::string& name, const SharedJson& metadata) {
+  BlockSink sink;
+  sink.domain = domain;
+  sink.prepare = [result, name, metadata](Block& block) -> absl::Status {
+    // The view shares the element pointer of the result.
+    SharedArray<void, dynamic_rank, offset_origin> view(
+        result.element_pointer(),
+        tensorstore::StridedLayout<dynamic_rank, offset_origin>(
+            block.domain.origin(), block.domain.shape(),
+            result.byte_strides()));
+    block.outputs.push_back(VariableData<>{
+        name, "", metadata,
+        LabeledArray<void, dynamic_rank, offset_origin>{block.domain,
+                                                        std::move(view)}});
+    return absl::OkStatus();
+  };
+  // Written in place as soon as `fn` returns.
+  sink.commit = [](Block& block, const BytesWritten& written) {
+    written(OutputBytes(block));
+    return absl::OkStatus();
+  };
+  return sink;
+}
+
+// The engine of MapBlocks, MapOverlap, Reduce and Evaluate, which differ in
+// how they read and where the outputs go.
+inline Result<MapBlocksProgress> RunBlocks(
+    const BlockSink& sink, const std::function<absl::Status(Block&)>& fn,
+    const MapBlocksOptions& options, const std::vector<Index>& blockShape,
+    const IssueReads& issue) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto& domain = sink.domain;
+  const DimensionIndex rank = domain.rank();
+
+  // Blocks are aligned to multiples of the block shape, so that they stay
+  // chunk-aligned over a sliced output.
+  std::vector<Index> firstBlock(rank), gridShape(rank);
+  Index numBlocks = 1;
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    auto interval = domain[i].interval();
+    if (interval.empty()) {
+      numBlocks = 0;
+      continue;
+    }
+    firstBlock[i] = FloorDiv(interval.inclusive_min(), blockShape[i]);
+    gridShape[i] =
+        FloorDiv(interval.inclusive_max(), blockShape[i]) - firstBlock[i] + 1;
+    numBlocks *= gridShape[i];
+  }
+
+  std::atomic<Index> nextBlock{0};
+  std::mutex mutex;
+  absl::Status firstError;
+  MapBlocksProgress progress;
+  progress.blocksTotal = numBlocks;
+  auto fail = [&](const absl::Status& status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (firstError.ok()) {
+      firstError = status;
+    }
+  };
+  auto failed = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !firstError.ok();
+  };
+
+  std::vector<std::string> labels(domain.labels().begin(),
+                                  domain.labels().end());
+  // Claims the next block and issues the reads of its inputs.
+  auto claim = [&]() -> std::optional<PendingBlock> {
+    Index index = nextBlock++;
+    if (index >= numBlocks || failed()) {
+      return std::nullopt;
+    }
+    std::vector<Index> origin(rank), shape(rank);
+    for (DimensionIndex i = rank - 1; i >= 0; --i) {
+      Index lo = (firstBlock[i] + index % gridShape[i]) * blockShape[i];
+      index /= gridShape[i];
+      origin[i] = std::max(lo, domain[i].inclusive_min());
+      shape[i] = std::min(lo + blockShape[i], domain[i].exclusive_max()) -
+                 origin[i];
+    }
+    PendingBlock pending;
+    auto blockDomain = tensorstore::IndexDomainBuilder<>(rank)
+                           .origin(origin)
+                           .shape(shape)
+                           .labels(labels)
+                           .Finalize();
+    if (!blockDomain.ok()) {
+      fail(blockDomain.status());
+      return std::nullopt;
+    }
+    pending.block.domain = blockDomain.value();
+    auto status = issue(pending);
+    if (!status.ok()) {
+      fail(status);
+      return std::nullopt;
+    }
+    return pending;
+  };
+
+  // Counts the bytes of output once their writes complete, which the flush
+  // waits for before the progress is returned.
+  BytesWritten written = [&](Index bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    progress.bytesWritten += bytes;
+  };
+
+  auto process = [&](PendingBlock& pending) -> absl::Status {
+    auto& block = pending.block;
+    Index bytesRead = 0;
+    if (pending.assemble) {
+      MDIO_ASSIGN_OR_RETURN(bytesRead, pending.assemble(pending))
+    } else {
+      for (auto& read : pending.reads) {
+        MDIO_ASSIGN_OR_RETURN(auto data, read.result())
+        bytesRead += data.num_samples() * data.dtype().size();
+        block.inputs.push_back(std::move(data));
+      }
+    }
+    auto status = sink.prepare(block);
+    if (!status.ok()) {
+      return status;
+    }
+    trace::Span span("MapBlocks::fn", "compute");
+    status = fn(block);
+    span.End(status);
+    if (!status.ok()) {
+      return status;
+    }
+    status = sink.commit(block, written);
+    if (!status.ok()) {
+      return status;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    ++progress.blocksDone;
+    progress.bytesRead += bytesRead;
+    progress.seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+    if (options.onProgress) {
+      options.onProgress(progress);
+    }
+    return absl::OkStatus();
+  };
+
+  auto worker = [&] {
+    auto next = claim();
+    while (next) {
+      auto current = std::move(*next);
+      // Read ahead while this block is computed.
+      next = claim();
+      auto status = process(current);
+      if (!status.ok()) {
+        fail(status);
+      }
+    }
+  };
+
+  int numThreads = options.numThreads > 0
+                       ? options.numThreads
+                       : static_cast<int>(std::thread::hardware_concurrency());
+  numThreads = static_cast<int>(
+      std::clamp<Index>(numThreads, 1, std::max<Index>(numBlocks, 1)));
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (int i = 1; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (sink.flush) {
+    auto status = sink.flush();
+    if (!status.ok()) {
+      fail(status);
+    }
+  }
+  if (!firstError.ok()) {
+    return firstError;
+  }
+  progress.seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+  return progress;
+}
+
+// Runs the blocks of the first output, writing every output.
+inline Result<MapBlocksProgress> RunBlocks(
+    const std::vector<Variable<>>& outputs,
+    const std::function<absl::Status(Block&)>& fn,
+    const MapBlocksOptions& options, const std::vector<Index>& blockShape,
+    const IssueReads& issue) {
+  MDIO_ASSIGN_OR_RETURN(auto sink, VariableSink(outputs, options))
+  return RunBlocks(sink, fn, options, blockShape, issue);
+}
+
+}  // namespace internal
+
+/**
+ * @brief Computes outputs block by block from inputs, in parallel.
+ * The outputs are divided into chunk-aligned blocks, partial at the edges,
+ * which worker threads take in turn. A worker issues the reads of its next
+ * block before computing the current one and hands the outputs to an
+ * AsyncWriter, so reading, computing and writing overlap while the data in
+ * flight stays bounded.
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto seismic, ds.variables.at("seismic"))
+ * MDIO_ASSIGN_OR_RETURN(auto envelope, ds.variables.at("envelope"))
+ * MDIO_ASSIGN_OR_RETURN(
+ *     auto summary,
+ *     mdio::MapBlocks({seismic}, {envelope}, [](mdio::Block& block) {
+ *       MDIO_ASSIGN_OR_RETURN(auto in, block.input<float>(0))
+ *       MDIO_ASSIGN_OR_RETURN(auto out, block.output<float>(0))
+ *       ...
+ *       return absl::OkStatus();
+ *     }))
+ * @endcode
+ * @param inputs The Variables to read, sliced to every block by the labels
+ * they share with it.
+ * @param outputs The Variables to write. Each must have every labeled
+ * dimension of the first.
+ * @param fn Fills the outputs of a block. It is called from several threads at
+ * once.
+ * @param options The block shape, threads, in-flight budget and progress.
+ * @return The final progress, or the first error of a read, `fn` or a write.
+ */
+inline Result<MapBlocksProgress> MapBlocks(
+    const std::vector<Variable<>>& inputs,
+    const std::vector<Variable<>>& outputs,
+    const std::function<absl::Status(Block&)>& fn,
+    const MapBlocksOptions& options = {}) {
+  if (outputs.empty()) {
+    return absl::InvalidArgumentError("MapBlocks needs an output.");
+  }
+  MDIO_ASSIGN_OR_RETURN(auto blockShape,
+                        internal::ResolveBlockShape(outputs.front(), options))
+  return internal::RunBlocks(
+      outputs, fn, options, blockShape,
+      [&](internal::PendingBlock& pending) -> absl::Status {
+        for (const auto& input : inputs) {
+          MDIO_ASSIGN_OR_RETURN(
+              auto sliced,
+              internal::SliceToDomain(
+                  input, IndexDomainView<>(pending.block.domain)))
+          pending.reads.push_back(sliced.Read());
+        }
+        return absl::OkStatus();
+      });
+}
+
+/**
+ * @brief Computes one output block by block from inputs, in parallel.
+ * See the overload for several outputs.
+ */
+inline Result<MapBlocksProgress> MapBlocks(
+    const std::vector<Variable<>>& inputs, const Variable<>& output,
+    const std::function<absl::Status(Block&)>& fn,
+    const MapBlocksOptions& options = {}) {
+  return MapBlocks(inputs, std::vector<Variable<>>{output}, fn, options);
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_MAP_BLOCKS_H_
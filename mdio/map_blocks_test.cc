@@ -0,0 +1,214 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/map_blocks.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/map_blocks.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "seismic",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 12},
+      {"name": "time", "size": 8}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8, 8] }
+      }
+    }
+  },
+  {
+    "name": "gain",
+    "dataType": "float32",
+    "dimensions": [{"name": "time", "size": 8}]
+  },
+  {
+    "name": "scaled",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 12},
+      {"name": "time", "size": 8}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8, 8] }
+      }
+    }
+  },
+  {
+    "name": "peak",
+    "dataType": "float64",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 12}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("map_blocks", variables));
+  ds = mdio::test_util::Fill<float>(ds, "seismic", [](auto index) {
+    return index[0] * 100 + index[1] + index[2] * 0.125f;
+  });
+  return mdio::test_util::Fill<float>(ds, "gain", [](auto index) {
+    return index[0] + 1;
+  });
+}
+
+// Scales every trace by the gain and records its peak.
+absl::Status ScaleAndPeak(mdio::Block& block) {  // NOLINT
+  MDIO_ASSIGN_OR_RETURN(auto seismic, block.input<float>(0))
+  MDIO_ASSIGN_OR_RETURN(auto gain, block.input<float>(1))
+  MDIO_ASSIGN_OR_RETURN(auto scaled, block.output<float>(0))
+  MDIO_ASSIGN_OR_RETURN(auto peak, block.output<double>(1))
+  auto domain = scaled.domain();
+  for (mdio::Index i = domain[0].inclusive_min(); i < domain[0].exclusive_max();
+       ++i) {
+    for (mdio::Index j = domain[1].inclusive_min();
+         j < domain[1].exclusive_max(); ++j) {
+      double max = 0;
+      for (mdio::Index k = 0; k < 8; ++k) {
+        scaled({i, j, k}) = seismic({i, j, k}) * gain({k});
+        max = std::max<double>(max, scaled({i, j, k}));
+      }
+      peak({i, j}) = max;
+    }
+  }
+  return absl::OkStatus();
+}
+
+TEST(MapBlocks, scaleAndPeak) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  std::vector<mdio::Variable<>> inputs = {vars.at("seismic").value(),
+                                          vars.at("gain").value()};
+  std::vector<mdio::Variable<>> outputs = {vars.at("scaled").value(),
+                                           vars.at("peak").value()};
+
+  mdio::MapBlocksOptions options;
+  options.numThreads = 4;
+  std::atomic<mdio::Index> calls{0};
+  options.onProgress = [&](const mdio::MapBlocksProgress& progress) {
+    ++calls;
+    EXPECT_LE(progress.blocksDone, progress.blocksTotal);
+  };
+  auto summary = mdio::MapBlocks(inputs, outputs, ScaleAndPeak, options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  // 3 x 2 x 1 chunks, partial along inline and crossline.
+  EXPECT_EQ(summary.value().blocksTotal, 6);
+  EXPECT_EQ(summary.value().blocksDone, 6);
+  EXPECT_EQ(calls, 6);
+  EXPECT_EQ(summary.value().bytesWritten, 20 * 12 * 8 * 4 + 20 * 12 * 8);
+
+  auto scaled = vars.get<float>("scaled").value().Read().result();
+  ASSERT_TRUE(scaled.ok()) << scaled.status();
+  auto peak = vars.get<double>("peak").value().Read().result();
+  ASSERT_TRUE(peak.ok()) << peak.status();
+  auto scaledData = scaled.value().get_data_accessor();
+  auto peakData = peak.value().get_data_accessor();
+  for (int i = 0; i < 20; ++i) {
+    for (int j = 0; j < 12; ++j) {
+      for (int k = 0; k < 8; ++k) {
+        EXPECT_FLOAT_EQ(scaledData({i, j, k}),
+                        (i * 100 + j + k * 0.125f) * (k + 1));
+      }
+      EXPECT_FLOAT_EQ(peakData({i, j}), (i * 100 + j + 0.875f) * 8);
+    }
+  }
+}
+
+TEST(MapBlocks, blockShape) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  mdio::MapBlocksOptions options;
+  options.numThreads = 1;
+  options.blockShape = {16, 8, 8};
+  auto summary = mdio::MapBlocks(
+      {vars.at("seismic").value()}, vars.at("scaled").value(),
+      [](mdio::Block& block) -> absl::Status {
+        MDIO_ASSIGN_OR_RETURN(auto in, block.input<float>(0))
+        MDIO_ASSIGN_OR_RETURN(auto out, block.output<float>(0))
+        EXPECT_EQ(block.domain.labels()[0], "inline");
+        EXPECT_LE(block.domain.shape()[0], 16);
+        tensorstore::CopyArray(in, out);
+        return absl::OkStatus();
+      },
+      options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  EXPECT_EQ(summary.value().blocksTotal, 4);
+
+  auto scaled = vars.get<float>("scaled").value().Read().result();
+  ASSERT_TRUE(scaled.ok()) << scaled.status();
+  EXPECT_FLOAT_EQ(scaled.value().get_data_accessor()({19, 11, 7}),
+                  1911.875f);
+}
+
+TEST(MapBlocks, errors) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  auto seismic = vars.at("seismic").value();
+
+  auto failed = mdio::MapBlocks({seismic}, vars.at("scaled").value(),
+                                [](mdio::Block&) {
+                                  return absl::InternalError("compute failed");
+                                });
+  ASSERT_FALSE(failed.ok());
+  EXPECT_EQ(failed.status().code(), absl::StatusCode::kInternal);
+
+  // Every block would write all of `gain`.
+  auto scaled = vars.at("scaled").value();
+  auto broadcast =
+      mdio::MapBlocks({seismic}, {scaled, vars.at("gain").value()},
+                      [](mdio::Block&) { return absl::OkStatus(); });
+  EXPECT_EQ(broadcast.status().code(), absl::StatusCode::kInvalidArgument);
+
+  mdio::MapBlocksOptions options;
+  options.blockShape = {8, 8};
+  auto wrongRank = mdio::MapBlocks(
+      {seismic}, scaled, [](mdio::Block&) { return absl::OkStatus(); },
+      options);
+  EXPECT_EQ(wrongRank.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
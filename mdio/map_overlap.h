@@ -0,0 +1,496 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_MAP_OVERLAP_H_
+#define MDIO_MAP_OVERLAP_H_
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mdio/map_blocks.h"
+#include "tensorstore/data_type.h"
+
+namespace mdio {
+
+/**
+ * @brief How MapOverlap pads a halo that falls outside an input.
+ */
+enum class Boundary {
+  // Mirrored about the edge, which is repeated: c b a | a b c | c b a.
+  kReflect,
+  // Filled with MapOverlapOptions::constant.
+  kConstant,
+  // The edge sample repeated: a a a | a b c | c c c.
+  kNearest,
+};
+
+/**
+ * @brief Options of MapOverlap, on top of those of MapBlocks.
+ */
+struct MapOverlapOptions : MapBlocksOptions {
+  // The halo over the dimensions of the first output, added to both sides of
+  // every block; empty for none.
+  std::vector<Index> halo;
+  Boundary boundary = Boundary::kReflect;
+  // The value of a kConstant boundary, converted to each input's data type.
+  double constant = 0;
+  // The bytes of input tiles kept for the neighbouring blocks.
+  Index cacheBytes = Index{256} << 20;
+};
+
+namespace internal {
+
+// Tiles of the inputs that neighbouring blocks share. The least recently used
+// go first once the cache is over its budget.
+class TileCache {
+ public:
+  explicit TileCache(Index maxBytes) : maxBytes_(maxBytes) {}
+
+  // The tile under `key`, read with `read` unless cached. `hit` tells which.
+  // The read is issued outside the lock; blocks asking for the tile meanwhile
+  // wait on the same future.
+  Future<VariableData<>> Get(
+      const std::string& key, Index bytes,
+      const std::function<Future<VariableData<>>()>& read, bool* hit) {
+    auto pair = tensorstore::PromiseFuturePair<VariableData<>>::Make();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto found = entries_.find(key);
+      if (found != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, found->second.position);
+        *hit = true;
+        return found->second.tile;
+      }
+      *hit = false;
+      lru_.push_front(key);
+      entries_.emplace(key, Entry{pair.future, bytes, lru_.begin()});
+      bytes_ += bytes;
+      while (bytes_ > maxBytes_ && lru_.size() > 1) {
+        auto last = entries_.find(lru_.back());
+        bytes_ -= last->second.bytes;
+        entries_.erase(last);
+        lru_.pop_back();
+      }
+    }
+    read().ExecuteWhenReady(
+        [promise = std::move(pair.promise)](
+            tensorstore::ReadyFuture<VariableData<>> tile) {
+          promise.SetResult(tile.result());
+        });
+    return pair.future;
+  }
+
+ private:
+  struct Entry {
+    Future<VariableData<>> tile;
+    Index bytes;
+    std::list<std::string>::iterator position;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  // Most recently used first.
+  std::list<std::string> lru_;
+  Index bytes_ = 0;
+  Index maxBytes_;
+};
+
+// Copies a region between two arrays of the same data type, whole rows at a
+// time where both are contiguous along the last dimension.
+inline void CopyRegion(
+    const SharedArray<const void, dynamic_rank, offset_origin>& source,
+    tensorstore::span<const Index> sourceStart,
+    const SharedArray<void, dynamic_rank, offset_origin>& target,
+    tensorstore::span<const Index> targetStart,
+    tensorstore::span<const Index> shape) {
+  const DimensionIndex rank = shape.size();
+  const Index size = target.dtype().size();
+  auto from = static_cast<const char*>(
+      source.byte_strided_origin_pointer().get());
+  auto to = static_cast<char*>(target.byte_strided_origin_pointer().get());
+  if (rank == 0) {
+    std::memcpy(to, from, size);
+    return;
+  }
+  for (auto extent : shape) {
+    if (extent <= 0) {
+      return;
+    }
+  }
+  const Index sourceStride = source.byte_strides()[rank - 1];
+  const Index targetStride = target.byte_strides()[rank - 1];
+  const bool rows = sourceStride == size && targetStride == size;
+  std::vector<Index> position(rank, 0);
+  while (true) {
+    Index s = 0, t = 0;
+    for (DimensionIndex d = 0; d < rank; ++d) {
+      s += (sourceStart[d] + position[d] - source.origin()[d]) *
+           source.byte_strides()[d];
+      t += (targetStart[d] + position[d] - target.origin()[d]) *
+           target.byte_strides()[d];
+    }
+    if (rows) {
+      std::memcpy(to + t, from + s, shape[rank - 1] * size);
+    } else {
+      for (Index k = 0; k < shape[rank - 1]; ++k) {
+        std::memcpy(to + t + k * targetStride, from + s + k * sourceStride,
+                    size);
+      }
+    }
+    DimensionIndex d = rank - 2;
+    for (; d >= 0; --d) {
+      if (++position[d] < shape[d]) {
+        break;
+      }
+      position[d] = 0;
+    }
+    if (d < 0) {
+      return;
+    }
+  }
+}
+
+// Where a halo sample outside [lo, hi) takes its value from.
+inline Index BoundarySource(Boundary boundary, Index p, Index lo, Index hi) {
+  if (boundary == Boundary::kNearest) {
+    return std::clamp(p, lo, hi - 1);
+  }
+  const Index n = hi - lo;
+  Index r = (p - lo) % (2 * n);
+  if (r < 0) {
+    r += 2 * n;
+  }
+  return lo + (r < n ? r : 2 * n - 1 - r);
+}
+
+// How an input is read around a block.
+struct OverlapInput {
+  Variable<> variable;
+  std::vector<std::string> labels;
+  tensorstore::Box<> bounds;
+  // The dimension of the first output each dimension follows, or -1 if it is
+  // read whole.
+  std::vector<DimensionIndex> blockDims;
+  // The kConstant boundary, in the data type of the input.
+  SharedArray<void> fill;
+};
+
+// The tiles of an input for one block.
+struct OverlapRead {
+  // The padded region and the part of it inside the input.
+  std::vector<Index> origin, shape;
+  std::vector<Index> insideOrigin, insideShape;
+  size_t tiles = 0;
+  Index bytesRead = 0;
+};
+
+}  // namespace internal
+
+/**
+ * @brief Computes outputs block by block from inputs read with a halo.
+ * Filters and structure-oriented attributes need the samples around a block.
+ * Each input is read over the block grown by `options.halo` on both sides and
+ * padded where that falls outside the input, by reflection, a constant or the
+ * nearest sample. The function sees the padded inputs, whose domains extend
+ * past the block, and fills outputs over the block alone, so only the interior
+ * is written.
+ * Inputs are read in tiles of the block shape that are cached, so the overlap
+ * of neighbouring blocks is read once as long as `options.cacheBytes` holds a
+ * few rows of tiles. Blocks, threads and writes are as in MapBlocks.
+ * @details \b Usage
+ * @code
+ * mdio::MapOverlapOptions options;
+ * options.halo = {2, 2, 0};
+ * options.boundary = mdio::Boundary::kNearest;
+ * MDIO_ASSIGN_OR_RETURN(
+ *     auto summary,
+ *     mdio::MapOverlap({seismic}, {smoothed}, [](mdio::Block& block) {
+ *       MDIO_ASSIGN_OR_RETURN(auto in, block.input<float>(0))
+ *       MDIO_ASSIGN_OR_RETURN(auto out, block.output<float>(0))
+ *       // in({i - 2, j, k}) is valid anywhere in out's domain.
+ *       ...
+ *       return absl::OkStatus();
+ *     }, options))
+ * @endcode
+ * @param inputs The Variables to read. Dimensions labeled as one of the first
+ * output are sliced to the block and its halo, the others are read whole.
+ * @param outputs The Variables to write. Each must have every labeled
+ * dimension of the first.
+ * @param fn Fills the outputs of a block. It is called from several threads at
+ * once.
+ * @param options The halo and boundary, cache budget and MapBlocks options.
+ * @return The final progress, or the first error of a read, `fn` or a write.
+ * Bytes read count each tile once per read from storage.
+ */
+inline Result<MapBlocksProgress> MapOverlap(
+    const std::vector<Variable<>>& inputs,
+    const std::vector<Variable<>>& outputs,
+    const std::function<absl::Status(Block&)>& fn,
+    const MapOverlapOptions& options = {}) {
+  if (outputs.empty()) {
+    return absl::InvalidArgumentError("MapOverlap needs an output.");
+  }
+  MDIO_ASSIGN_OR_RETURN(auto blockShape,
+                        internal::ResolveBlockShape(outputs.front(), options))
+  const auto domain = outputs.front().get_store().domain();
+  const DimensionIndex rank = domain.rank();
+  std::vector<Index> halo = options.halo;
+  halo.resize(options.halo.empty() ? rank : halo.size(), 0);
+  if (static_cast<DimensionIndex>(halo.size()) != rank) {
+    return absl::InvalidArgumentError(
+        "The halo must have the rank of the first output.");
+  }
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    if (halo[i] < 0) {
+      return absl::InvalidArgumentError("The halo must not be negative.");
+    }
+    if (domain.labels()[i].empty()) {
+      halo[i] = 0;
+    }
+  }
+
+  std::vector<internal::OverlapInput> plans;
+  for (const auto& input : inputs) {
+    internal::OverlapInput plan;
+    plan.variable = input;
+    auto inputDomain = input.get_store().domain();
+    plan.labels.assign(inputDomain.labels().begin(),
+                       inputDomain.labels().end());
+    plan.bounds = tensorstore::Box<>(inputDomain.box());
+    auto id = input.dtype().id();
+    if (id == tensorstore::DataTypeId::string_t ||
+        id == tensorstore::DataTypeId::ustring_t ||
+        id == tensorstore::DataTypeId::json_t) {
+      return absl::InvalidArgumentError(
+          "MapOverlap cannot pad input " + input.get_variable_name() +
+          " of type " + std::string(input.dtype().name()) + ".");
+    }
+    for (const auto& label : plan.labels) {
+      DimensionIndex blockDim = -1;
+      for (DimensionIndex i = 0; i < rank && !label.empty(); ++i) {
+        if (domain.labels()[i] == label) {
+          blockDim = i;
+        }
+      }
+      plan.blockDims.push_back(blockDim);
+    }
+    if (options.boundary == Boundary::kConstant) {
+      plan.fill = tensorstore::AllocateArray(
+          tensorstore::span<const Index>{}, mdio::ContiguousLayoutOrder::c,
+          tensorstore::value_init, input.dtype());
+      auto status = tensorstore::CopyConvertedArray(
+          tensorstore::MakeScalarArray<double>(options.constant), plan.fill);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    plans.push_back(std::move(plan));
+  }
+
+  auto cache = std::make_shared<internal::TileCache>(options.cacheBytes);
+
+  // Looks up or reads the tiles of every input around the block.
+  auto issue = [&](internal::PendingBlock& pending) -> absl::Status {
+    const auto& block = pending.block.domain;
+    auto reads = std::make_shared<std::vector<internal::OverlapRead>>();
+    for (size_t k = 0; k < plans.size(); ++k) {
+      const auto& plan = plans[k];
+      const DimensionIndex inputRank = plan.labels.size();
+      internal::OverlapRead read;
+      std::vector<Index> firstTile(inputRank), numTiles(inputRank);
+      for (DimensionIndex d = 0; d < inputRank; ++d) {
+        const auto bounds = plan.bounds[d];
+        const DimensionIndex b = plan.blockDims[d];
+        Index lo = bounds.inclusive_min(), hi = bounds.exclusive_max();
+        if (b >= 0) {
+          lo = block[b].inclusive_min() - halo[b];
+          hi = block[b].exclusive_max() + halo[b];
+        }
+        Index insideLo = std::max(lo, bounds.inclusive_min());
+        Index insideHi = std::min(hi, bounds.exclusive_max());
+        if (insideLo >= insideHi) {
+          return absl::OutOfRangeError(absl::StrCat(
+              "Input ", plan.variable.get_variable_name(),
+              " does not overlap the block in dimension '", plan.labels[d],
+              "'."));
+        }
+        read.origin.push_back(lo);
+        read.shape.push_back(hi - lo);
+        read.insideOrigin.push_back(insideLo);
+        read.insideShape.push_back(insideHi - insideLo);
+        if (b >= 0) {
+          firstTile[d] = internal::FloorDiv(insideLo, blockShape[b]);
+          numTiles[d] = internal::FloorDiv(insideHi - 1, blockShape[b]) -
+                        firstTile[d] + 1;
+        } else {
+          numTiles[d] = 1;
+        }
+      }
+
+      std::vector<Index> tile(inputRank, 0);
+      while (true) {
+        std::string key = absl::StrCat(k);
+        std::vector<Index> origin(inputRank), shape(inputRank);
+        Index elements = 1;
+        for (DimensionIndex d = 0; d < inputRank; ++d) {
+          const auto bounds = plan.bounds[d];
+          const DimensionIndex b = plan.blockDims[d];
+          origin[d] = bounds.inclusive_min();
+          shape[d] = bounds.size();
+          if (b >= 0) {
+            Index index = firstTile[d] + tile[d];
+            Index lo = std::max(index * blockShape[b], bounds.inclusive_min());
+            Index hi = std::min((index + 1) * blockShape[b],
+                                bounds.exclusive_max());
+            origin[d] = lo;
+            shape[d] = hi - lo;
+            absl::StrAppend(&key, "/", index);
+          }
+          elements *= shape[d];
+        }
+        const Index bytes = elements * plan.variable.dtype().size();
+        bool hit = false;
+        auto future = cache->Get(
+            key, bytes,
+            [&]() -> Future<VariableData<>> {
+              MDIO_ASSIGN_OR_RETURN(auto tileDomain,
+                                    tensorstore::IndexDomainBuilder<>(inputRank)
+                                        .origin(origin)
+                                        .shape(shape)
+                                        .labels(plan.labels)
+                                        .Finalize())
+              MDIO_ASSIGN_OR_RETURN(
+                  auto sliced,
+                  internal::SliceToDomain(plan.variable,
+                                          IndexDomainView<>(tileDomain)))
+              return sliced.Read();
+            },
+            &hit);
+        if (!hit) {
+          read.bytesRead += bytes;
+        }
+        pending.reads.push_back(std::move(future));
+        ++read.tiles;
+
+        DimensionIndex d = inputRank - 1;
+        for (; d >= 0; --d) {
+          if (++tile[d] < numTiles[d]) {
+            break;
+          }
+          tile[d] = 0;
+        }
+        if (d < 0) {
+          break;
+        }
+      }
+      reads->push_back(std::move(read));
+    }
+
+    // Pads each input and copies its tiles in.
+    pending.assemble = [&plans, &options,
+                        reads](internal::PendingBlock& ready) -> Result<Index> {
+      Index bytesRead = 0;
+      size_t next = 0;
+      for (size_t k = 0; k < plans.size(); ++k) {
+        const auto& plan = plans[k];
+        const auto& read = (*reads)[k];
+        const DimensionIndex inputRank = plan.labels.size();
+        bytesRead += read.bytesRead;
+        tensorstore::BoxView<> box(read.origin, read.shape);
+        auto padded =
+            tensorstore::AllocateArray(box, mdio::ContiguousLayoutOrder::c,
+                                       tensorstore::default_init,
+                                       plan.variable.dtype());
+        if (options.boundary == Boundary::kConstant) {
+          const Index size = padded.dtype().size();
+          auto to =
+              static_cast<char*>(padded.byte_strided_origin_pointer().get());
+          for (Index i = 0; i < padded.num_elements(); ++i) {
+            std::memcpy(to + i * size, plan.fill.data(), size);
+          }
+        }
+        for (size_t t = 0; t < read.tiles; ++t) {
+          MDIO_ASSIGN_OR_RETURN(auto data, ready.reads[next++].result())
+          const auto& array = data.data.data;
+          std::vector<Index> origin(inputRank), shape(inputRank);
+          for (DimensionIndex d = 0; d < inputRank; ++d) {
+            origin[d] = std::max(array.origin()[d], read.insideOrigin[d]);
+            shape[d] = std::min(array.origin()[d] + array.shape()[d],
+                                read.insideOrigin[d] + read.insideShape[d]) -
+                       origin[d];
+          }
+          internal::CopyRegion(array, origin, padded, origin, shape);
+        }
+        if (options.boundary != Boundary::kConstant) {
+          // One dimension after another, so the corners take the value their
+          // source takes in every dimension.
+          for (DimensionIndex d = 0; d < inputRank; ++d) {
+            const Index lo = read.insideOrigin[d];
+            const Index hi = lo + read.insideShape[d];
+            std::vector<Index> from(read.origin), to(read.origin);
+            std::vector<Index> plane(read.shape);
+            plane[d] = 1;
+            for (Index p = read.origin[d]; p < read.origin[d] + read.shape[d];
+                 ++p) {
+              if (p >= lo && p < hi) {
+                continue;
+              }
+              from[d] = internal::BoundarySource(options.boundary, p, lo, hi);
+              to[d] = p;
+              internal::CopyRegion(padded, from, padded, to, plane);
+            }
+          }
+        }
+        MDIO_ASSIGN_OR_RETURN(auto paddedDomain,
+                              tensorstore::IndexDomainBuilder<>(inputRank)
+                                  .origin(read.origin)
+                                  .shape(read.shape)
+                                  .labels(plan.labels)
+                                  .Finalize())
+        ready.block.inputs.push_back(VariableData<>{
+            plan.variable.get_variable_name(), plan.variable.get_long_name(),
+            plan.variable.getSharedReducedMetadata(),
+            LabeledArray<void, dynamic_rank, offset_origin>{paddedDomain,
+                                                            padded}});
+      }
+      return bytesRead;
+    };
+    return absl::OkStatus();
+  };
+  return internal::RunBlocks(outputs, fn, options, blockShape, issue);
+}
+
+/**
+ * @brief Computes one output block by block from inputs read with a halo.
+ * See the overload for several outputs.
+ */
+inline Result<MapBlocksProgress> MapOverlap(
+    const std::vector<Variable<>>& inputs, const Variable<>& output,
+    const std::function<absl::Status(Block&)>& fn,
+    const MapOverlapOptions& options = {}) {
+  return MapOverlap(inputs, std::vector<Variable<>>{output}, fn, options);
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_MAP_OVERLAP_H_
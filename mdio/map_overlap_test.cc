@@ -0,0 +1,232 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/map_overlap.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/map_overlap.mdio";
+
+// The value written to the seismic at a sample.
+float Sample(mdio::Index i, mdio::Index j, mdio::Index k) {
+  return i * 100 + j + k * 0.125f;
+}
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "seismic",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 12},
+      {"name": "time", "size": 8}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8, 8] }
+      }
+    }
+  },
+  {
+    "name": "smoothed",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 20},
+      {"name": "crossline", "size": 12},
+      {"name": "time", "size": 8}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8, 8] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("map_overlap", variables));
+  return mdio::test_util::Fill<float>(ds, "seismic", [](auto index) {
+    return Sample(index[0], index[1], index[2]);
+  });
+}
+
+// Sums each sample with its inline neighbours.
+absl::Status Smooth(mdio::Block& block) {  // NOLINT
+  MDIO_ASSIGN_OR_RETURN(auto in, block.input<float>(0))
+  MDIO_ASSIGN_OR_RETURN(auto out, block.output<float>(0))
+  auto domain = out.domain();
+  for (mdio::Index i = domain[0].inclusive_min(); i < domain[0].exclusive_max();
+       ++i) {
+    for (mdio::Index j = domain[1].inclusive_min();
+         j < domain[1].exclusive_max(); ++j) {
+      for (mdio::Index k = 0; k < 8; ++k) {
+        out({i, j, k}) = in({i - 1, j, k}) + in({i, j, k}) + in({i + 1, j, k});
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+TEST(MapOverlap, reflect) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  mdio::MapOverlapOptions options;
+  options.numThreads = 4;
+  options.halo = {1, 0, 0};
+  auto summary = mdio::MapOverlap({vars.at("seismic").value()},
+                                  vars.at("smoothed").value(), Smooth, options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  EXPECT_EQ(summary.value().blocksTotal, 6);
+  // Every tile is read once, although the blocks overlap.
+  EXPECT_EQ(summary.value().bytesRead, 20 * 12 * 8 * 4);
+  EXPECT_EQ(summary.value().bytesWritten, 20 * 12 * 8 * 4);
+
+  auto smoothed = vars.get<float>("smoothed").value().Read().result();
+  ASSERT_TRUE(smoothed.ok()) << smoothed.status();
+  auto data = smoothed.value().get_data_accessor();
+  for (int i = 0; i < 20; ++i) {
+    // The edge is repeated by the reflection.
+    int before = std::max(i - 1, 0);
+    int after = std::min(i + 1, 19);
+    for (int j = 0; j < 12; ++j) {
+      for (int k = 0; k < 8; ++k) {
+        EXPECT_FLOAT_EQ(data({i, j, k}), Sample(before, j, k) +
+                                             Sample(i, j, k) +
+                                             Sample(after, j, k))
+            << i << " " << j << " " << k;
+      }
+    }
+  }
+}
+
+TEST(MapOverlap, boundaries) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  auto seismic = vars.at("seismic").value();
+  auto smoothed = vars.at("smoothed").value();
+
+  for (auto boundary : {mdio::Boundary::kReflect, mdio::Boundary::kConstant,
+                        mdio::Boundary::kNearest}) {
+    mdio::MapOverlapOptions options;
+    options.numThreads = 1;
+    options.halo = {2, 1, 0};
+    options.boundary = boundary;
+    options.constant = -1;
+    auto summary = mdio::MapOverlap(
+        {seismic}, smoothed,
+        [&](mdio::Block& block) -> absl::Status {
+          MDIO_ASSIGN_OR_RETURN(auto in, block.input<float>(0))
+          auto origin = block.domain.origin();
+          auto shape = block.domain.shape();
+          EXPECT_EQ(in.origin()[0], origin[0] - 2);
+          EXPECT_EQ(in.shape()[0], shape[0] + 4);
+          EXPECT_EQ(in.origin()[1], origin[1] - 1);
+          EXPECT_EQ(in.shape()[2], 8);
+          if (origin[0] != 0 || origin[1] != 0) {
+            return absl::OkStatus();
+          }
+          // The corner of the first block.
+          float expected[] = {Sample(1, 0, 3), -1, Sample(0, 0, 3)};
+          EXPECT_FLOAT_EQ(in({-2, -1, 3}),
+                          expected[static_cast<int>(boundary)]);
+          float inside[] = {Sample(0, 0, 3), -1, Sample(0, 0, 3)};
+          EXPECT_FLOAT_EQ(in({-1, 0, 3}), inside[static_cast<int>(boundary)]);
+          EXPECT_FLOAT_EQ(in({1, 8, 3}), Sample(1, 8, 3));
+          return absl::OkStatus();
+        },
+        options);
+    ASSERT_TRUE(summary.ok()) << summary.status();
+  }
+}
+
+TEST(MapOverlap, smallCache) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  mdio::MapOverlapOptions options;
+  options.numThreads = 1;
+  options.halo = {1, 1, 0};
+  // Only the last tile is kept, so the overlap is read again.
+  options.cacheBytes = 1;
+  auto summary = mdio::MapOverlap({vars.at("seismic").value()},
+                                  vars.at("smoothed").value(), Smooth, options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  EXPECT_GT(summary.value().bytesRead, 20 * 12 * 8 * 4);
+}
+
+TEST(MapOverlap, tileCacheReadsUnlocked) {
+  mdio::internal::TileCache cache(1024);
+  auto missing = [] {
+    return tensorstore::MakeReadyFuture<mdio::VariableData<>>(
+        absl::NotFoundError("No tile."));
+  };
+  bool hit = true;
+  bool innerHit = true;
+  // The read may use the cache itself, as it is issued outside the lock.
+  auto tile = cache.Get(
+      "a", 8, [&] { return cache.Get("b", 8, missing, &innerHit); }, &hit);
+  EXPECT_FALSE(hit);
+  EXPECT_FALSE(innerHit);
+  EXPECT_TRUE(absl::IsNotFound(tile.status())) << tile.status();
+  cache.Get("a", 8, missing, &hit);
+  EXPECT_TRUE(hit);
+}
+
+TEST(MapOverlap, errors) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  auto seismic = vars.at("seismic").value();
+  auto smoothed = vars.at("smoothed").value();
+  auto noop = [](mdio::Block&) { return absl::OkStatus(); };
+
+  mdio::MapOverlapOptions options;
+  options.halo = {1, 1};
+  EXPECT_EQ(mdio::MapOverlap({seismic}, smoothed, noop, options)
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  options.halo = {1, -1, 0};
+  EXPECT_EQ(mdio::MapOverlap({seismic}, smoothed, noop, options)
+                .status()
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+
+  options.halo = {1, 0, 0};
+  auto failed = mdio::MapOverlap(
+      {seismic}, smoothed,
+      [](mdio::Block&) { return absl::InternalError("compute failed"); },
+      options);
+  EXPECT_EQ(failed.status().code(), absl::StatusCode::kInternal);
+}
+
+}  // namespace
@@ -0,0 +1,180 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_QUANTIZATION_H_
+#define MDIO_QUANTIZATION_H_
+
+#include <cmath>
+#include <string>
+
+#include "mdio/impl.h"
+#include "mdio/kernels/kernels.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace internal {
+// The key under ["metadata"]["attributes"] declaring a quantized Variable.
+constexpr char kQuantizationKey[] = "quantization";
+}  // namespace internal
+
+/**
+ * @brief A lossy integer encoding of a float32 Variable,
+ * value = code * scale + offset
+ * Declared in the schema under the Variable's attributes; the Variable keeps
+ * its float32 dataType while the Zarr array stores the integer codes:
+ * @code
+ * "dataType": "float32",
+ * "metadata": {
+ *   "attributes": {
+ *     "quantization": {"dtype": "int16", "scale": 0.001, "offset": 0}
+ *   }
+ * }
+ * @endcode
+ * Either "scale" or "errorBound" must be given. Rounding to the nearest code
+ * bounds the error by scale / 2, so a missing one is derived from the other.
+ * The lowest code of the dtype is the fill value and reads back as NaN.
+ */
+struct Quantization {
+  std::string dtype = "int16";
+  float scale = 1;
+  float offset = 0;
+  double errorBound = 0.5;
+
+  /**
+   * @brief Parses the quantization declaration.
+   * @param j The JSON declaration with keys "dtype", "scale" and/or
+   * "errorBound", and optional "offset".
+   * @return The quantization or an error if the JSON is malformed.
+   */
+  static Result<Quantization> FromJson(const nlohmann::json& j) {
+    if (!j.is_object() || !j.contains("dtype") || !j["dtype"].is_string()) {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\tExpected string key 'dtype'");
+    }
+    Quantization q;
+    q.dtype = j["dtype"].get<std::string>();
+    if (q.dtype != "int8" && q.dtype != "int16") {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\t'dtype' must be 'int8' or 'int16'");
+    }
+    for (const char* key : {"scale", "offset", "errorBound"}) {
+      if (j.contains(key) && !j[key].is_number()) {
+        return absl::InvalidArgumentError(
+            "Error parsing quantization:\n\t'" + std::string(key) +
+            "' must be a number");
+      }
+    }
+    if (!j.contains("scale") && !j.contains("errorBound")) {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\tExpected 'scale' or 'errorBound'");
+    }
+    if (j.contains("scale")) {
+      q.scale = j["scale"].get<float>();
+    } else {
+      q.scale = static_cast<float>(2 * j["errorBound"].get<double>());
+    }
+    if (!(q.scale > 0) || !std::isfinite(q.scale)) {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\t'scale' must be positive");
+    }
+    q.errorBound = j.contains("errorBound") ? j["errorBound"].get<double>()
+                                            : double{q.scale} / 2;
+    // Allow for the rounding of the declared scale to float.
+    if (double{q.scale} / 2 > q.errorBound * (1 + 1e-6)) {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\t'scale' of " +
+          std::to_string(q.scale) + " cannot honor an 'errorBound' of " +
+          std::to_string(q.errorBound));
+    }
+    q.offset = j.contains("offset") ? j["offset"].get<float>() : 0.0f;
+    if (!std::isfinite(q.offset)) {
+      return absl::InvalidArgumentError(
+          "Error parsing quantization:\n\t'offset' must be finite");
+    }
+    return q;
+  }
+
+  nlohmann::json ToJson() const {
+    return {{"dtype", dtype},
+            {"scale", scale},
+            {"offset", offset},
+            {"errorBound", errorBound}};
+  }
+
+  /// The code stored for missing values, the lowest of the dtype.
+  float fill_code() const { return dtype == "int8" ? -128.0f : -32768.0f; }
+
+  /// The lowest code of a finite value.
+  float min_code() const { return fill_code() + 1; }
+
+  /// The highest code of a finite value.
+  float max_code() const { return dtype == "int8" ? 127.0f : 32767.0f; }
+
+  /// Converts codes held as float32 to values, in place.
+  void Dequantize(float* values, Index n) const {
+    kernels::Dequantize(values, n, scale, offset, fill_code());
+  }
+
+  /**
+   * @brief Converts values to codes held as float32.
+   * @return An OutOfRangeError if any finite value lies outside of the range
+   * the codes can represent.
+   */
+  absl::Status Quantize(const float* src, float* codes, Index n) const {
+    Index clamped = kernels::Quantize(src, codes, n, scale, offset, min_code(),
+                                      max_code());
+    if (clamped != 0) {
+      return absl::OutOfRangeError(
+          std::to_string(clamped) + " values lie outside of the quantized " +
+          "range [" + std::to_string(min_code() * scale + offset) + ", " +
+          std::to_string(max_code() * scale + offset) + "].");
+    }
+    return absl::OkStatus();
+  }
+};
+
+namespace internal {
+
+/**
+ * @brief Retrieves the quantization declared in a Variable's user attributes.
+ * @param attrs The attributes as returned by `Variable::GetAttributes`.
+ * @return The quantization, or a NotFoundError if none is declared.
+ */
+inline Result<Quantization> GetQuantization(const nlohmann::json& attrs) {
+  if (!attrs.contains("attributes") ||
+      !attrs["attributes"].contains(kQuantizationKey)) {
+    return absl::NotFoundError("The Variable is not quantized.");
+  }
+  return Quantization::FromJson(attrs["attributes"][kQuantizationKey]);
+}
+
+}  // namespace internal
+
+/**
+ * @brief Retrieves the quantization declared on a Variable.
+ * The Variable parses it once per change of its User Attributes.
+ * @return The quantization, or a NotFoundError if the Variable is not
+ * quantized.
+ */
+template <typename V>
+Result<Quantization> GetQuantization(const V& variable) {
+  return variable.get_quantization();
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_QUANTIZATION_H_
@@ -0,0 +1,222 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/quantization.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+::nlohmann::json GetQuantizedToy(const ::nlohmann::json& quantization) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 10},
+      {"name": "time", "size": 50}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": {"chunkShape": [5, 25]}
+      },
+      "attributes": {}
+    }
+  }
+]
+  )";
+  auto json = mdio::test_util::Manifest("quantized", variables);
+  json["variables"][0]["metadata"]["attributes"]["quantization"] =
+      quantization;
+  return json;
+}
+
+mdio::Result<mdio::Dataset> MakeQuantizedDataset(
+    const std::string& path, const ::nlohmann::json& quantization) {
+  return mdio::test_util::SETUP(path, GetQuantizedToy(quantization)).result();
+}
+
+float Sample(int i, int k) { return std::sin(0.1f * i + 0.05f * k) * 20.0f; }
+
+TEST(Quantization, fromJson) {
+  auto derived = mdio::Quantization::FromJson(
+      {{"dtype", "int16"}, {"errorBound", 0.005}});
+  ASSERT_TRUE(derived.status().ok()) << derived.status();
+  EXPECT_FLOAT_EQ(derived.value().scale, 0.01f);
+  EXPECT_EQ(derived.value().offset, 0);
+
+  auto scaled =
+      mdio::Quantization::FromJson({{"dtype", "int8"}, {"scale", 0.1}});
+  ASSERT_TRUE(scaled.status().ok()) << scaled.status();
+  EXPECT_DOUBLE_EQ(scaled.value().errorBound, double{0.1f} / 2);
+  EXPECT_EQ(scaled.value().fill_code(), -128);
+
+  EXPECT_FALSE(mdio::Quantization::FromJson({{"dtype", "int16"}}).ok())
+      << "A scale or error bound is required";
+  EXPECT_FALSE(
+      mdio::Quantization::FromJson({{"dtype", "int32"}, {"scale", 1}}).ok());
+  EXPECT_FALSE(
+      mdio::Quantization::FromJson({{"dtype", "int16"}, {"scale", -1}}).ok());
+  EXPECT_FALSE(mdio::Quantization::FromJson(
+                   {{"dtype", "int16"}, {"scale", 1}, {"errorBound", 0.1}})
+                   .ok())
+      << "The scale cannot honor the error bound";
+}
+
+TEST(Quantization, storesIntegerCodes) {
+  const std::string path = "zarrs/quantized";
+  auto dsRes = MakeQuantizedDataset(
+      path, {{"dtype", "int16"}, {"scale", 0.001}, {"offset", 0}});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto raw = dsRes.value().variables.at("image").value();
+  EXPECT_EQ(raw.dtype(), mdio::constants::kInt16);
+  auto quantization = mdio::GetQuantization(raw);
+  ASSERT_TRUE(quantization.status().ok()) << quantization.status();
+  EXPECT_FLOAT_EQ(quantization.value().scale, 0.001f);
+  EXPECT_DOUBLE_EQ(quantization.value().errorBound, double{0.001f} / 2);
+  std::filesystem::remove_all(path);
+}
+
+TEST(Quantization, rejectsNonFloat) {
+  auto json = GetQuantizedToy({{"dtype", "int16"}, {"scale", 0.1}});
+  json["variables"][0]["dataType"] = "int32";
+  auto dsRes = mdio::Dataset::from_json(json, "zarrs/quantized",
+                                        mdio::constants::kCreateClean)
+                   .result();
+  EXPECT_FALSE(dsRes.status().ok());
+}
+
+TEST(Quantization, roundTrip) {
+  const std::string path = "zarrs/quantized";
+  auto dsRes = MakeQuantizedDataset(
+      path, {{"dtype", "int16"}, {"errorBound", 0.001}, {"offset", 1}});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image");
+  ASSERT_TRUE(image.status().ok()) << image.status();
+
+  auto dataRes = mdio::from_variable<float>(image.value());
+  ASSERT_TRUE(dataRes.status().ok()) << dataRes.status();
+  auto data = dataRes.value();
+  auto accessor = data.get_data_accessor();
+  for (int i = 0; i < 10; ++i) {
+    for (int k = 0; k < 50; ++k) {
+      accessor({i, k}) = Sample(i, k);
+    }
+  }
+  accessor({3, 7}) = std::nanf("");
+  auto written = image.value().Write(data).result();
+  ASSERT_TRUE(written.status().ok()) << written.status();
+
+  auto readRes = image.value().Read().result();
+  ASSERT_TRUE(readRes.status().ok()) << readRes.status();
+  auto values = readRes.value().get_data_accessor();
+  for (int i = 0; i < 10; ++i) {
+    for (int k = 0; k < 50; ++k) {
+      if (i == 3 && k == 7) {
+        EXPECT_TRUE(std::isnan(values({i, k}))) << "NaN is stored as fill";
+        continue;
+      }
+      EXPECT_NEAR(values({i, k}), Sample(i, k), 0.001 + 1e-5)
+          << "at " << i << ", " << k;
+    }
+  }
+
+  // The store holds the codes, code = round((value - offset) / scale).
+  auto raw = dsRes.value().variables.at("image").value();
+  auto rawData = raw.Read().result();
+  ASSERT_TRUE(rawData.status().ok()) << rawData.status();
+  auto codes = tensorstore::StaticDataTypeCast<int16_t>(
+                   rawData.value().get_data_accessor())
+                   .value();
+  EXPECT_EQ(codes({0, 0}), -500);
+  EXPECT_EQ(codes({3, 7}), -32768);
+  std::filesystem::remove_all(path);
+}
+
+TEST(Quantization, outOfRange) {
+  const std::string path = "zarrs/quantized";
+  auto dsRes =
+      MakeQuantizedDataset(path, {{"dtype", "int8"}, {"scale", 0.1}});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+  auto data = mdio::from_variable<float>(image).value();
+  auto accessor = data.get_data_accessor();
+  for (int i = 0; i < 10; ++i) {
+    for (int k = 0; k < 50; ++k) {
+      accessor({i, k}) = 1.0f;
+    }
+  }
+  accessor({9, 49}) = 13.0f;
+  auto written = image.Write(data).result();
+  EXPECT_TRUE(absl::IsOutOfRange(written.status())) << written.status();
+  std::filesystem::remove_all(path);
+}
+
+TEST(Quantization, statsOnDequantizedValues) {
+  const std::string path = "zarrs/quantized";
+  auto dsRes =
+      MakeQuantizedDataset(path, {{"dtype", "int8"}, {"scale", 0.5}});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.get<float>("image").value();
+  auto data = mdio::from_variable<float>(image).value();
+  auto accessor = data.get_data_accessor();
+  for (int i = 0; i < 10; ++i) {
+    for (int k = 0; k < 50; ++k) {
+      accessor({i, k}) = k < 25 ? -2.0f : 3.0f;
+    }
+  }
+  accessor({0, 0}) = std::nanf("");
+  ASSERT_TRUE(image.Write(data).result().ok());
+
+  auto readRes = image.Read().result();
+  ASSERT_TRUE(readRes.status().ok()) << readRes.status();
+  auto values = readRes.value().get_data_accessor();
+  auto stats = mdio::ComputeSummaryStats(
+      values.byte_strided_origin_pointer().get(), values.num_elements(), 5);
+  EXPECT_EQ(stats["count"], 499);
+  EXPECT_FLOAT_EQ(stats["min"].get<float>(), -2.0f);
+  EXPECT_FLOAT_EQ(stats["max"].get<float>(), 3.0f);
+  EXPECT_FLOAT_EQ(stats["sum"].get<float>(), 249 * -2.0f + 250 * 3.0f);
+  EXPECT_EQ(stats["histogram"]["counts"],
+            ::nlohmann::json({249, 0, 0, 0, 250}));
+
+  auto attrs = image.GetAttributes();
+  attrs["statsV1"] = stats;
+  auto updated = image.UpdateAttributes<float>(attrs);
+  EXPECT_TRUE(updated.status().ok()) << updated.status();
+  EXPECT_TRUE(mdio::GetQuantization(image).ok())
+      << "Updating the stats keeps the quantization";
+
+  // The parsed quantization follows replaced attributes.
+  attrs["attributes"]["quantization"]["scale"] = 0.02;
+  ASSERT_TRUE(image.UpdateAttributes<float>(attrs).status().ok());
+  EXPECT_FLOAT_EQ(mdio::GetQuantization(image).value().scale, 0.02f);
+  std::filesystem::remove_all(path);
+}
+
+}  // namespace
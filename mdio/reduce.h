@@ -0,0 +1,499 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_REDUCE_H_
+#define MDIO_REDUCE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/kernels/kernels.h"
+#include "mdio/map_blocks.h"
+#include "mdio/variable_collection.h"
+
+namespace mdio {
+
+/**
+ * @brief The reductions of Reduce.
+ */
+enum class ReduceOp {
+  kSum,
+  kMean,
+  // The root mean square.
+  kRms,
+  kMin,
+  kMax,
+  // The index along the reduced dimension of the first maximum, -1 if every
+  // sample is masked.
+  kArgMax,
+  kCountNonzero,
+};
+
+/**
+ * @brief Options of Reduce, on top of those of MapBlocks.
+ * The block shape is over the dimensions of the output.
+ */
+struct ReduceOptions : MapBlocksOptions {
+  // Samples where the mask is zero are skipped, like NaN samples. Its labeled
+  // dimensions must be dimensions of the reduced Variable, and it is broadcast
+  // over the others, so a live mask of the traces masks every sample of them.
+  std::optional<Variable<>> mask;
+  // The extent of the reduced dimension read at once; 0 uses its chunk size.
+  Index step = 0;
+};
+
+namespace internal {
+
+// Running reductions over the samples of one output block.
+class Accumulator {
+ public:
+  Accumulator(ReduceOp op, Index size) : op_(op) {
+    switch (op) {
+      case ReduceOp::kSum:
+      case ReduceOp::kMean:
+      case ReduceOp::kRms:
+        sum_.assign(size, 0.0);
+        count_.assign(size, 0.0);
+        break;
+      case ReduceOp::kMin:
+        // The sum is only kept for the count of valid samples.
+        sum_.assign(size, 0.0);
+        count_.assign(size, 0.0);
+        min_.assign(size, std::numeric_limits<float>::infinity());
+        break;
+      case ReduceOp::kMax:
+      case ReduceOp::kArgMax:
+        max_.assign(size, -std::numeric_limits<float>::infinity());
+        argmax_.assign(size, -1);
+        break;
+      case ReduceOp::kCountNonzero:
+        count_.assign(size, 0.0);
+        break;
+    }
+  }
+
+  // Adds samples laid out as [outer, steps, inner] in C order, where the
+  // first step is at `position` along the reduced dimension.
+  void Add(const float* samples, Index outer, Index steps, Index inner,
+           Index position) {
+    for (Index o = 0; o < outer; ++o) {
+      const Index at = o * inner;
+      for (Index s = 0; s < steps; ++s) {
+        const float* row = samples + (o * steps + s) * inner;
+        switch (op_) {
+          case ReduceOp::kSum:
+          case ReduceOp::kMean:
+            kernels::AccumulateSum(row, &sum_[at], &count_[at], inner);
+            break;
+          case ReduceOp::kRms:
+            kernels::AccumulateSquares(row, &sum_[at], &count_[at], inner);
+            break;
+          case ReduceOp::kMin:
+            kernels::AccumulateSum(row, &sum_[at], &count_[at], inner);
+            kernels::AccumulateMin(row, &min_[at], inner);
+            break;
+          case ReduceOp::kMax:
+          case ReduceOp::kArgMax:
+            kernels::AccumulateMax(row, &max_[at], &argmax_[at], position + s,
+                                   inner);
+            break;
+          case ReduceOp::kCountNonzero:
+            kernels::CountNonzero(row, &count_[at], inner);
+            break;
+        }
+      }
+    }
+  }
+
+  // Writes the reductions out. Elements with no valid sample are NaN, except
+  // for sums and counts, which are zero, and arg maxima, which are -1.
+  void Finish(double* out) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const Index size =
+        static_cast<Index>(std::max(count_.size(), max_.size()));
+    for (Index i = 0; i < size; ++i) {
+      switch (op_) {
+        case ReduceOp::kSum:
+          out[i] = sum_[i];
+          break;
+        case ReduceOp::kMean:
+          out[i] = count_[i] > 0 ? sum_[i] / count_[i] : nan;
+          break;
+        case ReduceOp::kRms:
+          out[i] = count_[i] > 0 ? std::sqrt(sum_[i] / count_[i]) : nan;
+          break;
+        case ReduceOp::kMin:
+          out[i] = count_[i] > 0 ? min_[i] : nan;
+          break;
+        case ReduceOp::kMax:
+          out[i] = argmax_[i] >= 0 ? max_[i] : nan;
+          break;
+        case ReduceOp::kArgMax:
+          out[i] = static_cast<double>(argmax_[i]);
+          break;
+        case ReduceOp::kCountNonzero:
+          out[i] = count_[i];
+          break;
+      }
+    }
+  }
+
+ private:
+  ReduceOp op_;
+  std::vector<double> sum_;
+  // Counts are exact in double up to 2^53.
+  std::vector<double> count_;
+  std::vector<float> min_;
+  std::vector<float> max_;
+  std::vector<Index> argmax_;
+};
+
+// The reads of one step along the reduced dimension.
+struct ReduceStep {
+  Index lo = 0, hi = 0;
+  // Float inputs are read as float, which also dequantizes them.
+  std::optional<Future<VariableData<float>>> floats;
+  std::optional<Future<VariableData<>>> raw;
+  std::optional<Future<VariableData<>>> mask;
+};
+
+// Issues the reads of the samples of `slab` in [lo, hi) along `label`.
+inline Result<ReduceStep> ReadStep(const Variable<>& slab,
+                                   const std::optional<Variable<>>& mask,
+                                   const std::string& label, bool asFloat,
+                                   Index lo, Index hi) {
+  ReduceStep step;
+  step.lo = lo;
+  step.hi = hi;
+  MDIO_ASSIGN_OR_RETURN(auto domain, tensorstore::IndexDomainBuilder<>(1)
+                                         .origin({lo})
+                                         .shape({hi - lo})
+                                         .labels({label})
+                                         .Finalize())
+  MDIO_ASSIGN_OR_RETURN(auto sliced,
+                        SliceToDomain(slab, IndexDomainView<>(domain)))
+  if (asFloat) {
+    MDIO_ASSIGN_OR_RETURN(
+        auto floats,
+        (CastVariable<float, dynamic_rank, ReadWriteMode::dynamic>(sliced)))
+    step.floats = floats.Read();
+  } else {
+    step.raw = sliced.Read();
+  }
+  if (mask) {
+    MDIO_ASSIGN_OR_RETURN(auto maskStep,
+                          SliceToDomain(*mask, IndexDomainView<>(domain)))
+    step.mask = maskStep.Read();
+  }
+  return step;
+}
+
+// Sets the samples where the mask is zero to NaN. Both are in C order and the
+// mask covers the samples over the dimensions it has.
+inline void ApplyMask(
+    const SharedArray<float, dynamic_rank, offset_origin>& samples,
+    const std::vector<std::string>& labels,
+    const SharedArray<bool, dynamic_rank, offset_origin>& mask,
+    const std::vector<std::string>& maskLabels) {
+  const DimensionIndex rank = samples.rank();
+  // The stride of the mask along each dimension of the samples.
+  std::vector<Index> strides(rank, 0);
+  for (DimensionIndex d = 0; d < rank; ++d) {
+    for (DimensionIndex m = 0; m < mask.rank(); ++m) {
+      if (!labels[d].empty() && maskLabels[m] == labels[d]) {
+        strides[d] = mask.byte_strides()[m] / static_cast<Index>(sizeof(bool));
+      }
+    }
+  }
+  float* values = samples.byte_strided_origin_pointer().get();
+  const bool* live = mask.byte_strided_origin_pointer().get();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const Index n = samples.num_elements();
+  std::vector<Index> position(rank, 0);
+  Index offset = 0;
+  for (Index i = 0; i < n; ++i) {
+    if (!live[offset]) {
+      values[i] = nan;
+    }
+    for (DimensionIndex d = rank - 1; d >= 0; --d) {
+      offset += strides[d];
+      if (++position[d] < samples.shape()[d]) {
+        break;
+      }
+      offset -= strides[d] * position[d];
+      position[d] = 0;
+    }
+  }
+}
+
+}  // namespace internal
+
+/**
+ * @brief Reduces a Variable along one dimension into an output Variable.
+ * Makes attribute maps such as RMS amplitude, or stacks over offset, from
+ * Variables of any size. The output is divided into blocks as in MapBlocks,
+ * and the worker of a block streams the input through it one step of the
+ * reduced dimension at a time, reading the next step while it accumulates
+ * the current one with the vectorized kernels. Memory is a few blocks of the
+ * output per worker, whatever the extent of the reduced dimension.
+ * Samples are reduced as float32 and accumulated in double. NaN samples, such
+ * as the fill of quantized Variables, and samples where `options.mask` is zero
+ * are skipped.
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto seismic, ds.variables.at("seismic"))
+ * MDIO_ASSIGN_OR_RETURN(auto rms, ds.variables.at("rms_amplitude"))
+ * mdio::ReduceOptions options;
+ * MDIO_ASSIGN_OR_RETURN(options.mask, ds.variables.at("live_mask"))
+ * MDIO_ASSIGN_OR_RETURN(
+ *     auto summary,
+ *     mdio::Reduce(seismic, "time", mdio::ReduceOp::kRms, rms, options))
+ * @endcode
+ * Structarray fields are reduced by passing the Variable Dataset::SelectField
+ * returns.
+ * @param variable The Variable to reduce.
+ * @param label The dimension to reduce.
+ * @param op The reduction.
+ * @param output The Variable to write, over the other dimensions of
+ * `variable` in the same order. Results are converted to its data type.
+ * @param options The mask, step, block shape, threads and progress.
+ * @return The final progress, or the first error of a read or a write.
+ */
+inline Result<MapBlocksProgress> Reduce(const Variable<>& variable,
+                                        const std::string& label, ReduceOp op,
+                                        const Variable<>& output,
+                                        const ReduceOptions& options = {}) {
+  const auto domain = variable.get_store().domain();
+  std::vector<std::string> labels(domain.labels().begin(),
+                                  domain.labels().end());
+  auto found = std::find(labels.begin(), labels.end(), label);
+  if (label.empty() || found == labels.end()) {
+    return absl::NotFoundError("Variable " + variable.get_variable_name() +
+                               " has no dimension '" + label + "'.");
+  }
+  const DimensionIndex reduced = found - labels.begin();
+
+  std::vector<std::string> expected = labels;
+  expected.erase(expected.begin() + reduced);
+  const auto outputDomain = output.get_store().domain();
+  const auto outputLabels = outputDomain.labels();
+  if (!std::equal(expected.begin(), expected.end(), outputLabels.begin(),
+                  outputLabels.end())) {
+    return absl::InvalidArgumentError(
+        "Output " + output.get_variable_name() + " must have the dimensions " +
+        "of " + variable.get_variable_name() + " without '" + label + "'.");
+  }
+  std::vector<std::string> maskLabels;
+  if (options.mask) {
+    auto maskDomain = options.mask->get_store().domain();
+    maskLabels.assign(maskDomain.labels().begin(), maskDomain.labels().end());
+    for (const auto& maskLabel : maskLabels) {
+      if (maskLabel.empty() || std::find(labels.begin(), labels.end(),
+                                         maskLabel) == labels.end()) {
+        return absl::InvalidArgumentError(
+            "Every dimension of the mask must be a labeled dimension of " +
+            variable.get_variable_name() + ".");
+      }
+    }
+  }
+
+  Index step = options.step;
+  if (step <= 0) {
+    MDIO_ASSIGN_OR_RETURN(auto chunks, variable.get_chunk_shape())
+    step = reduced < static_cast<DimensionIndex>(chunks.size())
+               ? chunks[reduced]
+               : domain[reduced].size();
+  }
+  step = std::max<Index>(step, 1);
+  const bool asFloat = variable.dtype() == constants::kFloat32 ||
+                       GetQuantization(variable).ok();
+  const IndexInterval extent = domain[reduced].interval();
+  // Steps are aligned to multiples of the step, as blocks are.
+  auto stepEnd = [&](Index lo) {
+    return std::min((internal::FloorDiv(lo, step) + 1) * step,
+                    extent.exclusive_max());
+  };
+
+  MDIO_ASSIGN_OR_RETURN(auto blockShape,
+                        internal::ResolveBlockShape(output, options))
+  auto issue = [&](internal::PendingBlock& pending) -> absl::Status {
+    MDIO_ASSIGN_OR_RETURN(
+        auto slab, internal::SliceToDomain(
+                       variable, IndexDomainView<>(pending.block.domain)))
+    std::optional<Variable<>> mask;
+    if (options.mask) {
+      MDIO_ASSIGN_OR_RETURN(
+          mask, internal::SliceToDomain(
+                    *options.mask, IndexDomainView<>(pending.block.domain)))
+    }
+    // The first step is read while the worker finishes its previous block.
+    const Index lo = extent.inclusive_min();
+    MDIO_ASSIGN_OR_RETURN(
+        auto first,
+        internal::ReadStep(slab, mask, label, asFloat, lo, stepEnd(lo)))
+    pending.assemble = [&, slab, mask, first = std::move(first)](
+                           internal::PendingBlock& ready) -> Result<Index> {
+      const auto slabDomain = slab.get_store().domain();
+      Index outer = 1, inner = 1;
+      for (DimensionIndex d = 0; d < slabDomain.rank(); ++d) {
+        if (d < reduced) {
+          outer *= slabDomain.shape()[d];
+        } else if (d > reduced) {
+          inner *= slabDomain.shape()[d];
+        }
+      }
+      internal::Accumulator accumulator(op, outer * inner);
+      trace::Span span("Reduce::accumulate", "compute");
+      Index bytesRead = 0;
+      auto current = first;
+      while (true) {
+        std::optional<internal::ReduceStep> next;
+        if (current.hi < extent.exclusive_max()) {
+          MDIO_ASSIGN_OR_RETURN(
+              next, internal::ReadStep(slab, mask, label, asFloat, current.hi,
+                                       stepEnd(current.hi)))
+        }
+        SharedArray<float, dynamic_rank, offset_origin> samples;
+        if (current.floats) {
+          MDIO_ASSIGN_OR_RETURN(auto data, current.floats->result())
+          samples = data.data.data;
+          bytesRead += samples.num_elements() * variable.dtype().size();
+        } else {
+          MDIO_ASSIGN_OR_RETURN(auto data, current.raw->result())
+          samples = tensorstore::AllocateArray<float>(
+              data.data.data.domain(), mdio::ContiguousLayoutOrder::c,
+              tensorstore::default_init);
+          auto status =
+              tensorstore::CopyConvertedArray(data.data.data, samples);
+          if (!status.ok()) {
+            return status;
+          }
+          bytesRead += data.num_samples() * data.dtype().size();
+        }
+        if (current.mask) {
+          MDIO_ASSIGN_OR_RETURN(auto data, current.mask->result())
+          auto live = tensorstore::AllocateArray<bool>(
+              data.data.data.domain(), mdio::ContiguousLayoutOrder::c,
+              tensorstore::default_init);
+          auto status = tensorstore::CopyConvertedArray(data.data.data, live);
+          if (!status.ok()) {
+            return status;
+          }
+          internal::ApplyMask(samples, labels, live, maskLabels);
+        }
+        // Reads allocate C order arrays.
+        accumulator.Add(samples.byte_strided_origin_pointer().get(), outer,
+                        current.hi - current.lo, inner, current.lo);
+        if (!next) {
+          break;
+        }
+        current = std::move(*next);
+      }
+      span.End();
+
+      auto reduction = tensorstore::AllocateArray<double>(
+          ready.block.domain.box(), mdio::ContiguousLayoutOrder::c,
+          tensorstore::default_init);
+      accumulator.Finish(reduction.byte_strided_origin_pointer().get());
+      ready.block.inputs.push_back(VariableData<>{
+          output.get_variable_name(), output.get_long_name(),
+          output.getSharedReducedMetadata(),
+          LabeledArray<void, dynamic_rank, offset_origin>{ready.block.domain,
+                                                          reduction}});
+      return bytesRead;
+    };
+    return absl::OkStatus();
+  };
+
+  // The reduction arrives as the only input and is converted to the output.
+  auto convert = [](Block& block) -> absl::Status {
+    return tensorstore::CopyConvertedArray(block.inputs[0].data.data,
+                                           block.outputs[0].data.data);
+  };
+  return internal::RunBlocks({output}, convert, options, blockShape, issue);
+}
+
+/**
+ * @brief Reduces a Variable of one Dataset into a Variable of another, with
+ * its coordinates.
+ * The output's dimension and coordinate Variables that do not depend on the
+ * reduced dimension are copied from `source` when `target` is another
+ * Dataset that has them.
+ * @param source The Dataset of the Variable to reduce.
+ * @param variable The name of the Variable to reduce.
+ * @param label The dimension to reduce.
+ * @param op The reduction.
+ * @param target The Dataset of the output, which may be `source`.
+ * @param output The name of the output Variable.
+ * @param options The mask, step, block shape, threads and progress.
+ * @return The final progress of the reduction, or the first error.
+ */
+inline Result<MapBlocksProgress> Reduce(const Dataset& source,
+                                        const std::string& variable,
+                                        const std::string& label, ReduceOp op,
+                                        const Dataset& target,
+                                        const std::string& output,
+                                        const ReduceOptions& options = {}) {
+  MDIO_ASSIGN_OR_RETURN(auto input, source.variables.at(variable))
+  MDIO_ASSIGN_OR_RETURN(auto reduced, target.variables.at(output))
+  MDIO_ASSIGN_OR_RETURN(auto summary,
+                        Reduce(input, label, op, reduced, options))
+  if (&source == &target) {
+    return summary;
+  }
+
+  const auto domain = reduced.get_store().domain();
+  std::vector<std::string> names(domain.labels().begin(),
+                                 domain.labels().end());
+  auto coordinates = target.coordinates.find(output);
+  if (coordinates != target.coordinates.end()) {
+    names.insert(names.end(), coordinates->second.begin(),
+                 coordinates->second.end());
+  }
+  std::vector<Future<const void>> copies;
+  for (const auto& name : names) {
+    auto from = source.variables.at(name);
+    auto to = target.variables.at(name);
+    if (name.empty() || !from.ok() || !to.ok()) {
+      continue;
+    }
+    const auto fromDomain = from.value().get_store().domain();
+    auto dimensions = fromDomain.labels();
+    if (std::find(dimensions.begin(), dimensions.end(), label) !=
+        dimensions.end()) {
+      continue;
+    }
+    copies.push_back(tensorstore::Copy(from.value().get_store(),
+                                       to.value().get_store())
+                         .commit_future);
+  }
+  for (auto& copy : copies) {
+    auto status = copy.result().status();
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return summary;
+}
+
+}  // namespace mdio
+
+#endif  // MDIO_REDUCE_H_
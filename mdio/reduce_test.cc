@@ -0,0 +1,287 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/reduce.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/reduce.mdio";
+/*NOLINT*/ const std::string kMapsPath = "zarrs/testing/reduce_maps.mdio";
+
+// The value written to the seismic at a sample; trace (1, 2) is dead.
+float Sample(mdio::Index i, mdio::Index j, mdio::Index k) {
+  if (i == 1 && j == 2) {
+    return std::numeric_limits<float>::quiet_NaN();
+  }
+  return (i + 1) * (j + 1) * (k - 7.5f);
+}
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "seismic",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ],
+    "coordinates": ["inline", "crossline"],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4, 8] }
+      }
+    }
+  },
+  {
+    "name": "live_mask",
+    "dataType": "bool",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ]
+  },
+  {
+    "name": "rms",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 4] }
+      }
+    }
+  },
+  {
+    "name": "peak_time",
+    "dataType": "int32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ]
+  },
+  {
+    "name": "stack",
+    "dataType": "float64",
+    "dimensions": [
+      {"name": "crossline", "size": 5},
+      {"name": "time", "size": 16}
+    ]
+  },
+  {
+    "name": "inline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "inline", "size": 6}]
+  },
+  {
+    "name": "crossline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "crossline", "size": 5}]
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("reduce", variables));
+  ds = mdio::test_util::Fill<float>(ds, "seismic", [](auto index) {
+    return Sample(index[0], index[1], index[2]);
+  });
+  // Inline 4 is masked out.
+  ds = mdio::test_util::Fill<bool>(ds, "live_mask", [](auto index) {
+    return index[0] != 4;
+  });
+  return mdio::test_util::Fill<uint32_t>(ds, "inline", [](auto index) {
+    return 100 + index[0];
+  });
+}
+
+TEST(Reduce, rms) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  mdio::ReduceOptions options;
+  options.numThreads = 4;
+  // Two steps per block.
+  options.step = 8;
+  auto summary =
+      mdio::Reduce(vars.at("seismic").value(), "time", mdio::ReduceOp::kRms,
+                   vars.at("rms").value(), options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+  EXPECT_EQ(summary.value().blocksTotal, 4);
+  EXPECT_EQ(summary.value().bytesRead, 6 * 5 * 16 * 4);
+  EXPECT_EQ(summary.value().bytesWritten, 6 * 5 * 4);
+
+  auto rms = vars.get<float>("rms").value().Read().result();
+  ASSERT_TRUE(rms.ok()) << rms.status();
+  auto data = rms.value().get_data_accessor();
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      if (i == 1 && j == 2) {
+        EXPECT_TRUE(std::isnan(data({i, j})));
+        continue;
+      }
+      double sum = 0;
+      for (int k = 0; k < 16; ++k) {
+        sum += static_cast<double>(Sample(i, j, k)) * Sample(i, j, k);
+      }
+      EXPECT_FLOAT_EQ(data({i, j}), std::sqrt(sum / 16)) << i << " " << j;
+    }
+  }
+}
+
+TEST(Reduce, argMaxMasked) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  mdio::ReduceOptions options;
+  options.mask = vars.at("live_mask").value();
+  auto summary =
+      mdio::Reduce(vars.at("seismic").value(), "time", mdio::ReduceOp::kArgMax,
+                   vars.at("peak_time").value(), options);
+  ASSERT_TRUE(summary.ok()) << summary.status();
+
+  auto peak = vars.get<int32_t>("peak_time").value().Read().result();
+  ASSERT_TRUE(peak.ok()) << peak.status();
+  auto data = peak.value().get_data_accessor();
+  for (int i = 0; i < 6; ++i) {
+    for (int j = 0; j < 5; ++j) {
+      bool dead = i == 4 || (i == 1 && j == 2);
+      EXPECT_EQ(data({i, j}), dead ? -1 : 15) << i << " " << j;
+    }
+  }
+}
+
+TEST(Reduce, stack) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+
+  for (auto op : {mdio::ReduceOp::kMean, mdio::ReduceOp::kSum,
+                  mdio::ReduceOp::kMin, mdio::ReduceOp::kCountNonzero}) {
+    auto summary = mdio::Reduce(vars.at("seismic").value(), "inline", op,
+                                vars.at("stack").value());
+    ASSERT_TRUE(summary.ok()) << summary.status();
+    auto stack = vars.get<double>("stack").value().Read().result();
+    ASSERT_TRUE(stack.ok()) << stack.status();
+    auto data = stack.value().get_data_accessor();
+    for (int j = 0; j < 5; ++j) {
+      for (int k = 0; k < 16; ++k) {
+        // The dead trace is skipped.
+        double sum = 0, count = 0, min = INFINITY;
+        for (int i = 0; i < 6; ++i) {
+          float v = Sample(i, j, k);
+          if (!std::isnan(v)) {
+            sum += v;
+            count += v != 0;
+            min = std::min<double>(min, v);
+          }
+        }
+        double live = j == 2 ? 5 : 6;
+        double expected = op == mdio::ReduceOp::kMean  ? sum / live
+                          : op == mdio::ReduceOp::kSum ? sum
+                          : op == mdio::ReduceOp::kMin ? min
+                                                       : count;
+        EXPECT_DOUBLE_EQ(data({j, k}), expected)
+            << j << " " << k;
+      }
+    }
+  }
+}
+
+TEST(Reduce, coordinates) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  std::string variables = R"(
+[
+  {
+    "name": "rms",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 6},
+      {"name": "crossline", "size": 5}
+    ],
+    "coordinates": ["inline", "crossline"]
+  },
+  {
+    "name": "inline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "inline", "size": 6}]
+  },
+  {
+    "name": "crossline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "crossline", "size": 5}]
+  }
+]
+  )";
+  auto maps = mdio::test_util::SETUP(
+                  kMapsPath,
+                  mdio::test_util::Manifest("reduce_maps", variables))
+                  .result();
+  ASSERT_TRUE(maps.ok()) << maps.status();
+
+  auto summary = mdio::Reduce(ds.value(), "seismic", "time",
+                              mdio::ReduceOp::kMax, maps.value(), "rms");
+  ASSERT_TRUE(summary.ok()) << summary.status();
+
+  auto inline_ =
+      maps.value().variables.get<uint32_t>("inline").value().Read().result();
+  ASSERT_TRUE(inline_.ok()) << inline_.status();
+  EXPECT_EQ(inline_.value().get_data_accessor()({5}), 105);
+  auto peak =
+      maps.value().variables.get<float>("rms").value().Read().result();
+  ASSERT_TRUE(peak.ok()) << peak.status();
+  EXPECT_FLOAT_EQ(peak.value().get_data_accessor()({2, 3}), Sample(2, 3, 15));
+}
+
+TEST(Reduce, errors) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto& vars = ds.value().variables;
+  auto seismic = vars.at("seismic").value();
+
+  auto missing = mdio::Reduce(seismic, "offset", mdio::ReduceOp::kSum,
+                              vars.at("rms").value());
+  EXPECT_EQ(missing.status().code(), absl::StatusCode::kNotFound);
+  // `stack` is over crossline and time.
+  auto wrongOutput = mdio::Reduce(seismic, "time", mdio::ReduceOp::kSum,
+                                  vars.at("stack").value());
+  EXPECT_EQ(wrongOutput.status().code(), absl::StatusCode::kInvalidArgument);
+
+  mdio::ReduceOptions options;
+  options.mask = vars.at("stack").value();
+  auto wrongMask = mdio::Reduce(vars.at("live_mask").value(), "inline",
+                                mdio::ReduceOp::kSum,
+                                vars.at("crossline").value(), options);
+  EXPECT_EQ(wrongMask.status().code(), absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
@@ -0,0 +1,581 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_EXPORT_H_
+#define MDIO_SEGY_EXPORT_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "mdio/analytic_coordinate.h"
+#include "mdio/dataset.h"
+#include "mdio/quantization.h"
+#include "mdio/segy/format.h"
+#include "mdio/segy/ingest.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace segy {
+
+/**
+ * @brief Options controlling a SEG-Y export.
+ */
+struct ExportOptions {
+  // The Variable holding the trace samples.
+  std::string seismicVariable = "seismic";
+  // The structarray Variable holding the trace headers. Skipped if absent.
+  std::string headerVariable = "headers";
+  // Byte locations for header fields that are not standard SEG-Y fields, or
+  // that override the standard location.
+  std::vector<HeaderField> headerFields;
+  // The output sample format.
+  int16_t format = static_cast<int16_t>(SampleFormat::kIbm32);
+  // The textual header. Defaults to the Dataset's "textHeader" attribute.
+  std::vector<std::string> textHeader;
+  // The number of traces per output file; 0 writes a single file.
+  Index tracesPerFile = 0;
+  // The memory budget of each worker's slab, in bytes. Slabs hold whole
+  // chunks along the dimension they split, so a budget smaller than one
+  // chunk is raised to it.
+  Index bufferBytes = Index{64} << 20;
+  // The number of worker threads; 0 uses the hardware concurrency.
+  int numThreads = 0;
+};
+
+/**
+ * @brief What an export did.
+ */
+struct ExportSummary {
+  std::vector<std::string> files;
+  Index tracesWritten = 0;
+  Index bytesWritten = 0;
+  double seconds = 0;
+
+  double gigabytes_per_second() const {
+    return seconds > 0 ? bytesWritten / seconds / 1e9 : 0;
+  }
+};
+
+namespace internal {
+
+// The alignment of slab buffers, matching the usual direct I/O requirement.
+constexpr size_t kExportBufferAlignment = 4096;
+
+struct AlignedFree {
+  void operator()(char* p) const { std::free(p); }
+};
+
+// Owns the file descriptor of an output file.
+struct OutputFile {
+  int fd = -1;
+
+  ~OutputFile() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+/**
+ * @brief Writes all of a buffer at a file offset, retrying short writes.
+ */
+inline absl::Status PwriteAll(int fd, const char* data, Index size,
+                              Index offset, const std::string& path) {
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return ErrnoStatus("Writing", path);
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return absl::OkStatus();
+}
+
+/**
+ * @brief Reads a box of a Variable, requesting only the chunks its occupancy
+ * bitmap marks as occupied.
+ */
+template <typename Store>
+Future<SharedArray<void, dynamic_rank, offset_origin>> ReadBox(
+    const Store& box, const std::optional<ChunkOccupancy>& occupancy) {
+  if (occupancy && OccupancyCovers(*occupancy, box)) {
+    return ReadOccupiedArray(box, *occupancy);
+  }
+  return tensorstore::Read(box);
+}
+
+/**
+ * @brief The output file names: `path` itself, or `stem_0000.ext` etc. when
+ * the export is split.
+ */
+inline std::vector<std::string> ExportFileNames(const std::string& path,
+                                                Index numFiles) {
+  if (numFiles == 1) {
+    return {path};
+  }
+  std::string stem = path;
+  std::string extension;
+  auto dot = path.find_last_of('.');
+  auto slash = path.find_last_of('/');
+  if (dot != std::string::npos &&
+      (slash == std::string::npos || dot > slash)) {
+    stem = path.substr(0, dot);
+    extension = path.substr(dot);
+  }
+  std::vector<std::string> names;
+  for (Index i = 0; i < numFiles; ++i) {
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), "_%04lld",
+                  static_cast<long long>(i));  // NOLINT
+    names.push_back(stem + suffix + extension);
+  }
+  return names;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Writes a Dataset's seismic and header Variables out as SEG-Y.
+ * The Dataset may be a subset from `isel` or `sel`; every position of the
+ * seismic Variable's grid dimensions becomes one trace, in C order. The work
+ * is cut into slabs of consecutive traces bounded by `bufferBytes` and
+ * aligned to the chunks of the seismic Variable. Worker threads read a slab,
+ * encode it into an aligned buffer and write it with a positional write, so
+ * output order never serializes the workers. Chunks that a stored occupancy
+ * bitmap marks as empty are not read and export as the fill value. SEG-Y has
+ * no fill code, so NaN samples, such as dead traces, export as 0.
+ *
+ * Trace headers come from the header Variable. Grid dimensions whose name is
+ * a standard header field (e.g. inline, crossline, offset) and that the
+ * header Variable does not hold are filled from the dimension coordinates.
+ * @param dataset The (possibly sliced) Dataset.
+ * @param path The output path. Split exports append a file number.
+ * @param options Variable names, format, file splitting and parallelism.
+ * @return A summary of the export or the first error encountered.
+ */
+inline Result<ExportSummary> ExportSegy(Dataset& dataset,  // NOLINT
+                                        const std::string& path,
+                                        const ExportOptions& options = {}) {
+  auto start = std::chrono::steady_clock::now();
+  MDIO_ASSIGN_OR_RETURN(auto sampleSize, SampleSize(options.format))
+  MDIO_ASSIGN_OR_RETURN(auto seismic,
+                        dataset.variables.at(options.seismicVariable))
+  // Quantized seismic is exported as the dequantized values.
+  std::optional<Quantization> quantization;
+  auto quantizationRes = GetQuantization(seismic);
+  if (quantizationRes.ok()) {
+    quantization = quantizationRes.value();
+  } else if (!absl::IsNotFound(quantizationRes.status())) {
+    return quantizationRes.status();
+  }
+  // Empty chunks need not be read.
+  std::optional<ChunkOccupancy> seismicOccupancy;
+  auto occupancyRes = GetChunkOccupancy(seismic);
+  if (occupancyRes.ok()) {
+    seismicOccupancy = std::move(occupancyRes).value();
+  }
+  auto domain = seismic.dimensions();
+  const DimensionIndex gridRank = domain.rank() - 1;
+  if (gridRank < 1) {
+    return absl::InvalidArgumentError(
+        "The seismic Variable needs at least one grid dimension and a sample "
+        "dimension.");
+  }
+  const Index numSamples = domain[gridRank].size();
+  if (numSamples <= 0 || numSamples > 65535) {
+    return absl::InvalidArgumentError(
+        "SEG-Y traces hold between 1 and 65535 samples, not " +
+        std::to_string(numSamples));
+  }
+  Index numTraces = 1;
+  for (DimensionIndex i = 0; i < gridRank; ++i) {
+    numTraces *= domain[i].size();
+  }
+
+  bool readHeaders = false;
+  Variable<> headers;
+  std::optional<ChunkOccupancy> headerOccupancy;
+  internal::HeaderLayout layout;
+  if (!options.headerVariable.empty()) {
+    auto headerRes = dataset.variables.at(options.headerVariable);
+    if (headerRes.ok()) {
+      headers = headerRes.value();
+      MDIO_ASSIGN_OR_RETURN(auto spec, headers.get_spec())
+      MDIO_ASSIGN_OR_RETURN(
+          layout, internal::HeaderLayout::FromDtype(spec["metadata"]["dtype"],
+                                                    options.headerFields))
+      auto headerDomain = headers.dimensions();
+      bool matches = headerDomain.rank() == gridRank + 1;
+      for (DimensionIndex i = 0; matches && i < gridRank; ++i) {
+        matches = headerDomain[i].interval() == domain[i].interval();
+      }
+      if (!matches) {
+        return absl::InvalidArgumentError(
+            "The header Variable must span the seismic grid.");
+      }
+      readHeaders = true;
+      auto headerOccupancyRes = GetChunkOccupancy(headers);
+      if (headerOccupancyRes.ok()) {
+        headerOccupancy = std::move(headerOccupancyRes).value();
+      }
+    }
+  }
+
+  // Grid dimensions that can be filled in from their coordinates.
+  std::vector<std::pair<HeaderField, std::vector<int64_t>>> gridFields(
+      gridRank);
+  for (DimensionIndex i = 0; i < gridRank; ++i) {
+    std::string label(domain[i].label());
+    auto field = FindHeaderField(label);
+    if (!field.ok() || layout.contains(field.value().name)) {
+      continue;
+    }
+    auto coordVar = dataset.variables.at(label);
+    if (!coordVar.ok() || coordVar.value().rank() != 1) {
+      continue;
+    }
+    auto var = coordVar.value();
+    MDIO_ASSIGN_OR_RETURN(auto coord, ReadCoordinate(var).result())
+    auto values = tensorstore::AllocateArray<int64_t>(
+        coord.get_data_accessor().domain(), mdio::ContiguousLayoutOrder::c,
+        tensorstore::default_init);
+    auto status =
+        tensorstore::CopyConvertedArray(coord.get_data_accessor(), values);
+    if (!status.ok()) {
+      return status;
+    }
+    if (values.num_elements() != domain[i].size()) {
+      continue;
+    }
+    const int64_t* data = values.byte_strided_origin_pointer().get();
+    gridFields[i] = {field.value(),
+                     std::vector<int64_t>(data, data + domain[i].size())};
+  }
+
+  // File headers.
+  auto attrs = dataset.getMetadata().contains("attributes")
+                   ? dataset.getMetadata()["attributes"]
+                   : nlohmann::json::object();
+  std::vector<std::string> textLines = options.textHeader;
+  if (textLines.empty() && attrs.contains("textHeader") &&
+      attrs["textHeader"].is_array()) {
+    textLines = attrs["textHeader"].get<std::vector<std::string>>();
+  }
+  if (textLines.empty()) {
+    textLines = {"C 1 EXPORTED BY MDIO"};
+  }
+  BinaryHeader binary;
+  if (attrs.contains("binaryHeader")) {
+    MDIO_ASSIGN_OR_RETURN(binary, BinaryHeader::FromJson(attrs["binaryHeader"]))
+  } else {
+    auto timeVar = dataset.variables.at(std::string(domain[gridRank].label()));
+    if (timeVar.ok()) {
+      auto coord = GetAnalyticCoordinate(timeVar.value());
+      if (coord.ok()) {
+        // Milliseconds to microseconds.
+        binary.sampleInterval =
+            static_cast<int16_t>(std::lround(coord.value().step * 1000));
+      }
+    }
+  }
+  binary.samplesPerTrace = static_cast<int16_t>(numSamples);
+  binary.formatCode = options.format;
+  binary.numExtendedTextHeaders = 0;
+  binary.fixedLengthFlag = 1;
+
+  // Output files, sized up front so workers can write anywhere.
+  const Index traceSize = kTraceHeaderSize + numSamples * sampleSize;
+  const Index tracesPerFile =
+      options.tracesPerFile > 0 ? options.tracesPerFile : numTraces;
+  const Index numFiles =
+      std::max<Index>(1, (numTraces + tracesPerFile - 1) / tracesPerFile);
+  ExportSummary summary;
+  summary.files = internal::ExportFileNames(path, numFiles);
+  std::vector<std::unique_ptr<internal::OutputFile>> files;
+  std::vector<char> fileHeader(kFileHeaderSize);
+  auto text = EncodeTextHeader(textLines);
+  std::memcpy(fileHeader.data(), text.data(), kTextHeaderSize);
+  binary.Write(fileHeader.data() + kTextHeaderSize);
+  for (Index f = 0; f < numFiles; ++f) {
+    const auto& name = summary.files[f];
+    auto file = std::make_unique<internal::OutputFile>();
+    file->fd = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file->fd < 0) {
+      return internal::ErrnoStatus("Creating", name);
+    }
+    Index traces = std::min(tracesPerFile, numTraces - f * tracesPerFile);
+    Index size = kFileHeaderSize + traces * traceSize;
+    if (ftruncate(file->fd, size) != 0) {
+      return internal::ErrnoStatus("Sizing", name);
+    }
+    auto status = internal::PwriteAll(file->fd, fileHeader.data(),
+                                      kFileHeaderSize, 0, name);
+    if (!status.ok()) {
+      return status;
+    }
+    summary.bytesWritten += size;
+    files.push_back(std::move(file));
+  }
+
+  // Slabs: [1, ..., 1, k, full, ..., full] boxes over the grid dimensions.
+  const Index bytesPerTrace =
+      traceSize + numSamples * static_cast<Index>(seismic.dtype().size()) +
+      layout.itemSize;
+  DimensionIndex splitDim = gridRank - 1;
+  Index innerTraces = 1;
+  while (splitDim > 0 &&
+         innerTraces * domain[splitDim].size() * bytesPerTrace <=
+             options.bufferBytes) {
+    innerTraces *= domain[splitDim].size();
+    --splitDim;
+  }
+  // Slabs start and end on chunk boundaries along splitDim, otherwise the
+  // slabs that straddle a chunk would each fetch and decode it.
+  MDIO_ASSIGN_OR_RETURN(auto chunkShape, seismic.get_chunk_shape())
+  const Index chunkExtent = chunkShape[splitDim];
+  Index slabLength = std::clamp<Index>(
+      options.bufferBytes / (innerTraces * bytesPerTrace), 1,
+      domain[splitDim].size());
+  slabLength = std::max(chunkExtent, slabLength / chunkExtent * chunkExtent);
+  const Index splitOrigin = domain[splitDim].inclusive_min();
+  const Index alignedOrigin = splitOrigin - splitOrigin % chunkExtent;
+  const Index splitBlocks =
+      (domain[splitDim].exclusive_max() - alignedOrigin + slabLength - 1) /
+      slabLength;
+  Index numSlabs = splitBlocks;
+  for (DimensionIndex i = 0; i < splitDim; ++i) {
+    numSlabs *= domain[i].size();
+  }
+
+  std::atomic<Index> nextSlab{0};
+  std::mutex mutex;
+  absl::Status firstError;
+  auto fail = [&](const absl::Status& status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (firstError.ok()) {
+      firstError = status;
+    }
+  };
+  auto failed = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !firstError.ok();
+  };
+
+  const HeaderField samplesField = FindHeaderField("samples_per_trace").value();
+  const HeaderField intervalField = FindHeaderField("sample_interval").value();
+  auto worker = [&] {
+    std::unique_ptr<char, internal::AlignedFree> buffer;
+    size_t capacity = 0;
+    std::vector<Index> pos(gridRank);
+    for (Index slab = nextSlab++; slab < numSlabs && !failed();
+         slab = nextSlab++) {
+      // Locate the slab's box and its first trace in output order.
+      tensorstore::Box<> box(domain.box());
+      Index rem = slab;
+      Index block = rem % splitBlocks;
+      rem /= splitBlocks;
+      Index splitMin =
+          std::max(splitOrigin, alignedOrigin + block * slabLength);
+      Index splitSize =
+          std::min(alignedOrigin + (block + 1) * slabLength,
+                   domain[splitDim].exclusive_max()) -
+          splitMin;
+      box[splitDim] =
+          tensorstore::IndexInterval::UncheckedSized(splitMin, splitSize);
+      Index firstTrace = (splitMin - splitOrigin) * innerTraces;
+      Index outerStride = domain[splitDim].size() * innerTraces;
+      for (DimensionIndex i = splitDim - 1; i >= 0; --i) {
+        Index index = rem % domain[i].size();
+        rem /= domain[i].size();
+        box[i] = tensorstore::IndexInterval::UncheckedSized(
+            domain[i].inclusive_min() + index, 1);
+        firstTrace += index * outerStride;
+        outerStride *= domain[i].size();
+      }
+      const Index count = splitSize * innerTraces;
+
+      auto target = seismic.get_store() | tensorstore::AllDims().BoxSlice(box);
+      if (!target.ok()) {
+        fail(target.status());
+        return;
+      }
+      auto readFuture = internal::ReadBox(target.value(), seismicOccupancy);
+      tensorstore::SharedOffsetArray<void> headerData;
+      if (readHeaders) {
+        tensorstore::Box<> headerBox(headers.dimensions().box());
+        for (DimensionIndex i = 0; i < gridRank; ++i) {
+          headerBox[i] = box[i];
+        }
+        auto headerTarget =
+            headers.get_store() | tensorstore::AllDims().BoxSlice(headerBox);
+        if (!headerTarget.ok()) {
+          fail(headerTarget.status());
+          return;
+        }
+        auto headerRes =
+            internal::ReadBox(headerTarget.value(), headerOccupancy).result();
+        if (!headerRes.ok()) {
+          fail(headerRes.status());
+          return;
+        }
+        headerData = std::move(headerRes).value();
+      }
+      auto readRes = readFuture.result();
+      if (!readRes.ok()) {
+        fail(readRes.status());
+        return;
+      }
+      auto data = std::move(readRes).value();
+
+      if (data.dtype() != constants::kFloat32) {
+        auto converted = tensorstore::AllocateArray<float>(
+            data.domain(), mdio::ContiguousLayoutOrder::c,
+            tensorstore::default_init);
+        auto status = tensorstore::CopyConvertedArray(data, converted);
+        if (!status.ok()) {
+          fail(status);
+          return;
+        }
+        if (quantization) {
+          quantization->Dequantize(
+              converted.byte_strided_origin_pointer().get(),
+              converted.num_elements());
+        }
+        data = converted;
+      }
+      const float* sampleData =
+          static_cast<const float*>(data.byte_strided_origin_pointer().get());
+      const char* headerBytes =
+          readHeaders ? static_cast<const char*>(
+                            headerData.byte_strided_origin_pointer().get())
+                      : nullptr;
+
+      size_t needed = static_cast<size_t>(count * traceSize);
+      if (needed > capacity) {
+        capacity = (needed + internal::kExportBufferAlignment - 1) /
+                   internal::kExportBufferAlignment *
+                   internal::kExportBufferAlignment;
+        buffer.reset(static_cast<char*>(
+            std::aligned_alloc(internal::kExportBufferAlignment, capacity)));
+        if (!buffer) {
+          fail(absl::ResourceExhaustedError(
+              "Unable to allocate the export buffer."));
+          return;
+        }
+      }
+
+      for (Index k = 0; k < count; ++k) {
+        char* trace = buffer.get() + k * traceSize;
+        std::memset(trace, 0, kTraceHeaderSize);
+        Index r = k;
+        for (DimensionIndex i = gridRank - 1; i >= 0; --i) {
+          pos[i] = box[i].inclusive_min() + r % box[i].size() -
+                   domain[i].inclusive_min();
+          r /= box[i].size();
+        }
+        if (headerBytes != nullptr) {
+          layout.Decode(headerBytes + k * layout.itemSize, trace);
+        }
+        for (DimensionIndex i = 0; i < gridRank; ++i) {
+          if (!gridFields[i].second.empty()) {
+            gridFields[i].first.Write(trace, gridFields[i].second[pos[i]]);
+          }
+        }
+        samplesField.Write(trace, numSamples);
+        intervalField.Write(trace, binary.sampleInterval);
+        auto status = EncodeSamples(sampleData + k * numSamples,
+                                    options.format, trace + kTraceHeaderSize,
+                                    numSamples);
+        if (!status.ok()) {
+          fail(status);
+          return;
+        }
+      }
+
+      // Write the slab, split where it straddles output files.
+      Index written = 0;
+      while (written < count) {
+        Index trace = firstTrace + written;
+        Index file = trace / tracesPerFile;
+        Index inFile = trace % tracesPerFile;
+        Index run = std::min(count - written, tracesPerFile - inFile);
+        auto status = internal::PwriteAll(
+            files[file]->fd, buffer.get() + written * traceSize,
+            run * traceSize, kFileHeaderSize + inFile * traceSize,
+            summary.files[file]);
+        if (!status.ok()) {
+          fail(status);
+          return;
+        }
+        written += run;
+      }
+    }
+  };
+
+  int numThreads = options.numThreads > 0
+                       ? options.numThreads
+                       : static_cast<int>(std::thread::hardware_concurrency());
+  numThreads = static_cast<int>(
+      std::clamp<Index>(numThreads, 1, std::max<Index>(numSlabs, 1)));
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!firstError.ok()) {
+    return firstError;
+  }
+  for (Index f = 0; f < numFiles; ++f) {
+    if (fsync(files[f]->fd) != 0) {
+      return internal::ErrnoStatus("Flushing", summary.files[f]);
+    }
+  }
+
+  summary.tracesWritten = numTraces;
+  summary.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  return summary;
+}
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_EXPORT_H_
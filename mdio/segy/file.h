@@ -0,0 +1,224 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_FILE_H_
+#define MDIO_SEGY_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mdio/segy/format.h"
+
+namespace mdio {
+namespace segy {
+namespace internal {
+
+// Owns the file descriptor and the read-only mapping of a SEG-Y file.
+struct Mapping {
+  int fd = -1;
+  const char* data = nullptr;
+  size_t size = 0;
+
+  ~Mapping() {
+    if (data != nullptr && size > 0) {
+      munmap(const_cast<char*>(data), size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+inline absl::Status ErrnoStatus(const std::string& what,
+                                const std::string& path) {
+  return absl::InternalError(what + " '" + path +
+                             "' failed: " + std::strerror(errno));
+}
+
+}  // namespace internal
+
+/**
+ * @brief A read-only, memory-mapped SEG-Y file.
+ * Copies share the underlying mapping, so a SegyFile can be handed to worker
+ * threads freely. Only fixed-length traces are supported; the trace length is
+ * taken from the binary header.
+ *
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto segy, mdio::segy::SegyFile::Open("survey.sgy"));
+ * std::vector<float> trace(segy.num_samples());
+ * auto status = segy.ReadTrace(0, trace.data());
+ * @endcode
+ */
+class SegyFile {
+ public:
+  SegyFile() = default;
+
+  /**
+   * @brief Opens and maps a SEG-Y file.
+   * @param path The path of the SEG-Y file.
+   * @return The mapped file or an error if the file is not valid SEG-Y.
+   */
+  static Result<SegyFile> Open(const std::string& path) {
+    auto mapping = std::make_shared<internal::Mapping>();
+    mapping->fd = ::open(path.c_str(), O_RDONLY);
+    if (mapping->fd < 0) {
+      return internal::ErrnoStatus("Opening", path);
+    }
+    struct stat st;
+    if (fstat(mapping->fd, &st) != 0) {
+      return internal::ErrnoStatus("Stat of", path);
+    }
+    mapping->size = static_cast<size_t>(st.st_size);
+    if (mapping->size < static_cast<size_t>(kFileHeaderSize)) {
+      return absl::InvalidArgumentError("'" + path +
+                                        "' is too small to be a SEG-Y file.");
+    }
+    void* addr = mmap(nullptr, mapping->size, PROT_READ, MAP_PRIVATE,
+                      mapping->fd, 0);
+    if (addr == MAP_FAILED) {
+      return internal::ErrnoStatus("Mapping", path);
+    }
+    mapping->data = static_cast<const char*>(addr);
+    madvise(addr, mapping->size, MADV_SEQUENTIAL);
+
+    SegyFile file;
+    file.path_ = path;
+    file.mapping_ = std::move(mapping);
+    file.binaryHeader_ =
+        BinaryHeader::Parse(file.mapping_->data + kTextHeaderSize);
+
+    const auto& bh = file.binaryHeader_;
+    if (bh.numExtendedTextHeaders < 0) {
+      return absl::UnimplementedError(
+          "A variable number of extended textual headers is not supported.");
+    }
+    // Rev 2 treats the sample count as unsigned.
+    if (static_cast<uint16_t>(bh.samplesPerTrace) == 0) {
+      return absl::InvalidArgumentError(
+          "'" + path + "' declares no samples per trace.");
+    }
+    MDIO_ASSIGN_OR_RETURN(file.sampleSize_, SampleSize(bh.formatCode))
+    file.dataOffset_ = kFileHeaderSize +
+                       static_cast<Index>(bh.numExtendedTextHeaders) *
+                           kTextHeaderSize;
+    file.numSamples_ = static_cast<uint16_t>(bh.samplesPerTrace);
+    file.traceSize_ = kTraceHeaderSize + file.numSamples_ * file.sampleSize_;
+    Index payload = static_cast<Index>(file.mapping_->size) - file.dataOffset_;
+    if (payload < 0 || payload % file.traceSize_ != 0) {
+      return absl::InvalidArgumentError(
+          "'" + path + "' does not hold a whole number of " +
+          std::to_string(file.traceSize_) + " byte traces.");
+    }
+    file.numTraces_ = payload / file.traceSize_;
+    return file;
+  }
+
+  /// The path the file was opened from.
+  const std::string& path() const { return path_; }
+
+  /// The raw 3200 byte textual header.
+  std::string_view raw_text_header() const {
+    return std::string_view(mapping_->data, kTextHeaderSize);
+  }
+
+  /// The textual header decoded to ASCII card images.
+  std::vector<std::string> text_header() const {
+    return DecodeTextHeader(raw_text_header());
+  }
+
+  const BinaryHeader& binary_header() const { return binaryHeader_; }
+
+  int16_t format() const { return binaryHeader_.formatCode; }
+
+  Index num_traces() const { return numTraces_; }
+
+  Index num_samples() const { return numSamples_; }
+
+  Index sample_size() const { return sampleSize_; }
+
+  /// The size of one trace including its 240 byte header.
+  Index trace_size() const { return traceSize_; }
+
+  /// The file offset of the first trace header.
+  Index data_offset() const { return dataOffset_; }
+
+  /// The file size in bytes.
+  Index size() const { return static_cast<Index>(mapping_->size); }
+
+  /// The file descriptor, for positional reads that bypass the mapping.
+  int fd() const { return mapping_->fd; }
+
+  /// A pointer to the 240 byte header of a trace.
+  const char* trace_header(Index trace) const {
+    return mapping_->data + dataOffset_ + trace * traceSize_;
+  }
+
+  /// A pointer to the raw (big-endian) samples of a trace.
+  const char* trace_data(Index trace) const {
+    return trace_header(trace) + kTraceHeaderSize;
+  }
+
+  /**
+   * @brief Decodes the samples of a trace to float32.
+   * @param trace The 0-based trace number.
+   * @param dst Space for `num_samples()` floats.
+   */
+  absl::Status ReadTrace(Index trace, float* dst) const {
+    if (trace < 0 || trace >= numTraces_) {
+      return absl::OutOfRangeError("Trace " + std::to_string(trace) +
+                                   " is out of range.");
+    }
+    return DecodeSamples(trace_data(trace), format(), dst, numSamples_);
+  }
+
+  /**
+   * @brief Hints the kernel to page in a range of traces ahead of use.
+   */
+  void Prefetch(Index firstTrace, Index numTraces) const {
+    Index begin = dataOffset_ + firstTrace * traceSize_;
+    Index end = std::min<Index>(begin + numTraces * traceSize_, size());
+    long page = sysconf(_SC_PAGESIZE);  // NOLINT: POSIX convention
+    begin -= begin % page;
+    if (end > begin) {
+      madvise(const_cast<char*>(mapping_->data) + begin, end - begin,
+              MADV_WILLNEED);
+    }
+  }
+
+ private:
+  std::string path_;
+  std::shared_ptr<internal::Mapping> mapping_;
+  BinaryHeader binaryHeader_;
+  Index sampleSize_ = 0;
+  Index numSamples_ = 0;
+  Index traceSize_ = 0;
+  Index dataOffset_ = 0;
+  Index numTraces_ = 0;
+};
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_FILE_H_
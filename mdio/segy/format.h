@@ -0,0 +1,515 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_FORMAT_H_
+#define MDIO_SEGY_FORMAT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "mdio/kernels/kernels.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+/**
+ * The on-disk layout of SEG-Y rev 1/2 files: the 3200 byte textual header,
+ * the 400 byte binary header, the 240 byte trace headers and the sample
+ * encodings. All multi-byte values in SEG-Y are big-endian.
+ */
+namespace mdio {
+namespace segy {
+
+constexpr Index kTextHeaderSize = 3200;
+constexpr Index kBinaryHeaderSize = 400;
+constexpr Index kTraceHeaderSize = 240;
+constexpr Index kFileHeaderSize = kTextHeaderSize + kBinaryHeaderSize;
+
+/// The SEG-Y data sample format codes (binary header bytes 3225-3226).
+enum class SampleFormat : int16_t {
+  kIbm32 = 1,
+  kInt32 = 2,
+  kInt16 = 3,
+  kIeee32 = 5,
+  kInt8 = 8,
+};
+
+/**
+ * @brief The size in bytes of one sample of the given format.
+ * @return The size, or an UnimplementedError for unsupported formats.
+ */
+inline Result<Index> SampleSize(int16_t format) {
+  switch (static_cast<SampleFormat>(format)) {
+    case SampleFormat::kIbm32:
+    case SampleFormat::kInt32:
+    case SampleFormat::kIeee32:
+      return 4;
+    case SampleFormat::kInt16:
+      return 2;
+    case SampleFormat::kInt8:
+      return 1;
+  }
+  return absl::UnimplementedError("SEG-Y sample format " +
+                                  std::to_string(format) +
+                                  " is not supported.");
+}
+
+namespace internal {
+
+inline uint16_t LoadBE16(const char* p) {
+  uint16_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return __builtin_bswap16(v);
+}
+
+inline uint32_t LoadBE32(const char* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return __builtin_bswap32(v);
+}
+
+inline void StoreBE16(char* p, uint16_t v) {
+  v = __builtin_bswap16(v);
+  std::memcpy(p, &v, sizeof(v));
+}
+
+inline void StoreBE32(char* p, uint32_t v) {
+  v = __builtin_bswap32(v);
+  std::memcpy(p, &v, sizeof(v));
+}
+
+// EBCDIC (code page 037) to ASCII; unmapped characters become spaces.
+inline const char* EbcdicTable() {
+  static const char* table = [] {
+    static char t[256];
+    std::memset(t, ' ', sizeof(t));
+    const char* lower = "abcdefghi";
+    const char* lower2 = "jklmnopqr";
+    const char* lower3 = "stuvwxyz";
+    for (int i = 0; i < 9; ++i) {
+      t[0x81 + i] = lower[i];
+      t[0x91 + i] = lower2[i];
+      t[0xC1 + i] = static_cast<char>(lower[i] - 32);
+      t[0xD1 + i] = static_cast<char>(lower2[i] - 32);
+    }
+    for (int i = 0; i < 8; ++i) {
+      t[0xA2 + i] = lower3[i];
+      t[0xE2 + i] = static_cast<char>(lower3[i] - 32);
+    }
+    for (int i = 0; i < 10; ++i) {
+      t[0xF0 + i] = static_cast<char>('0' + i);
+    }
+    const std::pair<unsigned char, char> punct[] = {
+        {0x40, ' '}, {0x4B, '.'}, {0x4C, '<'}, {0x4D, '('}, {0x4E, '+'},
+        {0x4F, '|'}, {0x50, '&'}, {0x5A, '!'}, {0x5B, '$'}, {0x5C, '*'},
+        {0x5D, ')'}, {0x5E, ';'}, {0x60, '-'}, {0x61, '/'}, {0x6B, ','},
+        {0x6C, '%'}, {0x6D, '_'}, {0x6E, '>'}, {0x6F, '?'}, {0x7A, ':'},
+        {0x7B, '#'}, {0x7C, '@'}, {0x7D, '\''}, {0x7E, '='}, {0x7F, '"'},
+        {0xBA, '['}, {0xBB, ']'}, {0xC0, '{'}, {0xD0, '}'}, {0xE0, '\\'},
+        {0xA1, '~'}, {0xB0, '^'}, {0x79, '`'}};
+    for (auto [ebcdic, ascii] : punct) {
+      t[ebcdic] = ascii;
+    }
+    return t;
+  }();
+  return table;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Decodes a textual header, converting from EBCDIC when needed.
+ * Headers whose first byte is the EBCDIC 'C' (0xC3) are treated as EBCDIC.
+ * @return The header split into its 40 card images of 80 characters.
+ */
+inline std::vector<std::string> DecodeTextHeader(std::string_view raw) {
+  std::string text(raw);
+  if (!text.empty() && static_cast<unsigned char>(text[0]) == 0xC3) {
+    const char* table = internal::EbcdicTable();
+    for (auto& c : text) {
+      c = table[static_cast<unsigned char>(c)];
+    }
+  }
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < text.size(); i += 80) {
+    lines.emplace_back(text.substr(i, 80));
+  }
+  return lines;
+}
+
+/**
+ * @brief Encodes card images as an EBCDIC textual header.
+ * Lines are padded or truncated to 80 characters and the header to 40 lines.
+ */
+inline std::string EncodeTextHeader(const std::vector<std::string>& lines) {
+  // Invert the decoding table; only characters it maps are representable.
+  char inverse[256];
+  std::memset(inverse, 0x40, sizeof(inverse));
+  const char* table = internal::EbcdicTable();
+  for (int i = 255; i >= 0; --i) {
+    inverse[static_cast<unsigned char>(table[i])] = static_cast<char>(i);
+  }
+  inverse[static_cast<unsigned char>(' ')] = 0x40;
+  std::string out(kTextHeaderSize, static_cast<char>(0x40));
+  for (size_t line = 0; line < lines.size() && line < 40; ++line) {
+    for (size_t i = 0; i < lines[line].size() && i < 80; ++i) {
+      out[line * 80 + i] =
+          inverse[static_cast<unsigned char>(lines[line][i])];
+    }
+  }
+  return out;
+}
+
+/**
+ * @brief The fields of the 400 byte binary file header used by MDIO.
+ */
+struct BinaryHeader {
+  int32_t jobId = 0;
+  int32_t lineNumber = 0;
+  int32_t reelNumber = 0;
+  int16_t tracesPerEnsemble = 0;
+  int16_t sampleInterval = 0;
+  int16_t samplesPerTrace = 0;
+  int16_t formatCode = static_cast<int16_t>(SampleFormat::kIbm32);
+  int16_t ensembleFold = 0;
+  int16_t sortingCode = 0;
+  int16_t measurementSystem = 0;
+  uint16_t revision = 0;
+  int16_t fixedLengthFlag = 1;
+  int16_t numExtendedTextHeaders = 0;
+
+  /**
+   * @brief Parses the binary header.
+   * @param p A pointer to the 400 bytes following the textual header.
+   */
+  static BinaryHeader Parse(const char* p) {
+    BinaryHeader h;
+    h.jobId = static_cast<int32_t>(internal::LoadBE32(p + 0));
+    h.lineNumber = static_cast<int32_t>(internal::LoadBE32(p + 4));
+    h.reelNumber = static_cast<int32_t>(internal::LoadBE32(p + 8));
+    h.tracesPerEnsemble = static_cast<int16_t>(internal::LoadBE16(p + 12));
+    h.sampleInterval = static_cast<int16_t>(internal::LoadBE16(p + 16));
+    h.samplesPerTrace = static_cast<int16_t>(internal::LoadBE16(p + 20));
+    h.formatCode = static_cast<int16_t>(internal::LoadBE16(p + 24));
+    h.ensembleFold = static_cast<int16_t>(internal::LoadBE16(p + 26));
+    h.sortingCode = static_cast<int16_t>(internal::LoadBE16(p + 28));
+    h.measurementSystem = static_cast<int16_t>(internal::LoadBE16(p + 54));
+    h.revision = internal::LoadBE16(p + 300);
+    h.fixedLengthFlag = static_cast<int16_t>(internal::LoadBE16(p + 302));
+    h.numExtendedTextHeaders =
+        static_cast<int16_t>(internal::LoadBE16(p + 304));
+    return h;
+  }
+
+  /**
+   * @brief Serializes the binary header.
+   * @param p A pointer to 400 writable bytes. Unmodelled bytes are zeroed.
+   */
+  void Write(char* p) const {
+    std::memset(p, 0, kBinaryHeaderSize);
+    internal::StoreBE32(p + 0, static_cast<uint32_t>(jobId));
+    internal::StoreBE32(p + 4, static_cast<uint32_t>(lineNumber));
+    internal::StoreBE32(p + 8, static_cast<uint32_t>(reelNumber));
+    internal::StoreBE16(p + 12, static_cast<uint16_t>(tracesPerEnsemble));
+    internal::StoreBE16(p + 16, static_cast<uint16_t>(sampleInterval));
+    internal::StoreBE16(p + 20, static_cast<uint16_t>(samplesPerTrace));
+    internal::StoreBE16(p + 24, static_cast<uint16_t>(formatCode));
+    internal::StoreBE16(p + 26, static_cast<uint16_t>(ensembleFold));
+    internal::StoreBE16(p + 28, static_cast<uint16_t>(sortingCode));
+    internal::StoreBE16(p + 54, static_cast<uint16_t>(measurementSystem));
+    internal::StoreBE16(p + 300, revision);
+    internal::StoreBE16(p + 302, static_cast<uint16_t>(fixedLengthFlag));
+    internal::StoreBE16(p + 304, static_cast<uint16_t>(numExtendedTextHeaders));
+  }
+
+  nlohmann::json ToJson() const {
+    return {{"jobId", jobId},
+            {"lineNumber", lineNumber},
+            {"reelNumber", reelNumber},
+            {"tracesPerEnsemble", tracesPerEnsemble},
+            {"sampleInterval", sampleInterval},
+            {"samplesPerTrace", samplesPerTrace},
+            {"formatCode", formatCode},
+            {"ensembleFold", ensembleFold},
+            {"sortingCode", sortingCode},
+            {"measurementSystem", measurementSystem},
+            {"revision", revision},
+            {"fixedLengthFlag", fixedLengthFlag},
+            {"numExtendedTextHeaders", numExtendedTextHeaders}};
+  }
+
+  static Result<BinaryHeader> FromJson(const nlohmann::json& j) {
+    BinaryHeader h;
+    try {
+      h.jobId = j.value("jobId", h.jobId);
+      h.lineNumber = j.value("lineNumber", h.lineNumber);
+      h.reelNumber = j.value("reelNumber", h.reelNumber);
+      h.tracesPerEnsemble = j.value("tracesPerEnsemble", h.tracesPerEnsemble);
+      h.sampleInterval = j.value("sampleInterval", h.sampleInterval);
+      h.samplesPerTrace = j.value("samplesPerTrace", h.samplesPerTrace);
+      h.formatCode = j.value("formatCode", h.formatCode);
+      h.ensembleFold = j.value("ensembleFold", h.ensembleFold);
+      h.sortingCode = j.value("sortingCode", h.sortingCode);
+      h.measurementSystem = j.value("measurementSystem", h.measurementSystem);
+      h.revision = j.value("revision", h.revision);
+      h.fixedLengthFlag = j.value("fixedLengthFlag", h.fixedLengthFlag);
+      h.numExtendedTextHeaders =
+          j.value("numExtendedTextHeaders", h.numExtendedTextHeaders);
+    } catch (const nlohmann::json::exception& e) {
+      return absl::InvalidArgumentError(
+          "There appeared to be some malformed JSON" + std::string(e.what()));
+    }
+    return h;
+  }
+};
+
+/**
+ * @brief A trace header field: its 1-based byte location and width in bytes.
+ */
+struct HeaderField {
+  std::string name;
+  int byte = 1;
+  int width = 4;
+
+  /// Reads the (signed) field value from a 240 byte trace header.
+  int64_t Read(const char* header) const {
+    const char* p = header + byte - 1;
+    if (width == 2) {
+      return static_cast<int16_t>(internal::LoadBE16(p));
+    }
+    return static_cast<int32_t>(internal::LoadBE32(p));
+  }
+
+  /// Writes the field value into a 240 byte trace header.
+  void Write(char* header, int64_t value) const {
+    char* p = header + byte - 1;
+    if (width == 2) {
+      internal::StoreBE16(p, static_cast<uint16_t>(value));
+    } else {
+      internal::StoreBE32(p, static_cast<uint32_t>(value));
+    }
+  }
+};
+
+/**
+ * @brief The SEG-Y rev 1 standard trace header fields.
+ * Field names follow the MDIO header conventions.
+ */
+inline const std::vector<HeaderField>& StandardHeaderFields() {
+  static const std::vector<HeaderField> fields = {
+      {"trace_seq_num_line", 1, 4},
+      {"trace_seq_num_reel", 5, 4},
+      {"orig_field_record_num", 9, 4},
+      {"trace_num_orig_record", 13, 4},
+      {"energy_source_point_num", 17, 4},
+      {"ensemble_num", 21, 4},
+      {"trace_num_ensemble", 25, 4},
+      {"trace_id_code", 29, 2},
+      {"vertically_summed_traces", 31, 2},
+      {"horizontally_stacked_traces", 33, 2},
+      {"data_use", 35, 2},
+      {"offset", 37, 4},
+      {"receiver_group_elevation", 41, 4},
+      {"source_surface_elevation", 45, 4},
+      {"source_depth_below_surface", 49, 4},
+      {"receiver_datum_elevation", 53, 4},
+      {"source_datum_elevation", 57, 4},
+      {"source_water_depth", 61, 4},
+      {"receiver_water_depth", 65, 4},
+      {"elevation_depth_scalar", 69, 2},
+      {"coordinate_scalar", 71, 2},
+      {"source_coord_x", 73, 4},
+      {"source_coord_y", 77, 4},
+      {"group_coord_x", 81, 4},
+      {"group_coord_y", 85, 4},
+      {"coordinate_unit", 89, 2},
+      {"weathering_velocity", 91, 2},
+      {"subweathering_velocity", 93, 2},
+      {"source_uphole_time", 95, 2},
+      {"group_uphole_time", 97, 2},
+      {"source_static_correction", 99, 2},
+      {"group_static_correction", 101, 2},
+      {"total_static_applied", 103, 2},
+      {"lag_time_a", 105, 2},
+      {"lag_time_b", 107, 2},
+      {"delay_recording_time", 109, 2},
+      {"mute_time_start", 111, 2},
+      {"mute_time_end", 113, 2},
+      {"samples_per_trace", 115, 2},
+      {"sample_interval", 117, 2},
+      {"gain_type_instruments", 119, 2},
+      {"instrument_gain_const", 121, 2},
+      {"instrument_early_gain", 123, 2},
+      {"correlated", 125, 2},
+      {"year_recorded", 157, 2},
+      {"day_of_year", 159, 2},
+      {"hour_of_day", 161, 2},
+      {"minute_of_hour", 163, 2},
+      {"second_of_minute", 165, 2},
+      {"time_basis_code", 167, 2},
+      {"trace_weighting_factor", 169, 2},
+      {"cdp_x", 181, 4},
+      {"cdp_y", 185, 4},
+      {"inline", 189, 4},
+      {"crossline", 193, 4},
+      {"shot_point", 197, 4},
+      {"shot_point_scalar", 201, 2},
+      {"trace_value_unit", 203, 2},
+      {"source_type_orientation", 217, 2},
+      {"source_measurement_unit", 231, 2},
+  };
+  return fields;
+}
+
+/**
+ * @brief Looks up a standard trace header field by name.
+ * "cdp-x" and "cdp-y" are accepted as aliases of "cdp_x" and "cdp_y".
+ * @return The field or a NotFoundError.
+ */
+inline Result<HeaderField> FindHeaderField(std::string_view name) {
+  std::string key(name);
+  for (auto& c : key) {
+    if (c == '-') {
+      c = '_';
+    }
+  }
+  for (const auto& field : StandardHeaderFields()) {
+    if (field.name == key) {
+      return field;
+    }
+  }
+  return absl::NotFoundError("'" + std::string(name) +
+                             "' is not a standard SEG-Y trace header field.");
+}
+
+/**
+ * @brief Converts big-endian IBM System/360 floats to IEEE float32.
+ * Values beyond the float32 range become +/-inf; the result is correctly
+ * rounded.
+ */
+inline void IbmToIeee(const char* src, float* dst, Index n) {
+  kernels::IbmToIeee(src, dst, n);
+}
+
+/**
+ * @brief Converts IEEE float32 to big-endian IBM System/360 floats.
+ * The fraction is rounded to nearest. NaN and inf saturate to the largest
+ * IBM magnitude.
+ */
+inline void IeeeToIbm(const float* src, char* dst, Index n) {
+  kernels::IeeeToIbm(src, dst, n);
+}
+
+/**
+ * @brief Decodes big-endian samples of any supported format to float32.
+ * @return An error for unsupported sample formats.
+ */
+inline absl::Status DecodeSamples(const char* src, int16_t format, float* dst,
+                                  Index n) {
+  switch (static_cast<SampleFormat>(format)) {
+    case SampleFormat::kIbm32:
+      IbmToIeee(src, dst, n);
+      return absl::OkStatus();
+    case SampleFormat::kIeee32:
+      kernels::ByteSwap32(src, dst, n);
+      return absl::OkStatus();
+    case SampleFormat::kInt32:
+      kernels::Int32ToFloat(src, dst, n, 1.0f, true);
+      return absl::OkStatus();
+    case SampleFormat::kInt16:
+      kernels::Int16ToFloat(src, dst, n, 1.0f, true);
+      return absl::OkStatus();
+    case SampleFormat::kInt8:
+      for (Index i = 0; i < n; ++i) {
+        dst[i] = static_cast<float>(static_cast<int8_t>(src[i]));
+      }
+      return absl::OkStatus();
+  }
+  return SampleSize(format).status();
+}
+
+/**
+ * @brief Encodes float32 samples as big-endian samples of a SEG-Y format.
+ * Integer formats are rounded to nearest and saturated. SEG-Y has no fill
+ * code, so NaN samples, e.g. the fill of dead traces, are written as 0 in
+ * every format.
+ * @return An error for unsupported sample formats.
+ */
+inline absl::Status EncodeSamples(const float* src, int16_t format, char* dst,
+                                  Index n) {
+  // The float formats copy NaN through, so zero it in a copy first.
+  auto isNan = [](float v) { return std::isnan(v); };
+  std::vector<float> zeroed;
+  const auto sampleFormat = static_cast<SampleFormat>(format);
+  if ((sampleFormat == SampleFormat::kIbm32 ||
+       sampleFormat == SampleFormat::kIeee32) &&
+      std::any_of(src, src + n, isNan)) {
+    zeroed.assign(src, src + n);
+    std::replace_if(zeroed.begin(), zeroed.end(), isNan, 0.f);
+    src = zeroed.data();
+  }
+  auto saturate = [](float v, float lo, float hi) {
+    if (std::isnan(v)) {
+      return 0.f;
+    }
+    v = std::nearbyint(v);
+    return v < lo ? lo : (v > hi ? hi : v);
+  };
+  switch (sampleFormat) {
+    case SampleFormat::kIbm32:
+      IeeeToIbm(src, dst, n);
+      return absl::OkStatus();
+    case SampleFormat::kIeee32:
+      kernels::ByteSwap32(src, dst, n);
+      return absl::OkStatus();
+    case SampleFormat::kInt32:
+      for (Index i = 0; i < n; ++i) {
+        double v = std::isnan(src[i])
+                       ? 0.0
+                       : std::nearbyint(static_cast<double>(src[i]));
+        v = v < -2147483648.0 ? -2147483648.0
+                              : (v > 2147483647.0 ? 2147483647.0 : v);
+        internal::StoreBE32(dst + 4 * i,
+                            static_cast<uint32_t>(static_cast<int32_t>(v)));
+      }
+      return absl::OkStatus();
+    case SampleFormat::kInt16:
+      for (Index i = 0; i < n; ++i) {
+        internal::StoreBE16(dst + 2 * i,
+                            static_cast<uint16_t>(static_cast<int16_t>(
+                                saturate(src[i], -32768.f, 32767.f))));
+      }
+      return absl::OkStatus();
+    case SampleFormat::kInt8:
+      for (Index i = 0; i < n; ++i) {
+        dst[i] = static_cast<char>(
+            static_cast<int8_t>(saturate(src[i], -128.f, 127.f)));
+      }
+      return absl::OkStatus();
+  }
+  return SampleSize(format).status();
+}
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_FORMAT_H_
@@ -0,0 +1,308 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_GEOMETRY_H_
+#define MDIO_SEGY_GEOMETRY_H_
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <mutex>  // NOLINT
+#include <numeric>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "mdio/analytic_coordinate.h"
+#include "mdio/segy/file.h"
+#include "mdio/segy/format.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace segy {
+
+/**
+ * @brief Options controlling a geometry scan.
+ */
+struct GeometryOptions {
+  // The trace header fields spanning the grid, slowest varying first.
+  std::vector<std::string> dimensions = {"inline", "crossline"};
+  // Byte locations for non-standard or relocated header fields.
+  std::vector<HeaderField> headerFields;
+  // The number of scanning threads; 0 uses the hardware concurrency.
+  int numThreads = 0;
+  // The number of consecutive trace headers each scan task reads.
+  Index blockSize = 4096;
+};
+
+/**
+ * @brief The trace grid of a SEG-Y file, derived from its trace headers.
+ * The grid is the outer product of the sorted, distinct header values of each
+ * dimension. Positions without a trace are dead. When several traces share a
+ * position the first one in the file is kept.
+ */
+struct Geometry {
+  std::vector<std::string> dimensions;
+  // The distinct header values of each dimension, ascending.
+  std::vector<std::vector<int64_t>> coordinates;
+  std::vector<Index> shape;
+  // The grid position (C order) of each trace, or -1 for dropped duplicates.
+  std::vector<Index> gridIndex;
+  // The trace at each grid position, or -1 where the grid is dead.
+  std::vector<Index> traceIndex;
+  Index numLive = 0;
+  Index numDuplicates = 0;
+  // Whether the file holds the full grid in C order, one trace per position.
+  bool sorted = false;
+
+  Index grid_size() const { return static_cast<Index>(traceIndex.size()); }
+
+  Index num_traces() const { return static_cast<Index>(gridIndex.size()); }
+
+  Index num_dead() const { return grid_size() - numLive; }
+
+  /// The trace at a grid position, or -1 if the position is dead.
+  Index trace_at(Index linear) const { return traceIndex[linear]; }
+
+  /**
+   * @brief The regular spacing of a dimension.
+   * @return The analytic coordinate, or a NotFoundError if the values are not
+   * evenly spaced.
+   */
+  Result<AnalyticCoordinate> regular_coordinate(size_t dim) const {
+    const auto& values = coordinates[dim];
+    AnalyticCoordinate coord{static_cast<double>(values.front()), 1,
+                             static_cast<Index>(values.size())};
+    if (values.size() > 1) {
+      coord.step = static_cast<double>(values[1] - values[0]);
+      for (size_t i = 2; i < values.size(); ++i) {
+        if (values[i] - values[i - 1] != values[1] - values[0]) {
+          return absl::NotFoundError("Dimension '" + dimensions[dim] +
+                                     "' is not regularly spaced.");
+        }
+      }
+    }
+    return coord;
+  }
+
+  /**
+   * @brief Describes the grid and its irregularities.
+   * Irregular dimensions report the values missing from their smallest
+   * common step.
+   */
+  nlohmann::json ToJson() const {
+    nlohmann::json dims = nlohmann::json::array();
+    for (size_t i = 0; i < dimensions.size(); ++i) {
+      const auto& values = coordinates[i];
+      nlohmann::json dim = {{"name", dimensions[i]},
+                            {"size", shape[i]},
+                            {"min", values.front()},
+                            {"max", values.back()}};
+      auto coord = regular_coordinate(i);
+      if (coord.ok()) {
+        dim["step"] = static_cast<int64_t>(coord.value().step);
+      } else {
+        int64_t step = 0;
+        for (size_t v = 1; v < values.size(); ++v) {
+          step = std::gcd(step, values[v] - values[v - 1]);
+        }
+        dim["step"] = step;
+        dim["missing"] = (values.back() - values.front()) / step + 1 -
+                         static_cast<int64_t>(values.size());
+      }
+      dims.push_back(dim);
+    }
+    return {{"dimensions", dims},
+            {"traces", num_traces()},
+            {"live", numLive},
+            {"dead", num_dead()},
+            {"duplicates", numDuplicates},
+            {"sorted", sorted}};
+  }
+};
+
+namespace internal {
+
+/**
+ * @brief Runs `fn(begin, end)` over blocks of [0, n) on a pool of threads.
+ * @return The first error returned by any block.
+ */
+inline absl::Status ParallelFor(
+    Index n, Index blockSize, int numThreads,
+    const std::function<absl::Status(Index, Index)>& fn) {
+  const Index numBlocks = (n + blockSize - 1) / blockSize;
+  if (numThreads <= 0) {
+    numThreads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  numThreads = static_cast<int>(
+      std::clamp<Index>(numThreads, 1, std::max<Index>(numBlocks, 1)));
+  std::atomic<Index> next{0};
+  std::atomic<bool> failed{false};
+  std::mutex mutex;
+  absl::Status firstError;
+  auto worker = [&] {
+    for (Index block = next++; block < numBlocks && !failed;
+         block = next++) {
+      Index begin = block * blockSize;
+      auto status = fn(begin, std::min(begin + blockSize, n));
+      if (!status.ok()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (firstError.ok()) {
+          firstError = status;
+        }
+        failed = true;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int i = 1; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return firstError;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Scans the trace headers of a SEG-Y file to derive its grid.
+ * Only the 240 byte trace headers are read, with positional reads issued from
+ * several threads, so the samples never pass through the page cache.
+ * @param segy The SEG-Y file.
+ * @param options The grid dimensions and scan parallelism.
+ * @return The geometry, or an error if a header could not be read.
+ */
+inline Result<Geometry> ScanGeometry(const SegyFile& segy,
+                                     const GeometryOptions& options = {}) {
+  if (options.dimensions.empty()) {
+    return absl::InvalidArgumentError(
+        "At least one grid dimension is required.");
+  }
+  if (options.blockSize <= 0) {
+    return absl::InvalidArgumentError("The scan block size must be positive.");
+  }
+  std::vector<HeaderField> fields;
+  for (const auto& name : options.dimensions) {
+    auto override = std::find_if(
+        options.headerFields.begin(), options.headerFields.end(),
+        [&](const HeaderField& field) { return field.name == name; });
+    if (override != options.headerFields.end()) {
+      fields.push_back(*override);
+    } else {
+      MDIO_ASSIGN_OR_RETURN(auto field, FindHeaderField(name))
+      fields.push_back(field);
+    }
+  }
+
+  const Index numTraces = segy.num_traces();
+  const size_t rank = fields.size();
+  if (numTraces == 0) {
+    return absl::InvalidArgumentError("'" + segy.path() +
+                                      "' holds no traces.");
+  }
+
+  // Header values, trace-major.
+  std::vector<int64_t> keys(numTraces * rank);
+  auto scan = [&](Index begin, Index end) -> absl::Status {
+    char header[kTraceHeaderSize];
+    for (Index trace = begin; trace < end; ++trace) {
+      off_t offset = segy.data_offset() + trace * segy.trace_size();
+      ssize_t read = pread(segy.fd(), header, kTraceHeaderSize, offset);
+      if (read != kTraceHeaderSize) {
+        return absl::InternalError("Reading the header of trace " +
+                                   std::to_string(trace) + " failed: " +
+                                   std::strerror(errno));
+      }
+      for (size_t d = 0; d < rank; ++d) {
+        keys[trace * rank + d] = fields[d].Read(header);
+      }
+    }
+    return absl::OkStatus();
+  };
+  auto status = internal::ParallelFor(numTraces, options.blockSize,
+                                      options.numThreads, scan);
+  if (!status.ok()) {
+    return status;
+  }
+
+  Geometry geometry;
+  geometry.dimensions = options.dimensions;
+  geometry.coordinates.resize(rank);
+  geometry.shape.resize(rank);
+  std::vector<Index> strides(rank);
+  Index gridSize = 1;
+  for (size_t d = rank; d-- > 0;) {
+    auto& values = geometry.coordinates[d];
+    values.resize(numTraces);
+    for (Index t = 0; t < numTraces; ++t) {
+      values[t] = keys[t * rank + d];
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    geometry.shape[d] = static_cast<Index>(values.size());
+    strides[d] = gridSize;
+    gridSize *= geometry.shape[d];
+  }
+
+  geometry.gridIndex.resize(numTraces);
+  auto locate = [&](Index begin, Index end) -> absl::Status {
+    for (Index t = begin; t < end; ++t) {
+      Index linear = 0;
+      for (size_t d = 0; d < rank; ++d) {
+        const auto& values = geometry.coordinates[d];
+        auto it = std::lower_bound(values.begin(), values.end(),
+                                   keys[t * rank + d]);
+        linear += (it - values.begin()) * strides[d];
+      }
+      geometry.gridIndex[t] = linear;
+    }
+    return absl::OkStatus();
+  };
+  status = internal::ParallelFor(numTraces, options.blockSize,
+                                 options.numThreads, locate);
+  if (!status.ok()) {
+    return status;
+  }
+
+  geometry.traceIndex.assign(gridSize, -1);
+  geometry.sorted = numTraces == gridSize;
+  for (Index t = 0; t < numTraces; ++t) {
+    Index& slot = geometry.traceIndex[geometry.gridIndex[t]];
+    geometry.sorted &= geometry.gridIndex[t] == t;
+    if (slot >= 0) {
+      geometry.gridIndex[t] = -1;
+      ++geometry.numDuplicates;
+      continue;
+    }
+    slot = t;
+    ++geometry.numLive;
+  }
+  return geometry;
+}
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_GEOMETRY_H_
@@ -0,0 +1,656 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_INGEST_H_
+#define MDIO_SEGY_INGEST_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/strings/numbers.h"
+#include "mdio/dataset.h"
+#include "mdio/quantization.h"
+#include "mdio/segy/file.h"
+#include "mdio/segy/format.h"
+#include "mdio/segy/geometry.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace segy {
+
+/**
+ * @brief Options controlling a SEG-Y ingestion.
+ */
+struct IngestOptions {
+  // The Variable receiving the trace samples.
+  std::string seismicVariable = "seismic";
+  // The structarray Variable receiving the trace headers. Skipped if the
+  // Dataset has no Variable of this name.
+  std::string headerVariable = "headers";
+  // Byte locations for header fields that are not standard SEG-Y fields, or
+  // that override the standard location.
+  std::vector<HeaderField> headerFields;
+  // The number of worker threads; 0 uses the hardware concurrency.
+  int numThreads = 0;
+  // Whether to store the file headers in the Dataset attributes and commit
+  // them along with the chunk occupancy bitmap of the seismic Variable.
+  bool commitMetadata = true;
+};
+
+/**
+ * @brief What an ingestion did.
+ */
+struct IngestSummary {
+  Index tracesWritten = 0;
+  // Chunk-aligned batches skipped because they hold no live traces.
+  Index batchesSkipped = 0;
+  Index bytesRead = 0;
+  double seconds = 0;
+
+  double gigabytes_per_second() const {
+    return seconds > 0 ? bytesRead / seconds / 1e9 : 0;
+  }
+};
+
+namespace internal {
+
+/**
+ * @brief One field of a structarray header Variable and its SEG-Y source.
+ */
+struct HeaderColumn {
+  HeaderField field;
+  // Byte offset of the field within the struct.
+  Index offset = 0;
+  // numpy kind ('i', 'u' or 'f') and size in bytes.
+  char kind = 'i';
+  int size = 4;
+  bool bigEndian = false;
+};
+
+/**
+ * @brief Maps the SEG-Y trace header onto the zarr structured dtype of a
+ * header Variable.
+ */
+struct HeaderLayout {
+  Index itemSize = 0;
+  std::vector<HeaderColumn> columns;
+
+  /**
+   * @brief Builds the layout from a zarr structured dtype.
+   * @param dtype The zarr dtype, e.g. [["inline", "<i4"], ["cdp_x", "<i4"]].
+   * @param overrides Header fields taking precedence over the standard ones.
+   * @return The layout, or an error if a field has no known byte location or
+   * an unsupported type.
+   */
+  static Result<HeaderLayout> FromDtype(
+      const nlohmann::json& dtype, const std::vector<HeaderField>& overrides) {
+    if (!dtype.is_array()) {
+      return absl::InvalidArgumentError(
+          "The header Variable is not a structured dtype.");
+    }
+    HeaderLayout layout;
+    for (const auto& entry : dtype) {
+      if (!entry.is_array() || entry.size() != 2 || !entry[0].is_string() ||
+          !entry[1].is_string()) {
+        return absl::InvalidArgumentError("Unsupported header dtype entry: " +
+                                          entry.dump());
+      }
+      HeaderColumn column;
+      std::string name = entry[0].get<std::string>();
+      std::string type = entry[1].get<std::string>();
+      if (type.size() < 3) {
+        return absl::InvalidArgumentError("Unsupported header dtype '" + type +
+                                          "' for field '" + name + "'.");
+      }
+      column.bigEndian = type[0] == '>';
+      column.kind = type[1];
+      if (!absl::SimpleAtoi(type.substr(2), &column.size)) {
+        return absl::InvalidArgumentError("Unsupported header dtype '" + type +
+                                          "' for field '" + name + "'.");
+      }
+      bool supported =
+          ((column.kind == 'i' || column.kind == 'u') &&
+           (column.size == 1 || column.size == 2 || column.size == 4 ||
+            column.size == 8)) ||
+          (column.kind == 'f' &&
+           (column.size == 2 || column.size == 4 || column.size == 8));
+      if (!supported) {
+        return absl::InvalidArgumentError("Unsupported header dtype '" + type +
+                                          "' for field '" + name + "'.");
+      }
+      auto override = std::find_if(
+          overrides.begin(), overrides.end(),
+          [&](const HeaderField& field) { return field.name == name; });
+      if (override != overrides.end()) {
+        column.field = *override;
+      } else {
+        auto standard = FindHeaderField(name);
+        if (!standard.ok()) {
+          return absl::InvalidArgumentError(
+              "Header field '" + name +
+              "' is not a standard SEG-Y field. Supply its byte location in "
+              "IngestOptions::headerFields.");
+        }
+        column.field = standard.value();
+      }
+      column.offset = layout.itemSize;
+      layout.itemSize += column.size;
+      layout.columns.push_back(std::move(column));
+    }
+    return layout;
+  }
+
+  /**
+   * @brief Packs the fields of one 240 byte trace header into a struct.
+   * @param header The SEG-Y trace header.
+   * @param dst `itemSize` bytes of output.
+   */
+  void Encode(const char* header, char* dst) const {
+    for (const auto& column : columns) {
+      int64_t value = column.field.Read(header);
+      unsigned char bytes[8];
+      switch (column.kind) {
+        case 'f':
+          if (column.size == 2) {
+            mdio::dtypes::float_16_t half(static_cast<float>(value));
+            std::memcpy(bytes, &half, 2);
+          } else if (column.size == 4) {
+            float f = static_cast<float>(value);
+            std::memcpy(bytes, &f, 4);
+          } else {
+            double d = static_cast<double>(value);
+            std::memcpy(bytes, &d, 8);
+          }
+          break;
+        default: {
+          // Two's complement truncation handles both signed and unsigned.
+          uint64_t bits = static_cast<uint64_t>(value);
+          for (int b = 0; b < column.size; ++b) {
+            bytes[b] = static_cast<unsigned char>(bits >> (8 * b));
+          }
+        }
+      }
+      if (column.bigEndian) {
+        std::reverse(bytes, bytes + column.size);
+      }
+      std::memcpy(dst + column.offset, bytes, column.size);
+    }
+  }
+
+  /**
+   * @brief Writes the fields of one struct back into a 240 byte trace header.
+   * @param src `itemSize` bytes of struct data.
+   * @param header The SEG-Y trace header. Fields not in the layout are left
+   * untouched.
+   */
+  void Decode(const char* src, char* header) const {
+    for (const auto& column : columns) {
+      unsigned char bytes[8];
+      std::memcpy(bytes, src + column.offset, column.size);
+      if (column.bigEndian) {
+        std::reverse(bytes, bytes + column.size);
+      }
+      int64_t value = 0;
+      if (column.kind == 'f') {
+        if (column.size == 2) {
+          mdio::dtypes::float_16_t half;
+          std::memcpy(&half, bytes, 2);
+          value = std::llround(static_cast<float>(half));
+        } else if (column.size == 4) {
+          float f;
+          std::memcpy(&f, bytes, 4);
+          value = std::llround(f);
+        } else {
+          double d;
+          std::memcpy(&d, bytes, 8);
+          value = std::llround(d);
+        }
+      } else {
+        uint64_t bits = 0;
+        for (int b = 0; b < column.size; ++b) {
+          bits |= static_cast<uint64_t>(bytes[b]) << (8 * b);
+        }
+        if (column.kind == 'i' && column.size < 8) {
+          // Sign extend.
+          uint64_t sign = uint64_t{1} << (8 * column.size - 1);
+          bits = (bits ^ sign) - sign;
+        }
+        value = static_cast<int64_t>(bits);
+      }
+      column.field.Write(header, value);
+    }
+  }
+
+  /// Whether the layout holds a field of this name.
+  bool contains(const std::string& name) const {
+    return std::any_of(
+        columns.begin(), columns.end(),
+        [&](const HeaderColumn& column) { return column.field.name == name; });
+  }
+};
+
+/**
+ * @brief Writes the grid of a SEG-Y file into a Dataset in chunk order.
+ * @param geometry Maps grid positions to traces. If null the file must hold
+ * the full grid in C order.
+ */
+inline Result<IngestSummary> IngestGrid(const SegyFile& segy,
+                                        const Geometry* geometry,
+                                        Dataset& dataset,  // NOLINT
+                                        const IngestOptions& options) {
+  auto start = std::chrono::steady_clock::now();
+  MDIO_ASSIGN_OR_RETURN(auto seismic,
+                        dataset.variables.at(options.seismicVariable))
+  MDIO_ASSIGN_OR_RETURN(auto shape, seismic.get_store_shape())
+  MDIO_ASSIGN_OR_RETURN(auto chunks, seismic.get_chunk_shape())
+  const DimensionIndex gridRank = static_cast<DimensionIndex>(shape.size()) - 1;
+  if (gridRank < 1) {
+    return absl::InvalidArgumentError(
+        "The seismic Variable needs at least one grid dimension and a sample "
+        "dimension.");
+  }
+  if (shape.back() != segy.num_samples()) {
+    return absl::InvalidArgumentError(
+        "The seismic Variable has " + std::to_string(shape.back()) +
+        " samples but the SEG-Y file has " +
+        std::to_string(segy.num_samples()));
+  }
+  Index gridSize = 1;
+  for (DimensionIndex i = 0; i < gridRank; ++i) {
+    gridSize *= shape[i];
+  }
+  if (geometry != nullptr) {
+    if (geometry->num_traces() != segy.num_traces() ||
+        !std::equal(geometry->shape.begin(), geometry->shape.end(),
+                    shape.begin(), shape.end() - 1)) {
+      return absl::InvalidArgumentError(
+          "The geometry does not match the SEG-Y file and seismic Variable.");
+    }
+  } else if (gridSize != segy.num_traces()) {
+    return absl::InvalidArgumentError(
+        "The seismic grid holds " + std::to_string(gridSize) +
+        " traces but the SEG-Y file has " + std::to_string(segy.num_traces()));
+  }
+
+  bool writeHeaders = false;
+  Variable<> headers;
+  internal::HeaderLayout layout;
+  if (!options.headerVariable.empty()) {
+    auto headerRes = dataset.variables.at(options.headerVariable);
+    if (headerRes.ok()) {
+      headers = headerRes.value();
+      MDIO_ASSIGN_OR_RETURN(auto headerShape, headers.get_store_shape())
+      if (!std::equal(headerShape.begin(), headerShape.end(), shape.begin(),
+                      shape.end() - 1)) {
+        return absl::InvalidArgumentError(
+            "The header Variable must have the seismic grid shape.");
+      }
+      MDIO_ASSIGN_OR_RETURN(auto spec, headers.get_spec())
+      MDIO_ASSIGN_OR_RETURN(
+          layout, internal::HeaderLayout::FromDtype(spec["metadata"]["dtype"],
+                                                    options.headerFields))
+      writeHeaders = true;
+    }
+  }
+
+  // C order strides of the trace grid and the chunk grid.
+  std::vector<Index> traceStrides(gridRank), batchGrid(gridRank);
+  Index numBatches = 1;
+  for (DimensionIndex i = gridRank - 1; i >= 0; --i) {
+    traceStrides[i] =
+        i == gridRank - 1 ? 1 : traceStrides[i + 1] * shape[i + 1];
+    batchGrid[i] = (shape[i] + chunks[i] - 1) / chunks[i];
+    numBatches *= batchGrid[i];
+  }
+  // The trace holding each grid position, or -1 if it is dead.
+  auto traceFor = [geometry](Index linear) {
+    return geometry != nullptr ? geometry->trace_at(linear) : linear;
+  };
+  // Samples are written as float; Variable::Write quantizes them for a
+  // quantized Variable and the store converts them to any other dtype.
+  MDIO_ASSIGN_OR_RETURN(auto floatStore,
+                        tensorstore::Cast<float>(seismic.get_store()))
+  const Variable<float> seismicFloat(seismic, floatStore);
+  // Dead traces hold the fill value.
+  float fill = 0;
+  MDIO_ASSIGN_OR_RETURN(auto fillValue, seismic.get_store().fill_value())
+  if (fillValue.valid() && fillValue.num_elements() > 0) {
+    auto converted = tensorstore::AllocateArray<float>(fillValue.shape());
+    auto status = tensorstore::CopyConvertedArray(fillValue, converted);
+    if (!status.ok()) {
+      return status;
+    }
+    fill = *converted.data();
+  }
+  // Quantized seismic stores integer codes; dead traces become the fill code.
+  auto quantization = GetQuantization(seismic);
+  if (quantization.ok()) {
+    fill = std::numeric_limits<float>::quiet_NaN();
+  } else if (!absl::IsNotFound(quantization.status())) {
+    return quantization.status();
+  }
+  auto seismicLabels = seismic.dimensions().labels();
+  std::vector<std::string> sampleLabels(seismicLabels.begin(),
+                                        seismicLabels.end());
+  std::vector<std::string> headerLabels;
+  if (writeHeaders) {
+    auto labels = headers.dimensions().labels();
+    headerLabels.assign(labels.begin(), labels.end());
+  }
+
+  std::atomic<Index> tracesWritten{0};
+  std::atomic<Index> batchesSkipped{0};
+  // The chunks of the written batches; the skipped ones stay empty.
+  MDIO_ASSIGN_OR_RETURN(auto occupancy, internal::EmptyChunkOccupancy(seismic))
+
+  std::atomic<Index> nextBatch{0};
+  std::mutex mutex;
+  absl::Status firstError;
+  auto fail = [&](const absl::Status& status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (firstError.ok()) {
+      firstError = status;
+    }
+  };
+  auto failed = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !firstError.ok();
+  };
+
+  const Index numSamples = segy.num_samples();
+  auto worker = [&] {
+    std::vector<Index> origin(gridRank), extent(gridRank), pos(gridRank);
+    for (Index batch = nextBatch++; batch < numBatches && !failed();
+         batch = nextBatch++) {
+      Index rem = batch;
+      Index count = 1;
+      for (DimensionIndex i = gridRank - 1; i >= 0; --i) {
+        origin[i] = (rem % batchGrid[i]) * chunks[i];
+        extent[i] = std::min(chunks[i], shape[i] - origin[i]);
+        rem /= batchGrid[i];
+        count *= extent[i];
+      }
+
+      std::vector<Index> sampleOrigin(origin), sampleShape(extent);
+      sampleOrigin.push_back(0);
+      sampleShape.push_back(numSamples);
+      auto region = tensorstore::IndexDomainBuilder<>(gridRank + 1)
+                        .origin(sampleOrigin)
+                        .shape(sampleShape)
+                        .labels(sampleLabels)
+                        .Finalize();
+      if (!region.ok()) {
+        fail(region.status());
+        return;
+      }
+      auto samples = tensorstore::AllocateArray<float>(
+          sampleShape, mdio::ContiguousLayoutOrder::c,
+          tensorstore::default_init);
+      float* sampleData = samples.data();
+
+      tensorstore::IndexDomain<> headerRegion;
+      tensorstore::SharedArray<void> headerData;
+      char* headerBytes = nullptr;
+      if (writeHeaders) {
+        std::vector<Index> headerOrigin(origin), headerShape(extent);
+        headerOrigin.push_back(0);
+        headerShape.push_back(layout.itemSize);
+        auto headerRes = tensorstore::IndexDomainBuilder<>(gridRank + 1)
+                             .origin(headerOrigin)
+                             .shape(headerShape)
+                             .labels(headerLabels)
+                             .Finalize();
+        if (!headerRes.ok()) {
+          fail(headerRes.status());
+          return;
+        }
+        headerRegion = headerRes.value();
+        headerData = tensorstore::AllocateArray(
+            headerShape, mdio::ContiguousLayoutOrder::c,
+            tensorstore::value_init, headers.dtype());
+        headerBytes = static_cast<char*>(headerData.data());
+      }
+
+      Index live = 0;
+      const Index rowLength = extent[gridRank - 1];
+      for (Index k = 0; k < count; ++k) {
+        Index r = k;
+        Index linear = 0;
+        for (DimensionIndex i = gridRank - 1; i >= 0; --i) {
+          pos[i] = origin[i] + r % extent[i];
+          r /= extent[i];
+          linear += pos[i] * traceStrides[i];
+        }
+        Index trace = traceFor(linear);
+        if (trace < 0) {
+          std::fill_n(sampleData + k * numSamples, numSamples, fill);
+          continue;
+        }
+        ++live;
+        // Read ahead when a row of the batch is contiguous in the file.
+        if (pos[gridRank - 1] == origin[gridRank - 1] &&
+            traceFor(linear + rowLength - 1) == trace + rowLength - 1) {
+          segy.Prefetch(trace, rowLength);
+        }
+        auto status = DecodeSamples(segy.trace_data(trace), segy.format(),
+                                    sampleData + k * numSamples, numSamples);
+        if (!status.ok()) {
+          fail(status);
+          return;
+        }
+        if (headerBytes != nullptr) {
+          layout.Encode(segy.trace_header(trace),
+                        headerBytes + k * layout.itemSize);
+        }
+      }
+
+      if (live == 0) {
+        // Leave the chunks absent so they read back as the fill value.
+        ++batchesSkipped;
+        continue;
+      }
+      tracesWritten += live;
+
+      // The buffers outlive the commit, which is waited for below.
+      auto written = seismicFloat.Write(
+          samples, region.value(),
+          tensorstore::can_reference_source_data_until_commit);
+      if (writeHeaders) {
+        auto headerRes =
+            headers
+                .Write(headerData, headerRegion,
+                       tensorstore::can_reference_source_data_until_commit)
+                .commit_future.result();
+        if (!headerRes.ok()) {
+          fail(headerRes.status());
+          return;
+        }
+      }
+      auto writeRes = written.commit_future.result();
+      if (!writeRes.ok()) {
+        fail(writeRes.status());
+        return;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      occupancy.MarkBox(sampleOrigin, sampleShape);
+    }
+  };
+
+  int numThreads = options.numThreads > 0
+                       ? options.numThreads
+                       : static_cast<int>(std::thread::hardware_concurrency());
+  numThreads = static_cast<int>(
+      std::clamp<Index>(numThreads, 1, std::max<Index>(numBatches, 1)));
+  std::vector<std::thread> threads;
+  threads.reserve(numThreads - 1);
+  for (int i = 1; i < numThreads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!firstError.ok()) {
+    return firstError;
+  }
+
+  auto stored = SetChunkOccupancy(seismic, occupancy);
+  if (!stored.ok()) {
+    return stored.status();
+  }
+  if (options.commitMetadata) {
+    dataset.UpdateAttributes(
+        {{"textHeader", segy.text_header()},
+         {"binaryHeader", segy.binary_header().ToJson()}});
+    auto commitRes = dataset.CommitMetadata().result();
+    if (!commitRes.ok()) {
+      return commitRes.status();
+    }
+  }
+
+  IngestSummary summary;
+  summary.tracesWritten = tracesWritten;
+  summary.batchesSkipped = batchesSkipped;
+  summary.bytesRead = segy.num_traces() * segy.trace_size();
+  summary.seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  return summary;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Loads a SEG-Y file into an existing Dataset.
+ * The seismic Variable must be shaped [grid dims..., samples], with the
+ * sample dimension matching the file and the grid holding exactly one trace
+ * per position, with traces sorted in C order of the grid. Work is split into
+ * chunk-aligned batches over the grid dimensions which worker threads decode
+ * and write independently, so no chunk is written twice.
+ * @param segy The opened SEG-Y file.
+ * @param dataset The Dataset to write into.
+ * @param options Variable names, extra header fields and the thread count.
+ * @return A summary of the ingestion or the first error encountered.
+ */
+inline Result<IngestSummary> IngestSegy(const SegyFile& segy,
+                                        Dataset& dataset,  // NOLINT
+                                        const IngestOptions& options = {}) {
+  return internal::IngestGrid(segy, nullptr, dataset, options);
+}
+
+/**
+ * @brief Loads an unsorted or sparse SEG-Y file into an existing Dataset.
+ * The geometry (see ScanGeometry) maps every grid position to its trace, so
+ * batches are still assembled in chunk order whatever the trace order of the
+ * file. Dead positions hold the fill value and batches without live traces
+ * are not written. The seismic Variable's chunk occupancy bitmap is replaced
+ * by one marking the written batches, so reads skip the others. The leading
+ * dimensions of the seismic Variable must match the geometry's shape.
+ * @param segy The opened SEG-Y file.
+ * @param geometry The geometry scanned from `segy`.
+ * @param dataset The Dataset to write into.
+ * @param options Variable names, extra header fields and the thread count.
+ * @return A summary of the ingestion or the first error encountered.
+ */
+inline Result<IngestSummary> IngestSegy(const SegyFile& segy,
+                                        const Geometry& geometry,
+                                        Dataset& dataset,  // NOLINT
+                                        const IngestOptions& options = {}) {
+  return internal::IngestGrid(segy, &geometry, dataset, options);
+}
+
+/**
+ * @brief Writes the scanned header values of each grid dimension to the
+ * Dataset's dimension coordinate of the same name.
+ * Analytic coordinates are checked against the geometry instead of written.
+ * Dimensions without a coordinate Variable are skipped.
+ * @param geometry The scanned geometry.
+ * @param dataset The Dataset to write into.
+ * @return An error if a coordinate does not match the geometry.
+ */
+inline absl::Status WriteDimensionCoordinates(const Geometry& geometry,
+                                              Dataset& dataset) {  // NOLINT
+  for (size_t d = 0; d < geometry.dimensions.size(); ++d) {
+    const auto& name = geometry.dimensions[d];
+    auto varRes = dataset.variables.at(name);
+    if (!varRes.ok()) {
+      continue;
+    }
+    auto var = varRes.value();
+    auto analytic = GetAnalyticCoordinate(var);
+    if (analytic.ok()) {
+      auto regular = geometry.regular_coordinate(d);
+      if (!regular.ok() || regular.value().start != analytic.value().start ||
+          regular.value().step != analytic.value().step ||
+          regular.value().size != analytic.value().size) {
+        return absl::InvalidArgumentError(
+            "The analytic coordinate '" + name +
+            "' does not match the scanned header values.");
+      }
+      continue;
+    }
+    if (!absl::IsNotFound(analytic.status())) {
+      return analytic.status();
+    }
+    MDIO_ASSIGN_OR_RETURN(auto shape, var.get_store_shape())
+    if (shape.size() != 1 || shape[0] != geometry.shape[d]) {
+      return absl::InvalidArgumentError(
+          "The coordinate '" + name + "' does not have the size of the " +
+          "scanned dimension.");
+    }
+    auto values = tensorstore::MakeArrayView(
+        tensorstore::span<const int64_t>(geometry.coordinates[d]));
+    auto converted = tensorstore::AllocateArray(
+        values.shape(), mdio::ContiguousLayoutOrder::c,
+        tensorstore::default_init, var.dtype());
+    auto status = tensorstore::CopyConvertedArray(values, converted);
+    if (!status.ok()) {
+      return status;
+    }
+    auto written =
+        tensorstore::Write(converted, var.get_store()).commit_future.result();
+    if (!written.ok()) {
+      return written.status();
+    }
+  }
+  return absl::OkStatus();
+}
+
+/**
+ * @brief Opens a SEG-Y file and loads it into an existing Dataset.
+ * @see IngestSegy(const SegyFile&, Dataset&, const IngestOptions&)
+ */
+inline Result<IngestSummary> IngestSegy(const std::string& path,
+                                        Dataset& dataset,  // NOLINT
+                                        const IngestOptions& options = {}) {
+  MDIO_ASSIGN_OR_RETURN(auto segy, SegyFile::Open(path))
+  return IngestSegy(segy, dataset, options);
+}
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_INGEST_H_
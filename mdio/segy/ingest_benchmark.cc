@@ -0,0 +1,153 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Throughput of SEG-Y decoding, ingestion and export. Bytes are counted on
+// the SEG-Y side, so the reported rate is SEG-Y GB/s:
+//   mdio_segy_ingest_benchmark --benchmark_counters_tabular=true
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mdio/segy/export.h"
+#include "mdio/segy/geometry.h"
+#include "mdio/segy/ingest.h"
+#include "mdio/segy/synthetic.h"
+
+namespace {
+
+void BM_DecodeSamples(benchmark::State& state) {  // NOLINT
+  const int16_t format = static_cast<int16_t>(state.range(0));
+  const mdio::Index n = 1 << 20;
+  std::vector<float> samples(n);
+  for (mdio::Index i = 0; i < n; ++i) {
+    samples[i] = mdio::segy::SyntheticSurvey::Value(i / 1000, i % 1000, 0, i);
+  }
+  std::vector<char> raw(n * mdio::segy::SampleSize(format).value());
+  (void)mdio::segy::EncodeSamples(samples.data(), format, raw.data(), n);
+  for (auto _ : state) {
+    auto status =
+        mdio::segy::DecodeSamples(raw.data(), format, samples.data(), n);
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(samples.data());
+  }
+  state.SetBytesProcessed(state.iterations() * raw.size());
+}
+BENCHMARK(BM_DecodeSamples)
+    ->Arg(static_cast<int>(mdio::segy::SampleFormat::kIbm32))
+    ->Arg(static_cast<int>(mdio::segy::SampleFormat::kIeee32))
+    ->Arg(static_cast<int>(mdio::segy::SampleFormat::kInt16));
+
+void BM_ScanGeometry(benchmark::State& state) {  // NOLINT
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 128;
+  survey.numCrosslines = 512;
+  survey.numSamples = 16;
+  survey.shuffleSeed = 1;
+  const std::string segyPath = "scan_benchmark.sgy";
+  if (!mdio::segy::WriteSyntheticSegy(segyPath, survey).ok()) {
+    state.SkipWithError("Unable to write the synthetic SEG-Y file.");
+    return;
+  }
+  auto segy = mdio::segy::SegyFile::Open(segyPath).value();
+  mdio::segy::GeometryOptions options;
+  options.numThreads = static_cast<int>(state.range(0));
+  for (auto _ : state) {
+    auto geometry = mdio::segy::ScanGeometry(segy, options);
+    benchmark::DoNotOptimize(geometry);
+  }
+  state.SetItemsProcessed(state.iterations() * segy.num_traces());
+  std::filesystem::remove(segyPath);
+}
+BENCHMARK(BM_ScanGeometry)->Arg(1)->Arg(4)->Arg(0)->UseRealTime();
+
+void BM_Ingest(benchmark::State& state) {  // NOLINT
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 64;
+  survey.numCrosslines = 256;
+  survey.numSamples = 1000;
+  const std::string segyPath = "ingest_benchmark.sgy";
+  const std::string path = "ingest_benchmark.mdio";
+  if (!mdio::segy::WriteSyntheticSegy(segyPath, survey).ok()) {
+    state.SkipWithError("Unable to write the synthetic SEG-Y file.");
+    return;
+  }
+  auto segy = mdio::segy::SegyFile::Open(segyPath).value();
+
+  mdio::segy::IngestOptions options;
+  options.numThreads = static_cast<int>(state.range(0));
+  options.commitMetadata = false;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto json = mdio::segy::SyntheticSchema(survey, {16, 64, 1000});
+    auto ds = mdio::Dataset::from_json(json, path,
+                                       mdio::constants::kCreateClean)
+                  .value();
+    state.ResumeTiming();
+    auto summary = mdio::segy::IngestSegy(segy, ds, options);
+    if (!summary.ok()) {
+      state.SkipWithError(summary.status().ToString().c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * segy.size());
+  std::filesystem::remove_all(path);
+  std::filesystem::remove(segyPath);
+}
+BENCHMARK(BM_Ingest)->Arg(1)->Arg(4)->Arg(0)->UseRealTime()->Unit(
+    benchmark::kMillisecond);
+
+void BM_Export(benchmark::State& state) {  // NOLINT
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 64;
+  survey.numCrosslines = 256;
+  survey.numSamples = 1000;
+  const std::string segyPath = "export_benchmark_source.sgy";
+  const std::string path = "export_benchmark.mdio";
+  const std::string exportPath = "export_benchmark.sgy";
+  auto json = mdio::segy::SyntheticSchema(survey, {16, 64, 1000});
+  if (!mdio::segy::WriteSyntheticSegy(segyPath, survey).ok()) {
+    state.SkipWithError("Unable to write the synthetic SEG-Y file.");
+    return;
+  }
+  auto ds =
+      mdio::Dataset::from_json(json, path, mdio::constants::kCreateClean)
+          .value();
+  if (!mdio::segy::IngestSegy(segyPath, ds).ok()) {
+    state.SkipWithError("Unable to ingest the synthetic SEG-Y file.");
+    return;
+  }
+
+  mdio::segy::ExportOptions options;
+  options.numThreads = static_cast<int>(state.range(0));
+  mdio::Index bytes = 0;
+  for (auto _ : state) {
+    auto summary = mdio::segy::ExportSegy(ds, exportPath, options);
+    if (!summary.ok()) {
+      state.SkipWithError(summary.status().ToString().c_str());
+      break;
+    }
+    bytes += summary.value().bytesWritten;
+  }
+  state.SetBytesProcessed(bytes);
+  std::filesystem::remove_all(path);
+  std::filesystem::remove(segyPath);
+  std::filesystem::remove(exportPath);
+}
+BENCHMARK(BM_Export)->Arg(1)->Arg(4)->Arg(0)->UseRealTime()->Unit(
+    benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,631 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "mdio/segy/export.h"
+#include "mdio/segy/file.h"
+#include "mdio/segy/format.h"
+#include "mdio/segy/geometry.h"
+#include "mdio/segy/ingest.h"
+#include "mdio/segy/synthetic.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+const char kSegyDir[] = "segy_corpus";
+
+std::string CorpusPath(const std::string& name) {
+  std::filesystem::create_directories(kSegyDir);
+  return std::string(kSegyDir) + "/" + name;
+}
+
+mdio::Result<mdio::Dataset> MakeDataset(
+    const mdio::segy::SyntheticSurvey& survey, const std::string& path,
+    const std::vector<mdio::Index>& chunkShape) {
+  std::filesystem::remove_all(path);
+  auto json = mdio::segy::SyntheticSchema(survey, chunkShape);
+  return mdio::Dataset::from_json(json, path, mdio::constants::kCreateClean)
+      .result();
+}
+
+// Checks every sample of the seismic Variable against the synthetic survey.
+void ExpectSeismic(mdio::Dataset& ds,  // NOLINT
+                   const mdio::segy::SyntheticSurvey& survey) {
+  auto seismic = ds.variables.get<float>("seismic").value();
+  auto dataRes = seismic.Read().result();
+  ASSERT_TRUE(dataRes.status().ok()) << dataRes.status();
+  auto data = dataRes.value().get_data_accessor();
+  auto shape = survey.grid_shape();
+  const bool prestack = survey.numOffsets > 0;
+  int mismatches = 0;
+  for (mdio::Index i = 0; i < shape[0]; ++i) {
+    for (mdio::Index x = 0; x < shape[1]; ++x) {
+      for (mdio::Index o = 0; o < (prestack ? shape[2] : 1); ++o) {
+        for (mdio::Index s = 0; s < survey.numSamples; ++s) {
+          float expected = mdio::segy::SyntheticSurvey::Value(
+              survey.inline_at(i), survey.crossline_at(x),
+              prestack ? survey.offset_at(o) : 0, s);
+          float actual = prestack ? data({i, x, o, s}) : data({i, x, s});
+          mismatches += actual != expected;
+        }
+      }
+    }
+  }
+  EXPECT_EQ(mismatches, 0);
+}
+
+TEST(SegyFormat, ibmKnownValue) {
+  // 0xC276A000 is -118.625 in IBM floating point.
+  const char ibm[4] = {static_cast<char>(0xC2), 0x76, static_cast<char>(0xA0),
+                       0};
+  float value;
+  mdio::segy::IbmToIeee(ibm, &value, 1);
+  EXPECT_EQ(value, -118.625f);
+
+  char encoded[4];
+  mdio::segy::IeeeToIbm(&value, encoded, 1);
+  EXPECT_EQ(std::string(encoded, 4), std::string(ibm, 4));
+}
+
+TEST(SegyFormat, sampleRoundTrip) {
+  std::vector<float> samples = {0.f, 1.f, -2.5f, 1000.f, -32768.f, 42.f};
+  for (int16_t format : {1, 2, 3, 5}) {
+    auto size = mdio::segy::SampleSize(format);
+    ASSERT_TRUE(size.ok()) << size.status();
+    std::vector<char> raw(samples.size() * size.value());
+    ASSERT_TRUE(mdio::segy::EncodeSamples(samples.data(), format, raw.data(),
+                                          samples.size())
+                    .ok());
+    std::vector<float> decoded(samples.size());
+    ASSERT_TRUE(mdio::segy::DecodeSamples(raw.data(), format, decoded.data(),
+                                          samples.size())
+                    .ok());
+    for (size_t i = 0; i < samples.size(); ++i) {
+      // Integer formats round -2.5 to even.
+      float expected = format == 2 || format == 3 ? std::nearbyint(samples[i])
+                                                  : samples[i];
+      EXPECT_EQ(decoded[i], expected) << "format " << format << " index " << i;
+    }
+  }
+  EXPECT_FALSE(mdio::segy::SampleSize(4).ok()) << "Fixed point is unsupported";
+
+  // Integer formats have no fill code, NaN is written as 0.
+  const float nan = std::nanf("");
+  for (int16_t format : {2, 3, 8}) {
+    std::vector<char> raw(4, 'x');
+    ASSERT_TRUE(mdio::segy::EncodeSamples(&nan, format, raw.data(), 1).ok());
+    float decoded = -1;
+    ASSERT_TRUE(
+        mdio::segy::DecodeSamples(raw.data(), format, &decoded, 1).ok());
+    EXPECT_EQ(decoded, 0.f) << "format " << format;
+  }
+}
+
+TEST(SegyFormat, textHeader) {
+  auto raw = mdio::segy::EncodeTextHeader({"C 1 CLIENT TGS", "C 2 LINE 100"});
+  ASSERT_EQ(raw.size(), mdio::segy::kTextHeaderSize);
+  EXPECT_EQ(static_cast<unsigned char>(raw[0]), 0xC3) << "Expected EBCDIC";
+  auto lines = mdio::segy::DecodeTextHeader(raw);
+  ASSERT_EQ(lines.size(), 40);
+  EXPECT_EQ(lines[1].substr(0, 12), "C 2 LINE 100");
+}
+
+TEST(SegyFormat, binaryHeader) {
+  mdio::segy::BinaryHeader header;
+  header.samplesPerTrace = 1501;
+  header.sampleInterval = 2000;
+  header.formatCode = 5;
+  std::vector<char> raw(mdio::segy::kBinaryHeaderSize);
+  header.Write(raw.data());
+  auto parsed = mdio::segy::BinaryHeader::Parse(raw.data());
+  EXPECT_EQ(parsed.samplesPerTrace, 1501);
+  EXPECT_EQ(parsed.sampleInterval, 2000);
+  EXPECT_EQ(parsed.formatCode, 5);
+
+  auto fromJson = mdio::segy::BinaryHeader::FromJson(parsed.ToJson());
+  ASSERT_TRUE(fromJson.ok()) << fromJson.status();
+  EXPECT_EQ(fromJson.value().samplesPerTrace, 1501);
+}
+
+TEST(SegyFormat, headerFields) {
+  char header[mdio::segy::kTraceHeaderSize] = {};
+  auto field = mdio::segy::FindHeaderField("cdp-x");
+  ASSERT_TRUE(field.ok()) << field.status();
+  EXPECT_EQ(field.value().byte, 181);
+  field.value().Write(header, -123456);
+  EXPECT_EQ(field.value().Read(header), -123456);
+  EXPECT_FALSE(mdio::segy::FindHeaderField("not_a_field").ok());
+}
+
+TEST(SegyFile, open) {
+  mdio::segy::SyntheticSurvey survey;
+  auto path = CorpusPath("open.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(path, survey).ok());
+
+  auto segyRes = mdio::segy::SegyFile::Open(path);
+  ASSERT_TRUE(segyRes.status().ok()) << segyRes.status();
+  auto segy = segyRes.value();
+  EXPECT_EQ(segy.num_traces(), survey.numInlines * survey.numCrosslines);
+  EXPECT_EQ(segy.num_samples(), survey.numSamples);
+  EXPECT_EQ(segy.text_header()[0].substr(0, 25), "C 1 MDIO SYNTHETIC SURVEY");
+
+  std::vector<float> trace(segy.num_samples());
+  ASSERT_TRUE(segy.ReadTrace(3, trace.data()).ok());
+  // Traces are written in inline/crossline order.
+  EXPECT_EQ(trace[10], mdio::segy::SyntheticSurvey::Value(
+                           survey.inline_at(0), survey.crossline_at(3), 0, 10));
+  EXPECT_FALSE(segy.ReadTrace(segy.num_traces(), trace.data()).ok());
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyFile, openInvalid) {
+  auto path = CorpusPath("invalid.sgy");
+  std::ofstream(path) << "not a SEG-Y file";
+  EXPECT_FALSE(mdio::segy::SegyFile::Open(path).ok());
+  EXPECT_FALSE(mdio::segy::SegyFile::Open(CorpusPath("missing.sgy")).ok());
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, poststackIbm) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 10;
+  survey.numCrosslines = 12;
+  auto segyPath = CorpusPath("poststack.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_poststack.mdio";
+  // Chunks do not divide the grid, so edge batches are partial.
+  auto dsRes = MakeDataset(survey, path, {4, 5, 32});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  mdio::segy::IngestOptions options;
+  options.numThreads = 4;
+  auto summary = mdio::segy::IngestSegy(segyPath, ds, options);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  EXPECT_EQ(summary.value().tracesWritten, 120);
+  ExpectSeismic(ds, survey);
+
+  auto cdpX = ds.SelectField<mdio::dtypes::int32_t>("headers", "cdp_x");
+  ASSERT_TRUE(cdpX.status().ok()) << cdpX.status();
+  auto cdpXData = cdpX.value().Read().result();
+  ASSERT_TRUE(cdpXData.status().ok()) << cdpXData.status();
+  EXPECT_EQ(cdpXData.value().get_data_accessor()({2, 7}),
+            100000 + 25 * survey.crossline_at(7));
+
+  // The file headers are kept in the Dataset attributes.
+  auto reopened = mdio::Dataset::Open(path, mdio::constants::kOpen).result();
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  auto attrs = reopened.value().getMetadata()["attributes"];
+  EXPECT_EQ(attrs["binaryHeader"]["samplesPerTrace"], survey.numSamples);
+  EXPECT_EQ(attrs["textHeader"].size(), 40);
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, marksOccupancy) {
+  mdio::segy::SyntheticSurvey survey;
+  auto segyPath = CorpusPath("occupancy.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_occupancy.mdio";
+  auto dsRes = MakeDataset(survey, path, {4, 5, 32});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  // A stored bitmap with every chunk empty, as left by an earlier pass.
+  auto seismic = ds.variables.at("seismic").value();
+  auto empty = mdio::internal::EmptyChunkOccupancy(seismic);
+  ASSERT_TRUE(empty.status().ok()) << empty.status();
+  ASSERT_TRUE(mdio::SetChunkOccupancy(seismic, empty.value()).ok());
+
+  auto summary = mdio::segy::IngestSegy(segyPath, ds);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  ExpectSeismic(ds, survey);
+
+  auto reopened = mdio::Dataset::Open(path, mdio::constants::kOpen).result();
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  ExpectSeismic(reopened.value(), survey);
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, prestackIeee) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 5;
+  survey.numCrosslines = 6;
+  survey.numOffsets = 3;
+  survey.format = static_cast<int16_t>(mdio::segy::SampleFormat::kIeee32);
+  auto segyPath = CorpusPath("prestack.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_prestack.mdio";
+  auto dsRes = MakeDataset(survey, path, {2, 4, 3, 64});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  auto summary = mdio::segy::IngestSegy(segyPath, ds);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  ExpectSeismic(ds, survey);
+
+  auto offset = ds.SelectField<mdio::dtypes::int32_t>("headers", "offset");
+  ASSERT_TRUE(offset.status().ok()) << offset.status();
+  auto offsetData = offset.value().Read().result();
+  ASSERT_TRUE(offsetData.status().ok()) << offsetData.status();
+  EXPECT_EQ(offsetData.value().get_data_accessor()({1, 1, 2}),
+            survey.offset_at(2));
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, shapeMismatch) {
+  mdio::segy::SyntheticSurvey survey;
+  auto segyPath = CorpusPath("mismatch.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_mismatch.mdio";
+  auto larger = survey;
+  larger.numInlines += 1;
+  auto dsRes = MakeDataset(larger, path, {});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  EXPECT_FALSE(mdio::segy::IngestSegy(segyPath, ds).status().ok())
+      << "The grid must hold exactly one trace per position";
+
+  mdio::segy::IngestOptions options;
+  options.seismicVariable = "missing";
+  EXPECT_FALSE(mdio::segy::IngestSegy(segyPath, ds, options).status().ok());
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyGeometry, scanUnsortedSparse) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 6;
+  survey.numCrosslines = 9;
+  survey.numOffsets = 2;
+  survey.shuffleSeed = 3;
+  // Drop inline 3 entirely and the end of inline 5.
+  survey.live = [](int32_t il, int32_t xl) {
+    return il != 3 && !(il == 5 && xl > 4);
+  };
+  auto path = CorpusPath("unsorted.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(path, survey).ok());
+  auto segy = mdio::segy::SegyFile::Open(path).value();
+
+  mdio::segy::GeometryOptions options;
+  options.dimensions = {"inline", "crossline", "offset"};
+  options.blockSize = 7;
+  options.numThreads = 4;
+  auto geometryRes = mdio::segy::ScanGeometry(segy, options);
+  ASSERT_TRUE(geometryRes.status().ok()) << geometryRes.status();
+  auto geometry = geometryRes.value();
+  EXPECT_THAT(geometry.shape, ::testing::ElementsAre(5, 9, 2));
+  EXPECT_THAT(geometry.coordinates[0], ::testing::ElementsAre(1, 2, 4, 5, 6));
+  EXPECT_EQ(geometry.numLive, segy.num_traces());
+  EXPECT_EQ(geometry.num_dead(), 10);
+  EXPECT_FALSE(geometry.sorted);
+
+  // Every trace maps back to the grid position named by its headers.
+  auto inlineField = mdio::segy::FindHeaderField("inline").value();
+  auto crosslineField = mdio::segy::FindHeaderField("crossline").value();
+  for (mdio::Index t = 0; t < segy.num_traces(); ++t) {
+    mdio::Index linear = geometry.gridIndex[t];
+    ASSERT_EQ(geometry.trace_at(linear), t);
+    EXPECT_EQ(geometry.coordinates[0][linear / 18],
+              inlineField.Read(segy.trace_header(t)));
+    EXPECT_EQ(geometry.coordinates[1][(linear / 2) % 9],
+              crosslineField.Read(segy.trace_header(t)));
+  }
+
+  auto summary = geometry.ToJson();
+  EXPECT_EQ(summary["dimensions"][0]["missing"], 1) << "Inline 3 is missing";
+  EXPECT_EQ(summary["dimensions"][1]["step"], 1);
+  EXPECT_FALSE(geometry.regular_coordinate(0).ok());
+  EXPECT_EQ(geometry.regular_coordinate(2).value().step, 100);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyGeometry, duplicates) {
+  mdio::segy::SyntheticSurvey survey;
+  auto path = CorpusPath("duplicates.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(path, survey).ok());
+  {
+    // Append a second copy of the first trace.
+    auto segy = mdio::segy::SegyFile::Open(path).value();
+    std::string trace(segy.trace_header(0), segy.trace_size());
+    std::ofstream(path, std::ios::binary | std::ios::app) << trace;
+  }
+  auto segy = mdio::segy::SegyFile::Open(path).value();
+  auto geometry = mdio::segy::ScanGeometry(segy).value();
+  EXPECT_EQ(geometry.numDuplicates, 1);
+  EXPECT_EQ(geometry.gridIndex.back(), -1);
+  EXPECT_EQ(geometry.trace_at(0), 0) << "The first trace wins";
+  EXPECT_FALSE(geometry.sorted);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, geometryDriven) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 6;
+  survey.numCrosslines = 8;
+  survey.shuffleSeed = 11;
+  survey.live = [](int32_t il, int32_t xl) { return !(il >= 5 && xl >= 4); };
+  auto segyPath = CorpusPath("geometry.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_geometry.mdio";
+  auto dsRes = MakeDataset(survey, path, {2, 4, 64});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  auto segy = mdio::segy::SegyFile::Open(segyPath).value();
+  EXPECT_FALSE(mdio::segy::IngestSegy(segy, ds).status().ok())
+      << "A sparse file needs a geometry";
+  auto geometry = mdio::segy::ScanGeometry(segy).value();
+  auto summary = mdio::segy::IngestSegy(segy, geometry, ds);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  EXPECT_EQ(summary.value().tracesWritten, 38);
+  EXPECT_EQ(summary.value().batchesSkipped, 1)
+      << "The batch without live traces is not written";
+  auto occupancy = ds.GetChunkOccupancy("seismic");
+  ASSERT_TRUE(occupancy.status().ok()) << occupancy.status();
+  EXPECT_EQ(occupancy.value().count(), occupancy.value().num_chunks() - 1);
+  EXPECT_FALSE(occupancy.value().test({2, 1, 0}))
+      << "The bitmap leaves out the skipped batch";
+
+  auto seismic = ds.variables.get<float>("seismic").value();
+  auto data = seismic.Read().result().value().get_data_accessor();
+  for (mdio::Index i = 0; i < survey.numInlines; ++i) {
+    for (mdio::Index x = 0; x < survey.numCrosslines; ++x) {
+      int32_t il = survey.inline_at(i);
+      int32_t xl = survey.crossline_at(x);
+      if (survey.live(il, xl)) {
+        EXPECT_EQ(data({i, x, 7}),
+                  mdio::segy::SyntheticSurvey::Value(il, xl, 0, 7));
+      } else {
+        EXPECT_TRUE(std::isnan(data({i, x, 7}))) << "Dead traces hold fill";
+      }
+    }
+  }
+  ASSERT_TRUE(mdio::segy::WriteDimensionCoordinates(geometry, ds).ok())
+      << "The analytic coordinates agree with the headers";
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+// Ingests a synthetic post-stack survey into a new Dataset.
+mdio::Result<mdio::Dataset> IngestSynthetic(
+    const mdio::segy::SyntheticSurvey& survey, const std::string& segyPath,
+    const std::string& path) {
+  auto status = mdio::segy::WriteSyntheticSegy(segyPath, survey);
+  if (!status.ok()) {
+    return status;
+  }
+  MDIO_ASSIGN_OR_RETURN(auto ds, MakeDataset(survey, path, {4, 5, 32}))
+  auto summary = mdio::segy::IngestSegy(segyPath, ds);
+  if (!summary.ok()) {
+    return summary.status();
+  }
+  return ds;
+}
+
+TEST(SegyExport, roundTrip) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 10;
+  survey.numCrosslines = 12;
+  auto segyPath = CorpusPath("source.sgy");
+  const std::string path = "zarrs/segy_export.mdio";
+  auto dsRes = IngestSynthetic(survey, segyPath, path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  auto exportPath = CorpusPath("export.sgy");
+  auto summary = mdio::segy::ExportSegy(ds, exportPath);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  EXPECT_EQ(summary.value().tracesWritten, 120);
+
+  auto source = mdio::segy::SegyFile::Open(segyPath).value();
+  auto exported = mdio::segy::SegyFile::Open(exportPath).value();
+  ASSERT_EQ(exported.num_traces(), source.num_traces());
+  EXPECT_EQ(exported.text_header(), source.text_header());
+  EXPECT_EQ(exported.binary_header().sampleInterval,
+            source.binary_header().sampleInterval);
+  const std::vector<std::string> fields = {"inline", "crossline", "cdp_x",
+                                           "cdp_y", "samples_per_trace",
+                                           "sample_interval"};
+  for (mdio::Index t = 0; t < source.num_traces(); ++t) {
+    EXPECT_EQ(std::memcmp(exported.trace_data(t), source.trace_data(t),
+                          source.trace_size() - mdio::segy::kTraceHeaderSize),
+              0)
+        << "IBM samples survive the round trip bit for bit";
+    for (const auto& name : fields) {
+      auto field = mdio::segy::FindHeaderField(name).value();
+      EXPECT_EQ(field.Read(exported.trace_header(t)),
+                field.Read(source.trace_header(t)))
+          << name << " of trace " << t;
+    }
+  }
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyExport, subsetSplitIeee) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 10;
+  survey.numCrosslines = 12;
+  const std::string path = "zarrs/segy_export_subset.mdio";
+  auto dsRes = IngestSynthetic(survey, CorpusPath("source.sgy"), path);
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  mdio::RangeDescriptor<mdio::Index> il = {"inline", 2, 5, 1};
+  auto subset = dsRes.value().isel(il);
+  ASSERT_TRUE(subset.status().ok()) << subset.status();
+  auto ds = subset.value();
+
+  mdio::segy::ExportOptions options;
+  options.format = static_cast<int16_t>(mdio::segy::SampleFormat::kIeee32);
+  options.tracesPerFile = 10;
+  // A few traces per slab, so slabs straddle the output files.
+  options.bufferBytes = 3 * 1024;
+  options.numThreads = 3;
+  // Header words are taken from the dimension coordinates instead.
+  options.headerVariable = "";
+  auto summary = mdio::segy::ExportSegy(ds, CorpusPath("subset.sgy"), options);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  ASSERT_EQ(summary.value().files.size(), 4);
+  EXPECT_EQ(summary.value().files[1], CorpusPath("subset_0001.sgy"));
+
+  std::vector<float> trace(survey.numSamples);
+  mdio::Index total = 0;
+  for (const auto& file : summary.value().files) {
+    auto segy = mdio::segy::SegyFile::Open(file).value();
+    for (mdio::Index t = 0; t < segy.num_traces(); ++t, ++total) {
+      int32_t il = survey.inline_at(2 + total / 12);
+      int32_t xl = survey.crossline_at(total % 12);
+      auto header = segy.trace_header(t);
+      EXPECT_EQ(mdio::segy::FindHeaderField("inline")->Read(header), il);
+      EXPECT_EQ(mdio::segy::FindHeaderField("crossline")->Read(header), xl);
+      ASSERT_TRUE(segy.ReadTrace(t, trace.data()).ok());
+      EXPECT_EQ(trace[5], mdio::segy::SyntheticSurvey::Value(il, xl, 0, 5));
+    }
+  }
+  EXPECT_EQ(total, 36);
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyExport, deadTracesAsZeros) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 6;
+  survey.numCrosslines = 8;
+  survey.live = [](int32_t il, int32_t xl) { return !(il >= 5 && xl >= 4); };
+  auto segyPath = CorpusPath("sparse.sgy");
+  ASSERT_TRUE(mdio::segy::WriteSyntheticSegy(segyPath, survey).ok());
+  const std::string path = "zarrs/segy_export_sparse.mdio";
+  auto dsRes = MakeDataset(survey, path, {2, 4, 64});
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  auto segy = mdio::segy::SegyFile::Open(segyPath).value();
+  auto geometry = mdio::segy::ScanGeometry(segy).value();
+  ASSERT_TRUE(mdio::segy::IngestSegy(segy, geometry, ds).status().ok());
+
+  const std::vector<char> zeros(survey.numSamples * 4, 0);
+  std::vector<float> trace(survey.numSamples);
+  for (auto format : {mdio::segy::SampleFormat::kIbm32,
+                      mdio::segy::SampleFormat::kIeee32}) {
+    mdio::segy::ExportOptions options;
+    options.format = static_cast<int16_t>(format);
+    auto exportPath = CorpusPath("sparse_export.sgy");
+    auto summary = mdio::segy::ExportSegy(ds, exportPath, options);
+    ASSERT_TRUE(summary.status().ok()) << summary.status();
+    auto exported = mdio::segy::SegyFile::Open(exportPath).value();
+    ASSERT_EQ(exported.num_traces(), 48);
+    for (mdio::Index t = 0; t < exported.num_traces(); ++t) {
+      int32_t il = survey.inline_at(t / survey.numCrosslines);
+      int32_t xl = survey.crossline_at(t % survey.numCrosslines);
+      if (survey.live(il, xl)) {
+        ASSERT_TRUE(exported.ReadTrace(t, trace.data()).ok());
+        EXPECT_EQ(trace[7], mdio::segy::SyntheticSurvey::Value(il, xl, 0, 7));
+      } else {
+        EXPECT_EQ(std::memcmp(exported.trace_data(t), zeros.data(),
+                              zeros.size()),
+                  0)
+            << "Dead trace " << t << " is not zero in format "
+            << static_cast<int>(format);
+      }
+    }
+  }
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyExport, chunkAlignedReads) {
+  mdio::segy::SyntheticSurvey survey;
+  survey.numInlines = 10;
+  survey.numCrosslines = 12;
+  const std::string path = "zarrs/segy_export_reads.mdio";
+  ASSERT_TRUE(
+      IngestSynthetic(survey, CorpusPath("source.sgy"), path).status().ok());
+  mdio::SimKvStoreOptions sim;
+  sim.name = "chunkAlignedReads";
+  sim.latencyMedianMs = 0;
+  sim.latencyP99Ms = 0;
+  sim.bandwidthMiBps = 0;
+  sim.concurrency = 0;
+  auto dsRes = mdio::Dataset::Open(path, sim, mdio::constants::kOpen).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  // Room for 6 inlines of 768 bytes per trace, rounded down to the 4 of a
+  // chunk, so every chunk is read once.
+  mdio::segy::ExportOptions options;
+  options.bufferBytes = 6 * 12 * 768;
+  options.numThreads = 2;
+  mdio::ResetSimKvStoreStats(sim.name);
+  auto summary = mdio::segy::ExportSegy(ds, CorpusPath("aligned.sgy"), options);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  EXPECT_EQ(summary.value().tracesWritten, 120);
+  // 3 x 3 x 2 seismic chunks and 3 x 3 header chunks.
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 18 + 9);
+
+  // Chunks the occupancy bitmap marks as empty are not read.
+  auto seismic = ds.variables.at("seismic").value();
+  auto occupancy = mdio::BuildChunkOccupancy(seismic).result().value();
+  for (mdio::Index i = 1; i < 3; ++i) {
+    for (mdio::Index x = 0; x < 3; ++x) {
+      for (mdio::Index t = 0; t < 2; ++t) {
+        occupancy.set({i, x, t}, false);
+      }
+    }
+  }
+  ASSERT_TRUE(mdio::SetChunkOccupancy(seismic, occupancy).ok());
+  mdio::ResetSimKvStoreStats(sim.name);
+  summary = mdio::segy::ExportSegy(ds, CorpusPath("aligned.sgy"), options);
+  ASSERT_TRUE(summary.status().ok()) << summary.status();
+  EXPECT_EQ(mdio::GetSimKvStoreStats(sim.name).reads, 6 + 9);
+  std::filesystem::remove_all(path);
+  std::filesystem::remove_all(kSegyDir);
+}
+
+TEST(SegyIngest, unknownHeaderField) {
+  auto dtype = nlohmann::json::array({nlohmann::json::array({"inline", "<i4"}),
+                                      nlohmann::json::array(
+                                          {"water_bottom", "<f4"})});
+  EXPECT_FALSE(mdio::segy::internal::HeaderLayout::FromDtype(dtype, {}).ok());
+  auto malformed =
+      nlohmann::json::array({nlohmann::json::array({"inline", "<iX"})});
+  EXPECT_TRUE(absl::IsInvalidArgument(
+      mdio::segy::internal::HeaderLayout::FromDtype(malformed, {}).status()))
+      << "A malformed size is an error, not an exception";
+  auto layout = mdio::segy::internal::HeaderLayout::FromDtype(
+      dtype, {{"water_bottom", 225, 4}});
+  ASSERT_TRUE(layout.ok()) << layout.status();
+  EXPECT_EQ(layout.value().itemSize, 8);
+
+  char header[mdio::segy::kTraceHeaderSize] = {};
+  mdio::segy::HeaderField{"water_bottom", 225, 4}.Write(header, 1234);
+  char packed[8];
+  layout.value().Encode(header, packed);
+  float waterBottom;
+  std::memcpy(&waterBottom, packed + 4, sizeof(waterBottom));
+  EXPECT_EQ(waterBottom, 1234.f);
+}
+
+}  // namespace
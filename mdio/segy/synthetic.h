@@ -0,0 +1,278 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SEGY_SYNTHETIC_H_
+#define MDIO_SEGY_SYNTHETIC_H_
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mdio/segy/format.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace segy {
+
+/**
+ * @brief Describes a synthetic post- or pre-stack SEG-Y survey.
+ * Used to build a local test corpus without shipping SEG-Y files. Every sample
+ * value is a function of its grid position (see `Value`) so readers can check
+ * results without keeping the source data around.
+ */
+struct SyntheticSurvey {
+  int32_t firstInline = 1;
+  int32_t numInlines = 8;
+  int32_t inlineStep = 1;
+  int32_t firstCrossline = 1;
+  int32_t numCrosslines = 16;
+  int32_t crosslineStep = 1;
+  // Zero offsets gives a post-stack (3D) survey.
+  int32_t numOffsets = 0;
+  int32_t firstOffset = 0;
+  int32_t offsetStep = 100;
+  int16_t numSamples = 64;
+  // The sample interval in microseconds.
+  int16_t sampleInterval = 4000;
+  int16_t format = static_cast<int16_t>(SampleFormat::kIbm32);
+  // A non-zero seed writes the traces in a shuffled order.
+  uint32_t shuffleSeed = 0;
+  // Which (inline, crossline) locations hold traces. All are live if unset.
+  std::function<bool(int32_t, int32_t)> live;
+
+  /**
+   * @brief The sample value at a grid position.
+   * Values are exactly representable as IBM and IEEE floats.
+   */
+  static float Value(int32_t inline_, int32_t crossline, int32_t offset,
+                     Index sample) {
+    return static_cast<float>((offset % 8) * 100000 + (inline_ % 100) * 1000 +
+                              crossline % 1000) +
+           0.5f * static_cast<float>(sample % 128);
+  }
+
+  int32_t inline_at(Index i) const { return firstInline + i * inlineStep; }
+
+  int32_t crossline_at(Index i) const {
+    return firstCrossline + i * crosslineStep;
+  }
+
+  int32_t offset_at(Index i) const { return firstOffset + i * offsetStep; }
+
+  /// The shape of the trace grid, [inline, crossline(, offset)].
+  std::vector<Index> grid_shape() const {
+    std::vector<Index> shape = {numInlines, numCrosslines};
+    if (numOffsets > 0) {
+      shape.push_back(numOffsets);
+    }
+    return shape;
+  }
+};
+
+/**
+ * @brief Writes a synthetic survey to disk as SEG-Y.
+ * Trace headers carry the inline, crossline, offset, CDP coordinates
+ * (cdp_x = 100000 + 25 * crossline, cdp_y = 200000 + 25 * inline) and the
+ * sample count and interval.
+ * @param path The output file path.
+ * @param survey The survey to write.
+ * @return An error if the file could not be written.
+ */
+inline absl::Status WriteSyntheticSegy(const std::string& path,
+                                       const SyntheticSurvey& survey) {
+  MDIO_ASSIGN_OR_RETURN(auto sampleSize, SampleSize(survey.format))
+  const int32_t numOffsets = std::max(survey.numOffsets, 1);
+
+  struct Location {
+    int32_t il, xl, off;
+  };
+  std::vector<Location> locations;
+  for (Index i = 0; i < survey.numInlines; ++i) {
+    for (Index x = 0; x < survey.numCrosslines; ++x) {
+      int32_t il = survey.inline_at(i);
+      int32_t xl = survey.crossline_at(x);
+      if (survey.live && !survey.live(il, xl)) {
+        continue;
+      }
+      for (Index o = 0; o < numOffsets; ++o) {
+        locations.push_back(
+            {il, xl, survey.numOffsets > 0 ? survey.offset_at(o) : 0});
+      }
+    }
+  }
+  if (survey.shuffleSeed != 0) {
+    std::mt19937 rng(survey.shuffleSeed);
+    std::shuffle(locations.begin(), locations.end(), rng);
+  }
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    return absl::InternalError("Unable to open '" + path + "' for writing.");
+  }
+
+  out << EncodeTextHeader({"C 1 MDIO SYNTHETIC SURVEY",
+                           "C 2 INLINE BYTE 189 CROSSLINE BYTE 193"});
+  BinaryHeader binary;
+  binary.sampleInterval = survey.sampleInterval;
+  binary.samplesPerTrace = survey.numSamples;
+  binary.formatCode = survey.format;
+  binary.tracesPerEnsemble = static_cast<int16_t>(numOffsets);
+  binary.sortingCode = survey.numOffsets > 0 ? 2 : 4;
+  binary.measurementSystem = 1;
+  binary.revision = 0x0100;
+  std::vector<char> buffer(kBinaryHeaderSize);
+  binary.Write(buffer.data());
+  out.write(buffer.data(), kBinaryHeaderSize);
+
+  const Index numSamples = survey.numSamples;
+  std::vector<float> samples(numSamples);
+  buffer.assign(kTraceHeaderSize + numSamples * sampleSize, 0);
+  auto field = [](const char* name) { return FindHeaderField(name).value(); };
+  const HeaderField seq = field("trace_seq_num_line");
+  const HeaderField il = field("inline");
+  const HeaderField xl = field("crossline");
+  const HeaderField off = field("offset");
+  const HeaderField cdpX = field("cdp_x");
+  const HeaderField cdpY = field("cdp_y");
+  const HeaderField scalar = field("coordinate_scalar");
+  const HeaderField ns = field("samples_per_trace");
+  const HeaderField dt = field("sample_interval");
+
+  Index sequence = 0;
+  for (const auto& loc : locations) {
+    char* header = buffer.data();
+    std::fill(buffer.begin(), buffer.begin() + kTraceHeaderSize, 0);
+    seq.Write(header, ++sequence);
+    il.Write(header, loc.il);
+    xl.Write(header, loc.xl);
+    off.Write(header, loc.off);
+    cdpX.Write(header, 100000 + 25 * loc.xl);
+    cdpY.Write(header, 200000 + 25 * loc.il);
+    scalar.Write(header, 1);
+    ns.Write(header, survey.numSamples);
+    dt.Write(header, survey.sampleInterval);
+    for (Index s = 0; s < numSamples; ++s) {
+      samples[s] = SyntheticSurvey::Value(loc.il, loc.xl, loc.off, s);
+    }
+    auto status = EncodeSamples(samples.data(), survey.format,
+                                header + kTraceHeaderSize, numSamples);
+    if (!status.ok()) {
+      return status;
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  }
+  out.close();
+  if (!out) {
+    return absl::InternalError("Failed writing '" + path + "'.");
+  }
+  return absl::OkStatus();
+}
+
+/**
+ * @brief Builds an MDIO Dataset schema matching a synthetic survey.
+ * The Dataset holds a float32 "seismic" Variable on
+ * [inline, crossline(, offset), time], a structarray "headers" Variable with
+ * the inline, crossline(, offset), cdp_x and cdp_y header words, and analytic
+ * dimension coordinates.
+ * @param survey The survey.
+ * @param chunkShape The seismic chunk shape. The headers use its leading
+ * entries. Defaults to the full shape.
+ */
+inline nlohmann::json SyntheticSchema(const SyntheticSurvey& survey,
+                                      std::vector<Index> chunkShape = {}) {
+  auto shape = survey.grid_shape();
+  shape.push_back(survey.numSamples);
+  if (chunkShape.empty()) {
+    chunkShape = shape;
+  }
+  std::vector<std::string> names = {"inline", "crossline"};
+  if (survey.numOffsets > 0) {
+    names.push_back("offset");
+  }
+  names.push_back("time");
+
+  auto dims = nlohmann::json::array();
+  for (size_t i = 0; i < names.size(); ++i) {
+    dims.push_back({{"name", names[i]}, {"size", shape[i]}});
+  }
+  auto chunkGrid = [](std::vector<Index> chunks) {
+    return nlohmann::json{{"name", "regular"},
+                          {"configuration", {{"chunkShape", chunks}}}};
+  };
+  auto coordinateNames = names;
+
+  auto fields = nlohmann::json::array();
+  for (size_t i = 0; i + 1 < names.size(); ++i) {
+    fields.push_back({{"name", names[i]}, {"format", "int32"}});
+  }
+  fields.push_back({{"name", "cdp_x"}, {"format", "int32"}});
+  fields.push_back({{"name", "cdp_y"}, {"format", "int32"}});
+  auto headerDims = dims;
+  headerDims.erase(headerDims.size() - 1);
+
+  auto variables = nlohmann::json::array();
+  variables.push_back(
+      {{"name", "seismic"},
+       {"dataType", "float32"},
+       {"dimensions", dims},
+       {"compressor", {{"name", "blosc"}, {"algorithm", "zstd"}}},
+       {"metadata", {{"chunkGrid", chunkGrid(chunkShape)}}},
+       {"coordinates", coordinateNames}});
+  variables.push_back(
+      {{"name", "headers"},
+       {"dataType", {{"fields", fields}}},
+       {"dimensions", headerDims},
+       {"metadata",
+        {{"chunkGrid",
+          chunkGrid(std::vector<Index>(chunkShape.begin(),
+                                       chunkShape.end() - 1))}}}});
+
+  auto analytic = [&](const std::string& name, const std::string& dtype,
+                      Index size, double start, double step) {
+    variables.push_back(
+        {{"name", name},
+         {"dataType", dtype},
+         {"dimensions", {{{"name", name}, {"size", size}}}},
+         {"metadata",
+          {{"attributes",
+            {{"analyticCoordinate", {{"start", start}, {"step", step}}}}}}}});
+  };
+  analytic("inline", "int32", survey.numInlines, survey.firstInline,
+           survey.inlineStep);
+  analytic("crossline", "int32", survey.numCrosslines, survey.firstCrossline,
+           survey.crosslineStep);
+  if (survey.numOffsets > 0) {
+    analytic("offset", "int32", survey.numOffsets, survey.firstOffset,
+             survey.offsetStep);
+  }
+  analytic("time", "float32", survey.numSamples, 0.0,
+           survey.sampleInterval / 1000.0);
+
+  return {{"metadata",
+           {{"name", "synthetic"},
+            {"apiVersion", "1.0.0"},
+            {"createdOn", "2024-06-01T12:00:00.000000-05:00"}}},
+          {"variables", variables}};
+}
+
+}  // namespace segy
+}  // namespace mdio
+
+#endif  // MDIO_SEGY_SYNTHETIC_H_
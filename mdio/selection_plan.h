@@ -0,0 +1,305 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SELECTION_PLAN_H_
+#define MDIO_SELECTION_PLAN_H_
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/container/inlined_vector.h"
+#include "mdio/dataset.h"
+#include "mdio/shared_json.h"
+#include "mdio/variable_collection.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+
+/**
+ * @brief A window of a Dataset, compiled once and moved around cheaply.
+ * Sliding window processing and patch sampling select the same window shape
+ * at many offsets. The plan resolves the labels of the window against every
+ * selected Variable up front, so that moving the window only slices the
+ * stores.
+ * @details \b Usage
+ * @code
+ * mdio::RangeDescriptor<mdio::Index> desc1 = {"inline", 0, 64, 1};
+ * mdio::RangeDescriptor<mdio::Index> desc2 = {"crossline", 0, 64, 1};
+ * MDIO_ASSIGN_OR_RETURN(
+ *     auto plan, mdio::SelectionPlan::Compile(ds, {desc1, desc2}, {"seismic"}))
+ * // The same as ds.isel({"inline", 128, 192}, {"crossline", 64, 128})
+ * MDIO_ASSIGN_OR_RETURN(auto window, plan.At({128, 64}))
+ * // Or read the Variable without building a Dataset.
+ * auto data = plan.Read<float>("seismic", {128, 64});
+ * @endcode
+ * A plan is immutable, so any number of threads may use one.
+ */
+class SelectionPlan {
+ public:
+  SelectionPlan() = default;
+
+  /**
+   * @brief Compiles a plan for a window of the Dataset.
+   * @param dataset The Dataset to select from.
+   * @param window The window at offset zero, one descriptor per dimension.
+   * Dimensions that are not described remain intact.
+   * @param variables The Variables to select, all of them if empty.
+   * @return The plan, or an error if a descriptor is invalid or names a
+   * dimension of none of the Variables.
+   */
+  static Result<SelectionPlan> Compile(
+      const Dataset& dataset, const std::vector<RangeDescriptor<Index>>& window,
+      const std::vector<std::string>& variables = {}) {
+    SelectionPlan plan;
+    // Copied once here, shared by every window.
+    plan.metadata = dataset.getMetadata();
+
+    std::unordered_map<std::string, size_t> windowIndex;
+    for (const auto& desc : window) {
+      if (desc.label.label().empty()) {
+        return absl::InvalidArgumentError(
+            "A SelectionPlan must be described by dimension labels.");
+      }
+      if (desc.step != 1) {
+        return absl::InvalidArgumentError(
+            "Only step 1 is supported for slicing.");
+      }
+      if (desc.start > desc.stop) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Slice descriptor for ", desc.label.label(),
+                         " had an illegal configuration.\n\tStart '",
+                         desc.start, "' greater than stop '", desc.stop, "'."));
+      }
+      std::string label(desc.label.label());
+      if (!windowIndex.emplace(label, plan.start.size()).second) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Dimension '", label, "' was described twice."));
+      }
+      plan.start.push_back(desc.start);
+      plan.size.push_back(desc.stop - desc.start);
+    }
+
+    auto names = variables.empty() ? dataset.variables.get_iterable_accessor()
+                                   : variables;
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+
+    // The full extent of each dimension, ordered as Dataset::isel orders them.
+    std::map<std::string, IndexInterval> extents;
+    std::vector<bool> used(plan.start.size(), false);
+    for (const auto& name : names) {
+      MDIO_ASSIGN_OR_RETURN(auto variable, dataset.variables.at(name))
+      Entry entry{name, variable};
+      auto domain = variable.get_store().domain();
+      for (DimensionIndex i = 0; i < domain.rank(); ++i) {
+        std::string label(domain.labels()[i]);
+        // structarrays must have a byte dimension.
+        if (label.empty()) {
+          continue;
+        }
+        extents[label] = domain[i].interval();
+        auto found = windowIndex.find(label);
+        if (found != windowIndex.end()) {
+          entry.window.dims.push_back(i);
+          entry.window.axes.push_back(found->second);
+          entry.window.bounds.push_back(domain[i].interval());
+          used[found->second] = true;
+        }
+      }
+      plan.entries.push_back(std::move(entry));
+      auto coordinates = dataset.coordinates.find(name);
+      if (coordinates != dataset.coordinates.end()) {
+        plan.coordinates.insert(*coordinates);
+      }
+    }
+    for (const auto& [label, axis] : windowIndex) {
+      if (!used[axis]) {
+        return absl::NotFoundError(absl::StrCat(
+            "Dimension '", label, "' is not in any selected Variable."));
+      }
+    }
+
+    std::vector<std::string> labels;
+    std::vector<Index> origin, shape;
+    for (const auto& [label, interval] : extents) {
+      auto found = windowIndex.find(label);
+      if (found != windowIndex.end()) {
+        plan.domainWindow.dims.push_back(labels.size());
+        plan.domainWindow.axes.push_back(found->second);
+        plan.domainWindow.bounds.push_back(interval);
+      }
+      labels.push_back(label);
+      origin.push_back(interval.inclusive_min());
+      shape.push_back(interval.size());
+    }
+    MDIO_ASSIGN_OR_RETURN(plan.domain,
+                          tensorstore::IndexDomainBuilder<>(labels.size())
+                              .origin(origin)
+                              .shape(shape)
+                              .labels(labels)
+                              .Finalize())
+    return plan;
+  }
+
+  /**
+   * @brief The window moved by `offsets`, as a Dataset.
+   * Like Dataset::isel, the window is clamped to the domain of each Variable.
+   * @param offsets One offset per descriptor the plan was compiled from.
+   * @return The selected Variables sliced to the window.
+   */
+  Result<Dataset> At(tensorstore::span<const Index> offsets) const {
+    trace::Span span("SelectionPlan::At", "dataset");
+    auto map = std::make_shared<std::unordered_map<
+        std::string, std::shared_ptr<const Variable<>>>>();
+    map->reserve(entries.size());
+    for (const auto& entry : entries) {
+      MDIO_ASSIGN_OR_RETURN(auto variable, Slice(entry, offsets))
+      map->emplace(entry.name,
+                   std::make_shared<const Variable<>>(std::move(variable)));
+    }
+    MDIO_ASSIGN_OR_RETURN(auto windowDomain,
+                          Slice(domain, domainWindow, offsets))
+    return Dataset{metadata,
+                   VariableCollection(VariableCollection::Snapshot(map)),
+                   coordinates, windowDomain};
+  }
+
+  Result<Dataset> At(std::initializer_list<Index> offsets) const {
+    return At(tensorstore::span<const Index>(offsets.begin(), offsets.size()));
+  }
+
+  /**
+   * @brief One selected Variable, sliced to the window moved by `offsets`.
+   * @return The Variable, or an error if it was not selected or is not of the
+   * requested type.
+   */
+  template <typename T = void, DimensionIndex R = dynamic_rank,
+            ReadWriteMode M = ReadWriteMode::dynamic>
+  Result<Variable<T, R, M>> Get(const std::string& variable,
+                                tensorstore::span<const Index> offsets) const {
+    auto entry = std::lower_bound(
+        entries.begin(), entries.end(), variable,
+        [](const Entry& e, const std::string& name) { return e.name < name; });
+    if (entry == entries.end() || entry->name != variable) {
+      return absl::NotFoundError(absl::StrCat(
+          "Variable '", variable, "' is not selected by the plan."));
+    }
+    MDIO_ASSIGN_OR_RETURN(auto sliced, Slice(*entry, offsets))
+    return internal::CastVariable<T, R, M>(sliced);
+  }
+
+  /**
+   * @brief Reads one selected Variable in the window moved by `offsets`.
+   * @return A future to the data, as Variable::Read returns it.
+   */
+  template <typename T = void, DimensionIndex R = dynamic_rank,
+            ArrayOriginKind OriginKind = offset_origin>
+  Future<VariableData<T, R, OriginKind>> Read(
+      const std::string& variable,
+      tensorstore::span<const Index> offsets) const {
+    MDIO_ASSIGN_OR_RETURN(auto sliced, (Get<T, R>(variable, offsets)))
+    return sliced.template Read<OriginKind>();
+  }
+
+  template <typename T = void, DimensionIndex R = dynamic_rank,
+            ArrayOriginKind OriginKind = offset_origin>
+  Future<VariableData<T, R, OriginKind>> Read(
+      const std::string& variable, std::initializer_list<Index> offsets) const {
+    return Read<T, R, OriginKind>(
+        variable,
+        tensorstore::span<const Index>(offsets.begin(), offsets.size()));
+  }
+
+ private:
+  // Where the window falls in the domain of a Variable or of the Dataset.
+  struct Window {
+    // The dimensions that are sliced ...
+    std::vector<DimensionIndex> dims;
+    // ... the descriptor of each ...
+    std::vector<size_t> axes;
+    // ... and their extent, which the window is clamped to.
+    std::vector<IndexInterval> bounds;
+  };
+
+  // A selected Variable.
+  struct Entry {
+    std::string name;
+    Variable<> variable;
+    Window window;
+  };
+
+  Result<Variable<>> Slice(const Entry& entry,
+                           tensorstore::span<const Index> offsets) const {
+    MDIO_ASSIGN_OR_RETURN(
+        auto store, Slice(entry.variable.get_store(), entry.window, offsets))
+    return Variable<>{entry.variable, store};
+  }
+
+  // Slices a store or domain to the window.
+  template <typename Target>
+  Result<Target> Slice(const Target& target, const Window& window,
+                       tensorstore::span<const Index> offsets) const {
+    if (static_cast<size_t>(offsets.size()) != start.size()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Expected ", start.size(), " offsets but got ",
+                       offsets.size(), "."));
+    }
+    const size_t rank = window.dims.size();
+    if (rank == 0) {
+      return target;
+    }
+    absl::InlinedVector<Index, 8> lo(rank), hi(rank);
+    for (size_t i = 0; i < rank; ++i) {
+      // Clamped to the domain as Variable::slice clamps.
+      const auto& bounds = window.bounds[i];
+      Index first = start[window.axes[i]] + offsets[window.axes[i]];
+      lo[i] = std::max(first, bounds.inclusive_min());
+      hi[i] = std::min(first + size[window.axes[i]], bounds.exclusive_max());
+      if (lo[i] > hi[i]) {
+        return absl::OutOfRangeError(absl::StrCat(
+            "The window starts at ", first, " in dimension ", window.dims[i],
+            " but the domain ends at ", bounds.exclusive_max(), "."));
+      }
+    }
+    tensorstore::span<const DimensionIndex> dims(window.dims);
+    return target | tensorstore::Dims(dims).HalfOpenInterval(
+                        tensorstore::span<const Index>(lo.data(), rank),
+                        tensorstore::span<const Index>(hi.data(), rank));
+  }
+
+  // The window at offset zero, one entry per descriptor.
+  std::vector<Index> start;
+  std::vector<Index> size;
+  // The selected Variables, ordered by name.
+  std::vector<Entry> entries;
+  // The domain of the unsliced selection and the dimensions the window slices.
+  tensorstore::IndexDomain<> domain;
+  Window domainWindow;
+  // Passed on to every window. The coordinates are those of the selected
+  // Variables only, so that a window copies no more than it needs.
+  SharedJson metadata;
+  coordinate_map coordinates;
+};
+
+}  // namespace mdio
+
+#endif  // MDIO_SELECTION_PLAN_H_
@@ -0,0 +1,182 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/selection_plan.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/selection_plan.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 32},
+      {"name": "crossline", "size": 16},
+      {"name": "time", "size": 8}
+    ],
+    "coordinates": ["inline", "crossline"],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 8, 8] }
+      }
+    }
+  },
+  {
+    "name": "inline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "inline", "size": 32}]
+  },
+  {
+    "name": "crossline",
+    "dataType": "uint32",
+    "dimensions": [{"name": "crossline", "size": 16}]
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("selection_plan", variables));
+  return mdio::test_util::Fill<float>(ds, "image", [](auto index) {
+    return index[0] * 100 + index[1];
+  });
+}
+
+// The plan and Dataset::isel select the same window.
+void ExpectSameWindow(const mdio::Dataset& plan, const mdio::Dataset& isel) {
+  EXPECT_EQ(plan.domain, isel.domain);
+  EXPECT_EQ(plan.variables.get_iterable_accessor(),
+            isel.variables.get_iterable_accessor());
+  for (const auto& name : isel.variables.get_iterable_accessor()) {
+    auto expected = isel.variables.at(name);
+    auto actual = plan.variables.at(name);
+    ASSERT_TRUE(actual.ok()) << actual.status();
+    EXPECT_EQ(actual.value().dimensions(), expected.value().dimensions())
+        << name;
+  }
+}
+
+TEST(SelectionPlan, matchesIsel) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  mdio::RangeDescriptor<mdio::Index> desc1 = {"inline", 0, 8, 1};
+  mdio::RangeDescriptor<mdio::Index> desc2 = {"crossline", 2, 6, 1};
+  auto plan = mdio::SelectionPlan::Compile(ds.value(), {desc1, desc2});
+  ASSERT_TRUE(plan.ok()) << plan.status();
+
+  for (mdio::Index inline_ : {0, 8, 16, 24}) {
+    for (mdio::Index crossline : {0, 5, 10}) {
+      auto window = plan.value().At({inline_, crossline});
+      ASSERT_TRUE(window.ok()) << window.status();
+      mdio::RangeDescriptor<mdio::Index> moved1 = {"inline", inline_,
+                                                   inline_ + 8, 1};
+      mdio::RangeDescriptor<mdio::Index> moved2 = {
+          "crossline", 2 + crossline, 6 + crossline, 1};
+      auto expected = ds.value().isel(moved1, moved2);
+      ASSERT_TRUE(expected.ok()) << expected.status();
+      ExpectSameWindow(window.value(), expected.value());
+    }
+  }
+}
+
+TEST(SelectionPlan, clamped) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  mdio::RangeDescriptor<mdio::Index> desc = {"inline", 0, 8, 1};
+  auto plan = mdio::SelectionPlan::Compile(ds.value(), {desc});
+  ASSERT_TRUE(plan.ok()) << plan.status();
+
+  auto window = plan.value().At({28});
+  ASSERT_TRUE(window.ok()) << window.status();
+  mdio::RangeDescriptor<mdio::Index> moved = {"inline", 28, 36, 1};
+  auto expected = ds.value().isel(moved);
+  ASSERT_TRUE(expected.ok()) << expected.status();
+  ExpectSameWindow(window.value(), expected.value());
+  EXPECT_EQ(window.value().domain.shape()[1], 4);
+
+  auto past = plan.value().At({40});
+  EXPECT_FALSE(past.ok());
+}
+
+TEST(SelectionPlan, read) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  mdio::RangeDescriptor<mdio::Index> desc1 = {"inline", 0, 4, 1};
+  mdio::RangeDescriptor<mdio::Index> desc2 = {"crossline", 0, 4, 1};
+  auto plan =
+      mdio::SelectionPlan::Compile(ds.value(), {desc1, desc2}, {"image"});
+  ASSERT_TRUE(plan.ok()) << plan.status();
+
+  auto data = plan.value().Read<float>("image", {12, 8}).result();
+  ASSERT_TRUE(data.ok()) << data.status();
+  auto samples = data.value().get_data_accessor();
+  EXPECT_EQ(samples.domain().shape()[0], 4);
+  EXPECT_EQ(samples.domain().shape()[1], 4);
+  EXPECT_EQ(samples({13, 9, 0}), 1309);
+  EXPECT_EQ(samples({15, 11, 7}), 1511);
+
+  std::vector<mdio::Index> origin = {0, 0};
+  auto variable = plan.value().Get<float>("image", origin);
+  ASSERT_TRUE(variable.ok()) << variable.status();
+  EXPECT_EQ(variable.value().get_variable_name(), "image");
+  EXPECT_EQ(variable.value().dimensions().shape()[0], 4);
+
+  // Only the selected Variables are in the windows.
+  auto window = plan.value().At({0, 0});
+  ASSERT_TRUE(window.ok()) << window.status();
+  EXPECT_EQ(window.value().variables.get_keys(),
+            std::vector<std::string>{"image"});
+  EXPECT_EQ(window.value().coordinates.size(), 1);
+  // The windows share the root metadata rather than copying it.
+  auto other = plan.value().At({8, 8});
+  ASSERT_TRUE(other.ok()) << other.status();
+  EXPECT_EQ(&window.value().getMetadata(), &other.value().getMetadata());
+  EXPECT_EQ(window.value().getMetadata(), ds.value().getMetadata());
+  EXPECT_FALSE(plan.value().Read<float>("inline", {0, 0}).result().ok());
+}
+
+TEST(SelectionPlan, invalid) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  mdio::RangeDescriptor<mdio::Index> desc = {"inline", 0, 8, 1};
+
+  mdio::RangeDescriptor<mdio::Index> missing = {"offset", 0, 8, 1};
+  EXPECT_FALSE(mdio::SelectionPlan::Compile(ds.value(), {missing}).ok());
+  mdio::RangeDescriptor<mdio::Index> stepped = {"inline", 0, 8, 2};
+  EXPECT_FALSE(mdio::SelectionPlan::Compile(ds.value(), {stepped}).ok());
+  EXPECT_FALSE(mdio::SelectionPlan::Compile(ds.value(), {desc, desc}).ok());
+  EXPECT_FALSE(
+      mdio::SelectionPlan::Compile(ds.value(), {desc}, {"velocity"}).ok());
+  // `crossline` does not have an inline dimension.
+  EXPECT_FALSE(
+      mdio::SelectionPlan::Compile(ds.value(), {desc}, {"crossline"}).ok());
+
+  auto plan = mdio::SelectionPlan::Compile(ds.value(), {desc});
+  ASSERT_TRUE(plan.ok()) << plan.status();
+  EXPECT_FALSE(plan.value().At({0, 0}).ok());
+}
+
+}  // namespace
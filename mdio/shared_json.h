@@ -0,0 +1,113 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SHARED_JSON_H_
+#define MDIO_SHARED_JSON_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+
+/**
+ * @brief A JSON value shared by reference count and copied on write.
+ * Copies share one immutable value, so passing metadata along costs a
+ * reference count rather than a copy of the JSON. The non-const accessors
+ * copy the value first if it is shared, so a change is never seen through
+ * another copy.
+ * @details \b Usage
+ * @code
+ * mdio::SharedJson metadata = nlohmann::json{{"long_name", "amplitude"}};
+ * auto copy = metadata;                   // Shares the value
+ * copy["long_name"] = "velocity";         // Copies it, then changes the copy
+ * const nlohmann::json& json = metadata;  // Still "amplitude"
+ * @endcode
+ */
+class SharedJson {
+ public:
+  SharedJson() = default;
+
+  // Implicit, so that a JSON value can be passed wherever metadata is taken.
+  SharedJson(nlohmann::json value)  // NOLINT
+      : value_(std::make_shared<nlohmann::json>(std::move(value))) {}
+
+  /// The value. A default constructed SharedJson is null.
+  const nlohmann::json& get() const { return value_ ? *value_ : Null(); }
+
+  operator const nlohmann::json&() const { return get(); }  // NOLINT
+
+  /**
+   * @brief The value for modification.
+   * Copied first unless this is its only owner. The reference is invalidated
+   * by copying this SharedJson.
+   */
+  nlohmann::json& mutate() {
+    if (!value_ || value_.use_count() != 1) {
+      value_ = std::make_shared<nlohmann::json>(get());
+    }
+    return *value_;
+  }
+
+  template <typename Key>
+  const nlohmann::json& operator[](Key&& key) const {
+    return get()[std::forward<Key>(key)];
+  }
+
+  /// Like nlohmann::json, inserts a null value for a missing key.
+  template <typename Key>
+  nlohmann::json& operator[](Key&& key) {
+    return mutate()[std::forward<Key>(key)];
+  }
+
+  template <typename Key>
+  bool contains(Key&& key) const {
+    return get().contains(std::forward<Key>(key));
+  }
+
+  std::string dump(int indent = -1) const { return get().dump(indent); }
+
+  /// Whether both hold the same value, without comparing it.
+  bool shares(const SharedJson& other) const { return value_ == other.value_; }
+
+  friend bool operator==(const SharedJson& a, const nlohmann::json& b) {
+    return a.get() == b;
+  }
+
+  friend bool operator!=(const SharedJson& a, const nlohmann::json& b) {
+    return a.get() != b;
+  }
+
+  friend std::ostream& operator<<(std::ostream& os, const SharedJson& json) {
+    return os << json.get();
+  }
+
+ private:
+  static const nlohmann::json& Null() {
+    static const nlohmann::json* null = new nlohmann::json();
+    return *null;
+  }
+
+  // Never modified while shared, see mutate().
+  std::shared_ptr<nlohmann::json> value_;
+};
+
+}  // namespace mdio
+
+#endif  // MDIO_SHARED_JSON_H_
@@ -0,0 +1,204 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/shared_json.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+// Counts the allocations of the test, see readAllocations.
+static std::atomic<int64_t> allocations{0};
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* ptr = std::malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/shared_json.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 32},
+      {"name": "time", "size": 16}
+    ],
+    "longName": "Seismic amplitude",
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 16] }
+      }
+    }
+  },
+  {
+    "name": "quantized",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 32},
+      {"name": "time", "size": 16}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 16] }
+      },
+      "attributes": {
+        "quantization": {"dtype": "int16", "scale": 0.01}
+      }
+    }
+  }
+]
+  )";
+  return mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("shared_json", variables));
+}
+
+TEST(SharedJson, copyOnWrite) {
+  mdio::SharedJson original = nlohmann::json{{"long_name", "amplitude"}};
+  auto copy = original;
+  EXPECT_TRUE(copy.shares(original));
+
+  copy["long_name"] = "velocity";
+  EXPECT_FALSE(copy.shares(original));
+  EXPECT_EQ(original["long_name"], "amplitude");
+  EXPECT_EQ(copy["long_name"], "velocity");
+
+  // The only owner is modified in place.
+  auto before = &copy.get();
+  copy.mutate()["units"] = "m/s";
+  EXPECT_EQ(&copy.get(), before);
+}
+
+TEST(SharedJson, json) {
+  mdio::SharedJson empty;
+  EXPECT_TRUE(empty.get().is_null());
+  EXPECT_FALSE(empty.contains("long_name"));
+
+  mdio::SharedJson metadata = nlohmann::json{{"dimension_names", {"x", "y"}}};
+  const nlohmann::json& json = metadata;
+  EXPECT_EQ(json["dimension_names"].size(), 2);
+  EXPECT_TRUE(metadata.contains("dimension_names"));
+  EXPECT_EQ(metadata, json);
+  EXPECT_EQ(metadata.dump(), json.dump());
+
+  std::stringstream stream;
+  stream << metadata;
+  EXPECT_EQ(stream.str(), json.dump());
+}
+
+TEST(SharedJson, variableMetadata) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+
+  auto image = ds.value().variables.get<float>("image");
+  ASSERT_TRUE(image.ok()) << image.status();
+  auto again = ds.value().variables.get<float>("image");
+  ASSERT_TRUE(again.ok()) << again.status();
+  EXPECT_TRUE(image.value().getSharedReducedMetadata().shares(
+      again.value().getSharedReducedMetadata()));
+
+  mdio::RangeDescriptor<mdio::Index> range = {"inline", 0, 8, 1};
+  auto slice = image.value().isel(range);
+  ASSERT_TRUE(slice.ok()) << slice.status();
+  EXPECT_TRUE(slice.value().getSharedReducedMetadata().shares(
+      image.value().getSharedReducedMetadata()));
+
+  // The merged metadata is kept between calls and shared with the data read.
+  auto merged = image.value().getSharedMetadata();
+  EXPECT_TRUE(merged.shares(slice.value().getSharedMetadata()));
+  auto data = slice.value().Read().result();
+  ASSERT_TRUE(data.ok()) << data.status();
+  EXPECT_TRUE(data.value().metadata.shares(merged));
+  EXPECT_EQ(data.value().metadata, image.value().getMetadata());
+}
+
+TEST(SharedJson, attributesUpdated) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image");
+  ASSERT_TRUE(image.ok()) << image.status();
+
+  const auto before = image.value().getSharedMetadata();
+  nlohmann::json attrs = {{"attributes", {{"foo", "bar"}}}};
+  ASSERT_TRUE(image.value().UpdateAttributes(attrs).status().ok());
+  const auto after = image.value().getSharedMetadata();
+  EXPECT_FALSE(after.shares(before));
+  EXPECT_EQ(after["metadata"]["attributes"]["foo"], "bar") << after.dump(4);
+  EXPECT_EQ(before.dump().find("\"foo\""), std::string::npos)
+      << before.dump(4);
+
+  // Other Variables over the same attributes see the update.
+  auto other = ds.value().variables.get<float>("image");
+  ASSERT_TRUE(other.ok()) << other.status();
+  EXPECT_EQ(other.value().getMetadata(), after.get());
+}
+
+// The allocations of one read of the Variable.
+int64_t AllocationsOfRead(const mdio::Variable<float>& variable) {
+  const int64_t before = allocations;
+  auto data = variable.Read().result();
+  const int64_t count = allocations - before;
+  EXPECT_TRUE(data.ok()) << data.status();
+  return count;
+}
+
+TEST(SharedJson, readAllocations) {
+  auto ds = SETUP(kPath).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto quantized = ds.value().variables.get<float>("quantized");
+  ASSERT_TRUE(quantized.ok()) << quantized.status();
+  auto& variable = quantized.value();
+
+  // The first read merges the metadata and parses the quantization.
+  AllocationsOfRead(variable);
+  const int64_t few = AllocationsOfRead(variable);
+
+  auto attrs = variable.GetAttributes();
+  for (int i = 0; i < 2000; ++i) {
+    attrs["attributes"]["key" + std::to_string(i)] = i;
+  }
+  ASSERT_TRUE(variable.UpdateAttributes(attrs).status().ok());
+  AllocationsOfRead(variable);
+  const int64_t many = AllocationsOfRead(variable);
+  // Copying the attributes would take several allocations per key.
+  EXPECT_LT(many - few, 1000) << few << " allocations became " << many;
+}
+
+}  // namespace
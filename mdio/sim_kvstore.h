@@ -0,0 +1,511 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_SIM_KVSTORE_H_
+#define MDIO_SIM_KVSTORE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mdio/impl.h"
+#include "tensorstore/internal/intrusive_ptr.h"
+#include "tensorstore/internal/json_binding/bindable.h"
+#include "tensorstore/internal/json_binding/json_binding.h"
+#include "tensorstore/internal/thread/schedule_at.h"
+#include "tensorstore/kvstore/driver.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/kvstore/registry.h"
+#include "tensorstore/kvstore/spec.h"
+#include "tensorstore/util/future.h"
+#include "tensorstore/util/garbage_collection/garbage_collection.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+
+/**
+ * @brief The conditions a simulated remote store imposes on a local one.
+ * The defaults are roughly those of a cloud bucket read from a VM in the same
+ * region.
+ */
+struct SimKvStoreOptions {
+  /// The name the request counters are kept under, see GetSimKvStoreStats.
+  std::string name = "default";
+  /// The median time to first byte of a request.
+  double latencyMedianMs = 30;
+  /**
+   * The 99th percentile time to first byte. Latencies are log-normal between
+   * the two; equal values give a fixed latency.
+   */
+  double latencyP99Ms = 150;
+  /// The bandwidth shared by all transfers of the store. 0 is unlimited.
+  double bandwidthMiBps = 200;
+  /// The requests served at once; later ones queue. 0 is unlimited.
+  int concurrency = 32;
+  /// The probability that a request is throttled, like a 503 Slow Down.
+  double throttleRate = 0;
+  /**
+   * The retries of a throttled request before its error is returned, each
+   * after an exponential backoff, as the cloud drivers do.
+   */
+  int maxRetries = 8;
+  /// The backoff before the first retry.
+  double backoffMs = 100;
+  /// The seed of the latency and throttling draws.
+  uint64_t seed = 0;
+};
+
+/**
+ * @brief The requests a simulated store served.
+ */
+struct SimKvStoreStats {
+  Index reads = 0;
+  Index writes = 0;
+  Index deletes = 0;
+  Index lists = 0;
+  Index bytesRead = 0;
+  Index bytesWritten = 0;
+  /// Attempts rejected by throttling, whether retried or not.
+  Index throttled = 0;
+  /// Requests that failed after exhausting their retries.
+  Index failed = 0;
+};
+
+namespace internal {
+
+struct SimKvStoreCounters {
+  std::atomic<Index> reads{0};
+  std::atomic<Index> writes{0};
+  std::atomic<Index> deletes{0};
+  std::atomic<Index> lists{0};
+  std::atomic<Index> bytesRead{0};
+  std::atomic<Index> bytesWritten{0};
+  std::atomic<Index> throttled{0};
+  std::atomic<Index> failed{0};
+};
+
+/**
+ * @brief The counters of a name, shared by every simulated store of this
+ * process that uses it.
+ */
+inline std::shared_ptr<SimKvStoreCounters> GetSimKvStoreCounters(
+    const std::string& name) {
+  static std::mutex mutex;
+  static std::map<std::string, std::shared_ptr<SimKvStoreCounters>> counters;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& entry = counters[name];
+  if (!entry) {
+    entry = std::make_shared<SimKvStoreCounters>();
+  }
+  return entry;
+}
+
+/**
+ * @brief The timeline of a simulated store.
+ * Each request is placed on the earliest free slot of the store, waits for its
+ * latency and then for its share of the bandwidth. The completion time is
+ * decided when the request is issued, so the local store underneath can be as
+ * fast as it likes.
+ */
+class SimTimeline {
+ public:
+  explicit SimTimeline(const SimKvStoreOptions& options)
+      : options_(options),
+        slots_(std::max(options.concurrency, 0), absl::InfinitePast()),
+        random_(options.seed) {
+    const double median = std::max(options.latencyMedianMs, 0.0);
+    mu_ = std::log(std::max(median, 1e-3));
+    // 2.326 standard deviations put the 99th percentile at latencyP99Ms.
+    sigma_ = options.latencyP99Ms > median
+                 ? std::log(options.latencyP99Ms / std::max(median, 1e-3)) /
+                       2.326
+                 : 0;
+  }
+
+  /// The number of throttled attempts before a request gets through.
+  int DrawThrottled() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int throttled = 0;
+    std::uniform_real_distribution<double> uniform(0, 1);
+    while (throttled <= options_.maxRetries &&
+           uniform(random_) < options_.throttleRate) {
+      ++throttled;
+    }
+    return throttled;
+  }
+
+  /**
+   * @brief Schedules a request.
+   * @param throttled The attempts rejected before the one that transfers.
+   * @param bytes The bytes transferred by the last attempt.
+   * @return The time the request completes.
+   */
+  absl::Time Schedule(int throttled, Index bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    absl::Time time = absl::Now();
+    double backoff = options_.backoffMs;
+    for (int attempt = 0; attempt <= throttled; ++attempt) {
+      time = Occupy(time, attempt == throttled ? bytes : 0);
+      if (attempt < throttled) {
+        time += absl::Milliseconds(backoff);
+        backoff *= 2;
+      }
+    }
+    return time;
+  }
+
+ private:
+  // Runs one attempt from the earliest free slot at or after `ready`.
+  absl::Time Occupy(absl::Time ready, Index bytes) {
+    auto slot = std::min_element(slots_.begin(), slots_.end());
+    absl::Time start = ready;
+    if (slot != slots_.end()) {
+      start = std::max(start, *slot);
+    }
+    double latency = std::exp(mu_);
+    if (sigma_ > 0) {
+      latency = std::lognormal_distribution<double>(mu_, sigma_)(random_);
+    }
+    absl::Time finish = start + absl::Milliseconds(latency);
+    if (bytes > 0 && options_.bandwidthMiBps > 0) {
+      finish = std::max(finish, link_) +
+               absl::Seconds(bytes / (options_.bandwidthMiBps * (1 << 20)));
+      link_ = finish;
+    }
+    if (slot != slots_.end()) {
+      *slot = finish;
+    }
+    return finish;
+  }
+
+  SimKvStoreOptions options_;
+  std::mutex mutex_;
+  // The time each request slot frees up.
+  std::vector<absl::Time> slots_;
+  // The time the shared link frees up.
+  absl::Time link_ = absl::InfinitePast();
+  std::mt19937_64 random_;
+  double mu_ = 0;
+  double sigma_ = 0;
+};
+
+namespace jb = tensorstore::internal_json_binding;
+
+struct SimKvStoreSpecData {
+  tensorstore::kvstore::Spec base;
+  std::string name;
+  double latencyMedianMs;
+  double latencyP99Ms;
+  double bandwidthMiBps;
+  int concurrency;
+  double throttleRate;
+  int maxRetries;
+  double backoffMs;
+  uint64_t seed;
+
+  constexpr static auto ApplyMembers = [](auto&& x, auto f) {
+    return f(x.base, x.name, x.latencyMedianMs, x.latencyP99Ms,
+             x.bandwidthMiBps, x.concurrency, x.throttleRate, x.maxRetries,
+             x.backoffMs, x.seed);
+  };
+
+  constexpr static auto default_json_binder = jb::Object(
+      jb::Member("base", jb::Projection<&SimKvStoreSpecData::base>()),
+      jb::Member("name",
+                 jb::Projection<&SimKvStoreSpecData::name>(
+                     jb::DefaultValue([](auto* v) { *v = "default"; }))),
+      jb::Member("latency_median_ms",
+                 jb::Projection<&SimKvStoreSpecData::latencyMedianMs>(
+                     jb::DefaultValue([](auto* v) { *v = 30; }))),
+      jb::Member("latency_p99_ms",
+                 jb::Projection<&SimKvStoreSpecData::latencyP99Ms>(
+                     jb::DefaultValue([](auto* v) { *v = 150; }))),
+      jb::Member("bandwidth_mib_per_s",
+                 jb::Projection<&SimKvStoreSpecData::bandwidthMiBps>(
+                     jb::DefaultValue([](auto* v) { *v = 200; }))),
+      jb::Member("concurrency",
+                 jb::Projection<&SimKvStoreSpecData::concurrency>(
+                     jb::DefaultValue([](auto* v) { *v = 32; }))),
+      jb::Member("throttle_rate",
+                 jb::Projection<&SimKvStoreSpecData::throttleRate>(
+                     jb::DefaultValue([](auto* v) { *v = 0; }))),
+      jb::Member("max_retries",
+                 jb::Projection<&SimKvStoreSpecData::maxRetries>(
+                     jb::DefaultValue([](auto* v) { *v = 8; }))),
+      jb::Member("backoff_ms",
+                 jb::Projection<&SimKvStoreSpecData::backoffMs>(
+                     jb::DefaultValue([](auto* v) { *v = 100; }))),
+      jb::Member("seed", jb::Projection<&SimKvStoreSpecData::seed>(
+                             jb::DefaultValue([](auto* v) { *v = 0; }))));
+
+  SimKvStoreOptions options() const {
+    SimKvStoreOptions options;
+    options.name = name;
+    options.latencyMedianMs = latencyMedianMs;
+    options.latencyP99Ms = latencyP99Ms;
+    options.bandwidthMiBps = bandwidthMiBps;
+    options.concurrency = concurrency;
+    options.throttleRate = throttleRate;
+    options.maxRetries = maxRetries;
+    options.backoffMs = backoffMs;
+    options.seed = seed;
+    return options;
+  }
+};
+
+class SimKvStoreSpec
+    : public tensorstore::internal_kvstore::RegisteredDriverSpec<
+          SimKvStoreSpec, SimKvStoreSpecData> {
+ public:
+  static constexpr char id[] = "mdio_sim";
+
+  tensorstore::Future<tensorstore::kvstore::DriverPtr> DoOpen() const override;
+
+  absl::Status ApplyOptions(
+      tensorstore::kvstore::DriverSpecOptions&& options) override {
+    return data_.base.driver.Set(std::move(options));
+  }
+};
+
+/**
+ * @brief A key-value store that serves the requests of a base store with the
+ * latency, bandwidth and throttling of a remote one, and counts them.
+ * Listing is counted but not delayed.
+ */
+class SimKvStoreDriver
+    : public tensorstore::internal_kvstore::RegisteredDriver<SimKvStoreDriver,
+                                                             SimKvStoreSpec> {
+ public:
+  tensorstore::Future<tensorstore::kvstore::ReadResult> Read(
+      tensorstore::kvstore::Key key,
+      tensorstore::kvstore::ReadOptions options) override {
+    ++counters_->reads;
+    const int throttled = Throttle();
+    if (throttled > options_.maxRetries) {
+      return Fail<tensorstore::kvstore::ReadResult>(throttled, key);
+    }
+    auto read = base_.driver->Read(base_.path + key, std::move(options));
+    return Delay(std::move(read), [self = Self(), throttled](
+                                      const tensorstore::kvstore::ReadResult&
+                                          result) {
+      Index bytes = result.has_value() ? result.value.size() : 0;
+      self->counters_->bytesRead += bytes;
+      return self->timeline_->Schedule(throttled, bytes);
+    });
+  }
+
+  tensorstore::Future<tensorstore::TimestampedStorageGeneration> Write(
+      tensorstore::kvstore::Key key,
+      std::optional<tensorstore::kvstore::Value> value,
+      tensorstore::kvstore::WriteOptions options) override {
+    ++counters_->writes;
+    const int throttled = Throttle();
+    if (throttled > options_.maxRetries) {
+      return Fail<tensorstore::TimestampedStorageGeneration>(throttled, key);
+    }
+    const Index bytes = value ? value->size() : 0;
+    counters_->bytesWritten += bytes;
+    auto written = base_.driver->Write(base_.path + key, std::move(value),
+                                       std::move(options));
+    return Delay(std::move(written),
+                 [self = Self(), throttled,
+                  bytes](const tensorstore::TimestampedStorageGeneration&) {
+                   return self->timeline_->Schedule(throttled, bytes);
+                 });
+  }
+
+  tensorstore::Future<const void> DeleteRange(
+      tensorstore::KeyRange range) override {
+    ++counters_->deletes;
+    return base_.driver->DeleteRange(
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(range)));
+  }
+
+  void ListImpl(tensorstore::kvstore::ListOptions options,
+                tensorstore::kvstore::ListReceiver receiver) override {
+    ++counters_->lists;
+    options.range =
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(options.range));
+    options.strip_prefix_length += base_.path.size();
+    base_.driver->ListImpl(std::move(options), std::move(receiver));
+  }
+
+  std::string DescribeKey(std::string_view key) override {
+    return base_.driver->DescribeKey(base_.path + std::string(key));
+  }
+
+  absl::Status GetBoundSpecData(SimKvStoreSpecData& spec) const {  // NOLINT
+    MDIO_ASSIGN_OR_RETURN(spec.base, base_.spec())
+    spec.name = options_.name;
+    spec.latencyMedianMs = options_.latencyMedianMs;
+    spec.latencyP99Ms = options_.latencyP99Ms;
+    spec.bandwidthMiBps = options_.bandwidthMiBps;
+    spec.concurrency = options_.concurrency;
+    spec.throttleRate = options_.throttleRate;
+    spec.maxRetries = options_.maxRetries;
+    spec.backoffMs = options_.backoffMs;
+    spec.seed = options_.seed;
+    return absl::OkStatus();
+  }
+
+  tensorstore::KvStore base_;
+  SimKvStoreOptions options_;
+  std::shared_ptr<SimTimeline> timeline_;
+  std::shared_ptr<SimKvStoreCounters> counters_;
+
+ private:
+  tensorstore::internal::IntrusivePtr<SimKvStoreDriver> Self() {
+    return tensorstore::internal::IntrusivePtr<SimKvStoreDriver>(this);
+  }
+
+  int Throttle() {
+    const int throttled = timeline_->DrawThrottled();
+    counters_->throttled += throttled;
+    return throttled;
+  }
+
+  // Completes with the result of `op` at the time `when` returns for it.
+  template <typename T, typename When>
+  static tensorstore::Future<T> Delay(tensorstore::Future<T> op, When when) {
+    auto pair = tensorstore::PromiseFuturePair<T>::Make();
+    op.ExecuteWhenReady([promise = std::move(pair.promise),
+                         when = std::move(when)](
+                            tensorstore::ReadyFuture<T> readyFut) {
+      absl::Time at = absl::Now();
+      if (readyFut.result().ok()) {
+        at = when(readyFut.value());
+      }
+      tensorstore::internal::ScheduleAt(
+          at, [promise, result = readyFut.result()]() mutable {
+            promise.SetResult(std::move(result));
+          });
+    });
+    return std::move(pair.future);
+  }
+
+  // Completes with a throttling error once every retry was rejected.
+  template <typename T>
+  tensorstore::Future<T> Fail(int throttled, std::string_view key) {
+    ++counters_->failed;
+    auto pair = tensorstore::PromiseFuturePair<T>::Make();
+    tensorstore::internal::ScheduleAt(
+        timeline_->Schedule(throttled - 1, 0),
+        [promise = std::move(pair.promise),
+         message = "Simulated throttling of " + DescribeKey(key) + " after " +
+                   std::to_string(options_.maxRetries) + " retries."]() {
+          promise.SetResult(absl::UnavailableError(message));
+        });
+    return std::move(pair.future);
+  }
+};
+
+inline tensorstore::Future<tensorstore::kvstore::DriverPtr>
+SimKvStoreSpec::DoOpen() const {
+  return tensorstore::MapFutureValue(
+      tensorstore::InlineExecutor{},
+      [spec = tensorstore::internal::IntrusivePtr<const SimKvStoreSpec>(this)](
+          tensorstore::KvStore& base) -> tensorstore::kvstore::DriverPtr {
+        auto driver =
+            tensorstore::internal::MakeIntrusivePtr<SimKvStoreDriver>();
+        driver->base_ = std::move(base);
+        driver->options_ = spec->data_.options();
+        driver->timeline_ = std::make_shared<SimTimeline>(driver->options_);
+        driver->counters_ = GetSimKvStoreCounters(driver->options_.name);
+        return driver;
+      },
+      tensorstore::kvstore::Open(data_.base));
+}
+
+inline const tensorstore::internal_kvstore::DriverRegistration<SimKvStoreSpec>
+    kSimKvStoreRegistration;
+
+/**
+ * @brief Routes a Variable's key-value store through a simulated remote store.
+ * @param kvstore The kvstore spec JSON, e.g. a "file" or "memory" store.
+ * @param options The conditions to simulate.
+ * @return The kvstore spec JSON of the simulated store, with the same path.
+ */
+inline nlohmann::json WrapWithSim(const nlohmann::json& kvstore,
+                                  const SimKvStoreOptions& options) {
+  nlohmann::json base = kvstore;
+  base.erase("path");
+  return {{"driver", SimKvStoreSpec::id},
+          {"base", base},
+          {"path", kvstore.value("path", "")},
+          {"name", options.name},
+          {"latency_median_ms", options.latencyMedianMs},
+          {"latency_p99_ms", options.latencyP99Ms},
+          {"bandwidth_mib_per_s", options.bandwidthMiBps},
+          {"concurrency", options.concurrency},
+          {"throttle_rate", options.throttleRate},
+          {"max_retries", options.maxRetries},
+          {"backoff_ms", options.backoffMs},
+          {"seed", options.seed}};
+}
+
+}  // namespace internal
+
+/**
+ * @brief The requests served so far by the simulated stores of a name.
+ */
+inline SimKvStoreStats GetSimKvStoreStats(const std::string& name = "default") {
+  auto counters = internal::GetSimKvStoreCounters(name);
+  SimKvStoreStats stats;
+  stats.reads = counters->reads;
+  stats.writes = counters->writes;
+  stats.deletes = counters->deletes;
+  stats.lists = counters->lists;
+  stats.bytesRead = counters->bytesRead;
+  stats.bytesWritten = counters->bytesWritten;
+  stats.throttled = counters->throttled;
+  stats.failed = counters->failed;
+  return stats;
+}
+
+/**
+ * @brief Zeroes the counters of a name, e.g. between benchmark runs.
+ */
+inline void ResetSimKvStoreStats(const std::string& name = "default") {
+  auto counters = internal::GetSimKvStoreCounters(name);
+  counters->reads = 0;
+  counters->writes = 0;
+  counters->deletes = 0;
+  counters->lists = 0;
+  counters->bytesRead = 0;
+  counters->bytesWritten = 0;
+  counters->throttled = 0;
+  counters->failed = 0;
+}
+
+}  // namespace mdio
+
+TENSORSTORE_DECLARE_GARBAGE_COLLECTION_NOT_REQUIRED(
+    mdio::internal::SimKvStoreDriver)
+
+#endif  // MDIO_SIM_KVSTORE_H_
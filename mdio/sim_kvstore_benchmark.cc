@@ -0,0 +1,119 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Reads of a local dataset served as a simulated cloud store would serve
+// them. The arguments are the concurrency of the store and its median latency
+// in ms, so the effect of each can be compared without a bucket:
+//   mdio_sim_kvstore_benchmark --benchmark_counters_tabular=true
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/sim_kvstore.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "sim_benchmark.mdio";
+
+bool Setup() {
+  if (std::filesystem::exists(kPath)) {
+    return true;
+  }
+  auto json = ::nlohmann::json::parse(R"(
+{
+  "metadata": {
+    "name": "sim_benchmark",
+    "apiVersion": "1.0.0",
+    "createdOn": "2024-06-01T12:00:00.000000-05:00"
+  },
+  "variables": [
+    {
+      "name": "seismic",
+      "dataType": "float32",
+      "dimensions": [
+        {"name": "inline", "size": 64},
+        {"name": "crossline", "size": 64},
+        {"name": "time", "size": 512}
+      ],
+      "metadata": {
+        "chunkGrid": {
+          "name": "regular",
+          "configuration": { "chunkShape": [16, 16, 512] }
+        }
+      }
+    }
+  ]
+}
+  )");
+  auto ds =
+      mdio::Dataset::from_json(json, kPath, mdio::constants::kCreateClean)
+          .result();
+  if (!ds.ok()) {
+    return false;
+  }
+  auto seismic = ds.value().variables.get<float>("seismic").value();
+  auto data = mdio::from_variable<float>(seismic).value();
+  float* samples = data.get_data_accessor().data();
+  for (mdio::Index i = 0; i < data.num_samples(); ++i) {
+    samples[i] = static_cast<float>(i % 977);
+  }
+  return seismic.Write(data).result().ok();
+}
+
+void BM_SimRead(benchmark::State& state) {  // NOLINT
+  if (!Setup()) {
+    state.SkipWithError("Unable to write the benchmark dataset.");
+    return;
+  }
+  mdio::SimKvStoreOptions sim;
+  sim.name = "benchmark";
+  sim.concurrency = static_cast<int>(state.range(0));
+  sim.latencyMedianMs = static_cast<double>(state.range(1));
+  sim.latencyP99Ms = 5 * sim.latencyMedianMs;
+  mdio::ResetSimKvStoreStats(sim.name);
+  mdio::Index bytes = 0;
+  for (auto _ : state) {
+    // Reopened so that every iteration starts with a cold chunk cache.
+    auto ds =
+        mdio::Dataset::Open(kPath, sim, mdio::constants::kOpen).result();
+    if (!ds.ok()) {
+      state.SkipWithError(ds.status().ToString().c_str());
+      break;
+    }
+    auto seismic = ds.value().variables.get<float>("seismic").value();
+    auto data = seismic.Read().result();
+    if (!data.ok()) {
+      state.SkipWithError(data.status().ToString().c_str());
+      break;
+    }
+    bytes += data.value().num_samples() * sizeof(float);
+  }
+  auto stats = mdio::GetSimKvStoreStats(sim.name);
+  state.SetBytesProcessed(bytes);
+  state.counters["requests"] = benchmark::Counter(
+      stats.reads, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_SimRead)
+    ->ArgsProduct({{1, 8, 32, 128}, {10, 50}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
@@ -0,0 +1,185 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/sim_kvstore.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/sim.mdio";
+
+mdio::SimKvStoreOptions FixedLatency(double ms) {
+  mdio::SimKvStoreOptions options;
+  options.latencyMedianMs = ms;
+  options.latencyP99Ms = ms;
+  options.bandwidthMiBps = 0;
+  options.concurrency = 0;
+  return options;
+}
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 16},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [4, 32] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("sim", variables));
+  return mdio::test_util::Fill<float>(ds, "image", [](auto index) {
+    return index[0];
+  });
+}
+
+TEST(SimTimeline, latency) {
+  mdio::internal::SimTimeline timeline(FixedLatency(20));
+  auto start = absl::Now();
+  EXPECT_GE(timeline.Schedule(0, 1 << 20) - start, absl::Milliseconds(20));
+  EXPECT_LT(timeline.Schedule(0, 1 << 20) - start, absl::Milliseconds(40))
+      << "Unlimited concurrency runs requests side by side";
+}
+
+TEST(SimTimeline, concurrencyAndBandwidth) {
+  auto options = FixedLatency(10);
+  options.concurrency = 1;
+  mdio::internal::SimTimeline serial(options);
+  auto start = absl::Now();
+  serial.Schedule(0, 0);
+  EXPECT_GE(serial.Schedule(0, 0) - start, absl::Milliseconds(20));
+
+  options.concurrency = 0;
+  options.bandwidthMiBps = 10;
+  mdio::internal::SimTimeline link(options);
+  start = absl::Now();
+  // 1 MiB at 10 MiB/s after 10 ms to the first byte.
+  EXPECT_GE(link.Schedule(0, 1 << 20) - start, absl::Milliseconds(110));
+  EXPECT_GE(link.Schedule(0, 1 << 20) - start, absl::Milliseconds(210))
+      << "Transfers share the bandwidth";
+}
+
+TEST(SimTimeline, throttling) {
+  auto options = FixedLatency(1);
+  options.throttleRate = 1;
+  options.maxRetries = 3;
+  options.backoffMs = 10;
+  mdio::internal::SimTimeline timeline(options);
+  EXPECT_EQ(timeline.DrawThrottled(), 4);
+  auto start = absl::Now();
+  // Backoffs of 10, 20 and 40 ms between the attempts.
+  EXPECT_GE(timeline.Schedule(3, 0) - start, absl::Milliseconds(74));
+
+  options.throttleRate = 0;
+  mdio::internal::SimTimeline open(options);
+  EXPECT_EQ(open.DrawThrottled(), 0);
+}
+
+TEST(SimKvStore, memory) {
+  auto options = FixedLatency(5);
+  options.name = "memory";
+  mdio::ResetSimKvStoreStats(options.name);
+  auto spec = mdio::internal::WrapWithSim(
+      {{"driver", "memory"}, {"path", "prefix/"}}, options);
+  auto store = tensorstore::kvstore::Open(spec).result();
+  ASSERT_TRUE(store.ok()) << store.status();
+  auto start = absl::Now();
+  ASSERT_TRUE(
+      tensorstore::kvstore::Write(store.value(), "key", absl::Cord("value"))
+          .result()
+          .ok());
+  auto read = tensorstore::kvstore::Read(store.value(), "key").result();
+  ASSERT_TRUE(read.ok()) << read.status();
+  EXPECT_EQ(read.value().value, "value");
+  EXPECT_GE(absl::Now() - start, absl::Milliseconds(10));
+
+  auto stats = mdio::GetSimKvStoreStats(options.name);
+  EXPECT_EQ(stats.reads, 1);
+  EXPECT_EQ(stats.writes, 1);
+  EXPECT_EQ(stats.bytesRead, 5);
+  EXPECT_EQ(stats.bytesWritten, 5);
+  mdio::ResetSimKvStoreStats(options.name);
+  EXPECT_EQ(mdio::GetSimKvStoreStats(options.name).reads, 0);
+}
+
+TEST(SimKvStore, dataset) {
+  ASSERT_TRUE(SETUP(kPath).status().ok());
+  auto options = FixedLatency(10);
+  options.name = "dataset";
+  mdio::ResetSimKvStoreStats(options.name);
+  auto ds = mdio::Dataset::Open(kPath, options, mdio::constants::kOpen)
+                .result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image").value();
+  auto data = image.Read().result();
+  ASSERT_TRUE(data.status().ok()) << data.status();
+  EXPECT_EQ(data.value().get_data_accessor()({9, 0}), 9);
+
+  auto stats = mdio::GetSimKvStoreStats(options.name);
+  EXPECT_GE(stats.reads, 4) << "One read per chunk";
+  EXPECT_GT(stats.bytesRead, 0);
+  EXPECT_EQ(stats.throttled, 0);
+
+  // Metadata still reaches the local store.
+  ds.value().UpdateAttributes({{"simulated", true}});
+  ASSERT_TRUE(ds.value().CommitMetadata().result().ok());
+  auto reopened = mdio::Dataset::Open(kPath, mdio::constants::kOpen).result();
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  EXPECT_EQ(reopened.value().getMetadata()["attributes"]["simulated"], true);
+  std::filesystem::remove_all(kPath);
+}
+
+TEST(SimKvStore, throttled) {
+  ASSERT_TRUE(SETUP(kPath).status().ok());
+  auto options = FixedLatency(1);
+  options.name = "throttled";
+  options.throttleRate = 1;
+  options.maxRetries = 2;
+  options.backoffMs = 1;
+  mdio::ResetSimKvStoreStats(options.name);
+  // Opening already reads the array metadata through the store.
+  auto ds = mdio::Dataset::Open(kPath, options, mdio::constants::kOpen)
+                .result();
+  absl::Status status = ds.status();
+  if (status.ok()) {
+    auto image = ds.value().variables.get<float>("image").value();
+    status = image.Read().result().status();
+  }
+  EXPECT_EQ(status.code(), absl::StatusCode::kUnavailable) << status;
+
+  auto stats = mdio::GetSimKvStoreStats(options.name);
+  EXPECT_GT(stats.failed, 0);
+  EXPECT_EQ(stats.throttled, 3 * stats.failed);
+  std::filesystem::remove_all(kPath);
+}
+
+}  // namespace
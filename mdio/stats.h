@@ -16,6 +16,8 @@
 #define MDIO_STATS_H_
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
 #include <memory>
 #include <optional>
 #include <string>
@@ -555,5 +557,200 @@ class UserAttributes {
   const nlohmann::json attrs;
 };
 
+/**
+ * @brief Computes the statsV1 summary of float samples with a centered bin
+ * histogram. NaN samples, the fill value, are skipped.
+ * For quantized Variables pass the values read as float, so the statistics
+ * describe the dequantized data rather than the integer codes.
+ * @param values The samples
+ * @param n The number of samples
+ * @param bins The number of histogram bins spanning [min, max]
+ * @return The statsV1 JSON, suitable for `Variable::UpdateAttributes`
+ */
+inline nlohmann::json ComputeSummaryStats(const float* values, Index n,
+                                          int bins = 32) {
+  int64_t count = 0;
+  float min = std::numeric_limits<float>::infinity();
+  float max = -std::numeric_limits<float>::infinity();
+  double sum = 0;
+  double sumSquares = 0;
+  for (Index i = 0; i < n; ++i) {
+    float v = values[i];
+    if (std::isnan(v)) {
+      continue;
+    }
+    ++count;
+    min = std::min(min, v);
+    max = std::max(max, v);
+    sum += v;
+    sumSquares += static_cast<double>(v) * v;
+  }
+  if (count == 0) {
+    min = max = 0;
+  }
+  bins = std::max(bins, 1);
+  const double width = (static_cast<double>(max) - min) / bins;
+  std::vector<float> binCenters(bins);
+  std::vector<int64_t> counts(bins, 0);
+  for (int b = 0; b < bins; ++b) {
+    binCenters[b] = static_cast<float>(min + width * (b + 0.5));
+  }
+  if (count > 0) {
+    for (Index i = 0; i < n; ++i) {
+      if (std::isnan(values[i])) {
+        continue;
+      }
+      int b = width > 0 ? static_cast<int>((values[i] - min) / width) : 0;
+      ++counts[std::min(b, bins - 1)];
+    }
+  }
+  nlohmann::json stats;
+  stats["count"] = count;
+  stats["min"] = min;
+  stats["max"] = max;
+  stats["sum"] = sum;
+  stats["sumSquares"] = sumSquares;
+  stats["histogram"]["binCenters"] = binCenters;
+  stats["histogram"]["counts"] = counts;
+  return stats;
+}
+
+namespace internal {
+/**
+ * @brief Reads the bin centers and counts of a statsV1 histogram.
+ * The bins of an edge defined histogram are centered on their left edges plus
+ * half their widths.
+ */
+inline absl::Status GetHistogramBins(const nlohmann::json& histogram,
+                                     std::vector<float>* centers,
+                                     std::vector<int64_t>* counts) {
+  if (!histogram.contains("counts")) {
+    return absl::InvalidArgumentError(
+        "Error merging statsV1:\n\tMissing histogram key: 'counts'");
+  }
+  *counts = histogram["counts"].get<std::vector<int64_t>>();
+  if (histogram.contains("binCenters")) {
+    *centers = histogram["binCenters"].get<std::vector<float>>();
+    return absl::OkStatus();
+  }
+  if (!histogram.contains("binEdges") || !histogram.contains("binWidths")) {
+    return absl::InvalidArgumentError(
+        "Error merging statsV1:\n\tMissing 'binCenters' or 'binEdges' and "
+        "'binWidths'");
+  }
+  std::vector<float> edges = histogram["binEdges"];
+  std::vector<float> widths = histogram["binWidths"];
+  // The edges may include the right edge of the last bin.
+  if (edges.size() < widths.size()) {
+    return absl::InvalidArgumentError(
+        "Error merging statsV1:\n\tFewer 'binEdges' than 'binWidths'");
+  }
+  centers->resize(widths.size());
+  for (size_t i = 0; i < widths.size(); ++i) {
+    (*centers)[i] = edges[i] + widths[i] / 2;
+  }
+  return absl::OkStatus();
+}
+}  // namespace internal
+
+/**
+ * @brief Merges two statsV1 summaries of float samples, e.g. those of a
+ * Variable and of a slab appended to it.
+ * The counts, sums and extrema combine exactly; the sums are added in double
+ * precision. Histograms with the same bins are added; otherwise each bin's
+ * count moves to the bin of the merged range holding its center, which is
+ * approximate. The result keeps edge defined bins if both inputs have them and
+ * is centered otherwise.
+ * @param a A statsV1 JSON with a centered bin or edge defined histogram
+ * @param b Another one
+ * @return The merged statsV1 JSON or an error if either lacks a key
+ */
+inline Result<nlohmann::json> MergeSummaryStats(const nlohmann::json& a,
+                                                const nlohmann::json& b) {
+  std::vector<float> centers, otherCenters;
+  std::vector<int64_t> counts, otherCounts;
+  try {
+    for (const auto* stats : {&a, &b}) {
+      for (const char* key : {"count", "min", "max", "sum", "sumSquares"}) {
+        if (!stats->contains(key)) {
+          return absl::InvalidArgumentError(
+              std::string("Error merging statsV1:\n\tMissing key: '") + key +
+              "'");
+        }
+      }
+      if (!stats->contains("histogram")) {
+        return absl::InvalidArgumentError(
+            "Error merging statsV1:\n\tMissing key: 'histogram'");
+      }
+    }
+    auto status = internal::GetHistogramBins(a["histogram"], &centers, &counts);
+    if (!status.ok()) {
+      return status;
+    }
+    status = internal::GetHistogramBins(b["histogram"], &otherCenters,
+                                        &otherCounts);
+    if (!status.ok()) {
+      return status;
+    }
+  } catch (const nlohmann::json::exception& e) {
+    return absl::InvalidArgumentError(
+        "There appeared to be some malformed JSON" + std::string(e.what()));
+  }
+  if (b["count"].get<int64_t>() == 0) {
+    return a;
+  }
+  if (a["count"].get<int64_t>() == 0) {
+    return b;
+  }
+
+  nlohmann::json merged;
+  merged["count"] = a["count"].get<int64_t>() + b["count"].get<int64_t>();
+  const float min = std::min(a["min"].get<float>(), b["min"].get<float>());
+  const float max = std::max(a["max"].get<float>(), b["max"].get<float>());
+  merged["min"] = min;
+  merged["max"] = max;
+  merged["sum"] = a["sum"].get<double>() + b["sum"].get<double>();
+  merged["sumSquares"] =
+      a["sumSquares"].get<double>() + b["sumSquares"].get<double>();
+
+  const bool edgeDefined = !a["histogram"].contains("binCenters") &&
+                           !b["histogram"].contains("binCenters");
+  if (centers == otherCenters && counts.size() == otherCounts.size()) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += otherCounts[i];
+    }
+    merged["histogram"] = a["histogram"];
+    merged["histogram"]["counts"] = counts;
+    return merged;
+  }
+
+  const int bins = std::max<int>(centers.size(), 1);
+  const double width = (static_cast<double>(max) - min) / bins;
+  std::vector<int64_t> rebinned(bins, 0);
+  auto add = [&](const std::vector<float>& from,
+                 const std::vector<int64_t>& fromCounts) {
+    for (size_t i = 0; i < from.size() && i < fromCounts.size(); ++i) {
+      int bin = width > 0 ? static_cast<int>((from[i] - min) / width) : 0;
+      rebinned[std::clamp(bin, 0, bins - 1)] += fromCounts[i];
+    }
+  };
+  add(centers, counts);
+  add(otherCenters, otherCounts);
+  std::vector<float> edges(bins), widths(bins, static_cast<float>(width));
+  centers.resize(bins);
+  for (int i = 0; i < bins; ++i) {
+    edges[i] = static_cast<float>(min + width * i);
+    centers[i] = static_cast<float>(min + width * (i + 0.5));
+  }
+  if (edgeDefined) {
+    merged["histogram"]["binEdges"] = edges;
+    merged["histogram"]["binWidths"] = widths;
+  } else {
+    merged["histogram"]["binCenters"] = centers;
+  }
+  merged["histogram"]["counts"] = rebinned;
+  return merged;
+}
+
 }  // namespace mdio
 #endif  // MDIO_STATS_H_
@@ -129,6 +129,74 @@ TEST(SummaryStatsTest, fromJsonMissing) {
   ASSERT_FALSE(statsRes.status().ok()) << statsRes.status();
 }
 
+TEST(SummaryStatsTest, merge) {
+  std::vector<float> low = {1, 2, 3, 4};
+  std::vector<float> high = {5, 6, 7, 8};
+  auto merged =
+      mdio::MergeSummaryStats(mdio::ComputeSummaryStats(low.data(), 4),
+                              mdio::ComputeSummaryStats(high.data(), 4));
+  ASSERT_TRUE(merged.status().ok()) << merged.status();
+  EXPECT_EQ(merged.value()["count"], 8);
+  EXPECT_EQ(merged.value()["min"], 1.0f);
+  EXPECT_EQ(merged.value()["max"], 8.0f);
+  EXPECT_EQ(merged.value()["sum"], 36.0f);
+  EXPECT_EQ(merged.value()["sumSquares"], 204.0f);
+  std::vector<int32_t> counts = merged.value()["histogram"]["counts"];
+  EXPECT_EQ(counts.size(), 32);
+  int32_t total = 0;
+  for (auto count : counts) {
+    total += count;
+  }
+  EXPECT_EQ(total, 8);
+
+  auto same = mdio::MergeSummaryStats(mdio::ComputeSummaryStats(low.data(), 4),
+                                      mdio::ComputeSummaryStats(low.data(), 4));
+  ASSERT_TRUE(same.status().ok()) << same.status();
+  std::vector<int32_t> doubled = same.value()["histogram"]["counts"];
+  EXPECT_EQ(doubled.front(), 2);
+  EXPECT_EQ(doubled.back(), 2);
+
+  // Edge defined bins, whose right edge is also listed, are merged as such.
+  nlohmann::json edges = {{"count", 6},
+                          {"min", 0.0},
+                          {"max", 3.0},
+                          {"sum", 10.0},
+                          {"sumSquares", 20.0},
+                          {"histogram",
+                           {{"binEdges", {0.0, 1.0, 2.0, 3.0}},
+                            {"binWidths", {1.0, 1.0, 1.0}},
+                            {"counts", {1, 2, 3}}}}};
+  auto edgeMerged = mdio::MergeSummaryStats(edges, edges);
+  ASSERT_TRUE(edgeMerged.status().ok()) << edgeMerged.status();
+  EXPECT_EQ(edgeMerged.value()["histogram"]["counts"],
+            nlohmann::json({2, 4, 6}));
+  EXPECT_EQ(edgeMerged.value()["histogram"]["binEdges"],
+            edges["histogram"]["binEdges"]);
+  auto mixed =
+      mdio::MergeSummaryStats(edges, mdio::ComputeSummaryStats(high.data(), 4));
+  ASSERT_TRUE(mixed.status().ok()) << mixed.status();
+  std::vector<int64_t> mixedCounts = mixed.value()["histogram"]["counts"];
+  int64_t mixedTotal = 0;
+  for (auto count : mixedCounts) {
+    mixedTotal += count;
+  }
+  EXPECT_EQ(mixedTotal, 10);
+
+  // Counts beyond int32 and sums beyond float precision survive a merge.
+  nlohmann::json large = mdio::ComputeSummaryStats(high.data(), 4);
+  large["count"] = int64_t{3} << 31;
+  large["sum"] = 16777217.0;
+  auto largeMerged = mdio::MergeSummaryStats(large, large);
+  ASSERT_TRUE(largeMerged.status().ok()) << largeMerged.status();
+  EXPECT_EQ(largeMerged.value()["count"].get<int64_t>(), int64_t{3} << 32);
+  EXPECT_EQ(largeMerged.value()["sum"].get<double>(), 33554434.0);
+
+  nlohmann::json missing = {{"count", 1}};
+  EXPECT_FALSE(
+      mdio::MergeSummaryStats(missing, mdio::ComputeSummaryStats(low.data(), 4))
+          .ok());
+}
+
 TEST(UserAttributesTest, fromJsonNoStats) {
   nlohmann::json expected = {{"attributes",
                               {{"foo", "bar"},
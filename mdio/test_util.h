@@ -0,0 +1,116 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_TEST_UTIL_H_
+#define MDIO_TEST_UTIL_H_
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "tensorstore/util/iterate_over_index_range.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+// Dataset fixtures shared by the tests. Each test only spells out the
+// Variables of its Dataset, e.g.
+//
+//   mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+//     auto ds = mdio::test_util::SETUP(path, mdio::test_util::Manifest(
+//         "toy", R"([{"name": "image", ...}])"));
+//     return mdio::test_util::Fill<float>(
+//         ds, "image", [](auto index) { return index[0] * 100 + index[1]; });
+//   }
+
+namespace mdio {
+namespace test_util {
+
+/**
+ * @brief The manifest of a test Dataset.
+ * @param name The name of the Dataset.
+ * @param variables The JSON array of its Variables.
+ * @return The manifest, with the root metadata every test Dataset shares.
+ */
+inline nlohmann::json Manifest(const std::string& name,
+                               const std::string& variables) {
+  return {{"metadata",
+           {{"name", name},
+            {"apiVersion", "1.0.0"},
+            {"createdOn", "2024-06-01T12:00:00.000000-05:00"}}},
+          {"variables", nlohmann::json::parse(variables)}};
+}
+
+/**
+ * @brief Creates a Dataset from a manifest, replacing anything at the path.
+ * @param path The path of the Dataset.
+ * @param manifest The manifest, see Manifest.
+ * @return The new Dataset.
+ */
+inline Future<Dataset> SETUP(const std::string& path,
+                             const nlohmann::json& manifest) {
+  std::filesystem::remove_all(path);
+  return Dataset::from_json(manifest, path, constants::kCreateClean);
+}
+
+/**
+ * @brief Writes a value to every sample of a Variable.
+ * @param dataset The Dataset holding the Variable.
+ * @param name The name of the Variable.
+ * @param fn Called with the index of each sample, returns its value.
+ * @return The Dataset once the write has committed.
+ */
+template <typename T, typename Fn>
+Future<Dataset> Fill(const Future<Dataset>& dataset, const std::string& name,
+                     Fn fn) {
+  auto pair = tensorstore::PromiseFuturePair<Dataset>::Make();
+  dataset.ExecuteWhenReady([promise = pair.promise, name, fn](
+                               tensorstore::ReadyFuture<Dataset> ready) {
+    if (!ready.result().ok()) {
+      promise.SetResult(ready.result().status());
+      return;
+    }
+    const auto& ds = ready.value();
+    auto variable = ds.variables.get<T>(name);
+    if (!variable.ok()) {
+      promise.SetResult(variable.status());
+      return;
+    }
+    auto data = from_variable<T>(variable.value());
+    if (!data.ok()) {
+      promise.SetResult(data.status());
+      return;
+    }
+    auto samples = data.value().get_data_accessor();
+    tensorstore::IterateOverIndexRange(
+        samples.domain(), [&](tensorstore::span<const Index> index) {
+          samples(index) = static_cast<T>(fn(index));
+        });
+    variable.value().Write(data.value()).commit_future.ExecuteWhenReady(
+        [promise, ds](tensorstore::ReadyFuture<void> written) {
+          if (!written.result().ok()) {
+            promise.SetResult(written.result().status());
+          } else {
+            promise.SetResult(ds);
+          }
+        });
+  });
+  return pair.future;
+}
+
+}  // namespace test_util
+}  // namespace mdio
+
+#endif  // MDIO_TEST_UTIL_H_
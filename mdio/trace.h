@@ -0,0 +1,437 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_TRACE_H_
+#define MDIO_TRACE_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <fstream>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "mdio/impl.h"
+#include "tensorstore/internal/intrusive_ptr.h"
+#include "tensorstore/internal/json_binding/bindable.h"
+#include "tensorstore/internal/json_binding/json_binding.h"
+#include "tensorstore/kvstore/driver.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/kvstore/registry.h"
+#include "tensorstore/kvstore/spec.h"
+#include "tensorstore/util/future.h"
+#include "tensorstore/util/garbage_collection/garbage_collection.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+// Set by the MDIO_TRACING cmake option. When 0 every span compiles away.
+#ifndef MDIO_TRACING
+#define MDIO_TRACING 1
+#endif
+
+namespace mdio {
+namespace trace {
+
+/**
+ * @brief A completed span of an mdio operation.
+ */
+struct Event {
+  const char* name;
+  const char* category;
+  /// Microseconds since tracing was first enabled.
+  double startUs;
+  double durationUs;
+  /// A small number per thread.
+  int thread;
+  /// The variable, chunk key, bytes, etc. of the operation.
+  nlohmann::json args;
+};
+
+namespace internal {
+
+inline std::atomic<bool> enabled{false};
+
+inline double NowUs() {
+  using Clock = std::chrono::steady_clock;
+  static const Clock::time_point epoch = Clock::now();
+  return std::chrono::duration<double, std::micro>(Clock::now() - epoch)
+      .count();
+}
+
+inline int ThreadNumber() {
+  static std::atomic<int> next{1};
+  thread_local int number = next++;
+  return number;
+}
+
+/**
+ * @brief The events recorded since tracing was enabled, up to a limit.
+ */
+class Recorder {
+ public:
+  static Recorder& Get() {
+    static Recorder* recorder = new Recorder();
+    return *recorder;
+  }
+
+  void Record(Event&& event) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() >= maxEvents_) {
+      ++dropped_;
+      return;
+    }
+    events_.push_back(std::move(event));
+  }
+
+  void Reset(size_t maxEvents) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    maxEvents_ = maxEvents;
+    dropped_ = 0;
+  }
+
+  std::vector<Event> Events() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_;
+  }
+
+  Index Dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Event> events_;
+  size_t maxEvents_ = size_t{1} << 20;
+  Index dropped_ = 0;
+};
+
+}  // namespace internal
+
+/**
+ * @brief Whether spans are being recorded.
+ * A relaxed load of one flag, or a constant false if MDIO_TRACING is 0.
+ */
+inline bool Enabled() {
+#if MDIO_TRACING
+  return internal::enabled.load(std::memory_order_relaxed);
+#else
+  return false;
+#endif
+}
+
+/**
+ * @brief Starts recording spans, discarding those recorded before.
+ * Variables opened while tracing is enabled also trace their key-value store
+ * requests.
+ * @param maxEvents The spans kept; later ones are counted as dropped.
+ */
+inline void Enable(size_t maxEvents = size_t{1} << 20) {
+  internal::Recorder::Get().Reset(maxEvents);
+  internal::NowUs();
+  internal::enabled = true;
+}
+
+/// Stops recording spans. Those recorded so far are kept for export.
+inline void Disable() { internal::enabled = false; }
+
+/// The spans recorded since tracing was enabled.
+inline std::vector<Event> Events() {
+  return internal::Recorder::Get().Events();
+}
+
+/// The spans dropped because the limit was reached.
+inline Index Dropped() { return internal::Recorder::Get().Dropped(); }
+
+/**
+ * @brief Times an operation from construction to End or destruction.
+ * Inactive, and free beyond one flag load, unless tracing is enabled when it
+ * is constructed. Guard arguments that are expensive to compute with
+ * `active()`.
+ * @details \b Usage
+ * @code
+ * mdio::trace::Span span("Variable::Read", "variable");
+ * span.Arg("variable", variableName);
+ * @endcode
+ */
+class Span {
+ public:
+  Span(const char* name, const char* category) {
+    if (Enabled()) {
+      name_ = name;
+      category_ = category;
+      start_ = internal::NowUs();
+    }
+  }
+
+  Span(Span&& other) noexcept
+      : name_(std::exchange(other.name_, nullptr)),
+        category_(other.category_),
+        start_(other.start_),
+        args_(std::move(other.args_)) {}
+
+  Span& operator=(Span&& other) noexcept {
+    End();
+    name_ = std::exchange(other.name_, nullptr);
+    category_ = other.category_;
+    start_ = other.start_;
+    args_ = std::move(other.args_);
+    return *this;
+  }
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+  ~Span() { End(); }
+
+  bool active() const { return name_ != nullptr; }
+
+  /// Attaches an argument, shown with the span in the trace viewer.
+  template <typename V>
+  Span& Arg(const char* key, V&& value) {
+    if (active()) {
+      args_[key] = std::forward<V>(value);
+    }
+    return *this;
+  }
+
+  /**
+   * @brief Records the span, once.
+   * @param status The outcome of the operation, recorded if it failed.
+   */
+  void End(const absl::Status& status = absl::OkStatus()) {
+    if (!active()) {
+      return;
+    }
+    if (!status.ok()) {
+      args_["error"] = status.ToString();
+    }
+    const double end = internal::NowUs();
+    internal::Recorder::Get().Record({name_, category_, start_, end - start_,
+                                      internal::ThreadNumber(),
+                                      std::move(args_)});
+    name_ = nullptr;
+  }
+
+ private:
+  const char* name_ = nullptr;
+  const char* category_ = nullptr;
+  double start_ = 0;
+  nlohmann::json args_;
+};
+
+/**
+ * @brief Ends a span when an asynchronous operation completes.
+ * @param span The span of the operation.
+ * @param future The future of the operation.
+ */
+template <typename T>
+void EndWhenReady(Span span, const tensorstore::Future<T>& future) {
+  if (!span.active() || future.null()) {
+    return;
+  }
+  future.ExecuteWhenReady(
+      [span = std::make_shared<Span>(std::move(span))](
+          tensorstore::ReadyFuture<T> readyFut) {
+        span->End(readyFut.result().status());
+      });
+}
+
+/**
+ * @brief The recorded spans in the Chrome trace event format, which
+ * chrome://tracing and ui.perfetto.dev load.
+ */
+inline nlohmann::json ChromeTrace() {
+  nlohmann::json events = nlohmann::json::array();
+  for (auto& event : Events()) {
+    nlohmann::json item = {{"name", event.name},
+                           {"cat", event.category},
+                           {"ph", "X"},
+                           {"ts", event.startUs},
+                           {"dur", event.durationUs},
+                           {"pid", 1},
+                           {"tid", event.thread}};
+    if (!event.args.is_null()) {
+      item["args"] = std::move(event.args);
+    }
+    events.push_back(std::move(item));
+  }
+  return {{"traceEvents", std::move(events)}, {"displayTimeUnit", "ms"}};
+}
+
+/**
+ * @brief Writes the recorded spans as a Chrome trace JSON file.
+ * @param path The file to write, e.g. "open.trace.json".
+ * @return OkStatus, or an error if the file could not be written.
+ */
+inline absl::Status WriteChromeTrace(const std::string& path) {
+  std::ofstream out(path, std::ios::trunc);
+  if (!out) {
+    return absl::InternalError("Unable to open '" + path + "' for writing.");
+  }
+  out << ChromeTrace().dump();
+  if (!out) {
+    return absl::InternalError("Unable to write the trace to '" + path + "'.");
+  }
+  return absl::OkStatus();
+}
+
+namespace internal {
+
+namespace jb = tensorstore::internal_json_binding;
+
+struct TraceSpecData {
+  tensorstore::kvstore::Spec base;
+
+  constexpr static auto ApplyMembers = [](auto&& x, auto f) {
+    return f(x.base);
+  };
+
+  constexpr static auto default_json_binder = jb::Object(
+      jb::Member("base", jb::Projection<&TraceSpecData::base>()));
+};
+
+class TraceSpec : public tensorstore::internal_kvstore::RegisteredDriverSpec<
+                      TraceSpec, TraceSpecData> {
+ public:
+  static constexpr char id[] = "mdio_trace";
+
+  tensorstore::Future<tensorstore::kvstore::DriverPtr> DoOpen() const override;
+
+  absl::Status ApplyOptions(
+      tensorstore::kvstore::DriverSpecOptions&& options) override {
+    return data_.base.driver.Set(std::move(options));
+  }
+};
+
+/**
+ * @brief A key-value store that records a span for each request to a base
+ * store while tracing is enabled. Chunk keys are the chunk coordinates.
+ */
+class TraceDriver
+    : public tensorstore::internal_kvstore::RegisteredDriver<TraceDriver,
+                                                             TraceSpec> {
+ public:
+  tensorstore::Future<tensorstore::kvstore::ReadResult> Read(
+      tensorstore::kvstore::Key key,
+      tensorstore::kvstore::ReadOptions options) override {
+    Span span("kvstore::Read", "kvstore");
+    if (span.active()) {
+      span.Arg("key", base_.path + key);
+    }
+    auto read = base_.driver->Read(base_.path + key, std::move(options));
+    if (span.active()) {
+      read.ExecuteWhenReady(
+          [span = std::make_shared<Span>(std::move(span))](
+              tensorstore::ReadyFuture<tensorstore::kvstore::ReadResult>
+                  readyFut) {
+            if (readyFut.result().ok()) {
+              span->Arg("bytes", readyFut.value().value.size());
+              span->Arg("state",
+                        readyFut.value().has_value() ? "value" : "missing");
+            }
+            span->End(readyFut.result().status());
+          });
+    }
+    return read;
+  }
+
+  tensorstore::Future<tensorstore::TimestampedStorageGeneration> Write(
+      tensorstore::kvstore::Key key,
+      std::optional<tensorstore::kvstore::Value> value,
+      tensorstore::kvstore::WriteOptions options) override {
+    Span span("kvstore::Write", "kvstore");
+    if (span.active()) {
+      span.Arg("key", base_.path + key);
+      span.Arg("bytes", value ? value->size() : 0);
+    }
+    auto written = base_.driver->Write(base_.path + key, std::move(value),
+                                       std::move(options));
+    EndWhenReady(std::move(span), written);
+    return written;
+  }
+
+  tensorstore::Future<const void> DeleteRange(
+      tensorstore::KeyRange range) override {
+    return base_.driver->DeleteRange(
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(range)));
+  }
+
+  void ListImpl(tensorstore::kvstore::ListOptions options,
+                tensorstore::kvstore::ListReceiver receiver) override {
+    options.range =
+        tensorstore::KeyRange::AddPrefix(base_.path, std::move(options.range));
+    options.strip_prefix_length += base_.path.size();
+    base_.driver->ListImpl(std::move(options), std::move(receiver));
+  }
+
+  std::string DescribeKey(std::string_view key) override {
+    return base_.driver->DescribeKey(base_.path + std::string(key));
+  }
+
+  absl::Status GetBoundSpecData(TraceSpecData& spec) const {  // NOLINT
+    MDIO_ASSIGN_OR_RETURN(spec.base, base_.spec())
+    return absl::OkStatus();
+  }
+
+  tensorstore::KvStore base_;
+};
+
+inline tensorstore::Future<tensorstore::kvstore::DriverPtr>
+TraceSpec::DoOpen() const {
+  return tensorstore::MapFutureValue(
+      tensorstore::InlineExecutor{},
+      [](tensorstore::KvStore& base) -> tensorstore::kvstore::DriverPtr {
+        auto driver = tensorstore::internal::MakeIntrusivePtr<TraceDriver>();
+        driver->base_ = std::move(base);
+        return driver;
+      },
+      tensorstore::kvstore::Open(data_.base));
+}
+
+inline const tensorstore::internal_kvstore::DriverRegistration<TraceSpec>
+    kTraceRegistration;
+
+/**
+ * @brief Routes a Variable's key-value store through the tracing store.
+ * @param kvstore The kvstore spec JSON.
+ * @return The kvstore spec JSON of the traced store, with the same path.
+ */
+inline nlohmann::json WrapWithTrace(const nlohmann::json& kvstore) {
+  if (kvstore.value("driver", "") == TraceSpec::id) {
+    return kvstore;
+  }
+  nlohmann::json base = kvstore;
+  base.erase("path");
+  return {{"driver", TraceSpec::id},
+          {"base", base},
+          {"path", kvstore.value("path", "")}};
+}
+
+}  // namespace internal
+}  // namespace trace
+}  // namespace mdio
+
+TENSORSTORE_DECLARE_GARBAGE_COLLECTION_NOT_REQUIRED(
+    mdio::trace::internal::TraceDriver)
+
+#endif  // MDIO_TRACE_H_
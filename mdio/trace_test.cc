@@ -0,0 +1,154 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/trace.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "zarrs/testing/trace.mdio";
+/*NOLINT*/ const std::string kTracePath = "zarrs/testing/trace.json";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 16},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 32] }
+      }
+    }
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("trace", variables));
+  return mdio::test_util::Fill<float>(ds, "image", [](auto) { return 0; });
+}
+
+TEST(Trace, disabled) {
+  mdio::trace::Enable();
+  mdio::trace::Disable();
+  {
+    mdio::trace::Span span("disabled", "test");
+    EXPECT_FALSE(span.active());
+    span.Arg("bytes", 1);
+  }
+  EXPECT_TRUE(mdio::trace::Events().empty());
+}
+
+TEST(Trace, span) {
+  mdio::trace::Enable();
+  {
+    mdio::trace::Span span("outer", "test");
+    EXPECT_TRUE(span.active());
+    span.Arg("variable", "image").Arg("bytes", 4096);
+    mdio::trace::Span inner("inner", "test");
+    inner.End(absl::NotFoundError("missing"));
+  }
+  mdio::trace::Disable();
+  auto events = mdio::trace::Events();
+  ASSERT_EQ(events.size(), 2);
+  EXPECT_STREQ(events[0].name, "inner");
+  EXPECT_THAT(events[0].args["error"].get<std::string>(),
+              ::testing::HasSubstr("missing"));
+  EXPECT_STREQ(events[1].name, "outer");
+  EXPECT_EQ(events[1].args["bytes"], 4096);
+  EXPECT_LE(events[1].startUs, events[0].startUs);
+  EXPECT_GE(events[1].durationUs, events[0].durationUs);
+
+  auto trace = mdio::trace::ChromeTrace();
+  ASSERT_EQ(trace["traceEvents"].size(), 2);
+  EXPECT_EQ(trace["traceEvents"][1]["ph"], "X");
+  EXPECT_EQ(trace["traceEvents"][1]["args"]["variable"], "image");
+}
+
+TEST(Trace, limit) {
+  mdio::trace::Enable(2);
+  for (int i = 0; i < 3; ++i) {
+    mdio::trace::Span span("span", "test");
+  }
+  mdio::trace::Disable();
+  EXPECT_EQ(mdio::trace::Events().size(), 2);
+  EXPECT_EQ(mdio::trace::Dropped(), 1);
+}
+
+TEST(Trace, asynchronous) {
+  mdio::trace::Enable();
+  auto pair = tensorstore::PromiseFuturePair<int>::Make();
+  mdio::trace::EndWhenReady(mdio::trace::Span("pending", "test"),
+                            pair.future);
+  EXPECT_TRUE(mdio::trace::Events().empty());
+  pair.promise.SetResult(absl::DataLossError("corrupt"));
+  mdio::trace::Disable();
+  auto events = mdio::trace::Events();
+  ASSERT_EQ(events.size(), 1);
+  EXPECT_THAT(events[0].args["error"].get<std::string>(),
+              ::testing::HasSubstr("corrupt"));
+}
+
+TEST(Trace, dataset) {
+  ASSERT_TRUE(SETUP(kPath).status().ok());
+  mdio::trace::Enable();
+  auto ds = mdio::Dataset::Open(kPath, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image").value();
+  ASSERT_TRUE(image.Read().result().ok());
+  mdio::trace::Disable();
+
+  std::set<std::string> names;
+  std::set<std::string> chunks;
+  for (const auto& event : mdio::trace::Events()) {
+    names.insert(event.name);
+    if (std::string(event.name) == "kvstore::Read" &&
+        event.args.contains("bytes") && event.args["bytes"] > 0) {
+      chunks.insert(event.args["key"].get<std::string>());
+    }
+  }
+  EXPECT_THAT(names, ::testing::IsSupersetOf(
+                         {"from_zmetadata", "parse .zmetadata",
+                          "Dataset::Open", "Variable::Open", "Variable::Read",
+                          "kvstore::Read"}));
+  EXPECT_THAT(chunks, ::testing::Contains(::testing::HasSubstr("image/0")));
+
+  ASSERT_TRUE(mdio::trace::WriteChromeTrace(kTracePath).ok());
+  std::ifstream file(kTracePath);
+  auto trace = nlohmann::json::parse(file);
+  EXPECT_EQ(trace["traceEvents"].size(), mdio::trace::Events().size());
+  std::filesystem::remove(kTracePath);
+  std::filesystem::remove_all(kPath);
+}
+
+}  // namespace
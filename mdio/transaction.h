@@ -0,0 +1,197 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_TRANSACTION_H_
+#define MDIO_TRANSACTION_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/impl.h"
+#include "mdio/variable.h"
+#include "tensorstore/transaction.h"
+#include "tensorstore/util/future.h"
+
+namespace mdio {
+
+/**
+ * @brief Options of a Dataset wide transaction.
+ */
+struct TransactionOptions {
+  /**
+   * `tensorstore::atomic_isolated` stages every write and commits them all or
+   * nothing, which needs a key-value store with multi-key atomic commits (e.g.
+   * "memory"). File, GCS and S3 only commit single keys atomically, so use
+   * `tensorstore::isolated` there, which writes the staged writes back when
+   * the transaction commits but may leave some of them behind on failure.
+   */
+  tensorstore::TransactionMode mode = tensorstore::atomic_isolated;
+  /**
+   * The staged bytes beyond which the writes so far are written back and a new
+   * transaction is started, bounding the memory held. Isolation then only holds
+   * per write-back, so this must be opted into with `tensorstore::isolated`;
+   * atomic transactions fail with a ResourceExhaustedError instead. 0, the
+   * default, stages without limit.
+   */
+  Index writeBackBytes = 0;
+};
+
+/**
+ * @brief Stages the Variable writes and metadata commit of a Dataset, and
+ * writes them back in large batches.
+ * Small scattered writes to the same chunk are merged in memory instead of
+ * each reading, modifying and writing the chunk.
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto txn, mdio::Transaction::Begin(dataset))
+ * txn.Write("seismic", seismicData);
+ * txn.Write("headers", headerData);
+ * txn.Write("live_mask", maskData);
+ * txn.dataset().CommitMetadata();
+ * MDIO_ASSIGN_OR_RETURN(auto done, txn.Commit().result())
+ * @endcode
+ */
+class Transaction {
+ public:
+  /**
+   * @brief Begins a transaction on a Dataset.
+   * @param dataset A Dataset that is not bound to a transaction.
+   * @param options The transaction mode and write-back limit, atomic and
+   * unlimited by default.
+   */
+  static Result<Transaction> Begin(const Dataset& dataset,
+                                   const TransactionOptions& options = {}) {
+    if (dataset.get_transaction() != tensorstore::no_transaction) {
+      return absl::FailedPreconditionError(
+          "The Dataset is already bound to a transaction.");
+    }
+    tensorstore::Transaction transaction(options.mode);
+    MDIO_ASSIGN_OR_RETURN(auto bound, dataset.with_transaction(transaction))
+    return Transaction(std::move(bound), options, std::move(transaction));
+  }
+
+  /**
+   * @brief The Dataset bound to the transaction.
+   * Its Variables and CommitMetadata are staged. The reference is invalidated
+   * by a write-back, so look it up again after each Write.
+   */
+  Dataset& dataset() { return bound_; }
+
+  /**
+   * @brief Stages a write to a Variable of the Dataset.
+   * If the write would exceed the write-back limit, the writes so far are
+   * written back first, or an atomic transaction fails.
+   * @param name The name of the Variable.
+   * @param data The data to write, to the region its domain covers.
+   * @return The write futures; the commit future becomes ready when the write
+   * has been written back.
+   */
+  template <typename T, DimensionIndex R, ArrayOriginKind OriginKind>
+  WriteFutures Write(const std::string& name,
+                     const VariableData<T, R, OriginKind>& data) {
+    const Index bytes = data.num_samples() * data.dtype().size();
+    if (options_.writeBackBytes > 0 && staged_ > 0 &&
+        staged_ + bytes > options_.writeBackBytes) {
+      auto status = WriteBack();
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    MDIO_ASSIGN_OR_RETURN(auto variable, bound_.variables.get<T, R>(name))
+    MDIO_ASSIGN_OR_RETURN(variable, internal::SliceToData(variable, data))
+    staged_ += bytes;
+    return variable.Write(data);
+  }
+
+  /// The bytes staged since the last write-back.
+  Index staged_bytes() const { return staged_; }
+
+  /**
+   * @brief Commits the staged writes.
+   * @return A future that becomes ready once every write-back has completed.
+   */
+  Future<void> Commit() {
+    auto committed = transaction_.CommitAsync();
+    auto previous = std::move(pending_);
+    auto pair = tensorstore::PromiseFuturePair<void>::Make();
+    std::vector<tensorstore::AnyFuture> futures = {committed};
+    if (!previous.null()) {
+      futures.push_back(previous);
+    }
+    auto all_done_future = tensorstore::WaitAllFuture(futures);
+    all_done_future.ExecuteWhenReady(
+        [promise = std::move(pair.promise), committed,
+         previous](tensorstore::ReadyFuture<void> readyFut) {
+          if (!previous.null() && !previous.result().ok()) {
+            promise.SetResult(previous.result().status());
+            return;
+          }
+          if (!committed.result().ok()) {
+            promise.SetResult(committed.result().status());
+            return;
+          }
+          promise.SetResult(absl::OkStatus());
+        });
+    return pair.future;
+  }
+
+  /// Discards the writes staged since the last write-back.
+  void Abort() { transaction_.Abort(); }
+
+ private:
+  Transaction(Dataset bound, const TransactionOptions& options,
+              tensorstore::Transaction transaction)
+      : bound_(std::move(bound)),
+        options_(options),
+        transaction_(std::move(transaction)) {}
+
+  /**
+   * Commits the current transaction and continues in a new one. Only one
+   * write-back is in flight, so the memory stays bounded.
+   */
+  absl::Status WriteBack() {
+    if (options_.mode == tensorstore::atomic_isolated) {
+      return absl::ResourceExhaustedError(
+          "The atomic transaction exceeds its write-back limit of " +
+          std::to_string(options_.writeBackBytes) + " bytes.");
+    }
+    if (!pending_.null()) {
+      auto previous = pending_.result();
+      if (!previous.ok()) {
+        return previous.status();
+      }
+    }
+    pending_ = transaction_.CommitAsync();
+    transaction_ = tensorstore::Transaction(options_.mode);
+
+    // Rebind the current Dataset rather than the one the transaction began
+    // with, so Variables and metadata updated since are kept. Its stores may
+    // change transaction now that the previous one has started committing.
+    MDIO_ASSIGN_OR_RETURN(bound_, bound_.with_transaction(transaction_))
+    staged_ = 0;
+    return absl::OkStatus();
+  }
+
+  Dataset bound_;
+  TransactionOptions options_;
+  tensorstore::Transaction transaction_;
+  Future<const void> pending_;
+  Index staged_ = 0;
+};
+
+}  // namespace mdio
+
+#endif  // MDIO_TRANSACTION_H_
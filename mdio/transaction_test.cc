@@ -0,0 +1,170 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/transaction.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/transaction.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 16},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 32] }
+      }
+    }
+  },
+  {
+    "name": "mask",
+    "dataType": "bool",
+    "dimensions": [{"name": "inline", "size": 16}]
+  }
+]
+  )";
+  return mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("transaction", variables));
+}
+
+// Stages one trace of the image and its mask entry.
+void WriteTrace(mdio::Transaction& txn, int i) {  // NOLINT
+  auto image = txn.dataset().variables.get<float>("image").value();
+  mdio::RangeDescriptor<mdio::Index> desc = {"inline", i, i + 1, 1};
+  auto trace = mdio::from_variable<float>(image.slice(desc).value()).value();
+  auto values = trace.get_data_accessor();
+  for (int k = 0; k < 32; ++k) {
+    values({i, k}) = i * 100.0f + k;
+  }
+  ASSERT_TRUE(txn.Write("image", trace).copy_future.result().ok());
+
+  auto mask = txn.dataset().variables.get<bool>("mask").value();
+  auto live = mdio::from_variable<bool>(mask.slice(desc).value()).value();
+  live.get_data_accessor()({i}) = true;
+  ASSERT_TRUE(txn.Write("mask", live).copy_future.result().ok());
+}
+
+void ExpectWritten(const std::string& path) {
+  auto ds = mdio::Dataset::Open(path, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  auto image = ds.value().variables.get<float>("image").value().Read().result();
+  ASSERT_TRUE(image.status().ok()) << image.status();
+  auto values = image.value().get_data_accessor();
+  auto mask = ds.value().variables.get<bool>("mask").value().Read().result();
+  ASSERT_TRUE(mask.status().ok()) << mask.status();
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_TRUE(mask.value().get_data_accessor()({i}));
+    for (int k = 0; k < 32; ++k) {
+      ASSERT_EQ(values({i, k}), i * 100.0f + k);
+    }
+  }
+}
+
+TEST(Transaction, stagesUntilCommit) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  // The file store cannot commit several keys atomically.
+  mdio::TransactionOptions options;
+  options.mode = tensorstore::isolated;
+  auto txn = mdio::Transaction::Begin(dsRes.value(), options);
+  ASSERT_TRUE(txn.status().ok()) << txn.status();
+  for (int i = 0; i < 16; ++i) {
+    WriteTrace(txn.value(), i);
+  }
+  EXPECT_EQ(txn.value().staged_bytes(), 16 * (32 * 4 + 1));
+
+  auto before =
+      dsRes.value().variables.get<float>("image").value().Read().result();
+  ASSERT_TRUE(before.status().ok()) << before.status();
+  EXPECT_TRUE(std::isnan(before.value().get_data_accessor()({3, 3})))
+      << "Nothing reaches the store before the commit";
+
+  txn.value().dataset().UpdateAttributes({{"ingested", true}});
+  txn.value().dataset().CommitMetadata();
+  auto committed = txn.value().Commit().result();
+  ASSERT_TRUE(committed.status().ok()) << committed.status();
+  ExpectWritten(kTestPath);
+
+  auto ds = mdio::Dataset::Open(kTestPath, mdio::constants::kOpen).result();
+  ASSERT_TRUE(ds.status().ok()) << ds.status();
+  EXPECT_EQ(ds.value().getMetadata()["attributes"]["ingested"], true);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(Transaction, writesBackInBatches) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  mdio::TransactionOptions options;
+  options.mode = tensorstore::isolated;
+  options.writeBackBytes = 4 * (32 * 4 + 1);
+  auto txn = mdio::Transaction::Begin(dsRes.value(), options);
+  ASSERT_TRUE(txn.status().ok()) << txn.status();
+  // A Variable added after Begin survives the write-backs.
+  auto& variables = txn.value().dataset().variables;
+  variables.add("alias", variables.at("mask").value());
+  for (int i = 0; i < 16; ++i) {
+    WriteTrace(txn.value(), i);
+    EXPECT_LE(txn.value().staged_bytes(), options.writeBackBytes);
+  }
+  EXPECT_TRUE(txn.value().dataset().variables.at("alias").ok());
+  auto committed = txn.value().Commit().result();
+  ASSERT_TRUE(committed.status().ok()) << committed.status();
+  ExpectWritten(kTestPath);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(Transaction, atomicLimit) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  mdio::TransactionOptions options;
+  EXPECT_EQ(options.mode, tensorstore::atomic_isolated);
+  EXPECT_EQ(options.writeBackBytes, 0) << "Never split by default";
+  options.writeBackBytes = 32 * 4;
+  auto txn = mdio::Transaction::Begin(dsRes.value(), options);
+  ASSERT_TRUE(txn.status().ok()) << txn.status();
+
+  auto image = txn.value().dataset().variables.get<float>("image").value();
+  mdio::RangeDescriptor<mdio::Index> desc = {"inline", 0, 1, 1};
+  auto trace = mdio::from_variable<float>(image.slice(desc).value()).value();
+  EXPECT_TRUE(txn.value().Write("image", trace).copy_future.result().ok());
+  auto second = txn.value().Write("image", trace).copy_future.status();
+  EXPECT_TRUE(absl::IsResourceExhausted(second)) << second;
+  txn.value().Abort();
+
+  auto bound = dsRes.value().with_transaction(tensorstore::Transaction(
+      tensorstore::isolated));
+  ASSERT_TRUE(bound.status().ok()) << bound.status();
+  EXPECT_FALSE(mdio::Transaction::Begin(bound.value()).ok())
+      << "A bound Dataset cannot begin another transaction";
+  std::filesystem::remove_all(kTestPath);
+}
+
+}  // namespace
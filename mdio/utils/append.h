@@ -0,0 +1,255 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_UTILS_APPEND_H_
+#define MDIO_UTILS_APPEND_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "mdio/stats.h"
+#include "tensorstore/index_space/index_domain_builder.h"
+#include "tensorstore/util/future.h"
+
+namespace mdio {
+namespace utils {
+
+/**
+ * @brief Grows a dimension of a Dataset so that a slab can be appended to it.
+ * Every Variable over the dimension, coordinates included, grows together.
+ * Only the array metadata of those Variables is rewritten and no chunk is
+ * touched, so the cost does not depend on the size of the Dataset. Growing by
+ * whole chunks keeps the slab's writes chunk aligned; otherwise the last chunk
+ * of each Variable is read, modified and written back once.
+ *
+ * @param dataset The Dataset to grow. Its Variables and domain are updated.
+ * @param dimension The label of the dimension to grow.
+ * @param count The number of indices to append.
+ * @return The Dataset sliced to the appended slab, or an error if the
+ * dimension does not exist or a resize failed. Variables that had already
+ * grown when another failed are shrunk back, and the Dataset is left as it
+ * was.
+ *
+ * @details \b Usage
+ * @code
+ * MDIO_ASSIGN_OR_RETURN(auto slab,
+ *                       mdio::utils::GrowDataset(dataset, "inline", 8))
+ * MDIO_ASSIGN_OR_RETURN(auto seismic, slab.variables.get<float>("seismic"))
+ * MDIO_ASSIGN_OR_RETURN(auto data, mdio::from_variable<float>(seismic))
+ * // Fill data with the new shot line ...
+ * auto done = mdio::utils::WriteSlab(dataset, {data}).result();
+ * @endcode
+ */
+inline Result<Dataset> GrowDataset(Dataset& dataset,  // NOLINT
+                                   const std::string& dimension, Index count) {
+  if (count <= 0) {
+    return absl::InvalidArgumentError(
+        "A Dataset can only grow by a positive count.");
+  }
+  const DimensionIndex rank = dataset.domain.rank();
+  std::vector<std::string> labels(rank);
+  std::vector<Index> shape(rank);
+  Index start = -1;
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    labels[i] = dataset.domain.labels()[i];
+    shape[i] = dataset.domain.shape()[i];
+    if (labels[i] == dimension) {
+      start = dataset.domain[i].exclusive_max();
+      shape[i] += count;
+    }
+  }
+  if (start < 0) {
+    return absl::NotFoundError("The Dataset has no dimension " + dimension +
+                               ".");
+  }
+
+  // Issue every resize before waiting on any.
+  std::vector<std::string> names;
+  std::vector<std::vector<Index>> previous;
+  std::vector<Future<Variable<>>> grown;
+  for (const auto& name : dataset.variables.get_iterable_accessor()) {
+    MDIO_ASSIGN_OR_RETURN(auto variable, dataset.variables.at(name))
+    auto domain = variable.get_store().domain();
+    std::vector<Index> bounds(domain.rank(), tensorstore::kImplicit);
+    std::vector<Index> before(domain.rank(), tensorstore::kImplicit);
+    bool over = false;
+    for (DimensionIndex i = 0; i < domain.rank(); ++i) {
+      if (domain.labels()[i] == dimension) {
+        before[i] = domain[i].exclusive_max();
+        bounds[i] = before[i] + count;
+        over = true;
+      }
+    }
+    if (over) {
+      names.push_back(name);
+      previous.push_back(std::move(before));
+      grown.push_back(variable.Grow(bounds));
+    }
+  }
+  absl::Status status;
+  for (const auto& future : grown) {
+    if (!future.result().ok() && status.ok()) {
+      status = future.result().status();
+    }
+  }
+  if (!status.ok()) {
+    // Shrink the Variables that did grow back, so the Dataset stays whole.
+    tensorstore::ResizeOptions options;
+    options.mode = tensorstore::ResizeMode::resize_metadata_only |
+                   tensorstore::ResizeMode::shrink_only;
+    std::vector<tensorstore::AnyFuture> undone;
+    for (size_t v = 0; v < grown.size(); ++v) {
+      if (!grown[v].result().ok()) {
+        continue;
+      }
+      std::vector<Index> unchanged(previous[v].size(), tensorstore::kImplicit);
+      undone.push_back(tensorstore::Resize(
+          grown[v].result().value().get_store(),
+          tensorstore::span<const Index>(unchanged),
+          tensorstore::span<const Index>(previous[v]), options));
+    }
+    for (const auto& future : undone) {
+      future.Wait();
+    }
+    return status;
+  }
+  for (size_t v = 0; v < grown.size(); ++v) {
+    auto variable = grown[v].result().value();
+    // The consolidated metadata must pick up the new shape.
+    variable.set_metadata_publish_flag(true);
+    dataset.variables.add(names[v], variable);
+  }
+  MDIO_ASSIGN_OR_RETURN(
+      auto domain,
+      tensorstore::IndexDomainBuilder<>(rank).shape(shape).labels(labels)
+          .Finalize())
+  dataset.domain = std::move(domain);
+
+  RangeDescriptor<Index> slab = {dimension, start, start + count, 1};
+  return dataset.isel(slab);
+}
+
+/**
+ * @brief Writes the data of an appended slab and commits the metadata.
+ * The writes are issued together. The statsV1 of a float32 Variable are merged
+ * with those of its new samples, so existing chunks are never read back.
+ * The statistics and metadata are only updated once every write has
+ * succeeded, and are then committed in one transaction, so a failed write
+ * leaves them describing the Dataset before the append. Variables without
+ * data in the slab keep their metadata as it is.
+ *
+ * @param dataset The Dataset grown by GrowDataset.
+ * @param slab The data of the slab, e.g. from `from_variable` on the Variables
+ * GrowDataset returned.
+ * @return A future that becomes ready once the data and metadata are written.
+ */
+inline Future<void> WriteSlab(Dataset& dataset,  // NOLINT
+                              const std::vector<VariableData<>>& slab) {
+  // Merge the statistics up front, but apply them only after the writes.
+  std::vector<std::pair<Variable<>, nlohmann::json>> updates;
+  for (const auto& data : slab) {
+    MDIO_ASSIGN_OR_RETURN(auto variable,
+                          dataset.variables.at(data.variableName))
+    auto attrs = variable.GetAttributes();
+    if (data.dtype() != constants::kFloat32 || !attrs.contains("statsV1") ||
+        !attrs["statsV1"].is_object()) {
+      continue;
+    }
+    auto values = data.data.data;
+    if (!tensorstore::IsContiguousLayout(values, ContiguousLayoutOrder::c)) {
+      values = tensorstore::MakeCopy(values);
+    }
+    auto added = ComputeSummaryStats(
+        static_cast<const float*>(values.byte_strided_origin_pointer().get()),
+        values.num_elements(),
+        attrs["statsV1"]["histogram"]["counts"].size());
+    MDIO_ASSIGN_OR_RETURN(attrs["statsV1"],
+                          MergeSummaryStats(attrs["statsV1"], added))
+    updates.emplace_back(variable, std::move(attrs));
+  }
+
+  std::vector<tensorstore::AnyFuture> futures;
+  std::vector<Future<const void>> commits;
+  for (const auto& data : slab) {
+    MDIO_ASSIGN_OR_RETURN(auto variable,
+                          dataset.variables.at(data.variableName))
+    MDIO_ASSIGN_OR_RETURN(auto target, internal::SliceToData(variable, data))
+    auto written = target.Write(data);
+    commits.push_back(written.commit_future);
+    futures.push_back(written.commit_future);
+  }
+
+  auto all_done_future = tensorstore::WaitAllFuture(futures);
+  auto pair = tensorstore::PromiseFuturePair<void>::Make();
+  all_done_future.ExecuteWhenReady(
+      [promise = std::move(pair.promise), commits = std::move(commits),
+       updates = std::move(updates),
+       dataset](tensorstore::ReadyFuture<void> readyFut) mutable {
+        for (const auto& commit : commits) {
+          if (!commit.result().ok()) {
+            promise.SetResult(commit.result().status());
+            return;
+          }
+        }
+        // The Variables share their attributes with those of the caller.
+        for (auto& [variable, attrs] : updates) {
+          auto updated = variable.UpdateAttributes(attrs);
+          if (!updated.status().ok()) {
+            promise.SetResult(updated.status());
+            return;
+          }
+        }
+        // Nothing to commit if no statistics changed and the shape was
+        // published.
+        bool changed = false;
+        for (const auto& name : dataset.variables.get_iterable_accessor()) {
+          auto variable = dataset.variables.at(name);
+          changed |= variable.ok() && (variable.value().was_updated() ||
+                                       variable.value().should_publish());
+        }
+        if (!changed) {
+          promise.SetResult(absl::OkStatus());
+          return;
+        }
+        tensorstore::Transaction transaction(tensorstore::isolated);
+        auto bound = dataset.with_transaction(transaction);
+        if (!bound.ok()) {
+          promise.SetResult(bound.status());
+          return;
+        }
+        auto staged = bound.value().CommitMetadata();
+        staged.ExecuteWhenReady(
+            [promise = std::move(promise),
+             transaction](tensorstore::ReadyFuture<void> stagedFut) mutable {
+              if (!stagedFut.result().ok()) {
+                transaction.Abort();
+                promise.SetResult(stagedFut.result().status());
+                return;
+              }
+              transaction.CommitAsync().ExecuteWhenReady(
+                  [promise = std::move(promise)](
+                      tensorstore::ReadyFuture<const void> committed) {
+                    promise.SetResult(committed.result().status());
+                  });
+            });
+      });
+  return pair.future;
+}
+
+}  // namespace utils
+}  // namespace mdio
+
+#endif  // MDIO_UTILS_APPEND_H_
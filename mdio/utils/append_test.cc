@@ -0,0 +1,166 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/utils/append.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/test_util.h"
+
+namespace {
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/append.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 16},
+      {"name": "time", "size": 32}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [8, 32] }
+      }
+    },
+    "coordinates": ["inline", "time"]
+  },
+  {
+    "name": "inline",
+    "dataType": "int32",
+    "dimensions": [{"name": "inline", "size": 16}]
+  },
+  {
+    "name": "time",
+    "dataType": "int32",
+    "dimensions": [{"name": "time", "size": 32}]
+  }
+]
+  )";
+  return mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("append", variables));
+}
+
+// Writes a constant image and the inline numbers over the slab's inlines.
+void FillSlab(mdio::Dataset& ds, const mdio::Dataset& slab,  // NOLINT
+              float value) {
+  auto image = slab.variables.get<float>("image").value();
+  auto imageData = mdio::from_variable<float>(image).value();
+  auto samples = imageData.get_data_accessor();
+  auto domain = imageData.dimensions();
+  for (mdio::Index i = domain[0].inclusive_min(); i < domain[0].exclusive_max();
+       ++i) {
+    for (mdio::Index k = 0; k < 32; ++k) {
+      samples({i, k}) = value;
+    }
+  }
+  auto inlines = slab.variables.get<int32_t>("inline").value();
+  auto inlineData = mdio::from_variable<int32_t>(inlines).value();
+  auto values = inlineData.get_data_accessor();
+  for (mdio::Index i = domain[0].inclusive_min(); i < domain[0].exclusive_max();
+       ++i) {
+    values({i}) = i;
+  }
+  auto written = mdio::utils::WriteSlab(ds, {imageData, inlineData});
+  ASSERT_TRUE(written.result().ok()) << written.status();
+}
+
+TEST(Append, growAndWrite) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+
+  // Record the statistics of the initial data.
+  FillSlab(ds, ds, 1.0f);
+  auto image = ds.variables.get<float>("image").value();
+  auto attrs = image.GetAttributes();
+  std::vector<float> ones(16 * 32, 1.0f);
+  attrs["statsV1"] = mdio::ComputeSummaryStats(ones.data(), ones.size(), 4);
+  ASSERT_TRUE(image.UpdateAttributes(attrs).status().ok());
+  ASSERT_TRUE(ds.CommitMetadata().result().ok());
+
+  auto slab = mdio::utils::GrowDataset(ds, "inline", 8);
+  ASSERT_TRUE(slab.status().ok()) << slab.status();
+  auto slabDomain =
+      slab.value().variables.get<float>("image").value().dimensions();
+  EXPECT_EQ(slabDomain[0].inclusive_min(), 16);
+  EXPECT_EQ(slabDomain[0].exclusive_max(), 24);
+  EXPECT_EQ(ds.variables.at("time").value().dimensions().shape()[0], 32);
+
+  FillSlab(ds, slab.value(), 3.0f);
+
+  auto reopened = mdio::Dataset::Open(kTestPath, mdio::constants::kOpen);
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  auto stored = reopened.value().variables.get<float>("image").value();
+  EXPECT_EQ(stored.dimensions().shape()[0], 24);
+  auto data = stored.Read().result();
+  ASSERT_TRUE(data.status().ok()) << data.status();
+  auto samples = data.value().get_data_accessor();
+  EXPECT_EQ(samples({15, 31}), 1.0f);
+  EXPECT_EQ(samples({16, 0}), 3.0f);
+  EXPECT_EQ(samples({23, 31}), 3.0f);
+
+  auto inlines = reopened.value()
+                     .variables.get<int32_t>("inline")
+                     .value()
+                     .Read()
+                     .result();
+  ASSERT_TRUE(inlines.status().ok()) << inlines.status();
+  EXPECT_EQ(inlines.value().get_data_accessor()({20}), 20);
+
+  auto stats = stored.GetAttributes()["statsV1"];
+  EXPECT_EQ(stats["count"], 24 * 32);
+  EXPECT_EQ(stats["min"], 1.0f);
+  EXPECT_EQ(stats["max"], 3.0f);
+  EXPECT_FLOAT_EQ(stats["sum"].get<float>(), 16 * 32 + 3 * 8 * 32);
+  int64_t binned = 0;
+  for (const auto& count : stats["histogram"]["counts"]) {
+    binned += count.get<int64_t>();
+  }
+  EXPECT_EQ(binned, 24 * 32);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(Append, invalid) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto ds = dsRes.value();
+  EXPECT_TRUE(
+      absl::IsNotFound(mdio::utils::GrowDataset(ds, "crossline", 8).status()));
+  EXPECT_FALSE(mdio::utils::GrowDataset(ds, "inline", 0).ok());
+
+  // A failed slab leaves the statistics describing the Dataset before it.
+  auto image = ds.variables.get<float>("image").value();
+  auto attrs = image.GetAttributes();
+  std::vector<float> ones(16 * 32, 1.0f);
+  attrs["statsV1"] = mdio::ComputeSummaryStats(ones.data(), ones.size(), 4);
+  ASSERT_TRUE(image.UpdateAttributes(attrs).status().ok());
+  auto imageData = mdio::from_variable<float>(image).value();
+  auto missing = mdio::from_variable<float>(image).value();
+  missing.variableName = "missing";
+  EXPECT_FALSE(
+      mdio::utils::WriteSlab(ds, {imageData, missing}).result().ok());
+  EXPECT_EQ(image.GetAttributes()["statsV1"]["count"], 16 * 32);
+  std::filesystem::remove_all(kTestPath);
+}
+
+}  // namespace
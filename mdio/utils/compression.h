@@ -0,0 +1,458 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MDIO_UTILS_COMPRESSION_H_
+#define MDIO_UTILS_COMPRESSION_H_
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <limits>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mdio/dataset.h"
+#include "tensorstore/context.h"
+#include "tensorstore/kvstore/kvstore.h"
+#include "tensorstore/kvstore/operations.h"
+#include "tensorstore/transaction.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace mdio {
+namespace utils {
+
+/**
+ * @brief The outcome of compressing sample chunks with one compressor.
+ * Throughputs are in MB/s of uncompressed data.
+ */
+struct CompressorTrial {
+  /// The compressor in MDIO schema form, e.g. {"name": "zstd", "level": 3}.
+  nlohmann::json compressor;
+  Index rawBytes = 0;
+  Index storedBytes = 0;
+  double ratio = 0;
+  double encodeMBps = 0;
+  double decodeMBps = 0;
+};
+
+/**
+ * @brief Options for `BenchmarkCompressors` and `TuneCompressor`.
+ */
+struct CompressorTuneOptions {
+  /// The number of chunks sampled, spread evenly over the chunk grid.
+  Index sampleChunks = 4;
+  /// The compressors to try in MDIO schema form. Empty tries
+  /// `DefaultCompressorCandidates()`.
+  std::vector<nlohmann::json> candidates;
+  /// The recommendation is the best ratio among the compressors that decode at
+  /// least this fraction as fast as the fastest one.
+  double minDecodeFraction = 0.5;
+  /// The number of times each candidate encodes and decodes the samples; the
+  /// median time is reported, so one slow run does not skew the ranking.
+  int repeats = 3;
+};
+
+/**
+ * @brief A sweep of codec, level, shuffle and blocksize settings.
+ * @return Compressors in MDIO schema form.
+ */
+inline std::vector<nlohmann::json> DefaultCompressorCandidates() {
+  std::vector<nlohmann::json> candidates;
+  for (const char* algorithm : {"lz4", "lz4hc", "blosclz", "zstd", "zlib"}) {
+    for (int level : {1, 5, 9}) {
+      for (int shuffle : {0, 1, 2}) {
+        for (int blocksize : {0, 1 << 18}) {
+          candidates.push_back({{"name", "blosc"},
+                                {"algorithm", algorithm},
+                                {"level", level},
+                                {"shuffle", shuffle},
+                                {"blocksize", blocksize}});
+        }
+      }
+    }
+  }
+  for (int level : {1, 3, 9, 19}) {
+    candidates.push_back({{"name", "zstd"}, {"level", level}});
+  }
+  for (const char* name : {"gzip", "zlib"}) {
+    for (int level : {1, 6, 9}) {
+      candidates.push_back({{"name", name}, {"level", level}});
+    }
+  }
+  for (int level : {1, 9}) {
+    candidates.push_back({{"name", "bz2"}, {"level", level}});
+  }
+  return candidates;
+}
+
+namespace internal {
+
+/**
+ * @brief Translates a compressor from MDIO schema form to Zarr form.
+ * @return The Zarr compressor or an error if the compressor is invalid.
+ */
+inline Result<nlohmann::json> ToZarrCompressor(
+    const nlohmann::json& compressor) {
+  nlohmann::json input = {{"compressor", compressor}};
+  nlohmann::json variable = nlohmann::json::object();
+  auto status = transform_compressor(input, variable);
+  if (!status.ok()) {
+    return status;
+  }
+  return variable["metadata"]["compressor"];
+}
+
+/// The spec of a Variable's store, rejecting structured dtypes.
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<nlohmann::json> CompressibleSpec(const Variable<T, R, M>& variable) {
+  MDIO_ASSIGN_OR_RETURN(auto spec, variable.get_spec())
+  if (spec["metadata"]["dtype"].is_array()) {
+    return absl::InvalidArgumentError(
+        "Variable " + variable.get_variable_name() +
+        " has a structured dtype; recompressing it is not supported.");
+  }
+  spec.erase("transform");
+  spec.erase("schema");
+  return spec;
+}
+
+/// The median of some durations, in seconds.
+inline double MedianSeconds(std::vector<double> seconds) {
+  if (seconds.empty()) {
+    return 0;
+  }
+  auto middle = seconds.begin() + seconds.size() / 2;
+  std::nth_element(seconds.begin(), middle, seconds.end());
+  return *middle;
+}
+
+/// The total size of the values under a kvstore, skipping the metadata keys.
+inline Result<Index> StoredBytes(const tensorstore::KvStore& kvstore) {
+  MDIO_ASSIGN_OR_RETURN(auto entries,
+                        tensorstore::kvstore::ListFuture(kvstore).result())
+  Index bytes = 0;
+  for (const auto& entry : entries) {
+    if (absl::StartsWith(entry.key, ".")) {
+      continue;
+    }
+    MDIO_ASSIGN_OR_RETURN(
+        auto read, tensorstore::kvstore::Read(kvstore, entry.key).result())
+    bytes += static_cast<Index>(read.value.size());
+  }
+  return bytes;
+}
+
+}  // namespace internal
+
+/**
+ * @brief Benchmarks compressors on sample chunks of a Variable.
+ * Each candidate encodes the sampled chunks into an in-memory Zarr array and
+ * decodes them back, so the numbers include the Zarr driver's overhead just
+ * like real reads and writes. Both are repeated `repeats` times and the median
+ * is kept. The Variable is only read.
+ * @param variable The Variable to sample.
+ * @param options The sampling, candidates and recommendation options.
+ * @return One trial per candidate, in the order of the candidates, or an error
+ * if a candidate is invalid.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M>
+Result<std::vector<CompressorTrial>> BenchmarkCompressors(
+    const Variable<T, R, M>& variable,
+    const CompressorTuneOptions& options = {}) {
+  MDIO_ASSIGN_OR_RETURN(auto spec, internal::CompressibleSpec(variable))
+  auto store = variable.get_store();
+  auto domain = store.domain();
+  const DimensionIndex rank = domain.rank();
+  std::vector<Index> chunks = spec["metadata"]["chunks"];
+
+  // Spread the samples evenly over the chunk grid, in C order.
+  std::vector<Index> grid(rank);
+  Index numChunks = 1;
+  for (DimensionIndex i = 0; i < rank; ++i) {
+    grid[i] = (domain[i].size() + chunks[i] - 1) / chunks[i];
+    numChunks *= grid[i];
+  }
+  const Index numSamples =
+      std::max<Index>(1, std::min(options.sampleChunks, numChunks));
+  std::vector<SharedArray<void, dynamic_rank, offset_origin>> samples;
+  Index rawBytes = 0;
+  for (Index s = 0; s < numSamples; ++s) {
+    Index linear = (2 * s + 1) * numChunks / (2 * numSamples);
+    tensorstore::Box<> box(rank);
+    for (DimensionIndex i = rank - 1; i >= 0; --i) {
+      Index origin = domain[i].inclusive_min() + (linear % grid[i]) * chunks[i];
+      linear /= grid[i];
+      box[i] = tensorstore::IndexInterval::UncheckedSized(
+          origin, std::min(chunks[i], domain[i].exclusive_max() - origin));
+    }
+    MDIO_ASSIGN_OR_RETURN(
+        auto sample,
+        tensorstore::Read(store | tensorstore::AllDims().BoxSlice(box) |
+                          tensorstore::AllDims().TranslateTo(0))
+            .result())
+    rawBytes += sample.num_elements() * sample.dtype().size();
+    samples.push_back(std::move(sample));
+  }
+
+  // The samples are stacked along a new leading dimension, one per chunk.
+  nlohmann::json trialSpec = spec;
+  trialSpec["kvstore"] = {{"driver", "memory"}};
+  nlohmann::json shape = nlohmann::json::array({numSamples});
+  nlohmann::json trialChunks = nlohmann::json::array({1});
+  for (Index chunk : chunks) {
+    shape.push_back(chunk);
+    trialChunks.push_back(chunk);
+  }
+  trialSpec["metadata"]["shape"] = shape;
+  trialSpec["metadata"]["chunks"] = trialChunks;
+
+  const auto& candidates = options.candidates.empty()
+                               ? DefaultCompressorCandidates()
+                               : options.candidates;
+  std::vector<CompressorTrial> trials;
+  trials.reserve(candidates.size());
+  for (const auto& candidate : candidates) {
+    MDIO_ASSIGN_OR_RETURN(trialSpec["metadata"]["compressor"],
+                          internal::ToZarrCompressor(candidate))
+    // A fresh context gives every trial its own memory kvstore and no cache.
+    MDIO_ASSIGN_OR_RETURN(
+        auto trialStore,
+        tensorstore::Open(trialSpec, tensorstore::Context::Default(),
+                          tensorstore::OpenMode::create,
+                          tensorstore::ReadWriteMode::read_write)
+            .result())
+
+    std::vector<double> encodeRuns, decodeRuns;
+    for (int run = 0; run < std::max(options.repeats, 1); ++run) {
+      auto start = std::chrono::steady_clock::now();
+      for (Index s = 0; s < numSamples; ++s) {
+        tensorstore::Box<> box(rank);
+        for (DimensionIndex i = 0; i < rank; ++i) {
+          box[i] = samples[s].domain()[i];
+        }
+        auto target = trialStore | tensorstore::Dims(0).IndexSlice(s) |
+                      tensorstore::AllDims().BoxSlice(box);
+        if (!target.ok()) {
+          return target.status();
+        }
+        auto written = tensorstore::Write(samples[s], target.value()).result();
+        if (!written.ok()) {
+          return written.status();
+        }
+      }
+      encodeRuns.push_back(std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+
+      start = std::chrono::steady_clock::now();
+      auto decoded = tensorstore::Read(trialStore).result();
+      if (!decoded.ok()) {
+        return decoded.status();
+      }
+      decodeRuns.push_back(std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+    }
+    const double encodeSeconds = internal::MedianSeconds(encodeRuns);
+    const double decodeSeconds = internal::MedianSeconds(decodeRuns);
+
+    CompressorTrial trial;
+    trial.compressor = candidate;
+    trial.rawBytes = rawBytes;
+    MDIO_ASSIGN_OR_RETURN(trial.storedBytes,
+                          internal::StoredBytes(trialStore.kvstore()))
+    trial.ratio = trial.storedBytes > 0
+                      ? static_cast<double>(rawBytes) / trial.storedBytes
+                      : std::numeric_limits<double>::infinity();
+    trial.encodeMBps = rawBytes / 1e6 / std::max(encodeSeconds, 1e-9);
+    trial.decodeMBps = rawBytes / 1e6 / std::max(decodeSeconds, 1e-9);
+    trials.push_back(std::move(trial));
+  }
+  return trials;
+}
+
+/**
+ * @brief Picks the best ratio among the trials that decode at least
+ * `minDecodeFraction` as fast as the fastest trial. Ties go to the faster
+ * encoder.
+ * @return The recommended trial or an InvalidArgumentError if there are none.
+ */
+inline Result<CompressorTrial> RecommendCompressor(
+    const std::vector<CompressorTrial>& trials, double minDecodeFraction) {
+  if (trials.empty()) {
+    return absl::InvalidArgumentError("No compressor trials to choose from.");
+  }
+  double fastest = 0;
+  for (const auto& trial : trials) {
+    fastest = std::max(fastest, trial.decodeMBps);
+  }
+  const CompressorTrial* best = nullptr;
+  for (const auto& trial : trials) {
+    if (trial.decodeMBps < minDecodeFraction * fastest) {
+      continue;
+    }
+    if (best == nullptr || trial.ratio > best->ratio ||
+        (trial.ratio == best->ratio && trial.encodeMBps > best->encodeMBps)) {
+      best = &trial;
+    }
+  }
+  return *best;
+}
+
+/**
+ * @brief Rewrites a Variable with another compressor.
+ * DANGER: This operation will mutate the dataset on disk. The Variable is
+ * copied chunk by chunk into a sibling array with the new compressor. The
+ * copied chunks, the new .zarray and the updated consolidated metadata then
+ * replace the originals in one transaction, which is only committed once all
+ * of them are staged, so a failure before the commit leaves the Variable as it
+ * was. The staged chunks are held in memory until the commit. It should only
+ * be used on a fully written dataset, and open Datasets must be reopened
+ * afterwards.
+ * @param dataset_path The path to the dataset.
+ * @param variableName The Variable to recompress.
+ * @param compressor The compressor in MDIO schema form.
+ * @return OK if the Variable was rewritten, otherwise an error.
+ */
+inline Result<void> RecompressVariable(const std::string& dataset_path,
+                                       const std::string& variableName,
+                                       const nlohmann::json& compressor) {
+  MDIO_ASSIGN_OR_RETURN(
+      auto ds, mdio::Dataset::Open(dataset_path, mdio::constants::kOpen)
+                   .result())
+  MDIO_ASSIGN_OR_RETURN(auto var, ds.variables.at(variableName))
+  MDIO_ASSIGN_OR_RETURN(auto zarrCompressor,
+                        internal::ToZarrCompressor(compressor))
+  MDIO_ASSIGN_OR_RETURN(auto spec, internal::CompressibleSpec(var))
+
+  // Copy into "<variable>.recompress" next to the Variable.
+  nlohmann::json copySpec = spec;
+  std::string path = spec["kvstore"]["path"].get<std::string>();
+  while (!path.empty() && path.back() == '/') {
+    path.pop_back();
+  }
+  copySpec["kvstore"]["path"] = path + ".recompress/";
+  copySpec["metadata"]["compressor"] = zarrCompressor;
+  MDIO_ASSIGN_OR_RETURN(
+      auto copy,
+      tensorstore::Open(copySpec,
+                        tensorstore::OpenMode::create |
+                            tensorstore::OpenMode::delete_existing,
+                        tensorstore::ReadWriteMode::read_write)
+          .result())
+  auto copied = tensorstore::Copy(var.get_store(), copy).result();
+  if (!copied.ok()) {
+    return copied.status();
+  }
+
+  // Stage the chunks, the .zarray and the .zmetadata in one transaction;
+  // the .zattrs stay as they are. File, GCS and S3 stores cannot commit
+  // several keys atomically, so the transaction is isolated.
+  tensorstore::Transaction transaction(tensorstore::isolated);
+  auto source = copy.kvstore();
+  MDIO_ASSIGN_OR_RETURN(auto target, var.get_store().kvstore() | transaction)
+  MDIO_ASSIGN_OR_RETURN(auto oldEntries,
+                        tensorstore::kvstore::ListFuture(target).result())
+  MDIO_ASSIGN_OR_RETURN(auto newEntries,
+                        tensorstore::kvstore::ListFuture(source).result())
+  // Staged operations only become ready once the transaction commits.
+  std::vector<Future<tensorstore::TimestampedStorageGeneration>> staged;
+  std::set<std::string> newKeys;
+  for (const auto& entry : newEntries) {
+    MDIO_ASSIGN_OR_RETURN(
+        auto read, tensorstore::kvstore::Read(source, entry.key).result())
+    staged.push_back(
+        tensorstore::kvstore::Write(target, entry.key, read.value));
+    newKeys.insert(entry.key);
+  }
+  // Chunks equal to the fill value are not written by the copy.
+  for (const auto& entry : oldEntries) {
+    if (absl::StartsWith(entry.key, ".") || newKeys.count(entry.key)) {
+      continue;
+    }
+    staged.push_back(tensorstore::kvstore::Delete(target, entry.key));
+  }
+
+  // The consolidated metadata carries its own copy of the .zarray.
+  MDIO_ASSIGN_OR_RETURN(
+      auto rootStore, mdio::internal::dataset_kvs_store(dataset_path).result())
+  MDIO_ASSIGN_OR_RETURN(auto root, rootStore | transaction)
+  MDIO_ASSIGN_OR_RETURN(auto zmetadataRead,
+                        tensorstore::kvstore::Read(root, ".zmetadata").result())
+  nlohmann::json zmetadata =
+      nlohmann::json::parse(std::string(zmetadataRead.value), nullptr, false);
+  if (zmetadata.is_discarded() || !zmetadata.contains("metadata")) {
+    return absl::InternalError("Could not parse the dataset's .zmetadata.");
+  }
+  zmetadata["metadata"][variableName + "/.zarray"]["compressor"] =
+      zarrCompressor;
+  staged.push_back(tensorstore::kvstore::Write(root, ".zmetadata",
+                                               absl::Cord(zmetadata.dump(4))));
+  auto committed = transaction.CommitAsync().result();
+  if (!committed.ok()) {
+    return committed.status();
+  }
+  for (const auto& future : staged) {
+    if (!future.result().ok()) {
+      return future.result().status();
+    }
+  }
+
+  auto cleaned = tensorstore::kvstore::DeleteRange(source, {}).result();
+  if (!cleaned.ok()) {
+    return cleaned.status();
+  }
+  return absl::OkStatus();
+}
+
+/**
+ * @brief Benchmarks compressors on a Variable and recommends one.
+ * @param dataset_path The path to the dataset.
+ * @param variableName The Variable to tune.
+ * @param options The sampling, candidates and recommendation options.
+ * @param apply Whether to rewrite the Variable with the recommendation, see
+ * `RecompressVariable`.
+ * @return The recommended trial, or an error.
+ */
+inline Result<CompressorTrial> TuneCompressor(
+    const std::string& dataset_path, const std::string& variableName,
+    const CompressorTuneOptions& options = {}, bool apply = false) {
+  CompressorTrial best;
+  {
+    MDIO_ASSIGN_OR_RETURN(
+        auto ds, mdio::Dataset::Open(dataset_path, mdio::constants::kOpen)
+                     .result())
+    MDIO_ASSIGN_OR_RETURN(auto var, ds.variables.at(variableName))
+    MDIO_ASSIGN_OR_RETURN(auto trials, BenchmarkCompressors(var, options))
+    MDIO_ASSIGN_OR_RETURN(
+        best, RecommendCompressor(trials, options.minDecodeFraction))
+  }
+  if (apply) {
+    auto applied =
+        RecompressVariable(dataset_path, variableName, best.compressor);
+    if (!applied.ok()) {
+      return applied.status();
+    }
+  }
+  return best;
+}
+
+}  // namespace utils
+}  // namespace mdio
+
+#endif  // MDIO_UTILS_COMPRESSION_H_
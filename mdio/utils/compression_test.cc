@@ -0,0 +1,166 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mdio/utils/compression.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "mdio/test_util.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/compression.mdio";
+
+mdio::Future<mdio::Dataset> SETUP(const std::string& path) {
+  std::string variables = R"(
+[
+  {
+    "name": "image",
+    "dataType": "float32",
+    "dimensions": [
+      {"name": "inline", "size": 32},
+      {"name": "crossline", "size": 32},
+      {"name": "depth", "size": 64}
+    ],
+    "metadata": {
+      "chunkGrid": {
+        "name": "regular",
+        "configuration": { "chunkShape": [16, 16, 64] }
+      }
+    },
+    "compressor": {"name": "blosc", "algorithm": "lz4", "shuffle": 0}
+  }
+]
+  )";
+  auto ds = mdio::test_util::SETUP(
+      path, mdio::test_util::Manifest("compression", variables));
+  // Smooth and quantized, so every codec finds redundancy.
+  return mdio::test_util::Fill<float>(ds, "image", [](auto index) {
+    return std::round(std::sin(0.1 * index[2]) * 8) + index[0];
+  });
+}
+
+std::vector<nlohmann::json> Candidates() {
+  return {{{"name", "blosc"}, {"algorithm", "lz4"}, {"level", 1}},
+          {{"name", "blosc"}, {"algorithm", "zstd"}, {"shuffle", 2}},
+          {{"name", "zstd"}, {"level", 9}},
+          {{"name", "gzip"}, {"level", 6}},
+          {{"name", "bz2"}}};
+}
+
+TEST(Compression, defaultCandidatesAreValid) {
+  for (const auto& candidate : mdio::utils::DefaultCompressorCandidates()) {
+    auto zarr = mdio::utils::internal::ToZarrCompressor(candidate);
+    EXPECT_TRUE(zarr.status().ok()) << candidate << " " << zarr.status();
+  }
+}
+
+TEST(Compression, benchmark) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto image = dsRes.value().variables.at("image").value();
+
+  mdio::utils::CompressorTuneOptions options;
+  options.candidates = Candidates();
+  options.sampleChunks = 2;
+  auto trialsRes = mdio::utils::BenchmarkCompressors(image, options);
+  ASSERT_TRUE(trialsRes.status().ok()) << trialsRes.status();
+  auto trials = trialsRes.value();
+  ASSERT_EQ(trials.size(), options.candidates.size());
+  for (std::size_t i = 0; i < trials.size(); ++i) {
+    EXPECT_EQ(trials[i].compressor, options.candidates[i]);
+    EXPECT_EQ(trials[i].rawBytes, 2 * 16 * 16 * 64 * 4);
+    EXPECT_GT(trials[i].storedBytes, 0);
+    EXPECT_GT(trials[i].ratio, 1) << trials[i].compressor;
+    EXPECT_GT(trials[i].decodeMBps, 0);
+    EXPECT_GT(trials[i].encodeMBps, 0);
+  }
+
+  options.candidates = {{{"name", "zfp"}}};
+  EXPECT_FALSE(mdio::utils::BenchmarkCompressors(image, options).ok());
+}
+
+TEST(Compression, recommend) {
+  std::vector<mdio::utils::CompressorTrial> trials(3);
+  trials[0].compressor = "fast";
+  trials[0].ratio = 2;
+  trials[0].decodeMBps = 1000;
+  trials[1].compressor = "small";
+  trials[1].ratio = 4;
+  trials[1].decodeMBps = 600;
+  trials[2].compressor = "smallest";
+  trials[2].ratio = 6;
+  trials[2].decodeMBps = 100;
+  auto best = mdio::utils::RecommendCompressor(trials, 0.5);
+  ASSERT_TRUE(best.status().ok()) << best.status();
+  EXPECT_EQ(best.value().compressor, "small");
+  EXPECT_EQ(mdio::utils::RecommendCompressor(trials, 0).value().compressor,
+            "smallest");
+  EXPECT_EQ(mdio::utils::RecommendCompressor(trials, 1).value().compressor,
+            "fast");
+  EXPECT_FALSE(mdio::utils::RecommendCompressor({}, 0.5).ok());
+
+  // One stalled run does not decide the ranking.
+  EXPECT_EQ(mdio::utils::internal::MedianSeconds({0.3, 0.1, 100}), 0.3);
+}
+
+TEST(Compression, tuneAndApply) {
+  auto dsRes = SETUP(kTestPath).result();
+  ASSERT_TRUE(dsRes.status().ok()) << dsRes.status();
+  auto before = dsRes.value().variables.get<float>("image").value().Read();
+  ASSERT_TRUE(before.status().ok()) << before.status();
+
+  mdio::utils::CompressorTuneOptions options;
+  options.candidates = {{{"name", "zstd"}, {"level", 3}}};
+  auto best =
+      mdio::utils::TuneCompressor(kTestPath, "image", options, /*apply=*/true);
+  ASSERT_TRUE(best.status().ok()) << best.status();
+  EXPECT_EQ(best.value().compressor["name"], "zstd");
+
+  auto reopened = mdio::Dataset::Open(kTestPath, mdio::constants::kOpen);
+  ASSERT_TRUE(reopened.status().ok()) << reopened.status();
+  auto image = reopened.value().variables.get<float>("image").value();
+  auto spec = image.get_spec();
+  ASSERT_TRUE(spec.status().ok()) << spec.status();
+  EXPECT_EQ(spec.value()["metadata"]["compressor"]["id"], "zstd");
+  EXPECT_EQ(spec.value()["metadata"]["compressor"]["level"], 3);
+
+  auto after = image.Read();
+  ASSERT_TRUE(after.status().ok()) << after.status();
+  auto expected = before.value().get_data_accessor();
+  auto actual = after.value().get_data_accessor();
+  for (int i = 0; i < 32; ++i) {
+    for (int j = 0; j < 32; ++j) {
+      for (int k = 0; k < 64; ++k) {
+        ASSERT_EQ(actual({i, j, k}), expected({i, j, k}));
+      }
+    }
+  }
+  EXPECT_FALSE(
+      std::filesystem::exists(kTestPath + "/image.recompress/.zarray"))
+      << "The copy is cleaned up";
+  std::filesystem::remove_all(kTestPath);
+}
+
+}  // namespace
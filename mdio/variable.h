@@ -15,8 +15,10 @@
 #ifndef MDIO_VARIABLE_H_
 #define MDIO_VARIABLE_H_
 
+#include <algorithm>
 #include <filesystem>
 #include <memory>
+#include <optional>
 #include <queue>
 #include <set>
 #include <string>
@@ -25,8 +27,12 @@
 #include <vector>
 
 #include "absl/strings/str_split.h"
+#include "mdio/chunk_occupancy.h"
 #include "mdio/impl.h"
+#include "mdio/quantization.h"
+#include "mdio/shared_json.h"
 #include "mdio/stats.h"
+#include "mdio/trace.h"
 #include "tensorstore/array.h"
 #include "tensorstore/driver/driver.h"
 #include "tensorstore/driver/registry.h"
@@ -38,6 +44,7 @@
 #include "tensorstore/open.h"
 #include "tensorstore/stack.h"
 #include "tensorstore/tensorstore.h"
+#include "tensorstore/transaction.h"
 #include "tensorstore/util/future.h"
 
 // clang-format off
@@ -62,6 +69,12 @@ struct extract_descriptor_Ttype;
 template <typename T>
 struct outer_type;
 
+namespace internal {
+template <typename T, DimensionIndex R, ReadWriteMode M, DimensionIndex DR>
+Result<Variable<T, R, M>> SliceToDomain(Variable<T, R, M> variable,
+                                        IndexDomainView<DR> domain);
+}  // namespace internal
+
 /**
  * @brief A descriptor for slicing a Variable or Dataset.
  * @tparam T The type of the range. Default is `Index` for `isel` based slicing.
@@ -503,7 +516,12 @@ Future<Variable<T, R, M>> CreateVariable(const nlohmann::json& json_spec,
       tensorstore::InlineExecutor{}, build, spec, handled_store);
 
   bool isCloudStore = false;
-  std::string driver = json_spec["kvstore"]["driver"].get<std::string>();
+  // Stores wrapping a cloud store, e.g. the disk cache, write like it.
+  ::nlohmann::json kvstore = json_spec["kvstore"];
+  while (kvstore.contains("base")) {
+    kvstore = kvstore["base"];
+  }
+  std::string driver = kvstore["driver"].get<std::string>();
   if (driver == "gcs" || driver == "s3") {
     isCloudStore = true;
   }
@@ -712,18 +730,49 @@ template <typename T = void, DimensionIndex R = dynamic_rank,
           ReadWriteMode M = ReadWriteMode::dynamic>
 Future<Variable<T, R, M>> Open(const nlohmann::json& json_spec,
                                TransactionalOpenOptions&& options) {
+  trace::Span span("Variable::Open", "variable");
+  if (span.active() && json_spec.contains("kvstore")) {
+    span.Arg("path", json_spec["kvstore"].value("path", ""));
+  }
+  Future<Variable<T, R, M>> opened;
   // situations where we would create new metadata
   if (options.open_mode == constants::kCreateClean ||
       options.open_mode == constants::kCreate) {
     MDIO_ASSIGN_OR_RETURN(auto json_schema, ValidateAndProcessJson(json_spec))
     // extract the json for the store and our metadata
     auto [json_store, metadata] = json_schema;
+    if (trace::Enabled()) {
+      json_store["kvstore"] =
+          trace::internal::WrapWithTrace(json_store["kvstore"]);
+    }
     // this will write metadata
-    return CreateVariable<T, R, M>(json_store, metadata, std::move(options));
+    opened = CreateVariable<T, R, M>(json_store, metadata, std::move(options));
+  } else if (trace::Enabled() && json_spec.contains("kvstore")) {
+    // Records the chunk reads and writes of the Variable.
+    auto traced = json_spec;
+    traced["kvstore"] = trace::internal::WrapWithTrace(traced["kvstore"]);
+    opened = OpenVariable<T, R, M>(traced, std::move(options));
   } else {
-    return OpenVariable<T, R, M>(json_spec, std::move(options));
+    opened = OpenVariable<T, R, M>(json_spec, std::move(options));
   }
+  trace::EndWhenReady(std::move(span), opened);
+  return opened;
 }
+
+/**
+ * The metadata of a Variable merged with its User Attributes, kept until
+ * either is replaced.
+ */
+struct MergedMetadata {
+  std::shared_ptr<UserAttributes> attributes;
+  SharedJson reduced;
+  SharedJson metadata;
+  // Parsed once here rather than on every Read and Write.
+  Result<Quantization> quantization =
+      absl::NotFoundError("The Variable is not quantized.");
+  // Null unless a well formed bitmap is stored.
+  std::shared_ptr<const ChunkOccupancy> occupancy;
+};
 }  // namespace internal
 
 /**
@@ -746,7 +795,7 @@ class Variable {
   Variable() = default;
 
   Variable(const std::string& variableName, const std::string& longName,
-           const ::nlohmann::json& metdata,
+           const SharedJson& metdata,
            const tensorstore::TensorStore<T, R, M>& store,
            const std::shared_ptr<std::shared_ptr<UserAttributes>> attributes)
       : variableName(variableName),
@@ -754,7 +803,8 @@ class Variable {
         metadata(metdata),
         store(store),
         attributes(attributes) {
-    attributesAddress = reinterpret_cast<std::uintptr_t>((*attributes).get());
+    attributesAddress =
+        reinterpret_cast<std::uintptr_t>(current_attributes().get());
   }
 
   // Allows for conversion to compatible types (SourceElement), which should
@@ -764,10 +814,29 @@ class Variable {
   Variable(const Variable<SourceElement, SourceRank, SourceMode>& other)
       : variableName(other.get_variable_name()),
         longName(other.get_long_name()),
-        metadata(other.getReducedMetadata()),
+        metadata(other.metadata),
         store(other.get_store()),
         attributes(other.attributes),
-        attributesAddress(other.get_attributes_address()) {}
+        attributesAddress(other.get_attributes_address()),
+        merged(other.merged) {}
+
+  /**
+   * @brief A Variable like `other` over a different store, e.g. a slice of it.
+   * The metadata and User Attributes are shared rather than copied.
+   */
+  template <typename SourceElement, DimensionIndex SourceRank,
+            ReadWriteMode SourceMode>
+  Variable(const Variable<SourceElement, SourceRank, SourceMode>& other,
+           const tensorstore::TensorStore<T, R, M>& store)
+      : variableName(other.variableName),
+        longName(other.longName),
+        metadata(other.metadata),
+        store(store),
+        attributes(other.attributes),
+        merged(other.merged) {
+    attributesAddress =
+        reinterpret_cast<std::uintptr_t>(current_attributes().get());
+  }
 
   friend std::ostream& operator<<(std::ostream& os, const Variable& obj) {
     os << obj.variableName << "\t" << obj.dimensions() << "\n";
@@ -803,6 +872,8 @@ class Variable {
    * @brief Read the data from the variable.
    * Reads the data from the source variable.
    * Provide an Open method for an existing file...
+   * If a chunk occupancy bitmap is stored with the Variable, the chunks it
+   * marks as empty are not requested and read as the fill value.
    * @tparam T The type of the data to be read.
    * @tparam R The tensorstore rank of the data to be read.
    * @tparam M The read/write mode of the data to be read.
@@ -812,29 +883,24 @@ class Variable {
    */
   template <ArrayOriginKind OriginKind = offset_origin>
   Future<VariableData<T, R, OriginKind>> Read() {
-    auto data = tensorstore::Read(store);
-    // We need to capture this to ensure the Variable doesn't get prematurely
-    // destoryed if its parent goes out of scope before the future resolves.
-    auto thisVar = std::make_shared<Variable<T, R, M>>(*this);
-    auto pair =
-        tensorstore::PromiseFuturePair<VariableData<T, R, OriginKind>>::Make();
-    data.ExecuteWhenReady(
-        [thisVar, promise = pair.promise](
-            tensorstore::ReadyFuture<SharedArray<T, R, OriginKind>> readyFut) {
-          auto ready_result = readyFut.result();
-          if (!ready_result.ok()) {
-            promise.SetResult(ready_result.status());
-          } else {
-            LabeledArray<T, R, OriginKind> labeledArray{thisVar->dimensions(),
-                                                        ready_result.value()};
-            VariableData<T, R, OriginKind> variableData{
-                thisVar->variableName, thisVar->longName,
-                thisVar->getMetadata(), labeledArray};
-            promise.SetResult(variableData);
-          }
-        });
+    auto cached = merged_metadata();
+    return ReadSkipping<OriginKind>(cached->occupancy.get(),
+                                    cached->quantization);
+  }
 
-    return pair.future;
+  /**
+   * @brief Read the data, skipping the chunks a given occupancy bitmap marks
+   * as empty. See `ReadOccupied`.
+   * @param occupancy The occupancy bitmap of the whole Variable, used instead
+   * of the one stored with it.
+   * @return A future of VariableData that will be ready when the read is
+   * complete.
+   */
+  template <ArrayOriginKind OriginKind = offset_origin>
+  Future<VariableData<T, R, OriginKind>> Read(
+      const ChunkOccupancy& occupancy) {
+    return ReadSkipping<OriginKind>(&occupancy,
+                                    merged_metadata()->quantization);
   }
 
   /**
@@ -859,12 +925,125 @@ class Variable {
    * @return A future that will be ready when the write is complete.
    */
   template <ArrayOriginKind OriginKind = offset_origin>
-  WriteFutures Write(const VariableData<T, R, OriginKind> source) const {
+  WriteFutures Write(const VariableData<T, R, OriginKind>& source) const {
+    if (source.dtype() != this->dtype()) {
+      return absl::InvalidArgumentError(
+          "The source and target dtypes do not match.");
+    }
+    return WriteArray(source.data.data,
+                      tensorstore::cannot_reference_source_data);
+  }
+
+  /**
+   * @brief Writes borrowed samples to a region of the Variable.
+   * Unlike the VariableData overload, the samples need not be owned by a
+   * shared array.
+   * @param source The samples, with the shape of the region.
+   * @param domain The labeled region of the Variable to write, e.g. the
+   * dimensions() of a slice.
+   * @param reference By default the samples are copied before the copy future
+   * becomes ready. `tensorstore::can_reference_source_data_until_commit` writes
+   * them without the copy; they must then stay alive and unmodified until the
+   * commit future is ready.
+   * @return The write futures or an error if the dtypes or shapes don't match.
+   *
+   * @details \b Usage
+   * @code
+   * std::vector<float> traces(64 * 1500);
+   * auto block = seismic.slice(mdio::RangeDescriptor<>({"inline", 0, 64, 1}));
+   * auto written = seismic.Write(
+   *     tensorstore::Array(traces.data(), {64, 1500}),
+   *     block.value().dimensions(),
+   *     tensorstore::can_reference_source_data_until_commit);
+   * written.commit_future.Wait();  // traces may now be reused
+   * @endcode
+   */
+  WriteFutures Write(tensorstore::ArrayView<const T> source,
+                     IndexDomainView<> domain,
+                     tensorstore::SourceDataReferenceRestriction reference =
+                         tensorstore::cannot_reference_source_data) const {
     if (source.dtype() != this->dtype()) {
       return absl::InvalidArgumentError(
           "The source and target dtypes do not match.");
     }
-    return tensorstore::Write(source.data.data, store);
+    if (source.rank() != domain.rank() ||
+        !std::equal(source.shape().begin(), source.shape().end(),
+                    domain.shape().begin())) {
+      return absl::InvalidArgumentError(
+          "The source shape does not match the domain.");
+    }
+    MDIO_ASSIGN_OR_RETURN(auto target, internal::SliceToDomain(*this, domain))
+    // A container layout, as the write may outlive the caller's layout.
+    tensorstore::SharedArray<const T> shared(
+        tensorstore::UnownedToShared(source));
+    return target.WriteArray(shared, reference);
+  }
+
+  /**
+   * @brief Writes C-ordered samples to a region of the Variable.
+   * @param source The samples, one per element of the region.
+   * @param domain The labeled region of the Variable to write.
+   * @param reference As for the ArrayView overload.
+   */
+  template <typename U = T>
+  WriteFutures Write(
+      std::enable_if_t<!std::is_void_v<U>, tensorstore::span<const U>> source,
+      IndexDomainView<> domain,
+      tensorstore::SourceDataReferenceRestriction reference =
+          tensorstore::cannot_reference_source_data) const {
+    if (source.size() != domain.num_elements()) {
+      return absl::InvalidArgumentError(
+          "The source holds " + std::to_string(source.size()) +
+          " samples but the domain has " +
+          std::to_string(domain.num_elements()) + ".");
+    }
+    return Write(tensorstore::ArrayView<const T>(
+                     tensorstore::Array(source.data(), domain.shape())),
+                 domain, reference);
+  }
+
+  /**
+   * @brief Binds the Variable to a transaction.
+   * Writes through the returned Variable are staged in the transaction and
+   * reach durable media only when it commits. The user attributes are shared
+   * with this Variable.
+   * @param transaction The transaction to bind to.
+   * @return The bound Variable or an error if this Variable is already bound
+   * to a different transaction.
+   */
+  Result<Variable> with_transaction(
+      const tensorstore::Transaction& transaction) const {
+    MDIO_ASSIGN_OR_RETURN(auto bound, store | transaction)
+    Variable variable = *this;
+    variable.store = std::move(bound);
+    return variable;
+  }
+
+  /**
+   * @brief Grows the upper bounds of the Variable.
+   * Only the array metadata is rewritten, existing chunks are left untouched.
+   * The user attributes are shared with this Variable.
+   * @param shape The new exclusive upper bound of each dimension, or
+   * `kImplicit` to leave a dimension as it is.
+   * @return A future of the resized Variable, or an error if a bound would
+   * shrink.
+   */
+  Future<Variable> Grow(const std::vector<Index>& shape) const {
+    std::vector<Index> unchanged(shape.size(), tensorstore::kImplicit);
+    tensorstore::ResizeOptions options;
+    options.mode = tensorstore::ResizeMode::resize_metadata_only |
+                   tensorstore::ResizeMode::expand_only;
+    auto resized = tensorstore::Resize(
+        store, tensorstore::span<const Index>(unchanged),
+        tensorstore::span<const Index>(shape), options);
+    return tensorstore::MapFutureValue(
+        tensorstore::InlineExecutor{},
+        [self = *this](const tensorstore::TensorStore<T, R, M>& grown) {
+          Variable variable = self;
+          variable.store = grown;
+          return variable;
+        },
+        std::move(resized));
   }
 
   /**
@@ -1115,8 +1294,7 @@ class Variable {
             store |
                 tensorstore::Dims(labels).HalfOpenInterval(start, stop, step));
         // return a new variable with the sliced store
-        return Variable{variableName, longName, metadata, slice_store,
-                        attributes};
+        return Variable{*this, slice_store};
       } else if (labelSet.size() != labelSize) {
         // Concat the sliced Variable together if there are duplicate
         // labels(dimensions)
@@ -1160,8 +1338,7 @@ class Variable {
               tensorstore::TensorStore<T, R, M>(tensorstore::unchecked,
                                                 catStore);
           // Return a new Variable with the concatenated store
-          return Variable{variableName, longName, metadata, typedCatStore,
-                          attributes};
+          return Variable{*this, typedCatStore};
         }
         return absl::InternalError("No fragments to concatenate.");
       }
@@ -1290,7 +1467,12 @@ class Variable {
     bool isCloudStore = false;
     // TODO(BrianMichell): Make more error tolerant
     auto json_spec = store.spec().value().ToJson(IncludeDefaults{}).value();
-    auto driver = json_spec["kvstore"]["driver"];
+    auto kvstore = json_spec["kvstore"];
+    while (kvstore.contains("base")) {
+      // Stores wrapping a cloud store, e.g. the disk cache.
+      kvstore = kvstore["base"];
+    }
+    auto driver = kvstore["driver"];
     if (driver == "gcs" || driver == "s3") {
       isCloudStore = true;
     }
@@ -1349,34 +1531,42 @@ class Variable {
    */
   template <typename T_attrs = float>
   Result<void> UpdateAttributes(const nlohmann::json& newAttrs) {
-    auto res = (*attributes)->template FromJson<T_attrs>(newAttrs);
+    auto res = current_attributes()->template FromJson<T_attrs>(newAttrs);
     if (res.status().ok()) {
       // Create a new UserAttributes object and update the inner std::shared_ptr
-      *attributes = std::make_shared<UserAttributes>(res.value());
+      std::atomic_store(attributes.get(),
+                        std::make_shared<UserAttributes>(res.value()));
     }
     return res;
   }
 
   nlohmann::json GetAttributes() const {
     // Dereference the outer std::shared_ptr to get the inner std::shared_ptr
-    return (*attributes)->ToJson();
+    return current_attributes()->ToJson();
   }
 
   /**
    * @brief Gets the entire metadata of the Variable.
    * @return The metadata in JSON form
    */
-  nlohmann::json getMetadata() const {
-    auto ret = getReducedMetadata();
-    auto attrs = GetAttributes();
-    // Check for not being a `nlohmann::json::object()`
-    if (attrs.is_object() && !attrs.empty()) {
-      if (!ret.contains("metadata")) {
-        ret["metadata"] = nlohmann::json::object();
-      }
-      ret["metadata"].merge_patch(attrs);
-    }
-    return ret;
+  nlohmann::json getMetadata() const { return getSharedMetadata(); }
+
+  /**
+   * @brief Gets the entire metadata of the Variable without copying it.
+   * The merge with the User Attributes is kept until they are replaced, so
+   * repeated calls share one value rather than merging again.
+   * @return The metadata, shared with the Variable
+   */
+  SharedJson getSharedMetadata() const { return merged_metadata()->metadata; }
+
+  /**
+   * @brief Gets the quantization declared on the Variable.
+   * It is parsed once per change of the User Attributes.
+   * @return The quantization, or a NotFoundError if the Variable is not
+   * quantized.
+   */
+  Result<Quantization> get_quantization() const {
+    return merged_metadata()->quantization;
   }
 
   /**
@@ -1386,11 +1576,13 @@ class Variable {
    * portions, if they exist
    * @return The reduced metadata in JSON form
    */
-  const nlohmann::json getReducedMetadata() const {
-    nlohmann::json ret = metadata;
-    ret["long_name"] = longName;
-    return metadata;
-  }
+  const nlohmann::json& getReducedMetadata() const { return metadata.get(); }
+
+  /**
+   * @brief The reduced metadata, shared rather than copied.
+   * See `getReducedMetadata()`.
+   */
+  const SharedJson& getSharedReducedMetadata() const { return metadata; }
 
   /**
    * @brief Checks if the User Attributes has changed in the Variable.
@@ -1401,7 +1593,7 @@ class Variable {
     // This works because the UserAttributes object is immutable and can only be
     // replaced.
     std::uintptr_t currentAddress =
-        reinterpret_cast<std::uintptr_t>(&(**attributes));
+        reinterpret_cast<std::uintptr_t>(current_attributes().get());
     return attributesAddress != currentAddress;
   }
 
@@ -1417,7 +1609,7 @@ class Variable {
       toPublish = std::make_shared<std::shared_ptr<bool>>(
           std::make_shared<bool>(shouldPublish));
     } else {
-      *toPublish = std::make_shared<bool>(shouldPublish);
+      std::atomic_store(toPublish.get(), std::make_shared<bool>(shouldPublish));
     }
   }
 
@@ -1513,15 +1705,236 @@ class Variable {
    * @return True if the metadata should get republished.
    */
   bool should_publish() const {
-    if (toPublish && *toPublish) {
-      // Deref the shared_ptr so we're not increasing refcount
-      return **toPublish;
+    if (toPublish) {
+      auto flag = std::atomic_load(toPublish.get());
+      if (flag) {
+        return *flag;
+      }
     }
     // If the flag was a nullptr, err on the side of caution and republish
     return true;
   }
 
  private:
+  template <typename, DimensionIndex, ReadWriteMode>
+  friend class Variable;
+
+  // Reads the data, requesting only the chunks `occupancy` marks as occupied
+  // unless it is null or does not describe this view. Quantized Variables
+  // read as float are dequantized on the fly.
+  template <ArrayOriginKind OriginKind>
+  Future<VariableData<T, R, OriginKind>> ReadSkipping(
+      const ChunkOccupancy* occupancy,
+      const Result<Quantization>& quantizationRes) {
+    std::optional<Quantization> quantization;
+    if constexpr (std::is_same_v<T, float>) {
+      if (quantizationRes.ok()) {
+        quantization = quantizationRes.value();
+      } else if (!absl::IsNotFound(quantizationRes.status())) {
+        return quantizationRes.status();
+      }
+    }
+    trace::Span span("Variable::Read", "variable");
+    if (span.active()) {
+      span.Arg("variable", variableName);
+      span.Arg("bytes", store.domain().num_elements() * dtype().size());
+    }
+    Future<SharedArray<T, R, OriginKind>> data;
+    if constexpr (OriginKind == offset_origin) {
+      if (occupancy && internal::OccupancyCovers(*occupancy, store)) {
+        data = tensorstore::MapFutureValue(
+            tensorstore::InlineExecutor{},
+            [](const SharedArray<void, dynamic_rank, offset_origin>& array)
+                -> Result<SharedArray<T, R, offset_origin>> {
+              MDIO_ASSIGN_OR_RETURN(auto typed,
+                                    tensorstore::StaticDataTypeCast<T>(array))
+              return tensorstore::StaticCast<SharedArray<T, R, offset_origin>,
+                                             tensorstore::unchecked>(
+                  std::move(typed));
+            },
+            internal::ReadOccupiedArray(store, *occupancy));
+      }
+    }
+    if (data.null()) {
+      data = tensorstore::Read<OriginKind>(store);
+    }
+    // We need to capture this to ensure the Variable doesn't get prematurely
+    // destoryed if its parent goes out of scope before the future resolves.
+    auto thisVar = std::make_shared<Variable<T, R, M>>(*this);
+    auto pair =
+        tensorstore::PromiseFuturePair<VariableData<T, R, OriginKind>>::Make();
+    data.ExecuteWhenReady(
+        [thisVar, quantization, promise = pair.promise](
+            tensorstore::ReadyFuture<SharedArray<T, R, OriginKind>> readyFut) {
+          auto ready_result = readyFut.result();
+          if (!ready_result.ok()) {
+            promise.SetResult(ready_result.status());
+          } else {
+            if constexpr (std::is_same_v<T, float>) {
+              if (quantization) {
+                trace::Span dequantize("Quantization::Dequantize", "variable");
+                // Both reads allocate a C order array.
+                auto& array = ready_result.value();
+                quantization->Dequantize(
+                    array.byte_strided_origin_pointer().get(),
+                    array.num_elements());
+              }
+            }
+            LabeledArray<T, R, OriginKind> labeledArray{thisVar->dimensions(),
+                                                        ready_result.value()};
+            VariableData<T, R, OriginKind> variableData{
+                thisVar->variableName, thisVar->longName,
+                thisVar->getSharedMetadata(), labeledArray};
+            promise.SetResult(variableData);
+          }
+        });
+
+    trace::EndWhenReady(std::move(span), pair.future);
+    return pair.future;
+  }
+
+  /**
+   * Writes an array with the shape of the Variable. Floats written to a
+   * quantized Variable are quantized into a private buffer first.
+   */
+  template <typename Array>
+  WriteFutures WriteArray(
+      const Array& values,
+      tensorstore::SourceDataReferenceRestriction reference) const {
+    trace::Span span("Variable::Write", "variable");
+    if (span.active()) {
+      span.Arg("variable", variableName);
+      span.Arg("bytes", values.num_elements() * dtype().size());
+    }
+    auto marked = MarkOccupied();
+    if (!marked.ok()) {
+      return marked;
+    }
+    auto written = WriteArrayUntraced(values, reference);
+    trace::EndWhenReady(std::move(span), written.commit_future);
+    return written;
+  }
+
+  // Marks the chunks this view covers in the stored occupancy bitmap, so that
+  // reads keep requesting them. A view the bitmap does not describe, e.g. a
+  // strided slice, drops the bitmap instead.
+  absl::Status MarkOccupied() const {
+    while (true) {
+      auto attrs = current_attributes();
+      auto cached = merged_metadata();
+      if (!attrs || !cached->occupancy) {
+        return absl::OkStatus();
+      }
+      if (cached->attributes != attrs) {
+        // Replaced in between, try again.
+        continue;
+      }
+      const ChunkOccupancy& occupancy = *cached->occupancy;
+      const bool covers = internal::OccupancyCovers(occupancy, store);
+      std::vector<Index> origin(occupancy.rank()), shape(occupancy.rank());
+      if (covers) {
+        auto domain = store.domain();
+        for (size_t i = 0; i < occupancy.rank(); ++i) {
+          origin[i] = domain[i].inclusive_min();
+          shape[i] = domain[i].size();
+        }
+        if (occupancy.AllInBox(origin, shape)) {
+          return absl::OkStatus();
+        }
+      }
+      auto attrsJson = attrs->ToJson();
+      if (covers) {
+        ChunkOccupancy marked = occupancy;
+        marked.MarkBox(origin, shape);
+        attrsJson["attributes"][internal::kChunkOccupancyKey] =
+            marked.ToJson();
+      } else {
+        attrsJson["attributes"].erase(internal::kChunkOccupancyKey);
+      }
+      MDIO_ASSIGN_OR_RETURN(
+          auto updated,
+          UserAttributes::FromVariableJson({{"metadata", attrsJson}}))
+      auto replacement = std::make_shared<UserAttributes>(std::move(updated));
+      if (std::atomic_compare_exchange_strong(attributes.get(), &attrs,
+                                              replacement)) {
+        return absl::OkStatus();
+      }
+    }
+  }
+
+  template <typename Array>
+  WriteFutures WriteArrayUntraced(
+      const Array& values,
+      tensorstore::SourceDataReferenceRestriction reference) const {
+    if constexpr (std::is_same_v<T, float>) {
+      const auto& quantization = merged_metadata()->quantization;
+      if (quantization.ok()) {
+        auto codes = tensorstore::AllocateArray<float>(
+            values.domain(), ContiguousLayoutOrder::c,
+            tensorstore::default_init);
+        float* dst = codes.byte_strided_origin_pointer().get();
+        const float* src = values.byte_strided_origin_pointer().get();
+        if (!tensorstore::IsContiguousLayout(values,
+                                             ContiguousLayoutOrder::c)) {
+          tensorstore::CopyArray(values, codes);
+          src = dst;
+        }
+        auto status =
+            quantization.value().Quantize(src, dst, codes.num_elements());
+        if (!status.ok()) {
+          return status;
+        }
+        // Nothing else holds the codes, so they need not be copied again.
+        return tensorstore::Write(
+            codes, store, tensorstore::can_reference_source_data_indefinitely);
+      } else if (!absl::IsNotFound(quantization.status())) {
+        return quantization.status();
+      }
+    }
+    return tensorstore::Write(values, store, reference);
+  }
+
+  // The current attributes. Updates replace rather than modify them, so a
+  // reader on another thread keeps a consistent snapshot.
+  std::shared_ptr<UserAttributes> current_attributes() const {
+    return std::atomic_load(attributes.get());
+  }
+
+  // The metadata merged with the current attributes, rebuilt only after
+  // either was replaced.
+  std::shared_ptr<const internal::MergedMetadata> merged_metadata() const {
+    auto attrs = current_attributes();
+    auto cached = merged ? std::atomic_load(merged.get()) : nullptr;
+    if (cached && cached->attributes == attrs &&
+        cached->reduced.shares(metadata)) {
+      return cached;
+    }
+    auto next = std::make_shared<internal::MergedMetadata>();
+    next->attributes = attrs;
+    next->reduced = metadata;
+    next->metadata = metadata;
+    auto attrsJson = attrs ? attrs->ToJson() : nlohmann::json::object();
+    // Check for not being a `nlohmann::json::object()`
+    if (attrsJson.is_object() && !attrsJson.empty()) {
+      auto& ret = next->metadata.mutate();
+      if (!ret.contains("metadata")) {
+        ret["metadata"] = nlohmann::json::object();
+      }
+      ret["metadata"].merge_patch(attrsJson);
+    }
+    next->quantization = internal::GetQuantization(attrsJson);
+    auto occupancy = internal::GetChunkOccupancy(attrsJson);
+    if (occupancy.ok()) {
+      next->occupancy =
+          std::make_shared<const ChunkOccupancy>(std::move(occupancy).value());
+    }
+    std::shared_ptr<const internal::MergedMetadata> result = std::move(next);
+    if (merged) {
+      std::atomic_store(merged.get(), result);
+    }
+    return result;
+  }
+
   /**
    * This method should NEVER be called by the user.
    * This method is intended to be called as a callback by the Dataset
@@ -1532,9 +1945,9 @@ class Variable {
     // We only want to update the address if the UserAttributes object has
     // changed location This indicates a new UserAttributes object has taken the
     // place of the existing one.
-    if (attributes.get() != nullptr && attributes->get() != nullptr) {
+    if (attributes.get() != nullptr && current_attributes() != nullptr) {
       std::uintptr_t newAddress =
-          reinterpret_cast<std::uintptr_t>(&(**attributes));
+          reinterpret_cast<std::uintptr_t>(current_attributes().get());
       attributesAddress = newAddress;
     }
     // It is fine that this will only change in the "collection" instance of the
@@ -1545,8 +1958,8 @@ class Variable {
   std::string variableName;
   // optional, default to name
   std::string longName;
-  // other metadata
-  ::nlohmann::json metadata;
+  // other metadata, shared by the copies and slices of the Variable
+  SharedJson metadata;
   // delegate the I/O to the tensorstore
   tensorstore::TensorStore<T, R, M> store;
   // The address of the attributes. This MUST NEVER be touched by the user.
@@ -1554,6 +1967,9 @@ class Variable {
   // The metadata will need to be updated if the trim util was used on it.
   std::shared_ptr<std::shared_ptr<bool>> toPublish =
       std::make_shared<std::shared_ptr<bool>>(std::make_shared<bool>(false));
+  // The metadata merged with the User Attributes, see getSharedMetadata().
+  std::shared_ptr<std::shared_ptr<const internal::MergedMetadata>> merged =
+      std::make_shared<std::shared_ptr<const internal::MergedMetadata>>();
 };
 
 // Tensorstore Array's don't have an IndexDomain and so they can't be slice with
@@ -1659,7 +2075,7 @@ struct LabeledArray {
 template <typename T, DimensionIndex R, ArrayOriginKind OriginKind>
 struct VariableData {
   VariableData(const std::string& variableName, const std::string& longName,
-               const ::nlohmann::json& metdata,
+               const SharedJson& metdata,
                const LabeledArray<T, R, OriginKind>& data)
       : variableName(variableName),
         longName(longName),
@@ -1786,8 +2202,8 @@ struct VariableData {
   std::string variableName;
   // optional, default to name
   std::string longName;
-  // other metadata
-  ::nlohmann::json metadata;
+  // other metadata, shared with the Variable it was read from
+  SharedJson metadata;
   // the data
   LabeledArray<T, R, OriginKind> data;
 };
@@ -1819,7 +2235,47 @@ Result<VariableData<T, R, OriginKind>> from_variable(
 
   return VariableData<T, R, OriginKind>{
       variable.get_variable_name(), variable.get_long_name(),
-      variable.getReducedMetadata(), std::move(labeled_array)};
+      variable.getSharedReducedMetadata(), std::move(labeled_array)};
 }
+
+namespace internal {
+
+/**
+ * @brief Slices a Variable down to a labeled region, so that data with the
+ * region's shape can be written there.
+ * @param variable The Variable to be written.
+ * @param domain The region, unlabeled dimensions are not sliced.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M, DimensionIndex DR>
+Result<Variable<T, R, M>> SliceToDomain(Variable<T, R, M> variable,
+                                        IndexDomainView<DR> domain) {
+  std::vector<RangeDescriptor<Index>> slices;
+  for (DimensionIndex i = 0; i < domain.rank(); ++i) {
+    // structarrays carry an unlabeled byte dimension.
+    if (!domain.labels()[i].empty()) {
+      slices.push_back({domain.labels()[i], domain[i].inclusive_min(),
+                        domain[i].exclusive_max(), 1});
+    }
+  }
+  if (slices.empty()) {
+    return variable;
+  }
+  return variable.slice(slices);
+}
+
+/**
+ * @brief Slices a Variable down to the region some data covers, so that the
+ * data can be written there.
+ * @param variable The Variable to be written.
+ * @param data The data, its labeled domain selects the region.
+ */
+template <typename T, DimensionIndex R, ReadWriteMode M,
+          ArrayOriginKind OriginKind>
+Result<Variable<T, R, M>> SliceToData(
+    Variable<T, R, M> variable, const VariableData<T, R, OriginKind>& data) {
+  return SliceToDomain(std::move(variable), data.dimensions());
+}
+
+}  // namespace internal
 };  // namespace mdio
 #endif  // MDIO_VARIABLE_H_
@@ -0,0 +1,180 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The per-call cost of getting, slicing and reading small windows of a
+// Variable with a realistic amount of metadata, and of moving a window over a
+// Dataset with isel or a SelectionPlan. The argument is the number of user
+// attributes, so the metadata handling shows up against the I/O:
+//   mdio_variable_benchmark --benchmark_counters_tabular=true
+
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+
+#include "mdio/dataset.h"
+#include "mdio/selection_plan.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+/*NOLINT*/ const std::string kPath = "variable_benchmark.mdio";
+
+mdio::Result<mdio::Dataset> Setup(int attributes) {
+  auto json = ::nlohmann::json::parse(R"(
+{
+  "metadata": {
+    "name": "variable_benchmark",
+    "apiVersion": "1.0.0",
+    "createdOn": "2024-06-01T12:00:00.000000-05:00"
+  },
+  "variables": [
+    {
+      "name": "seismic",
+      "dataType": "float32",
+      "dimensions": [
+        {"name": "inline", "size": 256},
+        {"name": "crossline", "size": 16},
+        {"name": "time", "size": 16}
+      ],
+      "longName": "Seismic amplitude",
+      "metadata": {
+        "chunkGrid": {
+          "name": "regular",
+          "configuration": { "chunkShape": [4, 16, 16] }
+        }
+      }
+    }
+  ]
+}
+  )");
+  std::filesystem::remove_all(kPath);
+  MDIO_ASSIGN_OR_RETURN(
+      auto ds,
+      mdio::Dataset::from_json(json, kPath, mdio::constants::kCreateClean)
+          .result())
+  MDIO_ASSIGN_OR_RETURN(auto seismic, ds.variables.get<float>("seismic"))
+  nlohmann::json attrs = nlohmann::json::object();
+  for (int i = 0; i < attributes; ++i) {
+    attrs["attributes"]["attribute_" + std::to_string(i)] = {
+        {"description", "A user attribute of the benchmark Variable"},
+        {"values", {i, i + 1, i + 2}}};
+  }
+  auto updated = seismic.UpdateAttributes(attrs);
+  if (!updated.status().ok()) {
+    return updated.status();
+  }
+  return ds;
+}
+
+void BM_VariableGet(benchmark::State& state) {  // NOLINT
+  auto ds = Setup(static_cast<int>(state.range(0)));
+  if (!ds.ok()) {
+    state.SkipWithError(ds.status().ToString().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    auto seismic = ds.value().variables.get<float>("seismic");
+    benchmark::DoNotOptimize(seismic);
+  }
+}
+BENCHMARK(BM_VariableGet)->Arg(0)->Arg(64)->Arg(1024);
+
+void BM_VariableSlice(benchmark::State& state) {  // NOLINT
+  auto ds = Setup(static_cast<int>(state.range(0)));
+  if (!ds.ok()) {
+    state.SkipWithError(ds.status().ToString().c_str());
+    return;
+  }
+  auto seismic = ds.value().variables.get<float>("seismic").value();
+  mdio::Index inline_ = 0;
+  for (auto _ : state) {
+    mdio::RangeDescriptor<mdio::Index> range = {"inline", inline_,
+                                                inline_ + 4, 1};
+    auto slice = seismic.isel(range);
+    benchmark::DoNotOptimize(slice);
+    inline_ = (inline_ + 4) % 256;
+  }
+}
+BENCHMARK(BM_VariableSlice)->Arg(0)->Arg(64)->Arg(1024);
+
+void BM_VariableReadWindow(benchmark::State& state) {  // NOLINT
+  auto ds = Setup(static_cast<int>(state.range(0)));
+  if (!ds.ok()) {
+    state.SkipWithError(ds.status().ToString().c_str());
+    return;
+  }
+  mdio::Index inline_ = 0;
+  for (auto _ : state) {
+    mdio::RangeDescriptor<mdio::Index> range = {"inline", inline_,
+                                                inline_ + 4, 1};
+    auto window = ds.value().isel(range);
+    if (!window.ok()) {
+      state.SkipWithError(window.status().ToString().c_str());
+      break;
+    }
+    auto seismic = window.value().variables.get<float>("seismic").value();
+    auto data = seismic.Read().result();
+    if (!data.ok()) {
+      state.SkipWithError(data.status().ToString().c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(data.value().metadata);
+    inline_ = (inline_ + 4) % 256;
+  }
+}
+BENCHMARK(BM_VariableReadWindow)->Arg(0)->Arg(64)->Arg(1024);
+
+void BM_DatasetIsel(benchmark::State& state) {  // NOLINT
+  auto ds = Setup(static_cast<int>(state.range(0)));
+  if (!ds.ok()) {
+    state.SkipWithError(ds.status().ToString().c_str());
+    return;
+  }
+  mdio::Index inline_ = 0;
+  for (auto _ : state) {
+    mdio::RangeDescriptor<mdio::Index> range = {"inline", inline_,
+                                                inline_ + 4, 1};
+    auto window = ds.value().isel(range);
+    benchmark::DoNotOptimize(window);
+    inline_ = (inline_ + 4) % 256;
+  }
+}
+BENCHMARK(BM_DatasetIsel)->Arg(0)->Arg(1024);
+
+void BM_SelectionPlanAt(benchmark::State& state) {  // NOLINT
+  auto ds = Setup(static_cast<int>(state.range(0)));
+  if (!ds.ok()) {
+    state.SkipWithError(ds.status().ToString().c_str());
+    return;
+  }
+  mdio::RangeDescriptor<mdio::Index> range = {"inline", 0, 4, 1};
+  auto plan = mdio::SelectionPlan::Compile(ds.value(), {range});
+  if (!plan.ok()) {
+    state.SkipWithError(plan.status().ToString().c_str());
+    return;
+  }
+  mdio::Index inline_ = 0;
+  for (auto _ : state) {
+    auto window = plan.value().At({inline_});
+    benchmark::DoNotOptimize(window);
+    inline_ = (inline_ + 4) % 256;
+  }
+}
+BENCHMARK(BM_SelectionPlanAt)->Arg(0)->Arg(1024);
+
+}  // namespace
@@ -16,27 +16,88 @@
 #define MDIO_VARIABLE_COLLECTION_H_
 
 #include <algorithm>
+#include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "mdio/quantization.h"
 #include "mdio/variable.h"
+#include "tensorstore/cast.h"
 
 namespace mdio {
+namespace internal {
+/**
+ * @brief The Variable with a static data type, rank and mode.
+ * The metadata and User Attributes are shared with `variable`.
+ */
+template <typename T = void, DimensionIndex R = dynamic_rank,
+          ReadWriteMode M = ReadWriteMode::dynamic>
+Result<Variable<T, R, M>> CastVariable(const Variable<>& variable) {
+  auto store = variable.get_store();
+  if constexpr (std::is_same_v<T, float>) {
+    // Quantized Variables hold integer codes; Read and Write on the float
+    // Variable convert them.
+    if (store.dtype() != constants::kFloat32 &&
+        GetQuantization(variable).ok()) {
+      MDIO_ASSIGN_OR_RETURN(store, tensorstore::Cast<float>(store))
+    }
+  }
+  auto cast_store =
+      tensorstore::StaticCast<tensorstore::TensorStore<T, R, M>>(store);
+
+  if (!cast_store.ok()) {
+    return cast_store.status();
+  }
+
+  return Variable<T, R, M>{variable, cast_store.value()};
+}
+}  // namespace internal
+
 /**
  * @brief A collection of variables.
  * Provides type erasure for the coordinates and variables.
  * This is intended to be an underlying data structure for the Dataset class.
+ * Any number of threads may read the collection while one adds to it. Readers
+ * see an immutable snapshot of the variables, and an addition publishes a new
+ * snapshot without blocking them.
  */
 class VariableCollection {
  public:
+  /// An immutable view of the variables at one point in time.
+  using Snapshot = std::shared_ptr<
+      const std::unordered_map<std::string, std::shared_ptr<const Variable<>>>>;
+
   // Default constructor
-  VariableCollection() = default;
+  VariableCollection() : variables(std::make_shared<const Map>()) {}
 
   VariableCollection(
-      std::initializer_list<std::pair<const std::string, Variable<>>> list)
-      : variables(list) {}
+      std::initializer_list<std::pair<const std::string, Variable<>>> list) {
+    auto map = std::make_shared<Map>();
+    for (const auto& [label, variable] : list) {
+      (*map)[label] = std::make_shared<const Variable<>>(variable);
+    }
+    variables = std::move(map);
+  }
+
+  /// A collection of the variables of `snapshot`, e.g. built in one go.
+  explicit VariableCollection(Snapshot snapshot)
+      : variables(std::move(snapshot)) {}
+
+  // Copies share the snapshot, but not later additions.
+  VariableCollection(const VariableCollection& other)
+      : variables(other.snapshot()) {}
+
+  VariableCollection& operator=(const VariableCollection& other) {
+    if (this != &other) {
+      auto next = other.snapshot();
+      std::lock_guard<std::mutex> lock(writer);
+      std::atomic_store(&variables, std::move(next));
+    }
+    return *this;
+  }
 
   /**
    * @brief Adds a variable with the specified label to the dataset.
@@ -47,9 +108,21 @@ class VariableCollection {
    * @param variable The variable to be added.
    */
   void add(const std::string& label, const Variable<>& variable) {
-    variables[label] = variable;
+    auto entry = std::make_shared<const Variable<>>(variable);
+    std::lock_guard<std::mutex> lock(writer);
+    // Only the pointers are copied.
+    auto next = std::make_shared<Map>(*snapshot());
+    (*next)[label] = std::move(entry);
+    std::atomic_store(&variables, Snapshot(std::move(next)));
   }
 
+  /**
+   * @brief The variables as they are now.
+   * Later additions do not change the snapshot, so several variables can be
+   * looked up consistently while another thread adds to the collection.
+   */
+  Snapshot snapshot() const { return std::atomic_load(&variables); }
+
   /**
    * Retrieves a variable from the dataset based on the given label.
    *
@@ -66,24 +139,13 @@ class VariableCollection {
   template <typename T = void, DimensionIndex R = dynamic_rank,
             ReadWriteMode M = ReadWriteMode::dynamic>
   Result<Variable<T, R, M>> get(const std::string& label) const {
-    if (!variables.count(label)) {
+    auto current = snapshot();
+    auto found = current->find(label);
+    if (found == current->end()) {
       return absl::NotFoundError("Label '" + label +
                                  "' not found in the stores map");
     }
-
-    auto cast_store =
-        tensorstore::StaticCast<tensorstore::TensorStore<T, R, M>>(
-            variables.at(label).get_store());
-
-    if (!cast_store.ok()) {
-      return cast_store.status();
-    }
-
-    return Variable<T, R, M>{variables.at(label).get_variable_name(),
-                             variables.at(label).get_long_name(),
-                             variables.at(label).getReducedMetadata(),
-                             cast_store.value(),
-                             variables.at(label).attributes};
+    return internal::CastVariable<T, R, M>(*found->second);
   }
 
   /**
@@ -103,12 +165,14 @@ class VariableCollection {
   template <typename T = void, DimensionIndex R = dynamic_rank,
             ReadWriteMode M = ReadWriteMode::dynamic>
   Result<Variable<T, R, M>> at(const std::string& label) const {
-    if (!variables.count(label)) {
+    auto current = snapshot();
+    auto found = current->find(label);
+    if (found == current->end()) {
       return absl::NotFoundError("Label '" + label +
                                  "' not found in the stores map");
     }
 
-    return variables.at(label);
+    return *found->second;
   }
 
   /**
@@ -118,7 +182,7 @@ class VariableCollection {
    * @return true if the VariableCollection has that label, false otherwise.
    */
   bool contains_key(const std::string& label) const {
-    return variables.count(label) != 0;
+    return snapshot()->count(label) != 0;
   }
 
   /**
@@ -131,7 +195,7 @@ class VariableCollection {
    */
   std::vector<std::string> get_keys() const {
     std::vector<std::string> keys;
-    for (auto& [key, _] : variables) {
+    for (auto& [key, _] : *snapshot()) {
       keys.emplace_back(key);
     }
     return keys;
@@ -155,17 +219,13 @@ class VariableCollection {
   }
 
  private:
-  // Define the iterator type for the VariableCollection
-  using iterator = std::unordered_map<std::string, Variable<>>::iterator;
-  using const_iterator =
-      std::unordered_map<std::string, Variable<>>::const_iterator;
-
-  const_iterator begin() const { return variables.cbegin(); }
-  const_iterator end() const { return variables.cend(); }
-  const_iterator cbegin() const { return variables.cbegin(); }
-  const_iterator cend() const { return variables.cend(); }
+  using Map =
+      std::unordered_map<std::string, std::shared_ptr<const Variable<>>>;
 
-  std::unordered_map<std::string, Variable<>> variables;
+  // Replaced, never modified, by add. Accessed with std::atomic_load/store.
+  Snapshot variables;
+  // Serializes additions, so that none is lost.
+  std::mutex writer;
 };
 }  // namespace mdio
 
@@ -0,0 +1,188 @@
+// Copyright 2024 TGS
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//    http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// The borrowed writes are tested in their own binary, because counting the
+// allocations replaces the global operator new.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "mdio/variable.h"
+
+// clang-format off
+#include <nlohmann/json.hpp>  // NOLINT
+// clang-format on
+
+namespace {
+
+// Allocations of at least a chunk's worth of bytes, made while counting.
+std::atomic<bool> counting{false};
+std::atomic<int64_t> largeBytes{0};
+constexpr size_t kLargeAllocation = 64 * 1024;
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (counting && size >= kLargeAllocation) {
+    largeBytes += size;
+  }
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+/*NOLINT*/ const std::string kTestPath = "zarrs/testing/borrowed_write";
+constexpr mdio::Index kInlines = 256;
+constexpr mdio::Index kSamples = 1024;
+
+mdio::Result<mdio::Variable<float>> SETUP() {
+  std::filesystem::remove_all(kTestPath);
+  // clang-format off
+  ::nlohmann::json spec = {
+      {"driver", "zarr"},
+      {"kvstore", {{"driver", "file"}, {"path", kTestPath}}},
+      {"attributes",
+          {{"long_name", "borrowed"},
+           {"dimension_names", {"inline", "time"}}}},
+      {"metadata",
+          {{"compressor", nullptr},
+           {"dtype", "<f4"},
+           {"shape", {kInlines, kSamples}},
+           {"chunks", {64, kSamples}},
+           {"dimension_separator", "/"}}}};
+  // clang-format on
+  return mdio::Variable<float>::Open(spec, mdio::constants::kCreateClean)
+      .result();
+}
+
+std::vector<float> MakeSamples(float offset) {
+  std::vector<float> samples(kInlines * kSamples);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = offset + i;
+  }
+  return samples;
+}
+
+void ExpectStored(mdio::Variable<float> variable, float offset) {
+  auto stored = variable.Read().result();
+  ASSERT_TRUE(stored.status().ok()) << stored.status();
+  auto values = stored.value().get_data_accessor();
+  for (mdio::Index i = 0; i < kInlines; i += 17) {
+    for (mdio::Index k = 0; k < kSamples; k += 31) {
+      ASSERT_EQ(values({i, k}), offset + i * kSamples + k);
+    }
+  }
+}
+
+// The bytes of large allocations made by a borrowed write of the samples.
+int64_t CountWrite(const mdio::Variable<float>& variable,
+                   const std::vector<float>& samples,
+                   tensorstore::SourceDataReferenceRestriction reference) {
+  largeBytes = 0;
+  counting = true;
+  auto written = variable.Write(samples, variable.dimensions(), reference);
+  auto status = written.commit_future.status();
+  counting = false;
+  EXPECT_TRUE(status.ok()) << status;
+  return largeBytes;
+}
+
+TEST(VariableWrite, borrowedArray) {
+  auto variable = SETUP();
+  ASSERT_TRUE(variable.status().ok()) << variable.status();
+  auto samples = MakeSamples(0);
+
+  // Write the second half of the inlines from the middle of the buffer.
+  auto half = variable.value().slice(
+      mdio::RangeDescriptor<mdio::Index>({"inline", 128, 256, 1}));
+  ASSERT_TRUE(half.status().ok()) << half.status();
+  auto source = tensorstore::Array(samples.data() + 128 * kSamples,
+                                   {kInlines / 2, kSamples});
+  auto written = variable.value().Write(source, half.value().dimensions());
+  ASSERT_TRUE(written.commit_future.status().ok());
+
+  auto low = variable.value().slice(
+      mdio::RangeDescriptor<mdio::Index>({"inline", 0, 128, 1}));
+  written = variable.value().Write(
+      tensorstore::span<const float>(samples.data(), 128 * kSamples),
+      low.value().dimensions(),
+      tensorstore::can_reference_source_data_until_commit);
+  ASSERT_TRUE(written.commit_future.status().ok());
+  ExpectStored(variable.value(), 0);
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(VariableWrite, mismatch) {
+  auto variable = SETUP();
+  ASSERT_TRUE(variable.status().ok()) << variable.status();
+  std::vector<float> samples(10);
+  auto status = variable.value()
+                    .Write(samples, variable.value().dimensions())
+                    .copy_future.status();
+  EXPECT_TRUE(absl::IsInvalidArgument(status)) << status;
+
+  auto source = tensorstore::Array(samples.data(), {2, 5});
+  status = variable.value()
+               .Write(source, variable.value().dimensions())
+               .copy_future.status();
+  EXPECT_TRUE(absl::IsInvalidArgument(status)) << status;
+
+  std::vector<int32_t> ints(kInlines * kSamples);
+  mdio::Variable<> untyped = variable.value();
+  status = untyped
+               .Write(tensorstore::Array(ints.data(), {kInlines, kSamples}),
+                      untyped.dimensions())
+               .copy_future.status();
+  EXPECT_TRUE(absl::IsInvalidArgument(status)) << status;
+  std::filesystem::remove_all(kTestPath);
+}
+
+TEST(VariableWrite, referencedWithoutCopy) {
+  auto variable = SETUP();
+  ASSERT_TRUE(variable.status().ok()) << variable.status();
+  const int64_t blockBytes = kInlines * kSamples * sizeof(float);
+  auto samples = MakeSamples(0);
+  // Warm up the chunk cache and the file handles.
+  CountWrite(variable.value(), samples,
+             tensorstore::cannot_reference_source_data);
+
+  int64_t copied = CountWrite(variable.value(), samples,
+                              tensorstore::cannot_reference_source_data);
+  samples = MakeSamples(1);
+  int64_t referenced =
+      CountWrite(variable.value(), samples,
+                 tensorstore::can_reference_source_data_until_commit);
+  EXPECT_GE(copied, blockBytes) << "The default write copies the block";
+  EXPECT_LE(referenced + blockBytes, copied)
+      << "A referenced write skips the copy of the block";
+  ExpectStored(variable.value(), 1);
+  std::filesystem::remove_all(kTestPath);
+}
+
+}  // namespace